@@ -0,0 +1,251 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "autocropper.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "kernels/pixelkernels.h"
+
+namespace
+{
+    bool Contains(const Takoyaki::Rect& outer, const Takoyaki::Rect& inner)
+    {
+        return inner.m_X >= outer.m_X && inner.m_Y >= outer.m_Y &&
+            inner.m_X + inner.m_Width <= outer.m_X + outer.m_Width &&
+            inner.m_Y + inner.m_Height <= outer.m_Y + outer.m_Height;
+    }
+
+    Takoyaki::Rect GetUnion(const Takoyaki::Rect& a, const Takoyaki::Rect& b)
+    {
+        int32_t left = std::min(a.m_X, b.m_X);
+        int32_t top = std::min(a.m_Y, b.m_Y);
+        int32_t right = std::max(a.m_X + static_cast<int32_t>(a.m_Width), b.m_X + static_cast<int32_t>(b.m_Width));
+        int32_t bottom = std::max(a.m_Y + static_cast<int32_t>(a.m_Height), b.m_Y + static_cast<int32_t>(b.m_Height));
+
+        return { left, top, static_cast<uint32_t>(right - left), static_cast<uint32_t>(bottom - top) };
+    }
+
+    // Largest distance any edge of inner lies inside outer
+    uint32_t GetLargestInset(const Takoyaki::Rect& outer, const Takoyaki::Rect& inner)
+    {
+        uint32_t left = static_cast<uint32_t>(inner.m_X - outer.m_X);
+        uint32_t top = static_cast<uint32_t>(inner.m_Y - outer.m_Y);
+        uint32_t right = (outer.m_X + outer.m_Width) - (inner.m_X + inner.m_Width);
+        uint32_t bottom = (outer.m_Y + outer.m_Height) - (inner.m_Y + inner.m_Height);
+
+        return std::max({ left, top, right, bottom });
+    }
+}
+
+Takoyaki::AutoCropper::AutoCropper(uint32_t probeInterval, uint32_t windowProbes) :
+    m_ProbeInterval(probeInterval != 0 ? probeInterval : 1),
+    m_WindowProbes(windowProbes != 0 ? windowProbes : 1)
+{
+    m_History.resize(m_WindowProbes);
+}
+
+void Takoyaki::AutoCropper::Reset(uint32_t width, uint32_t height)
+{
+    m_Width = width;
+    m_Height = height;
+    m_Crop = { 0, 0, width, height };
+
+    m_FramesUntilProbe = 0;
+    m_HistoryNext = 0;
+    m_HistorySize = 0;
+    m_HasPrevious = false;
+}
+
+bool Takoyaki::AutoCropper::BeginFrame()
+{
+    if (m_FramesUntilProbe > 0)
+    {
+        --m_FramesUntilProbe;
+        return false;
+    }
+
+    m_FramesUntilProbe = m_ProbeInterval - 1;
+    return true;
+}
+
+void Takoyaki::AutoCropper::Analyze(const FrameView& frame)
+{
+    if (!frame.IsValid())
+        return;
+
+    if (frame.m_Width != m_Width || frame.m_Height != m_Height)
+        Reset(frame.m_Width, frame.m_Height);
+
+    ++m_Probes;
+
+    Rect live;
+    bool hasLive = FindLiveRect(frame, live);
+
+    m_Previous.resize(static_cast<size_t>(m_Width) * m_Height);
+    for (uint32_t y = 0; y < m_Height; ++y)
+        memcpy(m_Previous.data() + static_cast<size_t>(y) * m_Width, frame.GetRow(y), m_Width * 4);
+
+    m_HasPrevious = true;
+
+    UpdateCrop(hasLive, live);
+}
+
+bool Takoyaki::AutoCropper::FindLiveRect(const FrameView& frame, Rect& outRect)
+{
+    const PixelKernels& kernels = GetPixelKernels();
+    const uint32_t width = m_Width;
+    const uint32_t height = m_Height;
+
+    // Letterbox bars share one colour, so the top left pixel stands in for all four edges
+    m_ColourRow.assign(width, frame.GetRow(0)[0]);
+    const uint32_t* colour = m_ColourRow.data();
+
+    auto previous = [&](uint32_t y) { return m_Previous.data() + static_cast<size_t>(y) * width; };
+    auto isUniformRow = [&](uint32_t y) { return kernels.m_MatchRowPrefix(frame.GetRow(y), colour, width, m_Tolerance) == width; };
+    auto isStaticRow = [&](uint32_t y) { return m_HasPrevious && kernels.m_MatchRowPrefix(frame.GetRow(y), previous(y), width, m_Tolerance) == width; };
+
+    const uint32_t maxStaticRows = static_cast<uint32_t>(height * m_MaxStaticFraction);
+    const uint32_t maxStaticColumns = static_cast<uint32_t>(width * m_MaxStaticFraction);
+
+    // Rows first, uniform ones and then the unchanged ones below them. Unchanged rows only
+    // count if a changed row follows within maxStaticRows, since a run that reaches the
+    // limit says nothing about where the content starts.
+    uint32_t top = 0;
+    while (top < height && isUniformRow(top))
+        ++top;
+
+    if (top == height)
+        return false;
+
+    uint32_t staticTop = top;
+    while (staticTop < height && staticTop - top < maxStaticRows && isStaticRow(staticTop))
+        ++staticTop;
+
+    if (staticTop < height && staticTop - top < maxStaticRows)
+        top = staticTop;
+
+    uint32_t bottom = height;
+    while (bottom > top && isUniformRow(bottom - 1))
+        --bottom;
+
+    uint32_t staticBottom = bottom;
+    while (staticBottom > top && bottom - staticBottom < maxStaticRows && isStaticRow(staticBottom - 1))
+        --staticBottom;
+
+    if (staticBottom > top && bottom - staticBottom < maxStaticRows)
+        bottom = staticBottom;
+
+    if (bottom == top)
+        return false;
+
+    // Then columns, as the shortest matching run at each end of the remaining rows. The
+    // kernels stop at the first mismatch, so this costs about the border's own area.
+    uint32_t uniformLeft = width;
+    uint32_t uniformRight = width;
+    uint32_t staticLeft = m_HasPrevious ? width : 0;
+    uint32_t staticRight = m_HasPrevious ? width : 0;
+
+    for (uint32_t y = top; y < bottom; ++y)
+    {
+        const uint32_t* row = frame.GetRow(y);
+
+        if (uniformLeft != 0)
+            uniformLeft = std::min(uniformLeft, kernels.m_MatchRowPrefix(row, colour, uniformLeft, m_Tolerance));
+        if (uniformRight != 0)
+            uniformRight = std::min(uniformRight, kernels.m_MatchRowSuffix(row + width - uniformRight, colour, uniformRight, m_Tolerance));
+        if (staticLeft != 0)
+            staticLeft = std::min(staticLeft, kernels.m_MatchRowPrefix(row, previous(y), staticLeft, m_Tolerance));
+        if (staticRight != 0)
+            staticRight = std::min(staticRight, kernels.m_MatchRowSuffix(row + width - staticRight, previous(y) + width - staticRight, staticRight, m_Tolerance));
+    }
+
+    // Same limit as for rows, and a run over all of the width means nothing changed
+    auto getInset = [&](uint32_t uniform, uint32_t unchanged)
+    {
+        return unchanged > uniform && unchanged < width && unchanged - uniform < maxStaticColumns ? unchanged : uniform;
+    };
+
+    uint32_t left = getInset(uniformLeft, staticLeft);
+    uint32_t right = getInset(uniformRight, staticRight);
+
+    if (left + right >= width)
+        return false;
+
+    outRect = { static_cast<int32_t>(left), static_cast<int32_t>(top), width - left - right, bottom - top };
+    return true;
+}
+
+void Takoyaki::AutoCropper::UpdateCrop(bool hasLive, const Rect& live)
+{
+    m_History[m_HistoryNext] = hasLive ? live : Rect{};
+    m_HistoryNext = (m_HistoryNext + 1) % m_WindowProbes;
+    m_HistorySize = std::min(m_HistorySize + 1, m_WindowProbes);
+
+    // Never hide content that is showing now
+    if (hasLive && !Contains(m_Crop, live))
+    {
+        m_Crop = GetUnion(m_Crop, live);
+        ++m_Grows;
+        return;
+    }
+
+    if (m_HistorySize < m_WindowProbes)
+        return;
+
+    bool hasTarget = false;
+    Rect target;
+
+    for (const Rect& rect : m_History)
+    {
+        if (rect.m_Width == 0)
+            continue;
+
+        target = hasTarget ? GetUnion(target, rect) : rect;
+        hasTarget = true;
+    }
+
+    // A window with nothing live at all, a still or blank region, says nothing about where
+    // its content is, so keep the crop
+    if (!hasTarget || GetLargestInset(m_Crop, target) < m_MinShrink)
+        return;
+
+    m_Crop = target;
+    ++m_Shrinks;
+
+    // The next shrink needs a full window of probes that all fit the new crop
+    m_HistoryNext = 0;
+    m_HistorySize = 0;
+}
+
+std::string Takoyaki::AutoCropper::GetReport() const
+{
+    uint64_t area = static_cast<uint64_t>(m_Width) * m_Height;
+    uint64_t cropArea = static_cast<uint64_t>(m_Crop.m_Width) * m_Crop.m_Height;
+
+    char report[192];
+    snprintf(report, sizeof(report), "Auto-crop: %ux%u at (%d, %d) of %ux%u, %.1f%% of the pixels, after %llu probes, %llu grows and %llu shrinks\n",
+        m_Crop.m_Width, m_Crop.m_Height, m_Crop.m_X, m_Crop.m_Y, m_Width, m_Height,
+        area > 0 ? 100.0 * cropArea / area : 100.0,
+        static_cast<unsigned long long>(m_Probes),
+        static_cast<unsigned long long>(m_Grows),
+        static_cast<unsigned long long>(m_Shrinks));
+
+    return report;
+}
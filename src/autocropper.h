@@ -0,0 +1,104 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "frame.h"
+
+namespace Takoyaki
+{
+    // Finds borders of the capture region that never show anything, letterbox bars of one
+    // colour or window chrome that does not change, so that only the rect inside them has to
+    // be captured and copied. Every few frames the whole region is captured as a probe, and
+    // each probe's live rect is what remains after peeling uniform and unchanged rows and
+    // columns off its edges. The crop grows as soon as a probe has content outside it, but
+    // only shrinks to the union of a full window of probes, and by at least a minimum step,
+    // so it does not jitter. Content that appears in a cropped border shows up at the next
+    // probe.
+    class AutoCropper
+    {
+    public:
+        // probeInterval frames between probes, windowProbes probes that a shrink must hold for
+        AutoCropper(uint32_t probeInterval = 30, uint32_t windowProbes = 8);
+        ~AutoCropper() = default;
+
+        // Forgets everything and uncrops, for a region of width x height
+        void Reset(uint32_t width, uint32_t height);
+
+        // Call once per frame. Returns true when this frame must capture the whole region
+        // and be passed to Analyze.
+        bool BeginFrame();
+
+        // frame is the whole region, as captured, before anything is drawn into it
+        void Analyze(const FrameView& frame);
+
+    public:
+        // Relative to the region
+        inline Rect GetCropRect() const { return m_Crop; }
+        inline bool IsCropped() const { return m_Crop.m_Width != m_Width || m_Crop.m_Height != m_Height; }
+
+        // Per channel difference still treated as the border colour, or as unchanged
+        inline void SetTolerance(uint32_t tolerance) { m_Tolerance = tolerance; }
+
+        // Fraction of each dimension that unchanged but non-uniform content may be cropped
+        // from each edge. Without a limit, a still desktop would crop down to its clock.
+        inline void SetMaxStaticFraction(float fraction) { m_MaxStaticFraction = fraction; }
+
+        // Smallest inward move of an edge that is worth a shrink
+        inline void SetMinShrink(uint32_t pixels) { m_MinShrink = pixels; }
+
+        std::string GetReport() const;
+
+    private:
+        // Rect inside the uniform and unchanged borders, false if nothing is live
+        bool FindLiveRect(const FrameView& frame, Rect& outRect);
+
+        void UpdateCrop(bool hasLive, const Rect& live);
+
+    private:
+        uint32_t m_ProbeInterval;
+        uint32_t m_WindowProbes;
+        uint32_t m_FramesUntilProbe = 0;
+
+        uint32_t m_Tolerance = 8;
+        float m_MaxStaticFraction = 0.25f;
+        uint32_t m_MinShrink = 16;
+
+        uint32_t m_Width = 0;
+        uint32_t m_Height = 0;
+        Rect m_Crop;
+
+        // Live rects of the probes since the crop last shrank, a zero size if nothing was live
+        std::vector<Rect> m_History;
+        uint32_t m_HistoryNext = 0;
+        uint32_t m_HistorySize = 0;
+
+        // The previous probe, to find what did not change, and a row of the border colour
+        std::vector<uint32_t> m_Previous;
+        bool m_HasPrevious = false;
+        std::vector<uint32_t> m_ColourRow;
+
+        uint64_t m_Probes = 0;
+        uint64_t m_Grows = 0;
+        uint64_t m_Shrinks = 0;
+    };
+}
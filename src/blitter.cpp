@@ -0,0 +1,218 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "blitter.h"
+
+#include <cstring>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    using namespace Takoyaki;
+
+    // Source pixel under the centre of destination pixel index, for any ratio
+    inline uint32_t GetSourceIndex(uint32_t index, uint32_t srcSize, uint32_t dstSize)
+    {
+        return static_cast<uint32_t>(((2 * static_cast<uint64_t>(index) + 1) * srcSize) / (2 * static_cast<uint64_t>(dstSize)));
+    }
+
+    template<uint32_t Source, uint32_t Destination, uint32_t Index>
+    constexpr uint32_t FixedSourceOffset = ((2 * Index + 1) * Source) / (2 * Destination);
+
+    // One group of Destination pixels from Source pixels, fully unrolled with constant offsets
+    template<typename Pixel, uint32_t Source, uint32_t Destination, uint32_t... Index>
+    inline void ScaleGroup(const Pixel* src, Pixel* dst, std::integer_sequence<uint32_t, Index...>)
+    {
+        ((dst[Index] = src[FixedSourceOffset<Source, Destination, Index>]), ...);
+    }
+
+    // As many whole groups as fill 64 bits, gathered into a register and stored at once.
+    // Pixels are assembled little endian, like everything else Takoyaki runs on.
+    template<typename Pixel, uint32_t Source, uint32_t Destination, uint32_t... Index>
+    inline void ScaleWord(const Pixel* src, Pixel* dst, std::integer_sequence<uint32_t, Index...>)
+    {
+        uint64_t word = ((static_cast<uint64_t>(src[(Index / Destination) * Source + FixedSourceOffset<Source, Destination, Index % Destination>]) << (Index * sizeof(Pixel) * 8)) | ...);
+        memcpy(dst, &word, sizeof(word));
+    }
+
+    // The ratio is exact and reduced, so dstWidth is always a whole number of groups. Small
+    // pixels go out a 64-bit word at a time, which is faster than pixel stores and keeps
+    // auto-vectorizers from rebuilding the strided loads through the stack, which for 3:1
+    // ran at a third of memory bandwidth.
+    template<typename Pixel, uint32_t Source, uint32_t Destination>
+    void ScaleRowFixed(const Pixel* __restrict src, Pixel* __restrict dst, uint32_t dstWidth, const uint32_t*)
+    {
+        constexpr uint32_t WordPixels = sizeof(uint64_t) / sizeof(Pixel);
+        uint32_t x = 0;
+
+        if constexpr (Source == Destination)
+        {
+            memcpy(dst, src, static_cast<size_t>(dstWidth) * sizeof(Pixel));
+            return;
+        }
+        else if constexpr (WordPixels > 1 && WordPixels % Destination == 0)
+        {
+            for (; x + WordPixels <= dstWidth; x += WordPixels, src += WordPixels / Destination * Source)
+                ScaleWord<Pixel, Source, Destination>(src, dst + x, std::make_integer_sequence<uint32_t, WordPixels>());
+        }
+
+        for (; x < dstWidth; x += Destination, src += Source)
+            ScaleGroup<Pixel, Source, Destination>(src, dst + x, std::make_integer_sequence<uint32_t, Destination>());
+    }
+
+    template<typename Pixel>
+    void ScaleRowGeneric(const Pixel* __restrict src, Pixel* __restrict dst, uint32_t dstWidth, const uint32_t* columns)
+    {
+        for (uint32_t x = 0; x < dstWidth; ++x)
+            dst[x] = src[columns[x]];
+    }
+
+    template<typename Pixel>
+    using ScaleRowFn = void(*)(const Pixel*, Pixel*, uint32_t, const uint32_t*);
+
+    template<typename Pixel>
+    struct FixedRatio
+    {
+        uint32_t m_Source;
+        uint32_t m_Destination;
+        BlitPath m_Path;
+        ScaleRowFn<Pixel> m_ScaleRow;
+    };
+
+    template<typename Pixel>
+    constexpr FixedRatio<Pixel> FixedRatios[] = {
+        { 1, 1, BlitPath::Copy, ScaleRowFixed<Pixel, 1, 1> },
+        { 2, 1, BlitPath::Ratio2To1, ScaleRowFixed<Pixel, 2, 1> },
+        { 3, 1, BlitPath::Ratio3To1, ScaleRowFixed<Pixel, 3, 1> },
+        { 3, 2, BlitPath::Ratio3To2, ScaleRowFixed<Pixel, 3, 2> },
+    };
+
+    template<typename Pixel>
+    BlitPath BlitPixels(const FrameView& src, const FrameView& dst, bool allowFixedRatio)
+    {
+        BlitPath path = allowFixedRatio ? Blitter::SelectPath(src.m_Width, dst.m_Width) : BlitPath::Generic;
+        ScaleRowFn<Pixel> scaleRow = ScaleRowGeneric<Pixel>;
+
+        for (const FixedRatio<Pixel>& ratio : FixedRatios<Pixel>)
+        {
+            if (ratio.m_Path == path)
+                scaleRow = ratio.m_ScaleRow;
+        }
+
+        std::vector<uint32_t> columns;
+        if (path == BlitPath::Generic)
+        {
+            columns.resize(dst.m_Width);
+            for (uint32_t x = 0; x < dst.m_Width; ++x)
+                columns[x] = GetSourceIndex(x, src.m_Width, dst.m_Width);
+        }
+
+        for (uint32_t y = 0; y < dst.m_Height; ++y)
+        {
+            uint32_t sourceRow = GetSourceIndex(y, src.m_Height, dst.m_Height);
+            const Pixel* srcRow = reinterpret_cast<const Pixel*>(src.m_Data + static_cast<size_t>(sourceRow) * src.m_Stride);
+            Pixel* dstRow = reinterpret_cast<Pixel*>(dst.m_Data + static_cast<size_t>(y) * dst.m_Stride);
+
+            scaleRow(srcRow, dstRow, dst.m_Width, columns.data());
+        }
+
+        return path;
+    }
+
+    BlitPath BlitFormatted(const FrameView& src, const FrameView& dst, BlitFormat format, bool allowFixedRatio)
+    {
+        switch (format)
+        {
+        case BlitFormat::Gray8:
+            return BlitPixels<uint8_t>(src, dst, allowFixedRatio);
+        case BlitFormat::Bgra8:
+            return BlitPixels<uint32_t>(src, dst, allowFixedRatio);
+        case BlitFormat::Rgba16:
+            return BlitPixels<uint64_t>(src, dst, allowFixedRatio);
+        }
+
+        return BlitPath::Generic;
+    }
+}
+
+Takoyaki::BlitPath Takoyaki::Blitter::SelectPath(uint32_t srcWidth, uint32_t dstWidth)
+{
+    if (srcWidth == 0 || dstWidth == 0)
+        return BlitPath::Generic;
+
+    uint32_t divisor = std::gcd(srcWidth, dstWidth);
+    for (const FixedRatio<uint32_t>& ratio : FixedRatios<uint32_t>)
+    {
+        if (srcWidth / divisor == ratio.m_Source && dstWidth / divisor == ratio.m_Destination)
+            return ratio.m_Path;
+    }
+
+    return BlitPath::Generic;
+}
+
+Takoyaki::BlitPath Takoyaki::Blitter::Blit(const FrameView& src, const FrameView& dst, BlitFormat format)
+{
+    if (!src.IsValid() || !dst.IsValid())
+        return BlitPath::Generic;
+
+    return BlitFormatted(src, dst, format, true);
+}
+
+void Takoyaki::Blitter::BlitGeneric(const FrameView& src, const FrameView& dst, BlitFormat format)
+{
+    if (src.IsValid() && dst.IsValid())
+        BlitFormatted(src, dst, format, false);
+}
+
+uint32_t Takoyaki::Blitter::GetBytesPerPixel(BlitFormat format)
+{
+    switch (format)
+    {
+    case BlitFormat::Gray8:
+        return 1;
+    case BlitFormat::Bgra8:
+        return 4;
+    case BlitFormat::Rgba16:
+        return 8;
+    }
+
+    return 4;
+}
+
+const char* Takoyaki::Blitter::GetPathName(BlitPath path)
+{
+    switch (path)
+    {
+    case BlitPath::Copy:
+        return "1:1 copy";
+    case BlitPath::Ratio2To1:
+        return "2:1";
+    case BlitPath::Ratio3To1:
+        return "3:1";
+    case BlitPath::Ratio3To2:
+        return "3:2";
+    case BlitPath::Generic:
+        return "generic";
+    }
+
+    return "unknown";
+}
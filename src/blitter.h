@@ -0,0 +1,66 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include "frame.h"
+
+namespace Takoyaki
+{
+    enum class BlitFormat
+    {
+        Gray8,      // One byte per pixel, masks and luma planes
+        Bgra8,      // 8-bit BGRA, and anything else 32 bits wide like R10G10B10A2
+        Rgba16,     // 16 bits per channel, like the scRGB half float desktop
+    };
+
+    enum class BlitPath
+    {
+        Copy,
+        Ratio2To1,
+        Ratio3To1,
+        Ratio3To2,
+        Generic,
+    };
+
+    // Point-sampled CPU copies and scales between frames, matching the output's point
+    // sampler: every destination pixel takes the source pixel under its centre. The
+    // common ratios get a row kernel generated at compile time for each pixel format,
+    // where the source offsets within a group of pixels are constants, and anything else
+    // goes through a per-column lookup table. Views describe pixels of the given format,
+    // so m_Width is in pixels and m_Stride in bytes regardless of the pixel size.
+    class Blitter
+    {
+    public:
+        // Path a srcWidth to dstWidth scale takes. Rows are picked the same way for every
+        // path, so only the horizontal ratio matters.
+        static BlitPath SelectPath(uint32_t srcWidth, uint32_t dstWidth);
+
+        // Scales all of src into all of dst. Returns the path that was taken.
+        static BlitPath Blit(const FrameView& src, const FrameView& dst, BlitFormat format = BlitFormat::Bgra8);
+
+        // Always takes the lookup table path, to compare against the fixed ratio kernels
+        static void BlitGeneric(const FrameView& src, const FrameView& dst, BlitFormat format = BlitFormat::Bgra8);
+
+        static uint32_t GetBytesPerPixel(BlitFormat format);
+        static const char* GetPathName(BlitPath path);
+    };
+}
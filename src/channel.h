@@ -0,0 +1,256 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <vector>
+#include "executor.h"
+
+namespace Takoyaki
+{
+    // Bounded queue between coroutines. co_await Send suspends the sender while the channel is
+    // full and co_await Receive suspends the receiver while it is empty, so a slow consumer
+    // holds its producer back instead of letting frames pile up. Suspended coroutines are
+    // resumed through the executor, never from inside the other side's call.
+    template<typename T>
+    class Channel
+    {
+    public:
+        class SendAwaiter
+        {
+        public:
+            SendAwaiter(Channel& channel, T&& value) : m_Channel(channel), m_Value(std::move(value)) {}
+
+            bool await_ready() const noexcept { return false; }
+            bool await_suspend(std::coroutine_handle<> handle) { return m_Channel.SuspendSend(*this, handle); }
+
+            // False if the channel was closed, in which case the value was dropped
+            bool await_resume() const noexcept { return m_IsSent; }
+
+        private:
+            friend class Channel;
+
+            Channel& m_Channel;
+            T m_Value;
+            bool m_IsSent = false;
+            std::coroutine_handle<> m_Handle;
+        };
+
+        class ReceiveAwaiter
+        {
+        public:
+            explicit ReceiveAwaiter(Channel& channel) : m_Channel(channel) {}
+
+            bool await_ready() const noexcept { return false; }
+            bool await_suspend(std::coroutine_handle<> handle) { return m_Channel.SuspendReceive(*this, handle); }
+
+            // Empty once the channel is closed and everything sent before has been received
+            std::optional<T> await_resume() { return std::move(m_Value); }
+
+        private:
+            friend class Channel;
+
+            Channel& m_Channel;
+            std::optional<T> m_Value;
+            std::coroutine_handle<> m_Handle;
+        };
+
+        Channel(Executor& executor, size_t capacity) : m_Executor(executor), m_Capacity(capacity > 0 ? capacity : 1) {}
+        ~Channel() = default;
+
+        Channel(const Channel&) = delete;
+        Channel& operator=(const Channel&) = delete;
+
+        SendAwaiter Send(T value) { return SendAwaiter(*this, std::move(value)); }
+        ReceiveAwaiter Receive() { return ReceiveAwaiter(*this); }
+
+        // Fails every send from now on. Receivers still get what is queued, then nothing.
+        void Close();
+
+    public:
+        inline size_t GetCapacity() const { return m_Capacity; }
+        size_t GetSize() const;
+        bool IsClosed() const;
+
+        // Times a sender found the channel full, and a receiver found it empty
+        uint64_t GetSendWaits() const;
+        uint64_t GetReceiveWaits() const;
+
+    private:
+        // Both return true if the coroutine has to wait
+        bool SuspendSend(SendAwaiter& sender, std::coroutine_handle<> handle);
+        bool SuspendReceive(ReceiveAwaiter& receiver, std::coroutine_handle<> handle);
+
+    private:
+        Executor& m_Executor;
+        size_t m_Capacity;
+
+        mutable std::mutex m_Mutex;
+        std::deque<T> m_Queue;
+        std::deque<SendAwaiter*> m_Senders;
+        std::deque<ReceiveAwaiter*> m_Receivers;
+        bool m_IsClosed = false;
+
+        uint64_t m_SendWaits = 0;
+        uint64_t m_ReceiveWaits = 0;
+    };
+
+    template<typename T>
+    void Channel<T>::Close()
+    {
+        std::vector<std::coroutine_handle<>> resumed;
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (m_IsClosed)
+                return;
+
+            m_IsClosed = true;
+
+            // Receivers only wait on an empty queue, so they all get nothing
+            for (ReceiveAwaiter* receiver : m_Receivers)
+                resumed.push_back(receiver->m_Handle);
+
+            for (SendAwaiter* sender : m_Senders)
+                resumed.push_back(sender->m_Handle);
+
+            m_Receivers.clear();
+            m_Senders.clear();
+        }
+
+        for (std::coroutine_handle<> handle : resumed)
+            m_Executor.Post(handle);
+    }
+
+    template<typename T>
+    size_t Channel<T>::GetSize() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Queue.size();
+    }
+
+    template<typename T>
+    bool Channel<T>::IsClosed() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_IsClosed;
+    }
+
+    template<typename T>
+    uint64_t Channel<T>::GetSendWaits() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_SendWaits;
+    }
+
+    template<typename T>
+    uint64_t Channel<T>::GetReceiveWaits() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_ReceiveWaits;
+    }
+
+    template<typename T>
+    bool Channel<T>::SuspendSend(SendAwaiter& sender, std::coroutine_handle<> handle)
+    {
+        std::coroutine_handle<> resumed;
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+
+            if (m_IsClosed)
+                return false;
+
+            if (!m_Receivers.empty())
+            {
+                // A waiting receiver means the queue is empty, so hand the value straight over
+                ReceiveAwaiter* receiver = m_Receivers.front();
+                m_Receivers.pop_front();
+
+                receiver->m_Value.emplace(std::move(sender.m_Value));
+                resumed = receiver->m_Handle;
+            }
+            else if (m_Queue.size() < m_Capacity)
+            {
+                m_Queue.push_back(std::move(sender.m_Value));
+            }
+            else
+            {
+                sender.m_Handle = handle;
+                m_Senders.push_back(&sender);
+                ++m_SendWaits;
+                return true;
+            }
+
+            sender.m_IsSent = true;
+        }
+
+        if (resumed)
+            m_Executor.Post(resumed);
+
+        return false;
+    }
+
+    template<typename T>
+    bool Channel<T>::SuspendReceive(ReceiveAwaiter& receiver, std::coroutine_handle<> handle)
+    {
+        std::coroutine_handle<> resumed;
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+
+            if (m_Queue.empty())
+            {
+                if (m_IsClosed)
+                    return false;
+
+                receiver.m_Handle = handle;
+                m_Receivers.push_back(&receiver);
+                ++m_ReceiveWaits;
+                return true;
+            }
+
+            receiver.m_Value.emplace(std::move(m_Queue.front()));
+            m_Queue.pop_front();
+
+            // Room for the oldest waiting sender
+            if (!m_Senders.empty())
+            {
+                SendAwaiter* sender = m_Senders.front();
+                m_Senders.pop_front();
+
+                m_Queue.push_back(std::move(sender->m_Value));
+                sender->m_IsSent = true;
+                resumed = sender->m_Handle;
+            }
+        }
+
+        if (resumed)
+            m_Executor.Post(resumed);
+
+        return false;
+    }
+}
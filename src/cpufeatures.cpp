@@ -0,0 +1,150 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cpufeatures.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if TAKOYAKI_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace
+{
+    const char* g_SimdLevelNames[] = { "scalar", "sse2", "sse41", "avx2", "avx512" };
+
+#if TAKOYAKI_X86
+    void Cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+        for (int i = 0; i < 4; ++i)
+            regs[i] = static_cast<uint32_t>(info[i]);
+#else
+        __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    }
+
+    // Register state the OS saves on context switch, only valid when OSXSAVE is set
+    uint64_t GetEnabledXsaveFeatures()
+    {
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#else
+        uint32_t eax, edx;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+    }
+#endif
+}
+
+Takoyaki::SimdLevel Takoyaki::DetectSimdLevel()
+{
+#if TAKOYAKI_X86
+    uint32_t regs[4];
+    Cpuid(0, 0, regs);
+    uint32_t maxLeaf = regs[0];
+
+    Cpuid(1, 0, regs);
+    uint32_t ecx1 = regs[2];
+    uint32_t edx1 = regs[3];
+
+    if (!(edx1 & (1u << 26)))
+        return SimdLevel::Scalar;
+
+    if (!(ecx1 & (1u << 19)))
+        return SimdLevel::Sse2;
+
+    bool hasOsXsave = (ecx1 & (1u << 27)) != 0;
+    bool hasAvx = (ecx1 & (1u << 28)) != 0;
+    bool hasFma = (ecx1 & (1u << 12)) != 0;
+    bool hasF16c = (ecx1 & (1u << 29)) != 0;
+
+    if (!hasOsXsave || !hasAvx || !hasFma || !hasF16c || maxLeaf < 7)
+        return SimdLevel::Sse41;
+
+    // XMM and YMM state
+    uint64_t xcr0 = GetEnabledXsaveFeatures();
+    if ((xcr0 & 0x6) != 0x6)
+        return SimdLevel::Sse41;
+
+    Cpuid(7, 0, regs);
+    uint32_t ebx7 = regs[1];
+
+    if (!(ebx7 & (1u << 5)))
+        return SimdLevel::Sse41;
+
+    // F, DQ, BW and VL, plus opmask and ZMM state
+    constexpr uint32_t avx512Mask = (1u << 16) | (1u << 17) | (1u << 30) | (1u << 31);
+    if ((ebx7 & avx512Mask) != avx512Mask || (xcr0 & 0xE0) != 0xE0)
+        return SimdLevel::Avx2;
+
+    return SimdLevel::Avx512;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+Takoyaki::SimdLevel Takoyaki::GetSimdLevel()
+{
+    static const SimdLevel level = []()
+    {
+        SimdLevel detected = DetectSimdLevel();
+        const char* requested = getenv("TAKOYAKI_SIMD_LEVEL");
+
+        if (requested == nullptr)
+            return detected;
+
+        for (uint32_t i = 0; i < static_cast<uint32_t>(SimdLevel::Count); ++i)
+        {
+            if (strcmp(requested, g_SimdLevelNames[i]) != 0)
+                continue;
+
+            // Never go above what the machine can actually run
+            if (static_cast<SimdLevel>(i) > detected)
+            {
+                printf("Takoyaki: TAKOYAKI_SIMD_LEVEL=%s is not supported, using %s\n", requested, GetSimdLevelName(detected));
+                return detected;
+            }
+
+            return static_cast<SimdLevel>(i);
+        }
+
+        printf("Takoyaki: unknown TAKOYAKI_SIMD_LEVEL=%s, using %s\n", requested, GetSimdLevelName(detected));
+        return detected;
+    }();
+
+    return level;
+}
+
+const char* Takoyaki::GetSimdLevelName(SimdLevel level)
+{
+    if (level >= SimdLevel::Count)
+        return "unknown";
+
+    return g_SimdLevelNames[static_cast<uint32_t>(level)];
+}
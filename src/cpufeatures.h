@@ -0,0 +1,54 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define TAKOYAKI_X86 1
+#else
+#define TAKOYAKI_X86 0
+#endif
+
+namespace Takoyaki
+{
+    // Instruction set levels that pixel kernels are compiled for. Each level implies all
+    // the ones below it.
+    enum class SimdLevel
+    {
+        Scalar,
+        Sse2,
+        Sse41,
+        Avx2,       // AVX2 + FMA + F16C
+        Avx512,     // AVX-512 F/BW/DQ/VL
+
+        Count
+    };
+
+    // Highest level supported by both the CPU and the OS
+    SimdLevel DetectSimdLevel();
+
+    // Level the pixel kernels are bound to. This is the detected level, unless the
+    // TAKOYAKI_SIMD_LEVEL environment variable requests a lower one (scalar, sse2, sse41,
+    // avx2 or avx512). Evaluated once, on first use.
+    SimdLevel GetSimdLevel();
+
+    const char* GetSimdLevelName(SimdLevel level);
+}
@@ -0,0 +1,196 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "cursorcompositor.h"
+#include <algorithm>
+#include <cstring>
+#include "kernels/pixelkernels.h"
+
+namespace
+{
+    bool Intersects(const Takoyaki::Rect& a, const Takoyaki::Rect& b)
+    {
+        return a.m_X < b.m_X + static_cast<int32_t>(b.m_Width) && b.m_X < a.m_X + static_cast<int32_t>(a.m_Width) &&
+            a.m_Y < b.m_Y + static_cast<int32_t>(b.m_Height) && b.m_Y < a.m_Y + static_cast<int32_t>(a.m_Height);
+    }
+
+    Takoyaki::Rect GetUnion(const Takoyaki::Rect& a, const Takoyaki::Rect& b)
+    {
+        int32_t left = std::min(a.m_X, b.m_X);
+        int32_t top = std::min(a.m_Y, b.m_Y);
+        int32_t right = std::max(a.m_X + static_cast<int32_t>(a.m_Width), b.m_X + static_cast<int32_t>(b.m_Width));
+        int32_t bottom = std::max(a.m_Y + static_cast<int32_t>(a.m_Height), b.m_Y + static_cast<int32_t>(b.m_Height));
+
+        return { left, top, static_cast<uint32_t>(right - left), static_cast<uint32_t>(bottom - top) };
+    }
+}
+
+void Takoyaki::CursorCompositor::SetSprite(const uint32_t* pixels, uint32_t width, uint32_t height, uint32_t stride, int32_t hotspotX, int32_t hotspotY, uint64_t serial, bool isPremultiplied)
+{
+    m_Sprite.resize(static_cast<size_t>(width) * height);
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint32_t* src = pixels + static_cast<size_t>(y) * stride;
+        uint32_t* dst = m_Sprite.data() + static_cast<size_t>(y) * width;
+
+        if (isPremultiplied)
+        {
+            memcpy(dst, src, width * 4);
+            continue;
+        }
+
+        // Only happens when the shape changes, so the scalar conversion is plenty
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            uint32_t alpha = src[x] >> 24;
+            uint32_t pixel = alpha << 24;
+
+            for (uint32_t shift = 0; shift < 24; shift += 8)
+                pixel |= ((((src[x] >> shift) & 0xFF) * alpha + 127) / 255) << shift;
+
+            dst[x] = pixel;
+        }
+    }
+
+    m_Width = width;
+    m_Height = height;
+    m_HotspotX = hotspotX;
+    m_HotspotY = hotspotY;
+    m_Serial = serial;
+    m_HasSprite = true;
+    m_IsChanged = true;
+}
+
+void Takoyaki::CursorCompositor::SetPosition(int32_t x, int32_t y)
+{
+    if (x == m_X && y == m_Y)
+        return;
+
+    m_X = x;
+    m_Y = y;
+    m_IsChanged = true;
+}
+
+void Takoyaki::CursorCompositor::SetVisible(bool isVisible)
+{
+    if (isVisible == m_IsVisible)
+        return;
+
+    m_IsVisible = isVisible;
+    m_IsChanged = true;
+}
+
+void Takoyaki::CursorCompositor::Composite(const FrameView& frame, bool isFrameReplaced, std::vector<Rect>& outDamage)
+{
+    if (!isFrameReplaced && !m_IsChanged)
+        return;
+
+    m_IsChanged = false;
+
+    // A new frame has no cursor in it to take back out, but the previous frame showed one there
+    bool hadFootprint = m_HasFootprint;
+    Rect oldFootprint = m_Footprint;
+
+    if (m_HasFootprint && !isFrameReplaced)
+        RestoreBackground(frame);
+
+    m_HasFootprint = false;
+
+    Rect footprint;
+    bool hasFootprint = GetFootprint(frame, footprint);
+
+    if (hasFootprint)
+    {
+        SaveBackground(frame, footprint);
+        Blend(frame, footprint);
+    }
+
+    // Overlapping footprints, as for most mouse moves, are reported as one rect
+    if (hadFootprint && hasFootprint && Intersects(oldFootprint, footprint))
+    {
+        outDamage.push_back(GetUnion(oldFootprint, footprint));
+        return;
+    }
+
+    if (hadFootprint)
+        outDamage.push_back(oldFootprint);
+    if (hasFootprint)
+        outDamage.push_back(footprint);
+}
+
+void Takoyaki::CursorCompositor::Reset()
+{
+    m_HasFootprint = false;
+    m_IsChanged = true;
+}
+
+bool Takoyaki::CursorCompositor::GetFootprint(const FrameView& frame, Rect& outRect) const
+{
+    if (!m_HasSprite || !m_IsVisible)
+        return false;
+
+    int32_t left = std::max(m_X - m_HotspotX, 0);
+    int32_t top = std::max(m_Y - m_HotspotY, 0);
+    int32_t right = std::min(m_X - m_HotspotX + static_cast<int32_t>(m_Width), static_cast<int32_t>(frame.m_Width));
+    int32_t bottom = std::min(m_Y - m_HotspotY + static_cast<int32_t>(m_Height), static_cast<int32_t>(frame.m_Height));
+
+    if (right <= left || bottom <= top)
+        return false;
+
+    outRect = { left, top, static_cast<uint32_t>(right - left), static_cast<uint32_t>(bottom - top) };
+    return true;
+}
+
+void Takoyaki::CursorCompositor::SaveBackground(const FrameView& frame, const Rect& rect)
+{
+    m_Background.resize(static_cast<size_t>(rect.m_Width) * rect.m_Height);
+
+    for (uint32_t y = 0; y < rect.m_Height; ++y)
+        memcpy(m_Background.data() + static_cast<size_t>(y) * rect.m_Width, frame.GetRow(rect.m_Y + y) + rect.m_X, rect.m_Width * 4);
+
+    m_Footprint = rect;
+    m_HasFootprint = true;
+}
+
+void Takoyaki::CursorCompositor::RestoreBackground(const FrameView& frame)
+{
+    // The frame can only have shrunk if it was replaced, but never write outside it
+    if (m_Footprint.m_X + m_Footprint.m_Width > frame.m_Width || m_Footprint.m_Y + m_Footprint.m_Height > frame.m_Height)
+        return;
+
+    for (uint32_t y = 0; y < m_Footprint.m_Height; ++y)
+        memcpy(frame.GetRow(m_Footprint.m_Y + y) + m_Footprint.m_X, m_Background.data() + static_cast<size_t>(y) * m_Footprint.m_Width, m_Footprint.m_Width * 4);
+}
+
+void Takoyaki::CursorCompositor::Blend(const FrameView& frame, const Rect& rect)
+{
+    const PixelKernels& kernels = GetPixelKernels();
+
+    // Offset of the clipped rect inside the sprite
+    uint32_t spriteX = static_cast<uint32_t>(rect.m_X - (m_X - m_HotspotX));
+    uint32_t spriteY = static_cast<uint32_t>(rect.m_Y - (m_Y - m_HotspotY));
+
+    for (uint32_t y = 0; y < rect.m_Height; ++y)
+    {
+        const uint32_t* src = m_Sprite.data() + static_cast<size_t>(spriteY + y) * m_Width + spriteX;
+        kernels.m_BlendPremultipliedRow(src, frame.GetRow(rect.m_Y + y) + rect.m_X, rect.m_Width);
+    }
+}
@@ -0,0 +1,92 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "frame.h"
+
+namespace Takoyaki
+{
+    // Draws the mouse cursor into captured frames, which never include it. The shape is kept
+    // premultiplied, so each frame only blends the few pixels it covers, and the pixels it
+    // covered are saved so a frame that is drawn into again can have them put back. Only the
+    // cursor's old and new footprints are reported as damaged, so a cursor moving over an
+    // otherwise still desktop never dirties more than those.
+    class CursorCompositor
+    {
+    public:
+        CursorCompositor() = default;
+        ~CursorCompositor() = default;
+
+        // Caches a new shape. stride is in pixels, and serial identifies the shape, so that
+        // HasSprite can tell the caller the conversion can be skipped.
+        void SetSprite(const uint32_t* pixels, uint32_t width, uint32_t height, uint32_t stride, int32_t hotspotX, int32_t hotspotY, uint64_t serial, bool isPremultiplied);
+        inline bool HasSprite(uint64_t serial) const { return m_HasSprite && m_Serial == serial; }
+
+        // Hotspot position relative to the frame
+        void SetPosition(int32_t x, int32_t y);
+        void SetVisible(bool isVisible);
+
+        // Draws the cursor into frame. When frame has just been captured, set isFrameReplaced.
+        // Otherwise it must still hold what the previous call left in it, and the pixels under
+        // the previous cursor are restored first. Appends the rects that changed to outDamage,
+        // which is nothing when neither the frame nor the cursor changed.
+        void Composite(const FrameView& frame, bool isFrameReplaced, std::vector<Rect>& outDamage);
+
+        // Forgets the previous footprint, for when the frame it was drawn into is gone
+        void Reset();
+
+    public:
+        inline int32_t GetX() const { return m_X; }
+        inline int32_t GetY() const { return m_Y; }
+        inline bool IsVisible() const { return m_IsVisible; }
+
+    private:
+        // Sprite rect at the current position clipped to the frame, false if nothing is visible
+        bool GetFootprint(const FrameView& frame, Rect& outRect) const;
+
+        void SaveBackground(const FrameView& frame, const Rect& rect);
+        void RestoreBackground(const FrameView& frame);
+        void Blend(const FrameView& frame, const Rect& rect);
+
+    private:
+        std::vector<uint32_t> m_Sprite;
+        uint32_t m_Width = 0;
+        uint32_t m_Height = 0;
+        int32_t m_HotspotX = 0;
+        int32_t m_HotspotY = 0;
+        uint64_t m_Serial = 0;
+        bool m_HasSprite = false;
+
+        int32_t m_X = 0;
+        int32_t m_Y = 0;
+        bool m_IsVisible = true;
+
+        // Set by anything that changes what the next Composite draws
+        bool m_IsChanged = true;
+
+        // Where the cursor was last drawn, and the pixels it covered there
+        Rect m_Footprint;
+        bool m_HasFootprint = false;
+        std::vector<uint32_t> m_Background;
+    };
+}
@@ -0,0 +1,685 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "deflate.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace
+{
+    using namespace Takoyaki;
+
+    constexpr uint32_t AdlerBase = 65521;
+
+    // Largest run of bytes before the 32-bit Adler sums have to be reduced
+    constexpr size_t AdlerBlockSize = 5552;
+
+    constexpr uint32_t HashBits = 16;
+    constexpr uint32_t MinMatch = 4;
+    constexpr uint32_t MaxMatch = 258;
+
+    // Positions inside longer matches are not hashed, which keeps long runs of flat colour
+    // cheap. The match that follows still finds the run from where it started.
+    constexpr uint32_t MaxInsertLength = 32;
+
+    constexpr size_t MaxBlockSymbols = 65535;
+
+    constexpr uint32_t LiteralCount = 286;
+    constexpr uint32_t DistanceCount = 30;
+    constexpr uint32_t CodeLengthCount = 19;
+    constexpr uint32_t EndOfBlock = 256;
+
+    constexpr uint16_t LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    constexpr uint8_t LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    constexpr uint16_t DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    constexpr uint8_t DistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+    constexpr uint8_t CodeLengthOrder[CodeLengthCount] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    struct Tables
+    {
+        Tables()
+        {
+            for (uint32_t code = 0; code < 29; ++code)
+            {
+                for (uint32_t length = LengthBase[code]; length < LengthBase[code] + (1u << LengthExtra[code]) && length <= MaxMatch; ++length)
+                    m_LengthCode[length] = static_cast<uint8_t>(code);
+            }
+
+            // Distances up to 256 are looked up directly, longer ones by their top bits
+            for (uint32_t code = 0; code < 30; ++code)
+            {
+                for (uint32_t distance = DistanceBase[code]; distance < DistanceBase[code] + (1u << DistanceExtra[code]); ++distance)
+                {
+                    if (distance <= 256)
+                        m_NearDistanceCode[distance - 1] = static_cast<uint8_t>(code);
+                    else
+                        m_FarDistanceCode[(distance - 1) >> 7] = static_cast<uint8_t>(code);
+                }
+            }
+
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t crc = i;
+                for (uint32_t bit = 0; bit < 8; ++bit)
+                    crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+
+                m_Crc[0][i] = crc;
+            }
+
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                for (uint32_t slice = 1; slice < 8; ++slice)
+                    m_Crc[slice][i] = (m_Crc[slice - 1][i] >> 8) ^ m_Crc[0][m_Crc[slice - 1][i] & 0xFF];
+            }
+        }
+
+        inline uint32_t GetDistanceCode(uint32_t distance) const
+        {
+            return distance <= 256 ? m_NearDistanceCode[distance - 1] : m_FarDistanceCode[(distance - 1) >> 7];
+        }
+
+        std::array<uint8_t, MaxMatch + 1> m_LengthCode = {};
+        std::array<uint8_t, 256> m_NearDistanceCode = {};
+        std::array<uint8_t, 256> m_FarDistanceCode = {};
+        uint32_t m_Crc[8][256] = {};
+    };
+
+    const Tables& GetTables()
+    {
+        static const Tables tables;
+        return tables;
+    }
+
+    inline uint32_t Load32(const uint8_t* data)
+    {
+        uint32_t value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    inline uint64_t Load64(const uint8_t* data)
+    {
+        uint64_t value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    inline uint32_t Hash(const uint8_t* data)
+    {
+        return (Load32(data) * 2654435761u) >> (32 - HashBits);
+    }
+
+    uint32_t GetMatchLength(const uint8_t* a, const uint8_t* b, uint32_t maxLength)
+    {
+        uint32_t length = 0;
+
+        for (; length + 8 <= maxLength; length += 8)
+        {
+            uint64_t difference = Load64(a + length) ^ Load64(b + length);
+            if (difference != 0)
+                return length + (__builtin_ctzll(difference) >> 3);
+        }
+
+        while (length < maxLength && a[length] == b[length])
+            ++length;
+
+        return length;
+    }
+
+    // Code lengths for the given symbol frequencies, no longer than maxLength. Symbols with
+    // a zero frequency get no code, and a table never ends up with a single code, which
+    // some decoders reject as incomplete.
+    void BuildCodeLengths(const uint32_t* frequencies, uint32_t count, uint32_t maxLength, uint8_t* outLengths)
+    {
+        struct Entry
+        {
+            uint32_t m_Key;
+            uint16_t m_Symbol;
+        };
+
+        std::array<Entry, LiteralCount> entries;
+        uint32_t used = 0;
+
+        memset(outLengths, 0, count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (frequencies[i] != 0)
+                entries[used++] = { frequencies[i], static_cast<uint16_t>(i) };
+        }
+
+        if (used <= 1)
+        {
+            uint32_t symbol = used == 1 ? entries[0].m_Symbol : 0;
+            outLengths[symbol] = 1;
+            outLengths[symbol == 0 ? 1 : 0] = 1;
+            return;
+        }
+
+        std::sort(entries.begin(), entries.begin() + used, [](const Entry& a, const Entry& b) { return a.m_Key < b.m_Key || (a.m_Key == b.m_Key && a.m_Symbol < b.m_Symbol); });
+
+        // In-place minimum redundancy code lengths (Moffat and Katajainen), over the
+        // frequencies sorted in ascending order
+        Entry* a = entries.data();
+        int32_t n = static_cast<int32_t>(used);
+        int32_t root = 0;
+        int32_t leaf = 2;
+
+        a[0].m_Key += a[1].m_Key;
+        for (int32_t next = 1; next < n - 1; ++next)
+        {
+            if (leaf >= n || a[root].m_Key < a[leaf].m_Key)
+            {
+                a[next].m_Key = a[root].m_Key;
+                a[root++].m_Key = static_cast<uint32_t>(next);
+            }
+            else
+                a[next].m_Key = a[leaf++].m_Key;
+
+            if (leaf >= n || (root < next && a[root].m_Key < a[leaf].m_Key))
+            {
+                a[next].m_Key += a[root].m_Key;
+                a[root++].m_Key = static_cast<uint32_t>(next);
+            }
+            else
+                a[next].m_Key += a[leaf++].m_Key;
+        }
+
+        a[n - 2].m_Key = 0;
+        for (int32_t next = n - 3; next >= 0; --next)
+            a[next].m_Key = a[a[next].m_Key].m_Key + 1;
+
+        int32_t available = 1;
+        int32_t usedNodes = 0;
+        uint32_t depth = 0;
+        int32_t next = n - 1;
+        root = n - 2;
+
+        while (available > 0)
+        {
+            while (root >= 0 && a[root].m_Key == depth)
+            {
+                ++usedNodes;
+                --root;
+            }
+
+            while (available > usedNodes)
+            {
+                a[next--].m_Key = depth;
+                --available;
+            }
+
+            available = 2 * usedNodes;
+            ++depth;
+            usedNodes = 0;
+        }
+
+        // Fold anything too long into the longest allowed length, then lengthen shorter
+        // codes until the lengths describe a complete prefix code again
+        std::array<uint32_t, LiteralCount + 1> lengthCounts = {};
+        for (int32_t i = 0; i < n; ++i)
+            ++lengthCounts[std::min(a[i].m_Key, maxLength)];
+
+        uint32_t total = 0;
+        for (uint32_t length = maxLength; length > 0; --length)
+            total += lengthCounts[length] << (maxLength - length);
+
+        while (total != (1u << maxLength))
+        {
+            --lengthCounts[maxLength];
+            for (uint32_t length = maxLength - 1; length > 0; --length)
+            {
+                if (lengthCounts[length] != 0)
+                {
+                    --lengthCounts[length];
+                    lengthCounts[length + 1] += 2;
+                    break;
+                }
+            }
+
+            --total;
+        }
+
+        // The most frequent symbols are at the end and get the shortest codes
+        int32_t index = n;
+        for (uint32_t length = 1; length <= maxLength; ++length)
+        {
+            for (uint32_t i = lengthCounts[length]; i > 0; --i)
+                outLengths[a[--index].m_Symbol] = static_cast<uint8_t>(length);
+        }
+    }
+
+    // Canonical codes, bit reversed since deflate packs Huffman codes from the top bit down
+    void BuildCodes(const uint8_t* lengths, uint32_t count, uint16_t* outCodes)
+    {
+        uint32_t lengthCounts[16] = {};
+        uint32_t nextCode[16] = {};
+
+        for (uint32_t i = 0; i < count; ++i)
+            ++lengthCounts[lengths[i]];
+
+        lengthCounts[0] = 0;
+        uint32_t code = 0;
+        for (uint32_t length = 1; length < 16; ++length)
+        {
+            code = (code + lengthCounts[length - 1]) << 1;
+            nextCode[length] = code;
+        }
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint32_t length = lengths[i];
+            if (length == 0)
+                continue;
+
+            uint32_t value = nextCode[length]++;
+            uint32_t reversed = 0;
+            for (uint32_t bit = 0; bit < length; ++bit)
+                reversed |= ((value >> bit) & 1) << (length - 1 - bit);
+
+            outCodes[i] = static_cast<uint16_t>(reversed);
+        }
+    }
+}
+
+class Takoyaki::DeflateCompressor::BitWriter
+{
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : m_Out(out) {}
+
+    inline void Write(uint32_t bits, uint32_t count)
+    {
+        m_Buffer |= static_cast<uint64_t>(bits) << m_Count;
+        m_Count += count;
+
+        if (m_Count >= 32)
+        {
+            uint8_t bytes[4] = { static_cast<uint8_t>(m_Buffer), static_cast<uint8_t>(m_Buffer >> 8), static_cast<uint8_t>(m_Buffer >> 16), static_cast<uint8_t>(m_Buffer >> 24) };
+            m_Out.insert(m_Out.end(), bytes, bytes + 4);
+            m_Buffer >>= 32;
+            m_Count -= 32;
+        }
+    }
+
+    void AlignToByte()
+    {
+        for (; m_Count > 0; m_Count = m_Count > 8 ? m_Count - 8 : 0)
+        {
+            m_Out.push_back(static_cast<uint8_t>(m_Buffer));
+            m_Buffer >>= 8;
+        }
+    }
+
+    // Only valid once aligned to a byte
+    void WriteBytes(const uint8_t* data, size_t size)
+    {
+        m_Out.insert(m_Out.end(), data, data + size);
+    }
+
+private:
+    std::vector<uint8_t>& m_Out;
+    uint64_t m_Buffer = 0;
+    uint32_t m_Count = 0;
+};
+
+uint32_t Takoyaki::Crc32(const uint8_t* data, size_t size, uint32_t crc)
+{
+    const auto& table = GetTables().m_Crc;
+    crc = ~crc;
+
+    // Slicing by 8, the lookups for each byte of a word are independent
+    for (; size >= 8; data += 8, size -= 8)
+    {
+        uint32_t low = Load32(data) ^ crc;
+        uint32_t high = Load32(data + 4);
+
+        crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^ table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24] ^
+            table[3][high & 0xFF] ^ table[2][(high >> 8) & 0xFF] ^ table[1][(high >> 16) & 0xFF] ^ table[0][high >> 24];
+    }
+
+    for (; size > 0; ++data, --size)
+        crc = (crc >> 8) ^ table[0][(crc ^ *data) & 0xFF];
+
+    return ~crc;
+}
+
+uint32_t Takoyaki::Adler32(const uint8_t* data, size_t size, uint32_t adler)
+{
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+
+    while (size > 0)
+    {
+        size_t blockSize = std::min(size, AdlerBlockSize);
+        size -= blockSize;
+
+        for (; blockSize > 0; --blockSize)
+        {
+            a += *data++;
+            b += a;
+        }
+
+        a %= AdlerBase;
+        b %= AdlerBase;
+    }
+
+    return a | (b << 16);
+}
+
+uint32_t Takoyaki::CombineAdler32(uint32_t first, uint32_t second, size_t secondSize)
+{
+    uint32_t remainder = static_cast<uint32_t>(secondSize % AdlerBase);
+    uint32_t a = first & 0xFFFF;
+    uint32_t b = static_cast<uint32_t>((static_cast<uint64_t>(remainder) * a) % AdlerBase);
+
+    a += (second & 0xFFFF) + AdlerBase - 1;
+    b += (first >> 16) + (second >> 16) + AdlerBase - remainder;
+
+    a %= AdlerBase;
+    b %= AdlerBase;
+    return a | (b << 16);
+}
+
+Takoyaki::DeflateCompressor::DeflateCompressor()
+    : m_Previous(WindowSize)
+{
+    m_Head.resize(size_t(1) << HashBits);
+    m_Symbols.reserve(MaxBlockSymbols);
+}
+
+void Takoyaki::DeflateCompressor::Compress(const uint8_t* data, size_t size, size_t historySize, bool isLast, std::vector<uint8_t>& out)
+{
+    BitWriter writer(out);
+
+    historySize = std::min(historySize, WindowSize);
+    const uint8_t* base = data - historySize;
+    const int32_t total = static_cast<int32_t>(historySize + size);
+    const int32_t hashEnd = total - static_cast<int32_t>(MinMatch) + 1;
+    const int32_t windowMask = static_cast<int32_t>(WindowSize) - 1;
+
+    std::fill(m_Head.begin(), m_Head.end(), -1);
+    m_Symbols.clear();
+
+    for (int32_t position = 0; position < static_cast<int32_t>(historySize) && position < hashEnd; ++position)
+    {
+        uint32_t hash = Hash(base + position);
+        m_Previous[position & windowMask] = m_Head[hash];
+        m_Head[hash] = position;
+    }
+
+    int32_t position = static_cast<int32_t>(historySize);
+    int32_t blockStart = position;
+
+    while (position < total)
+    {
+        uint32_t bestLength = 0;
+        uint32_t bestDistance = 0;
+
+        if (position < hashEnd)
+        {
+            uint32_t hash = Hash(base + position);
+            int32_t candidate = m_Head[hash];
+            m_Previous[position & windowMask] = candidate;
+            m_Head[hash] = position;
+
+            uint32_t maxLength = std::min<uint32_t>(MaxMatch, total - position);
+            uint32_t chain = m_MaxChainLength;
+
+            while (candidate >= 0 && position - candidate <= static_cast<int32_t>(WindowSize) && chain-- > 0)
+            {
+                // A longer match has to agree on the byte just past the best one so far
+                if (base[candidate + bestLength] == base[position + bestLength])
+                {
+                    uint32_t length = GetMatchLength(base + candidate, base + position, maxLength);
+                    if (length > bestLength)
+                    {
+                        bestLength = length;
+                        bestDistance = static_cast<uint32_t>(position - candidate);
+
+                        if (length == maxLength)
+                            break;
+                    }
+                }
+
+                // Slots are reused every window, so a link forward means the chain ran out
+                int32_t next = m_Previous[candidate & windowMask];
+                if (next >= candidate)
+                    break;
+
+                candidate = next;
+            }
+        }
+
+        if (bestLength >= MinMatch)
+        {
+            m_Symbols.push_back({ static_cast<uint16_t>(bestLength), static_cast<uint16_t>(bestDistance) });
+
+            if (bestLength <= MaxInsertLength)
+            {
+                for (int32_t inserted = position + 1; inserted < position + static_cast<int32_t>(bestLength) && inserted < hashEnd; ++inserted)
+                {
+                    uint32_t hash = Hash(base + inserted);
+                    m_Previous[inserted & windowMask] = m_Head[hash];
+                    m_Head[hash] = inserted;
+                }
+            }
+
+            position += static_cast<int32_t>(bestLength);
+        }
+        else
+        {
+            m_Symbols.push_back({ base[position], 0 });
+            ++position;
+        }
+
+        if (m_Symbols.size() >= MaxBlockSymbols)
+        {
+            WriteBlock(writer, base + blockStart, position - blockStart, isLast && position == total);
+            m_Symbols.clear();
+            blockStart = position;
+        }
+    }
+
+    if (!m_Symbols.empty())
+        WriteBlock(writer, base + blockStart, position - blockStart, isLast);
+    else if (isLast && blockStart == static_cast<int32_t>(historySize))
+        WriteStored(writer, nullptr, 0, true);
+
+    // An empty stored block brings the stream to a byte boundary without ending it
+    if (!isLast)
+        WriteStored(writer, nullptr, 0, false);
+
+    writer.AlignToByte();
+}
+
+void Takoyaki::DeflateCompressor::WriteBlock(BitWriter& writer, const uint8_t* raw, size_t rawSize, bool isFinal)
+{
+    const Tables& tables = GetTables();
+
+    uint32_t literalFrequencies[LiteralCount] = {};
+    uint32_t distanceFrequencies[DistanceCount] = {};
+
+    for (const Symbol& symbol : m_Symbols)
+    {
+        if (symbol.m_Distance == 0)
+            ++literalFrequencies[symbol.m_Length];
+        else
+        {
+            ++literalFrequencies[257 + tables.m_LengthCode[symbol.m_Length]];
+            ++distanceFrequencies[tables.GetDistanceCode(symbol.m_Distance)];
+        }
+    }
+
+    literalFrequencies[EndOfBlock] = 1;
+
+    uint8_t literalLengths[LiteralCount];
+    uint8_t distanceLengths[DistanceCount];
+    BuildCodeLengths(literalFrequencies, LiteralCount, 15, literalLengths);
+    BuildCodeLengths(distanceFrequencies, DistanceCount, 15, distanceLengths);
+
+    uint32_t literalCount = LiteralCount;
+    while (literalCount > 257 && literalLengths[literalCount - 1] == 0)
+        --literalCount;
+
+    uint32_t distanceCount = DistanceCount;
+    while (distanceCount > 1 && distanceLengths[distanceCount - 1] == 0)
+        --distanceCount;
+
+    // Both tables' lengths are sent as one run-length coded sequence
+    uint8_t lengths[LiteralCount + DistanceCount];
+    memcpy(lengths, literalLengths, literalCount);
+    memcpy(lengths + literalCount, distanceLengths, distanceCount);
+    const uint32_t lengthCount = literalCount + distanceCount;
+
+    struct CodeLengthSymbol
+    {
+        uint8_t m_Symbol;
+        uint8_t m_Extra;
+    };
+
+    CodeLengthSymbol runs[LiteralCount + DistanceCount];
+    uint32_t runCount = 0;
+    uint32_t codeLengthFrequencies[CodeLengthCount] = {};
+
+    for (uint32_t i = 0; i < lengthCount;)
+    {
+        uint8_t value = lengths[i];
+        uint32_t run = 1;
+        while (i + run < lengthCount && lengths[i + run] == value)
+            ++run;
+
+        i += run;
+
+        if (value == 0)
+        {
+            for (; run >= 11; run -= std::min(run, 138u))
+                runs[runCount++] = { 18, static_cast<uint8_t>(std::min(run, 138u) - 11) };
+
+            if (run >= 3)
+            {
+                runs[runCount++] = { 17, static_cast<uint8_t>(run - 3) };
+                run = 0;
+            }
+        }
+        else
+        {
+            runs[runCount++] = { value, 0 };
+            for (--run; run >= 3; run -= std::min(run, 6u))
+                runs[runCount++] = { 16, static_cast<uint8_t>(std::min(run, 6u) - 3) };
+        }
+
+        for (; run > 0; --run)
+            runs[runCount++] = { value, 0 };
+    }
+
+    for (uint32_t i = 0; i < runCount; ++i)
+        ++codeLengthFrequencies[runs[i].m_Symbol];
+
+    uint8_t codeLengthLengths[CodeLengthCount];
+    uint16_t codeLengthCodes[CodeLengthCount] = {};
+    BuildCodeLengths(codeLengthFrequencies, CodeLengthCount, 7, codeLengthLengths);
+    BuildCodes(codeLengthLengths, CodeLengthCount, codeLengthCodes);
+
+    uint32_t codeLengthOrderCount = CodeLengthCount;
+    while (codeLengthOrderCount > 4 && codeLengthLengths[CodeLengthOrder[codeLengthOrderCount - 1]] == 0)
+        --codeLengthOrderCount;
+
+    // Compare against storing the block as is, which wins on noise
+    static constexpr uint8_t RunExtraBits[3] = { 2, 3, 7 };
+    uint64_t dynamicBits = 3 + 14 + 3 * codeLengthOrderCount;
+
+    for (uint32_t i = 0; i < CodeLengthCount; ++i)
+        dynamicBits += static_cast<uint64_t>(codeLengthFrequencies[i]) * (codeLengthLengths[i] + (i >= 16 ? RunExtraBits[i - 16] : 0));
+
+    for (uint32_t i = 0; i < LiteralCount; ++i)
+        dynamicBits += static_cast<uint64_t>(literalFrequencies[i]) * (literalLengths[i] + (i > 256 ? LengthExtra[i - 257] : 0));
+
+    for (uint32_t i = 0; i < DistanceCount; ++i)
+        dynamicBits += static_cast<uint64_t>(distanceFrequencies[i]) * (distanceLengths[i] + DistanceExtra[i]);
+
+    uint64_t storedBits = (rawSize + (rawSize / 65535 + 1) * 5) * 8 + 7;
+    if (storedBits <= dynamicBits)
+    {
+        WriteStored(writer, raw, rawSize, isFinal);
+        return;
+    }
+
+    uint16_t literalCodes[LiteralCount] = {};
+    uint16_t distanceCodes[DistanceCount] = {};
+    BuildCodes(literalLengths, LiteralCount, literalCodes);
+    BuildCodes(distanceLengths, DistanceCount, distanceCodes);
+
+    writer.Write(isFinal ? 1 : 0, 1);
+    writer.Write(2, 2);
+    writer.Write(literalCount - 257, 5);
+    writer.Write(distanceCount - 1, 5);
+    writer.Write(codeLengthOrderCount - 4, 4);
+
+    for (uint32_t i = 0; i < codeLengthOrderCount; ++i)
+        writer.Write(codeLengthLengths[CodeLengthOrder[i]], 3);
+
+    for (uint32_t i = 0; i < runCount; ++i)
+    {
+        const CodeLengthSymbol& run = runs[i];
+        writer.Write(codeLengthCodes[run.m_Symbol], codeLengthLengths[run.m_Symbol]);
+        if (run.m_Symbol >= 16)
+            writer.Write(run.m_Extra, RunExtraBits[run.m_Symbol - 16]);
+    }
+
+    for (const Symbol& symbol : m_Symbols)
+    {
+        if (symbol.m_Distance == 0)
+        {
+            writer.Write(literalCodes[symbol.m_Length], literalLengths[symbol.m_Length]);
+            continue;
+        }
+
+        uint32_t lengthCode = tables.m_LengthCode[symbol.m_Length];
+        writer.Write(literalCodes[257 + lengthCode], literalLengths[257 + lengthCode]);
+        writer.Write(symbol.m_Length - LengthBase[lengthCode], LengthExtra[lengthCode]);
+
+        uint32_t distanceCode = tables.GetDistanceCode(symbol.m_Distance);
+        writer.Write(distanceCodes[distanceCode], distanceLengths[distanceCode]);
+        writer.Write(symbol.m_Distance - DistanceBase[distanceCode], DistanceExtra[distanceCode]);
+    }
+
+    writer.Write(literalCodes[EndOfBlock], literalLengths[EndOfBlock]);
+}
+
+void Takoyaki::DeflateCompressor::WriteStored(BitWriter& writer, const uint8_t* raw, size_t rawSize, bool isFinal)
+{
+    do
+    {
+        uint32_t blockSize = static_cast<uint32_t>(std::min<size_t>(rawSize, 65535));
+        rawSize -= blockSize;
+
+        writer.Write(isFinal && rawSize == 0 ? 1 : 0, 1);
+        writer.Write(0, 2);
+        writer.AlignToByte();
+
+        uint8_t header[4] = { static_cast<uint8_t>(blockSize), static_cast<uint8_t>(blockSize >> 8), static_cast<uint8_t>(~blockSize), static_cast<uint8_t>(~blockSize >> 8) };
+        writer.WriteBytes(header, sizeof(header));
+        if (blockSize > 0)
+            writer.WriteBytes(raw, blockSize);
+
+        raw += blockSize;
+    } while (rawSize > 0);
+}
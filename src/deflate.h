@@ -0,0 +1,80 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Takoyaki
+{
+    // Checksums for PNG chunks and zlib streams. Pass the previous result to continue one
+    // over several calls.
+    uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+    uint32_t Adler32(const uint8_t* data, size_t size, uint32_t adler = 1);
+
+    // Adler-32 of two buffers back to back, from the checksum of each and the second's size
+    uint32_t CombineAdler32(uint32_t first, uint32_t second, size_t secondSize);
+
+    // Raw deflate compressor for data that is split into chunks and compressed on several
+    // threads at once. Each chunk may match against the 32 KB of input before it, so the
+    // chunks compress almost as well as one stream would, and every chunk but the last ends
+    // byte aligned with an empty stored block, so the outputs simply concatenate into one
+    // valid stream. Matches come from a 4-byte hash chain, greedy, and blocks use dynamic
+    // Huffman codes, falling back to stored blocks for incompressible input.
+    class DeflateCompressor
+    {
+    public:
+        static constexpr size_t WindowSize = 32768;
+
+        DeflateCompressor();
+        ~DeflateCompressor() = default;
+
+        DeflateCompressor(const DeflateCompressor&) = delete;
+        DeflateCompressor& operator=(const DeflateCompressor&) = delete;
+
+        // Appends the compressed form of data[0, size) to out. The historySize bytes before
+        // data must be readable, and are used as the dictionary.
+        void Compress(const uint8_t* data, size_t size, size_t historySize, bool isLast, std::vector<uint8_t>& out);
+
+        // How many earlier positions are tried for each match, trading speed for ratio
+        inline void SetMaxChainLength(uint32_t length) { m_MaxChainLength = length > 0 ? length : 1; }
+
+    private:
+        struct Symbol
+        {
+            uint16_t m_Length = 0;      // Match length, or the literal byte when m_Distance is 0
+            uint16_t m_Distance = 0;
+        };
+
+        class BitWriter;
+
+        void WriteBlock(BitWriter& writer, const uint8_t* raw, size_t rawSize, bool isFinal);
+        static void WriteStored(BitWriter& writer, const uint8_t* raw, size_t rawSize, bool isFinal);
+
+    private:
+        std::vector<int32_t> m_Head;
+        std::vector<int32_t> m_Previous;
+        std::vector<Symbol> m_Symbols;
+
+        uint32_t m_MaxChainLength = 8;
+    };
+}
@@ -0,0 +1,290 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "edgemap.h"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include "kernels/pixelkernels.h"
+
+Takoyaki::EdgeMap::~EdgeMap()
+{
+    Wait();
+}
+
+void Takoyaki::EdgeMap::Build(const FrameView& frame, int32_t originX, int32_t originY)
+{
+    Wait();
+    BuildEdges(frame, originX, originY);
+}
+
+void Takoyaki::EdgeMap::BuildEdges(const FrameView& frame, int32_t originX, int32_t originY)
+{
+    ClearEdges();
+
+    if (!frame.IsValid())
+        return;
+
+    const auto start = std::chrono::steady_clock::now();
+    const PixelKernels& kernels = GetPixelKernels();
+    const uint32_t width = frame.m_Width;
+    const uint32_t height = frame.m_Height;
+
+    m_OriginX = originX;
+    m_OriginY = originY;
+    m_Width = width;
+    m_Height = height;
+
+    // Three luma rows in a ring, one row of each gradient and its bits, so a 4K snapshot
+    // needs only a few tens of KB on top of itself
+    const uint32_t words = (width + 63) / 64;
+    std::vector<uint8_t> luma(static_cast<size_t>(width) * 3);
+    std::vector<uint8_t> gradientX(width, 0);
+    std::vector<uint8_t> gradientY(width, 0);
+    std::vector<uint64_t> rowBits(words);
+    std::vector<uint64_t> columnBits(words);
+
+    // Columns with a vertical run open through the previous row, and the row each started on
+    std::vector<uint64_t> openColumns(words, 0);
+    std::vector<uint32_t> runStarts(width, 0);
+
+    auto getLuma = [&](uint32_t y) { return luma.data() + static_cast<size_t>(y % 3) * width; };
+
+    auto forEachBit = [](uint64_t bits, auto&& function)
+    {
+        for (; bits != 0; bits &= bits - 1)
+            function(static_cast<uint32_t>(std::countr_zero(bits)));
+    };
+
+    // Runs are only ever looked at where they start or end, so flat areas cost a few word
+    // operations per 64 pixels, and only text and edges cost per pixel
+    auto closeColumns = [&](uint32_t word, uint64_t ends, uint32_t y)
+    {
+        forEachBit(ends, [&](uint32_t bit)
+        {
+            uint32_t x = word * 64 + bit;
+            if (y - runStarts[x] >= MinEdgeLength)
+                m_Vertical.m_Segments.push_back({ static_cast<int32_t>(x), static_cast<int32_t>(runStarts[x]), static_cast<int32_t>(y) });
+        });
+    };
+
+    if (height >= 3 && width >= 3)
+    {
+        kernels.m_LumaRow(frame.GetRow(0), getLuma(0), width);
+        kernels.m_LumaRow(frame.GetRow(1), getLuma(1), width);
+
+        // The outermost rows and columns have no gradient
+        for (uint32_t y = 1; y + 1 < height; ++y)
+        {
+            kernels.m_LumaRow(frame.GetRow(y + 1), getLuma(y + 1), width);
+            kernels.m_SobelRow(getLuma(y - 1) + 1, getLuma(y) + 1, getLuma(y + 1) + 1, gradientX.data() + 1, gradientY.data() + 1, width - 2);
+            kernels.m_ThresholdRow(gradientY.data(), rowBits.data(), width, m_Threshold);
+            kernels.m_ThresholdRow(gradientX.data(), columnBits.data(), width, m_Threshold);
+
+            // Horizontal runs start and end where a bit differs from the one before it. The
+            // last pixel of a row is never strong, so every run ends within the row.
+            uint32_t runStart = 0;
+            uint64_t carry = 0;
+
+            for (uint32_t word = 0; word < words; ++word)
+            {
+                uint64_t bits = rowBits[word];
+                forEachBit(bits ^ ((bits << 1) | carry), [&](uint32_t bit)
+                {
+                    uint32_t x = word * 64 + bit;
+                    if ((bits >> bit) & 1)
+                        runStart = x;
+                    else if (x - runStart >= MinEdgeLength)
+                        m_Horizontal.m_Segments.push_back({ static_cast<int32_t>(y), static_cast<int32_t>(runStart), static_cast<int32_t>(x) });
+                });
+
+                carry = bits >> 63;
+            }
+
+            for (uint32_t word = 0; word < words; ++word)
+            {
+                uint64_t open = openColumns[word];
+                uint64_t bits = columnBits[word];
+
+                forEachBit(bits & ~open, [&](uint32_t bit) { runStarts[word * 64 + bit] = y; });
+                closeColumns(word, open & ~bits, y);
+                openColumns[word] = bits;
+            }
+        }
+
+        for (uint32_t word = 0; word < words; ++word)
+            closeColumns(word, openColumns[word], height - 1);
+    }
+
+    m_Horizontal.Finish(height);
+    m_Vertical.Finish(width);
+
+    m_BuildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    m_IsReady.store(true, std::memory_order_release);
+}
+
+void Takoyaki::EdgeMap::BuildAsync(std::vector<uint32_t> pixels, uint32_t width, uint32_t height, int32_t originX, int32_t originY, MemoryReservation pixelMemory)
+{
+    Wait();
+    m_IsReady.store(false, std::memory_order_release);
+    m_PixelMemory = std::move(pixelMemory);
+
+    m_Thread = std::thread([this, pixels = std::move(pixels), width, height, originX, originY]() mutable
+    {
+        FrameView frame = { reinterpret_cast<uint8_t*>(pixels.data()), width, height, width * 4 };
+        if (pixels.size() < static_cast<size_t>(width) * height)
+            frame = {};
+
+        BuildEdges(frame, originX, originY);
+
+        // Only the index is needed from here on, so the snapshot and its charge go now
+        // rather than when the thread is joined
+        pixels = {};
+        m_PixelMemory.Reset();
+    });
+}
+
+void Takoyaki::EdgeMap::Clear()
+{
+    Wait();
+    ClearEdges();
+
+    m_PixelMemory.Reset();
+}
+
+void Takoyaki::EdgeMap::ClearEdges()
+{
+    m_IsReady.store(false, std::memory_order_release);
+
+    m_Horizontal.m_Segments.clear();
+    m_Horizontal.m_Offsets.clear();
+    m_Vertical.m_Segments.clear();
+    m_Vertical.m_Offsets.clear();
+    m_Width = 0;
+    m_Height = 0;
+}
+
+bool Takoyaki::EdgeMap::SnapX(int32_t x, int32_t y, int32_t radius, int32_t& outX) const
+{
+    if (!IsReady() || !m_Vertical.Find(x - m_OriginX, y - m_OriginY, radius, outX))
+        return false;
+
+    outX += m_OriginX;
+    return true;
+}
+
+bool Takoyaki::EdgeMap::SnapY(int32_t x, int32_t y, int32_t radius, int32_t& outY) const
+{
+    if (!IsReady() || !m_Horizontal.Find(y - m_OriginY, x - m_OriginX, radius, outY))
+        return false;
+
+    outY += m_OriginY;
+    return true;
+}
+
+bool Takoyaki::EdgeMap::Snap(int32_t& x, int32_t& y, int32_t radius) const
+{
+    int32_t snapped = 0;
+    bool hasSnappedX = SnapX(x, y, radius, snapped);
+    if (hasSnappedX)
+        x = snapped;
+
+    bool hasSnappedY = SnapY(x, y, radius, snapped);
+    if (hasSnappedY)
+        y = snapped;
+
+    if (!hasSnappedX && hasSnappedY && SnapX(x, y, radius, snapped))
+    {
+        x = snapped;
+        hasSnappedX = true;
+    }
+
+    return hasSnappedX || hasSnappedY;
+}
+
+std::string Takoyaki::EdgeMap::GetReport() const
+{
+    if (!IsReady())
+        return "Edge map: not built\n";
+
+    char report[160];
+    snprintf(report, sizeof(report), "Edge map: %ux%u, %zu horizontal and %zu vertical edges, built in %.2f ms\n",
+        m_Width, m_Height, m_Horizontal.m_Segments.size(), m_Vertical.m_Segments.size(), m_BuildMs);
+
+    return report;
+}
+
+void Takoyaki::EdgeMap::Wait()
+{
+    if (m_Thread.joinable())
+        m_Thread.join();
+}
+
+void Takoyaki::EdgeMap::EdgeIndex::Finish(uint32_t bucketCount)
+{
+    std::sort(m_Segments.begin(), m_Segments.end(), [](const EdgeSegment& a, const EdgeSegment& b)
+    {
+        return a.m_Position != b.m_Position ? a.m_Position < b.m_Position : a.m_Start < b.m_Start;
+    });
+
+    m_Offsets.assign(bucketCount + 1, 0);
+    for (const EdgeSegment& segment : m_Segments)
+        ++m_Offsets[segment.m_Position + 1];
+
+    for (uint32_t i = 0; i < bucketCount; ++i)
+        m_Offsets[i + 1] += m_Offsets[i];
+}
+
+bool Takoyaki::EdgeMap::EdgeIndex::Find(int32_t position, int32_t along, int32_t radius, int32_t& outPosition) const
+{
+    const int32_t bucketCount = static_cast<int32_t>(m_Offsets.size()) - 1;
+
+    auto contains = [&](int32_t bucket)
+    {
+        if (bucket < 0 || bucket >= bucketCount)
+            return false;
+
+        // Segments in a bucket never overlap, so only the last one starting at or before
+        // along, give or take the slack, can contain it
+        auto first = m_Segments.begin() + m_Offsets[bucket];
+        auto last = m_Segments.begin() + m_Offsets[bucket + 1];
+        auto next = std::upper_bound(first, last, along + EndSlack, [](int32_t value, const EdgeSegment& segment) { return value < segment.m_Start; });
+
+        return next != first && (next - 1)->m_End + EndSlack > along;
+    };
+
+    // Outward from position, so the first hit is the nearest
+    for (int32_t distance = 0; distance <= radius; ++distance)
+    {
+        if (contains(position - distance))
+        {
+            outPosition = position - distance;
+            return true;
+        }
+
+        if (distance != 0 && contains(position + distance))
+        {
+            outPosition = position + distance;
+            return true;
+        }
+    }
+
+    return false;
+}
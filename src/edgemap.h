@@ -0,0 +1,124 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include "frame.h"
+#include "memorybudget.h"
+
+namespace Takoyaki
+{
+    // A straight run of strong gradient, covering [m_Start, m_End) along the edge
+    struct EdgeSegment
+    {
+        int32_t m_Position = 0; // y of a horizontal edge, x of a vertical one
+        int32_t m_Start = 0;
+        int32_t m_End = 0;
+    };
+
+    // Index of the long horizontal and vertical edges in a desktop snapshot, such as window
+    // borders, for snapping a selection to them while dragging. Building runs a SIMD Sobel
+    // over the luma of the snapshot a row at a time and keeps only runs of strong gradient
+    // at least MinEdgeLength long, so text and icons drop out. Edges are bucketed by their
+    // row or column, so a snap looks at no more than 2 * radius + 1 buckets with a binary
+    // search in each.
+    class EdgeMap
+    {
+    public:
+        static constexpr uint32_t MinEdgeLength = 48;
+
+        // Sobel spreads an edge a pixel past each end of the line it found, so a point this
+        // close past the end of an edge still counts as on it
+        static constexpr int32_t EndSlack = 2;
+
+        EdgeMap() = default;
+        ~EdgeMap();
+
+        EdgeMap(const EdgeMap&) = delete;
+        EdgeMap& operator=(const EdgeMap&) = delete;
+
+        // Indexes frame, whose top left pixel is at (originX, originY) in screen coordinates
+        void Build(const FrameView& frame, int32_t originX, int32_t originY);
+
+        // Takes the snapshot and builds on a background thread. Snaps find nothing until it
+        // is done, and a build still running is waited for first. pixelMemory is the budget
+        // charge for pixels, held until the build is done with them or the map is cleared.
+        void BuildAsync(std::vector<uint32_t> pixels, uint32_t width, uint32_t height, int32_t originX, int32_t originY, MemoryReservation pixelMemory = {});
+
+        // Waits for a build still running first, and gives back the snapshot charge if it
+        // is still held
+        void Clear();
+
+        // Nearest vertical edge within radius of x that passes through y, and the nearest
+        // horizontal edge within radius of y that passes through x. Return false, leaving the
+        // output alone, if there is none or the map is not built yet.
+        bool SnapX(int32_t x, int32_t y, int32_t radius, int32_t& outX) const;
+        bool SnapY(int32_t x, int32_t y, int32_t radius, int32_t& outY) const;
+
+        // Both of the above, so a point near a corner snaps to it even from outside, where
+        // only one of the borders passes through it until the other has snapped. Returns
+        // false if neither coordinate moved.
+        bool Snap(int32_t& x, int32_t& y, int32_t radius) const;
+
+    public:
+        inline bool IsReady() const { return m_IsReady.load(std::memory_order_acquire); }
+
+        // Gradient, out of 255, that counts as an edge
+        inline void SetThreshold(uint8_t threshold) { m_Threshold = threshold; }
+
+        std::string GetReport() const;
+
+    private:
+        // One bucket per row (horizontal) or column (vertical), each sorted by m_Start
+        struct EdgeIndex
+        {
+            std::vector<EdgeSegment> m_Segments;
+            std::vector<uint32_t> m_Offsets;
+
+            void Finish(uint32_t bucketCount);
+            bool Find(int32_t position, int32_t along, int32_t radius, int32_t& outPosition) const;
+        };
+
+        // Build without waiting, for the build thread, which must not touch m_Thread
+        void BuildEdges(const FrameView& frame, int32_t originX, int32_t originY);
+
+        void Wait();
+        void ClearEdges();
+
+    private:
+        uint8_t m_Threshold = 12;
+
+        EdgeIndex m_Horizontal;
+        EdgeIndex m_Vertical;
+        int32_t m_OriginX = 0;
+        int32_t m_OriginY = 0;
+        uint32_t m_Width = 0;
+        uint32_t m_Height = 0;
+        double m_BuildMs = 0.0;
+
+        std::atomic<bool> m_IsReady = false;
+        std::thread m_Thread;
+        MemoryReservation m_PixelMemory;
+    };
+}
@@ -0,0 +1,138 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "executor.h"
+#include <utility>
+
+Takoyaki::Task::Task(Task&& other) noexcept
+    : m_Handle(std::exchange(other.m_Handle, nullptr))
+    , m_IsDone(std::move(other.m_IsDone))
+{
+}
+
+Takoyaki::Task::~Task()
+{
+    if (m_Handle)
+        m_Handle.destroy();
+}
+
+Takoyaki::Task& Takoyaki::Task::operator=(Task&& other) noexcept
+{
+    if (this != &other)
+    {
+        if (m_Handle)
+            m_Handle.destroy();
+
+        m_Handle = std::exchange(other.m_Handle, nullptr);
+        m_IsDone = std::move(other.m_IsDone);
+    }
+
+    return *this;
+}
+
+void Takoyaki::Task::Start(Executor& executor)
+{
+    executor.Post(m_Handle);
+}
+
+void Takoyaki::Task::Wait() const
+{
+    if (m_IsDone)
+        m_IsDone->wait(false, std::memory_order_acquire);
+}
+
+bool Takoyaki::Task::IsDone() const
+{
+    return !m_IsDone || m_IsDone->load(std::memory_order_acquire);
+}
+
+Takoyaki::Executor::Executor(uint32_t threadCount)
+{
+    m_Threads.reserve(threadCount);
+
+    for (uint32_t i = 0; i < threadCount; ++i)
+        m_Threads.emplace_back(&Executor::WorkerLoop, this);
+}
+
+Takoyaki::Executor::~Executor()
+{
+    Stop();
+}
+
+void Takoyaki::Executor::Post(std::coroutine_handle<> handle)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Ready.push_back(handle);
+    }
+
+    m_Condition.notify_one();
+}
+
+size_t Takoyaki::Executor::Poll()
+{
+    std::deque<std::coroutine_handle<>> ready;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        ready.swap(m_Ready);
+    }
+
+    for (std::coroutine_handle<> handle : ready)
+        handle.resume();
+
+    return ready.size();
+}
+
+void Takoyaki::Executor::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_IsStopping = true;
+    }
+
+    m_Condition.notify_all();
+
+    for (std::thread& thread : m_Threads)
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+}
+
+void Takoyaki::Executor::WorkerLoop()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+
+    while (true)
+    {
+        m_Condition.wait(lock, [this]() { return m_IsStopping || !m_Ready.empty(); });
+
+        if (m_IsStopping)
+            return;
+
+        std::coroutine_handle<> handle = m_Ready.front();
+        m_Ready.pop_front();
+
+        lock.unlock();
+        handle.resume();
+        lock.lock();
+    }
+}
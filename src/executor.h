@@ -0,0 +1,147 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Takoyaki
+{
+    class Executor;
+
+    // Coroutine that starts suspended and runs once it is handed to an Executor. The Task
+    // owns the coroutine frame, so it must outlive the coroutine, which Wait ensures.
+    class Task
+    {
+    public:
+        struct promise_type
+        {
+            std::shared_ptr<std::atomic<bool>> m_IsDone = std::make_shared<std::atomic<bool>>(false);
+
+            Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+
+            // Done is only flagged once the coroutine is suspended for good, so whoever waits
+            // on it may destroy the frame right away
+            auto final_suspend() noexcept
+            {
+                struct FinalAwaiter
+                {
+                    bool await_ready() noexcept { return false; }
+                    void await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+                    {
+                        std::shared_ptr<std::atomic<bool>> isDone = handle.promise().m_IsDone;
+                        isDone->store(true, std::memory_order_release);
+                        isDone->notify_all();
+                    }
+                    void await_resume() noexcept {}
+                };
+
+                return FinalAwaiter{};
+            }
+
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+
+        Task() = default;
+        Task(const Task&) = delete;
+        Task(Task&& other) noexcept;
+        ~Task();
+
+        Task& operator=(const Task&) = delete;
+        Task& operator=(Task&& other) noexcept;
+
+        void Start(Executor& executor);
+
+        // Blocks until the coroutine has finished. With an executor that has no worker threads,
+        // this thread has to be the one that polls it, so poll until IsDone instead.
+        void Wait() const;
+        bool IsDone() const;
+
+    private:
+        explicit Task(std::coroutine_handle<promise_type> handle) : m_Handle(handle), m_IsDone(handle.promise().m_IsDone) {}
+
+    private:
+        std::coroutine_handle<promise_type> m_Handle;
+        std::shared_ptr<std::atomic<bool>> m_IsDone;
+    };
+
+    // Resumes coroutines on a small fixed set of worker threads. An executor without workers
+    // runs nothing by itself: the owner calls Poll, so every coroutine stays on its thread.
+    class Executor
+    {
+    public:
+        explicit Executor(uint32_t threadCount);
+        ~Executor();
+
+        Executor(const Executor&) = delete;
+        Executor& operator=(const Executor&) = delete;
+
+        void Post(std::coroutine_handle<> handle);
+
+        // Resumes what was ready when it was called, but nothing that becomes ready while it
+        // runs, so a coroutine that yields cannot keep it busy. Returns how many were resumed.
+        size_t Poll();
+
+        // Workers finish the coroutine they are running and exit. Whatever is still queued
+        // is never resumed, and is destroyed along with the Tasks that own it.
+        void Stop();
+
+        // co_await executor.Schedule() continues the coroutine on this executor, and behind
+        // everything already queued, which is also how a coroutine yields
+        auto Schedule()
+        {
+            struct ScheduleAwaiter
+            {
+                Executor& m_Executor;
+
+                bool await_ready() const noexcept { return false; }
+                void await_suspend(std::coroutine_handle<> handle) { m_Executor.Post(handle); }
+                void await_resume() const noexcept {}
+            };
+
+            return ScheduleAwaiter{ *this };
+        }
+
+    public:
+        inline uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_Threads.size()); }
+
+    private:
+        void WorkerLoop();
+
+    private:
+        std::mutex m_Mutex;
+        std::condition_variable m_Condition;
+        std::deque<std::coroutine_handle<>> m_Ready;
+        bool m_IsStopping = false;
+
+        std::vector<std::thread> m_Threads;
+    };
+}
@@ -0,0 +1,56 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Takoyaki
+{
+    // Mirrors Tako::TakoRect so that the portable parts of the frame pipeline
+    // do not have to pull in Tako's Windows headers.
+    struct Rect
+    {
+        int32_t m_X = 0;
+        int32_t m_Y = 0;
+        uint32_t m_Width = 0;
+        uint32_t m_Height = 0;
+
+        bool operator==(const Rect& other) const = default;
+    };
+
+    // Non-owning view of a 32-bit BGRA frame in CPU memory.
+    struct FrameView
+    {
+        uint8_t* m_Data = nullptr;
+        uint32_t m_Width = 0;
+        uint32_t m_Height = 0;
+        uint32_t m_Stride = 0;
+
+        inline uint32_t* GetRow(uint32_t y) const { return reinterpret_cast<uint32_t*>(m_Data + static_cast<size_t>(y) * m_Stride); }
+        inline bool IsValid() const { return m_Data != nullptr && m_Width != 0 && m_Height != 0; }
+
+        // rect must lie inside the frame
+        inline FrameView GetSubView(const Rect& rect) const
+        {
+            return { m_Data + static_cast<size_t>(rect.m_Y) * m_Stride + static_cast<size_t>(rect.m_X) * 4, rect.m_Width, rect.m_Height, m_Stride };
+        }
+    };
+}
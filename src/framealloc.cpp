@@ -0,0 +1,335 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "framealloc.h"
+
+#include <algorithm>
+#include <bit>
+#include <new>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+#if defined(__linux__)
+namespace
+{
+    constexpr size_t HugePageSize = 2 << 20;
+}
+#endif
+
+Takoyaki::FrameAllocator::FrameAllocator(MemoryBudget& budget)
+    : m_Budget(budget)
+{
+    m_ReclaimerId = m_Budget.AddReclaimer("frame allocator cache", [this](size_t) { Trim(); });
+}
+
+Takoyaki::FrameAllocator::~FrameAllocator()
+{
+    m_Budget.RemoveReclaimer(m_ReclaimerId);
+    Trim();
+}
+
+uint32_t Takoyaki::FrameAllocator::GetSizeClass(size_t size)
+{
+    if (size <= MinClassSize)
+        return 0;
+
+    // size lies in (2^k, 2^(k+1)], split into ClassesPerDoubling equal steps
+    uint32_t k = static_cast<uint32_t>(std::bit_width(size - 1)) - 1;
+    size_t base = size_t(1) << k;
+    size_t step = base / ClassesPerDoubling;
+    uint32_t substep = static_cast<uint32_t>((size - base + step - 1) / step);
+
+    return 1 + (k - 12) * ClassesPerDoubling + (substep - 1);
+}
+
+size_t Takoyaki::FrameAllocator::GetClassSize(uint32_t sizeClass)
+{
+    if (sizeClass == 0)
+        return MinClassSize;
+
+    uint32_t k = 12 + (sizeClass - 1) / ClassesPerDoubling;
+    uint32_t substep = 1 + (sizeClass - 1) % ClassesPerDoubling;
+    size_t base = size_t(1) << k;
+
+    return base + substep * (base / ClassesPerDoubling);
+}
+
+Takoyaki::FrameAllocation Takoyaki::FrameAllocator::Allocate(size_t size, MemoryCategory category)
+{
+    if (size == 0)
+        return {};
+
+    uint32_t sizeClass = GetSizeClass(size);
+    if (sizeClass >= ClassCount)
+        return {};
+
+    const size_t classSize = GetClassSize(sizeClass);
+    bool useHugePages = false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        std::vector<FrameAllocation>& freeBlocks = m_FreeBlocks[sizeClass];
+        if (!freeBlocks.empty())
+        {
+            FrameAllocation allocation = freeBlocks.back();
+            freeBlocks.pop_back();
+
+            allocation.m_Category = category;
+            m_Budget.Transfer(MemoryCategory::Cached, category, classSize);
+
+            ++m_Stats.m_PoolHits;
+            m_Stats.m_BytesCached -= classSize;
+            m_Stats.m_BytesInUse += classSize;
+            m_Stats.m_PeakBytesInUse = std::max(m_Stats.m_PeakBytesInUse, m_Stats.m_BytesInUse);
+            return allocation;
+        }
+
+        useHugePages = m_UseHugePages;
+    }
+
+    // Charge first, so an over budget allocation can make room by trimming the cache. Both
+    // this and the system call happen outside the lock.
+    m_Budget.Charge(category, classSize);
+
+    FrameAllocation allocation = SystemAllocate(classSize, useHugePages);
+    if (!allocation.m_Data)
+    {
+        m_Budget.Release(category, classSize);
+        return {};
+    }
+
+    allocation.m_Category = category;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    ++m_Stats.m_SystemAllocations;
+    if (allocation.m_IsHugePage)
+        ++m_Stats.m_HugePageAllocations;
+
+    m_Stats.m_BytesInUse += classSize;
+    m_Stats.m_PeakBytesInUse = std::max(m_Stats.m_PeakBytesInUse, m_Stats.m_BytesInUse);
+    return allocation;
+}
+
+void Takoyaki::FrameAllocator::Free(FrameAllocation& allocation)
+{
+    if (!allocation.m_Data)
+        return;
+
+    uint32_t sizeClass = GetSizeClass(allocation.m_Size);
+    bool release = false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stats.m_BytesInUse -= allocation.m_Size;
+
+        if (m_Stats.m_BytesCached + allocation.m_Size <= m_MaxCachedBytes)
+        {
+            m_FreeBlocks[sizeClass].push_back(allocation);
+            m_Stats.m_BytesCached += allocation.m_Size;
+            m_Budget.Transfer(allocation.m_Category, MemoryCategory::Cached, allocation.m_Size);
+        }
+        else
+        {
+            ++m_Stats.m_SystemFrees;
+            m_Budget.Release(allocation.m_Category, allocation.m_Size);
+            release = true;
+        }
+    }
+
+    if (release)
+        SystemFree(allocation);
+
+    allocation = {};
+}
+
+void Takoyaki::FrameAllocator::Trim()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    TrimLocked();
+}
+
+void Takoyaki::FrameAllocator::TrimLocked()
+{
+    for (uint32_t sizeClass = 0; sizeClass < ClassCount; ++sizeClass)
+    {
+        for (const FrameAllocation& allocation : m_FreeBlocks[sizeClass])
+        {
+            SystemFree(allocation);
+            m_Stats.m_BytesCached -= allocation.m_Size;
+            ++m_Stats.m_SystemFrees;
+            m_Budget.Release(MemoryCategory::Cached, allocation.m_Size);
+        }
+
+        m_FreeBlocks[sizeClass].clear();
+    }
+}
+
+Takoyaki::FrameAllocatorStats Takoyaki::FrameAllocator::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Stats;
+}
+
+void Takoyaki::FrameAllocator::SetUseHugePages(bool useHugePages)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_UseHugePages = useHugePages;
+}
+
+void Takoyaki::FrameAllocator::SetMaxCachedBytes(size_t maxCachedBytes)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_MaxCachedBytes = maxCachedBytes;
+
+    if (m_Stats.m_BytesCached > m_MaxCachedBytes)
+        TrimLocked();
+}
+
+Takoyaki::FrameAllocation Takoyaki::FrameAllocator::SystemAllocate(size_t size, bool useHugePages)
+{
+    FrameAllocation allocation;
+    allocation.m_Size = size;
+
+#if defined(__linux__)
+    if (useHugePages && size >= HugePageSize)
+    {
+        // Over-allocate so the block can start on a huge page boundary, then unmap the slack
+        size_t mappedSize = size + HugePageSize;
+        void* mapped = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapped != MAP_FAILED)
+        {
+            uintptr_t start = reinterpret_cast<uintptr_t>(mapped);
+            uintptr_t aligned = (start + HugePageSize - 1) & ~(HugePageSize - 1);
+
+            if (aligned != start)
+                munmap(mapped, aligned - start);
+
+            size_t tail = (start + mappedSize) - (aligned + size);
+            if (tail != 0)
+                munmap(reinterpret_cast<void*>(aligned + size), tail);
+
+            madvise(reinterpret_cast<void*>(aligned), size, MADV_HUGEPAGE);
+
+            allocation.m_Data = reinterpret_cast<uint8_t*>(aligned);
+            allocation.m_IsHugePage = true;
+            return allocation;
+        }
+    }
+#else
+    // Windows large pages need SeLockMemoryPrivilege, which a tray app cannot count on
+    (void)useHugePages;
+#endif
+
+    allocation.m_Data = static_cast<uint8_t*>(::operator new(size, std::align_val_t(FrameAlignment), std::nothrow));
+    return allocation;
+}
+
+void Takoyaki::FrameAllocator::SystemFree(const FrameAllocation& allocation)
+{
+#if defined(__linux__)
+    if (allocation.m_IsHugePage)
+    {
+        munmap(allocation.m_Data, allocation.m_Size);
+        return;
+    }
+#endif
+
+    ::operator delete(allocation.m_Data, std::align_val_t(FrameAlignment));
+}
+
+Takoyaki::FrameAllocator& Takoyaki::GetFrameAllocator()
+{
+    static FrameAllocator allocator;
+    return allocator;
+}
+
+Takoyaki::FrameArena::FrameArena(size_t initialSize, FrameAllocator& allocator, MemoryCategory category)
+    : m_Allocator(allocator)
+    , m_Category(category)
+{
+    m_Chunks.reserve(8);
+
+    if (initialSize != 0)
+        m_Chunks.push_back(m_Allocator.Allocate(initialSize, m_Category));
+}
+
+Takoyaki::FrameArena::~FrameArena()
+{
+    for (FrameAllocation& chunk : m_Chunks)
+        m_Allocator.Free(chunk);
+}
+
+void* Takoyaki::FrameArena::Allocate(size_t size, size_t alignment)
+{
+    if (!m_Chunks.empty())
+    {
+        const FrameAllocation& chunk = m_Chunks.back();
+        uintptr_t base = reinterpret_cast<uintptr_t>(chunk.m_Data);
+        uintptr_t aligned = (base + m_Offset + alignment - 1) & ~(alignment - 1);
+
+        if (aligned + size <= base + chunk.m_Size)
+        {
+            m_UsedBytes += (aligned + size) - (base + m_Offset);
+            m_PeakBytes = std::max(m_PeakBytes, m_UsedBytes);
+            m_Offset = (aligned + size) - base;
+            return reinterpret_cast<void*>(aligned);
+        }
+    }
+
+    // Start a new chunk, at least twice the last so a growing frame settles quickly
+    size_t chunkSize = std::max(size + alignment, m_Chunks.empty() ? size_t(0) : m_Chunks.back().m_Size * 2);
+    FrameAllocation chunk = m_Allocator.Allocate(chunkSize, m_Category);
+    if (!chunk.m_Data)
+        return nullptr;
+
+    m_UsedBytes += m_Chunks.empty() ? 0 : m_Chunks.back().m_Size - m_Offset;
+    m_Chunks.push_back(chunk);
+    m_Offset = 0;
+
+    return Allocate(size, alignment);
+}
+
+void Takoyaki::FrameArena::Reset()
+{
+    // A frame that spilled into several chunks gets one chunk big enough for all of them
+    if (m_Chunks.size() > 1)
+    {
+        for (FrameAllocation& chunk : m_Chunks)
+            m_Allocator.Free(chunk);
+
+        m_Chunks.clear();
+        m_Chunks.push_back(m_Allocator.Allocate(m_PeakBytes, m_Category));
+    }
+
+    m_Offset = 0;
+    m_UsedBytes = 0;
+}
+
+size_t Takoyaki::FrameArena::GetCapacity() const
+{
+    size_t capacity = 0;
+    for (const FrameAllocation& chunk : m_Chunks)
+        capacity += chunk.m_Size;
+
+    return capacity;
+}
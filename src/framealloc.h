@@ -0,0 +1,157 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "memorybudget.h"
+
+namespace Takoyaki
+{
+    // Every block handed out is aligned to at least a cache line, and frame rows are padded
+    // to the same, so SIMD stages can use aligned loads on any row.
+    static constexpr size_t FrameAlignment = 64;
+
+    inline uint32_t GetPaddedStride(uint32_t width) { return (width * 4 + FrameAlignment - 1) & ~static_cast<uint32_t>(FrameAlignment - 1); }
+
+    struct FrameAllocation
+    {
+        uint8_t* m_Data = nullptr;
+
+        // Size of the size class the block came from, which may exceed what was requested
+        size_t m_Size = 0;
+
+        // Mapped directly onto transparent huge pages rather than taken from the heap
+        bool m_IsHugePage = false;
+
+        // What the block is charged to in the memory budget while it is in use
+        MemoryCategory m_Category = MemoryCategory::Scratch;
+    };
+
+    struct FrameAllocatorStats
+    {
+        uint64_t m_SystemAllocations = 0;
+        uint64_t m_SystemFrees = 0;
+        uint64_t m_HugePageAllocations = 0;
+        uint64_t m_PoolHits = 0;
+
+        size_t m_BytesInUse = 0;
+        size_t m_BytesCached = 0;
+        size_t m_PeakBytesInUse = 0;
+    };
+
+    // Size-classed cache of large, aligned blocks for pixel buffers and stage scratch memory.
+    // Classes are spaced four per power of two, so a block wastes at most a fifth of its
+    // size, and freed blocks are kept for reuse up to a cap. Once the pipeline has seen its
+    // working set, allocating and freeing a frame never reaches the system allocator. Every
+    // block is charged to the memory budget, and the cache is the first thing it reclaims.
+    class FrameAllocator
+    {
+    public:
+        explicit FrameAllocator(MemoryBudget& budget = GetMemoryBudget());
+        ~FrameAllocator();
+
+        FrameAllocator(const FrameAllocator&) = delete;
+        FrameAllocator& operator=(const FrameAllocator&) = delete;
+
+        FrameAllocation Allocate(size_t size, MemoryCategory category = MemoryCategory::Scratch);
+        void Free(FrameAllocation& allocation);
+
+        // Returns every cached block to the system
+        void Trim();
+
+    public:
+        FrameAllocatorStats GetStats() const;
+
+        // Backs blocks of 2 MB and up with transparent huge pages where the OS supports it,
+        // which cuts TLB misses when walking whole frames. Only affects new blocks.
+        void SetUseHugePages(bool useHugePages);
+        inline bool IsUsingHugePages() const { return m_UseHugePages; }
+
+        void SetMaxCachedBytes(size_t maxCachedBytes);
+
+    private:
+        static constexpr size_t MinClassSize = 4096;
+        static constexpr uint32_t ClassesPerDoubling = 4;
+        static constexpr uint32_t ClassCount = 1 + 40 * ClassesPerDoubling;
+
+        static uint32_t GetSizeClass(size_t size);
+        static size_t GetClassSize(uint32_t sizeClass);
+
+        static FrameAllocation SystemAllocate(size_t size, bool useHugePages);
+        static void SystemFree(const FrameAllocation& allocation);
+
+        void TrimLocked();
+
+    private:
+        MemoryBudget& m_Budget;
+        uint32_t m_ReclaimerId = 0;
+
+        mutable std::mutex m_Mutex;
+        std::array<std::vector<FrameAllocation>, ClassCount> m_FreeBlocks;
+
+        FrameAllocatorStats m_Stats;
+        size_t m_MaxCachedBytes = 512ull << 20;
+        bool m_UseHugePages = false;
+    };
+
+    // Allocator shared by the whole frame pipeline
+    FrameAllocator& GetFrameAllocator();
+
+    // Bump allocator for scratch memory that only lives for one frame. Everything is freed
+    // at once by Reset at the end of the frame. If a frame overflows the current chunk, the
+    // chunks are merged into one on Reset, so from then on the arena is a single pointer
+    // bump per allocation. Not thread safe, use one arena per thread or stage.
+    class FrameArena
+    {
+    public:
+        explicit FrameArena(size_t initialSize = 1 << 20, FrameAllocator& allocator = GetFrameAllocator(), MemoryCategory category = MemoryCategory::Scratch);
+        ~FrameArena();
+
+        FrameArena(const FrameArena&) = delete;
+        FrameArena& operator=(const FrameArena&) = delete;
+
+        void* Allocate(size_t size, size_t alignment = FrameAlignment);
+
+        template<typename T>
+        inline T* AllocateArray(size_t count) { return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T) > FrameAlignment ? alignof(T) : FrameAlignment)); }
+
+        void Reset();
+
+    public:
+        inline size_t GetUsedBytes() const { return m_UsedBytes; }
+        inline size_t GetPeakBytes() const { return m_PeakBytes; }
+        size_t GetCapacity() const;
+
+    private:
+        FrameAllocator& m_Allocator;
+        MemoryCategory m_Category;
+        std::vector<FrameAllocation> m_Chunks;
+        size_t m_Offset = 0;
+
+        // Bytes handed out this frame including alignment padding, and the most of any frame
+        size_t m_UsedBytes = 0;
+        size_t m_PeakBytes = 0;
+    };
+}
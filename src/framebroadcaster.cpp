@@ -0,0 +1,169 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "framebroadcaster.h"
+
+#include <algorithm>
+
+Takoyaki::FrameSink::FrameSink(const SinkOptions& options)
+    : m_Options(options)
+{
+    m_Options.m_QueueDepth = std::max(m_Options.m_QueueDepth, 1u);
+    m_Queue.resize(m_Options.m_QueueDepth);
+}
+
+bool Takoyaki::FrameSink::TryPop(FrameRef& outFrame)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_Count == 0)
+        return false;
+
+    outFrame = PopLocked();
+    return true;
+}
+
+bool Takoyaki::FrameSink::WaitPop(FrameRef& outFrame, std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    if (!m_Condition.wait_for(lock, timeout, [this]() { return m_Count != 0 || m_IsClosed; }) || m_Count == 0)
+        return false;
+
+    outFrame = PopLocked();
+    return true;
+}
+
+uint64_t Takoyaki::FrameSink::GetReceivedCount() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_ReceivedCount;
+}
+
+uint64_t Takoyaki::FrameSink::GetDroppedCount() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_DroppedCount;
+}
+
+bool Takoyaki::FrameSink::IsClosed() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_IsClosed;
+}
+
+void Takoyaki::FrameSink::Push(const FrameRef& frame)
+{
+    // The dropped reference is released after unlocking, so a buffer going back to the
+    // pool never happens under the sink lock
+    FrameRef dropped;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_IsClosed)
+            return;
+
+        ++m_ReceivedCount;
+
+        if (m_Count == m_Queue.size())
+        {
+            ++m_DroppedCount;
+
+            if (m_Options.m_DropPolicy == DropPolicy::DropNewest)
+                return;
+
+            dropped = PopLocked();
+        }
+
+        m_Queue[(m_Head + m_Count) % m_Queue.size()] = frame;
+        ++m_Count;
+    }
+
+    m_Condition.notify_one();
+}
+
+void Takoyaki::FrameSink::Close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_IsClosed = true;
+    }
+
+    m_Condition.notify_all();
+}
+
+Takoyaki::FrameRef Takoyaki::FrameSink::PopLocked()
+{
+    FrameRef frame = std::move(m_Queue[m_Head]);
+    m_Head = (m_Head + 1) % static_cast<uint32_t>(m_Queue.size());
+    --m_Count;
+    return frame;
+}
+
+Takoyaki::FrameBroadcaster::~FrameBroadcaster()
+{
+    std::lock_guard<std::mutex> lock(m_SinksMutex);
+    for (const std::shared_ptr<FrameSink>& sink : m_Sinks)
+        sink->Close();
+}
+
+std::shared_ptr<Takoyaki::FrameSink> Takoyaki::FrameBroadcaster::Subscribe(const SinkOptions& options)
+{
+    auto sink = std::make_shared<FrameSink>(options);
+
+    std::lock_guard<std::mutex> lock(m_SinksMutex);
+    m_Sinks.push_back(sink);
+    return sink;
+}
+
+void Takoyaki::FrameBroadcaster::Unsubscribe(const std::shared_ptr<FrameSink>& sink)
+{
+    if (!sink)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_SinksMutex);
+        std::erase(m_Sinks, sink);
+    }
+
+    sink->Close();
+}
+
+Takoyaki::FrameRef Takoyaki::FrameBroadcaster::Publish(WritableFrame&& frame)
+{
+    if (!frame)
+        return {};
+
+    FrameBuffer* buffer = frame.Detach();
+    buffer->m_FrameId = m_NextFrameId++;
+
+    // The writable reference becomes the producer's read-only one. Everything written to
+    // the buffer is published to the sinks by their queue locks.
+    FrameRef published(buffer);
+
+    std::lock_guard<std::mutex> lock(m_SinksMutex);
+    for (const std::shared_ptr<FrameSink>& sink : m_Sinks)
+        sink->Push(published);
+
+    return published;
+}
+
+size_t Takoyaki::FrameBroadcaster::GetSinkCount() const
+{
+    std::lock_guard<std::mutex> lock(m_SinksMutex);
+    return m_Sinks.size();
+}
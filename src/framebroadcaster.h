@@ -0,0 +1,118 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "framepool.h"
+
+namespace Takoyaki
+{
+    enum class DropPolicy
+    {
+        DropOldest,     // Keep the newest frames, best for live outputs
+        DropNewest,     // Keep what is already queued, best for sinks that need every frame in order
+    };
+
+    struct SinkOptions
+    {
+        uint32_t m_QueueDepth = 2;
+        DropPolicy m_DropPolicy = DropPolicy::DropOldest;
+    };
+
+    // Bounded queue of published frames for one consumer. Only the owning consumer pops.
+    class FrameSink
+    {
+    public:
+        explicit FrameSink(const SinkOptions& options);
+        ~FrameSink() = default;
+
+        bool TryPop(FrameRef& outFrame);
+
+        // Returns false on timeout, or once the broadcaster is gone and the queue is empty
+        bool WaitPop(FrameRef& outFrame, std::chrono::milliseconds timeout);
+
+    public:
+        inline const SinkOptions& GetOptions() const { return m_Options; }
+        uint64_t GetReceivedCount() const;
+        uint64_t GetDroppedCount() const;
+        bool IsClosed() const;
+
+    private:
+        friend class FrameBroadcaster;
+
+        void Push(const FrameRef& frame);
+        void Close();
+
+        FrameRef PopLocked();
+
+    private:
+        SinkOptions m_Options;
+
+        mutable std::mutex m_Mutex;
+        std::condition_variable m_Condition;
+
+        // Ring buffer sized to the queue depth up front
+        std::vector<FrameRef> m_Queue;
+        uint32_t m_Head = 0;
+        uint32_t m_Count = 0;
+
+        uint64_t m_ReceivedCount = 0;
+        uint64_t m_DroppedCount = 0;
+        bool m_IsClosed = false;
+    };
+
+    // Single producer, multiple consumer fan-out of captured frames. The producer fills a
+    // pooled buffer and publishes it once, and every sink gets a reference to the same
+    // buffer, so adding a sink costs no copies. Publishing never waits on a sink: a full
+    // queue drops a frame according to the sink's policy instead.
+    class FrameBroadcaster
+    {
+    public:
+        FrameBroadcaster() = default;
+        ~FrameBroadcaster();
+
+        std::shared_ptr<FrameSink> Subscribe(const SinkOptions& options = {});
+        void Unsubscribe(const std::shared_ptr<FrameSink>& sink);
+
+        inline WritableFrame AcquireFrame(uint32_t width, uint32_t height) { return m_Pool.Acquire(width, height); }
+
+        // Stamps the frame with the next frame ID and hands it to every sink. The returned
+        // reference lets the producer keep reading the frame, for example as the previous
+        // frame of a diff.
+        FrameRef Publish(WritableFrame&& frame);
+
+    public:
+        inline FramePool& GetPool() { return m_Pool; }
+        inline uint64_t GetPublishedCount() const { return m_NextFrameId; }
+        size_t GetSinkCount() const;
+
+    private:
+        FramePool m_Pool;
+
+        mutable std::mutex m_SinksMutex;
+        std::vector<std::shared_ptr<FrameSink>> m_Sinks;
+
+        uint64_t m_NextFrameId = 0;
+    };
+}
@@ -0,0 +1,266 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "framepipeline.h"
+#include <cstdio>
+
+namespace
+{
+    std::chrono::microseconds GetElapsed(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    }
+}
+
+Takoyaki::FramePipeline::FramePipeline(Executor& executor)
+    : m_Executor(executor)
+{
+}
+
+Takoyaki::FramePipeline::~FramePipeline()
+{
+    if (!m_Tasks.empty())
+    {
+        Stop();
+        Wait();
+    }
+}
+
+void Takoyaki::FramePipeline::AddSource(const char* name, StageFn source)
+{
+    AddStage(name, std::move(source), 0);
+}
+
+void Takoyaki::FramePipeline::AddStage(const char* name, StageFn stage, size_t capacity)
+{
+    auto newStage = std::make_unique<Stage>();
+    newStage->m_Name = name;
+    newStage->m_Function = std::move(stage);
+    newStage->m_Capacity = capacity;
+
+    m_Stages.push_back(std::move(newStage));
+}
+
+void Takoyaki::FramePipeline::Start()
+{
+    if (m_Stages.empty() || !m_Tasks.empty())
+        return;
+
+    // Channel i feeds stage i + 1
+    for (size_t i = 1; i < m_Stages.size(); ++i)
+        m_Channels.push_back(std::make_unique<FrameChannel>(m_Executor, m_Stages[i]->m_Capacity));
+
+    m_StartTime = std::chrono::steady_clock::now();
+    m_Tasks.push_back(RunSource(*m_Stages[0], m_Channels.empty() ? nullptr : m_Channels[0].get()));
+
+    for (size_t i = 1; i < m_Stages.size(); ++i)
+        m_Tasks.push_back(RunStage(*m_Stages[i], *m_Channels[i - 1], i < m_Channels.size() ? m_Channels[i].get() : nullptr));
+
+    for (Task& task : m_Tasks)
+        task.Start(m_Executor);
+}
+
+void Takoyaki::FramePipeline::Stop()
+{
+    m_IsStopping = true;
+}
+
+void Takoyaki::FramePipeline::Wait()
+{
+    if (m_Executor.GetThreadCount() == 0)
+    {
+        while (!IsDone())
+            m_Executor.Poll();
+
+        return;
+    }
+
+    for (const Task& task : m_Tasks)
+        task.Wait();
+}
+
+bool Takoyaki::FramePipeline::IsDone() const
+{
+    for (const Task& task : m_Tasks)
+    {
+        if (!task.IsDone())
+            return false;
+    }
+
+    return true;
+}
+
+std::vector<Takoyaki::PipelineStageStats> Takoyaki::FramePipeline::GetStats() const
+{
+    std::vector<PipelineStageStats> stats;
+    stats.reserve(m_Stages.size());
+
+    for (const std::unique_ptr<Stage>& stage : m_Stages)
+    {
+        std::lock_guard<std::mutex> lock(stage->m_StatsMutex);
+        stats.push_back(stage->m_Stats);
+    }
+
+    return stats;
+}
+
+std::string Takoyaki::FramePipeline::GetReport() const
+{
+    std::vector<PipelineStageStats> stats = GetStats();
+    if (stats.empty())
+        return "Pipeline has no stages\n";
+
+    std::chrono::microseconds elapsed = IsDone() && !m_Tasks.empty()
+        ? std::chrono::duration_cast<std::chrono::microseconds>(m_EndTime - m_StartTime)
+        : GetElapsed(m_StartTime);
+
+    // Frames that made it through every stage
+    uint64_t frames = stats.back().m_Frames - stats.back().m_Dropped;
+    double seconds = elapsed.count() / 1000000.0;
+
+    char line[192];
+    std::string report;
+
+    snprintf(line, sizeof(line), "Pipeline: %llu frames in %.2f s, %.1f fps\n",
+        static_cast<unsigned long long>(frames), seconds, seconds > 0 ? frames / seconds : 0.0);
+    report += line;
+
+    for (size_t i = 0; i < stats.size(); ++i)
+    {
+        const PipelineStageStats& stage = stats[i];
+        double perFrame = stage.m_Frames > 0 ? 1.0 / (1000.0 * stage.m_Frames) : 0.0;
+
+        snprintf(line, sizeof(line), "  %-12s %8llu frames, %6llu dropped, %7.2f ms busy, %7.2f ms waiting for input, %7.2f ms for output per frame\n",
+            m_Stages[i]->m_Name,
+            static_cast<unsigned long long>(stage.m_Frames),
+            static_cast<unsigned long long>(stage.m_Dropped),
+            stage.m_BusyTime.count() * perFrame,
+            stage.m_InputWait.count() * perFrame,
+            stage.m_OutputWait.count() * perFrame);
+        report += line;
+    }
+
+    return report;
+}
+
+Takoyaki::Task Takoyaki::FramePipeline::RunSource(Stage& stage, FrameChannel* output)
+{
+    uint64_t sequence = 0;
+
+    while (!m_IsStopping)
+    {
+        PipelineFrame frame;
+        frame.m_Sequence = sequence;
+        frame.m_StartTime = std::chrono::steady_clock::now();
+
+        StageResult result = Process(stage, frame);
+        if (result == StageResult::Stop)
+            break;
+
+        if (result == StageResult::Continue)
+        {
+            ++sequence;
+
+            if (output)
+            {
+                auto waitStart = std::chrono::steady_clock::now();
+                bool isSent = co_await output->Send(std::move(frame));
+
+                std::lock_guard<std::mutex> lock(stage.m_StatsMutex);
+                stage.m_Stats.m_OutputWait += GetElapsed(waitStart);
+
+                if (!isSent)
+                    break;
+            }
+        }
+
+        // Everything the frame woke up goes first, and a source with nothing to produce
+        // does not hold on to a worker
+        co_await m_Executor.Schedule();
+    }
+
+    if (output)
+        output->Close();
+    else
+        m_EndTime = std::chrono::steady_clock::now();
+}
+
+Takoyaki::Task Takoyaki::FramePipeline::RunStage(Stage& stage, FrameChannel& input, FrameChannel* output)
+{
+    while (true)
+    {
+        auto waitStart = std::chrono::steady_clock::now();
+        std::optional<PipelineFrame> frame = co_await input.Receive();
+
+        {
+            std::lock_guard<std::mutex> lock(stage.m_StatsMutex);
+            stage.m_Stats.m_InputWait += GetElapsed(waitStart);
+        }
+
+        if (!frame)
+            break;
+
+        StageResult result = Process(stage, *frame);
+        if (result == StageResult::Stop)
+            break;
+
+        if (result == StageResult::Drop || !output)
+            continue;
+
+        waitStart = std::chrono::steady_clock::now();
+        bool isSent = co_await output->Send(std::move(*frame));
+
+        {
+            std::lock_guard<std::mutex> lock(stage.m_StatsMutex);
+            stage.m_Stats.m_OutputWait += GetElapsed(waitStart);
+        }
+
+        if (!isSent)
+            break;
+    }
+
+    // Closing the input fails the previous stage's next send, so stopping anywhere stops
+    // everything upstream, and closing the output lets everything downstream drain
+    input.Close();
+
+    if (output)
+        output->Close();
+    else
+        m_EndTime = std::chrono::steady_clock::now();
+}
+
+Takoyaki::StageResult Takoyaki::FramePipeline::Process(Stage& stage, PipelineFrame& frame)
+{
+    auto start = std::chrono::steady_clock::now();
+    StageResult result = stage.m_Function(frame);
+    std::chrono::microseconds busy = GetElapsed(start);
+
+    // A source producing nothing is idle rather than busy with a frame
+    if (&stage == m_Stages[0].get() && result != StageResult::Continue)
+        return result;
+
+    std::lock_guard<std::mutex> lock(stage.m_StatsMutex);
+    stage.m_Stats.m_BusyTime += busy;
+    ++stage.m_Stats.m_Frames;
+    if (result != StageResult::Continue)
+        ++stage.m_Stats.m_Dropped;
+
+    return result;
+}
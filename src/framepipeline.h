@@ -0,0 +1,136 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "channel.h"
+#include "executor.h"
+#include "framepool.h"
+
+namespace Takoyaki
+{
+    // What travels down the pipeline. Stages that work on the GPU only pass the sequence and
+    // region along, the pixels stay in whatever texture they share.
+    struct PipelineFrame
+    {
+        uint64_t m_Sequence = 0;
+        std::chrono::steady_clock::time_point m_StartTime;
+        Rect m_Region;
+
+        // Filled in by the stage that produces pixels, until a later stage seals it
+        WritableFrame m_Writable;
+        FrameRef m_Frame;
+    };
+
+    enum class StageResult
+    {
+        Continue,   // Pass the frame on to the next stage
+        Drop,       // Drop the frame, or for a source, produce nothing this time
+        Stop,       // Drop the frame and stop the whole pipeline
+    };
+
+    struct PipelineStageStats
+    {
+        uint64_t m_Frames = 0;
+        uint64_t m_Dropped = 0;
+
+        // Time spent in the stage function, waiting for a frame from the previous stage and
+        // waiting for room in the next one
+        std::chrono::microseconds m_BusyTime{ 0 };
+        std::chrono::microseconds m_InputWait{ 0 };
+        std::chrono::microseconds m_OutputWait{ 0 };
+    };
+
+    // Chain of stages, each running as its own coroutine on the executor, with a bounded
+    // channel between every pair. A stage only waits for its neighbours, so with enough worker
+    // threads one frame is captured while the one before it renders and the one before that
+    // presents. Stopping closes the source, and the frames already in flight drain through.
+    class FramePipeline
+    {
+    public:
+        // Called for each frame, always from one coroutine at a time
+        using StageFn = std::function<StageResult(PipelineFrame&)>;
+
+        static constexpr size_t DefaultChannelCapacity = 2;
+
+        explicit FramePipeline(Executor& executor);
+        ~FramePipeline();
+
+        FramePipeline(const FramePipeline&) = delete;
+        FramePipeline& operator=(const FramePipeline&) = delete;
+
+        // The first stage gets empty frames with only the sequence and start time set. A
+        // source that returns Drop is run again after everything else that is ready, and
+        // has to pace itself, such as by sleeping until the next frame is due.
+        void AddSource(const char* name, StageFn source);
+
+        // capacity is the number of frames that can wait between the previous stage and this one
+        void AddStage(const char* name, StageFn stage, size_t capacity = DefaultChannelCapacity);
+
+        void Start();
+        void Stop();
+
+        // Blocks until every stage has finished, polling the executor if it has no workers
+        void Wait();
+
+    public:
+        bool IsDone() const;
+        std::vector<PipelineStageStats> GetStats() const;
+        std::string GetReport() const;
+
+    private:
+        struct Stage
+        {
+            const char* m_Name = nullptr;
+            StageFn m_Function;
+            size_t m_Capacity = DefaultChannelCapacity;
+
+            PipelineStageStats m_Stats;
+            mutable std::mutex m_StatsMutex;
+        };
+
+        using FrameChannel = Channel<PipelineFrame>;
+
+        Task RunSource(Stage& stage, FrameChannel* output);
+        Task RunStage(Stage& stage, FrameChannel& input, FrameChannel* output);
+
+        StageResult Process(Stage& stage, PipelineFrame& frame);
+
+    private:
+        Executor& m_Executor;
+
+        std::vector<std::unique_ptr<Stage>> m_Stages;
+        std::vector<std::unique_ptr<FrameChannel>> m_Channels;
+        std::vector<Task> m_Tasks;
+
+        std::atomic<bool> m_IsStopping = false;
+
+        // Set by the last stage as it finishes
+        std::chrono::steady_clock::time_point m_StartTime;
+        std::chrono::steady_clock::time_point m_EndTime;
+    };
+}
@@ -0,0 +1,280 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "framepool.h"
+
+#include <utility>
+
+struct Takoyaki::FrameBuffer::PoolState
+{
+    std::mutex m_Mutex;
+
+    // Buffers waiting to be reused, owned by the pool until they are handed out again
+    std::vector<FrameBuffer*> m_Free;
+
+    // Buffers in use or free, used for statistics only
+    uint32_t m_BufferCount = 0;
+
+    // Set once the FramePool is destroyed, after which released buffers free themselves
+    bool m_IsClosed = false;
+};
+
+Takoyaki::FrameBuffer::FrameBuffer(std::shared_ptr<PoolState> pool)
+    : m_Pool(std::move(pool))
+{
+}
+
+Takoyaki::FrameBuffer::~FrameBuffer()
+{
+    GetFrameAllocator().Free(m_Storage);
+}
+
+void Takoyaki::FrameBuffer::AddRef()
+{
+    m_RefCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Takoyaki::FrameBuffer::Release()
+{
+    if (m_RefCount.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    // Keep the pool state alive past our own deletion
+    std::shared_ptr<PoolState> pool = m_Pool;
+    std::lock_guard<std::mutex> lock(pool->m_Mutex);
+
+    if (pool->m_IsClosed)
+    {
+        --pool->m_BufferCount;
+        delete this;
+        return;
+    }
+
+    pool->m_Free.push_back(this);
+}
+
+Takoyaki::FrameRef::FrameRef(const FrameRef& other)
+    : m_Buffer(other.m_Buffer)
+{
+    if (m_Buffer)
+        m_Buffer->AddRef();
+}
+
+Takoyaki::FrameRef::FrameRef(FrameRef&& other) noexcept
+    : m_Buffer(std::exchange(other.m_Buffer, nullptr))
+{
+}
+
+Takoyaki::FrameRef::FrameRef(WritableFrame&& frame)
+    : m_Buffer(frame.Detach())
+{
+}
+
+Takoyaki::FrameRef::~FrameRef()
+{
+    Reset();
+}
+
+Takoyaki::FrameRef& Takoyaki::FrameRef::operator=(const FrameRef& other)
+{
+    // Take the new reference first so assigning a frame to itself keeps it alive
+    FrameBuffer* buffer = other.m_Buffer;
+    if (buffer)
+        buffer->AddRef();
+
+    Reset();
+    m_Buffer = buffer;
+    return *this;
+}
+
+Takoyaki::FrameRef& Takoyaki::FrameRef::operator=(FrameRef&& other) noexcept
+{
+    if (this != &other)
+    {
+        Reset();
+        m_Buffer = std::exchange(other.m_Buffer, nullptr);
+    }
+
+    return *this;
+}
+
+void Takoyaki::FrameRef::Reset()
+{
+    if (m_Buffer)
+        std::exchange(m_Buffer, nullptr)->Release();
+}
+
+Takoyaki::WritableFrame::WritableFrame(WritableFrame&& other) noexcept
+    : m_Buffer(std::exchange(other.m_Buffer, nullptr))
+{
+}
+
+Takoyaki::WritableFrame::~WritableFrame()
+{
+    Reset();
+}
+
+Takoyaki::WritableFrame& Takoyaki::WritableFrame::operator=(WritableFrame&& other) noexcept
+{
+    if (this != &other)
+    {
+        Reset();
+        m_Buffer = std::exchange(other.m_Buffer, nullptr);
+    }
+
+    return *this;
+}
+
+void Takoyaki::WritableFrame::Reset()
+{
+    if (m_Buffer)
+        std::exchange(m_Buffer, nullptr)->Release();
+}
+
+Takoyaki::FrameView Takoyaki::WritableFrame::GetView() const
+{
+    if (!m_Buffer)
+        return {};
+
+    return { m_Buffer->m_Storage.m_Data, m_Buffer->m_Width, m_Buffer->m_Height, m_Buffer->m_Stride };
+}
+
+void Takoyaki::WritableFrame::SetCaptureTime(std::chrono::steady_clock::time_point time)
+{
+    if (m_Buffer)
+        m_Buffer->m_CaptureTime = time;
+}
+
+void Takoyaki::WritableFrame::SetDamage(const std::vector<Rect>& damage)
+{
+    if (!m_Buffer)
+        return;
+
+    m_Buffer->m_Damage = damage;
+    m_Buffer->m_HasDamage = true;
+}
+
+void Takoyaki::WritableFrame::SetTileMap(const TileMap& tileMap)
+{
+    if (!m_Buffer)
+        return;
+
+    m_Buffer->m_TileMap = tileMap;
+    m_Buffer->m_HasTileMap = true;
+}
+
+Takoyaki::FrameBuffer* Takoyaki::WritableFrame::Detach()
+{
+    return std::exchange(m_Buffer, nullptr);
+}
+
+Takoyaki::FramePool::FramePool(MemoryCategory category)
+    : m_State(std::make_shared<FrameBuffer::PoolState>())
+    , m_Category(category)
+{
+    // Idle buffers are the cheapest thing to give up when memory runs short
+    m_ReclaimerId = GetMemoryBudget().AddReclaimer("frame pool", [this](size_t) { Trim(); });
+}
+
+Takoyaki::FramePool::~FramePool()
+{
+    GetMemoryBudget().RemoveReclaimer(m_ReclaimerId);
+
+    {
+        std::lock_guard<std::mutex> lock(m_State->m_Mutex);
+        m_State->m_IsClosed = true;
+    }
+
+    Trim();
+}
+
+Takoyaki::WritableFrame Takoyaki::FramePool::Acquire(uint32_t width, uint32_t height)
+{
+    const uint32_t stride = GetPaddedStride(width);
+    const size_t size = static_cast<size_t>(stride) * height;
+
+    FrameBuffer* buffer = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_State->m_Mutex);
+
+        if (!m_State->m_Free.empty())
+        {
+            // Prefer the most recently released buffer, it is most likely still in cache
+            buffer = m_State->m_Free.back();
+            m_State->m_Free.pop_back();
+        }
+        else
+        {
+            ++m_State->m_BufferCount;
+        }
+    }
+
+    if (!buffer)
+        buffer = new FrameBuffer(m_State);
+
+    // Only grows, so a pool that has seen the current size does not allocate again
+    if (buffer->m_Storage.m_Size < size)
+    {
+        GetFrameAllocator().Free(buffer->m_Storage);
+        buffer->m_Storage = GetFrameAllocator().Allocate(size, m_Category);
+
+        if (!buffer->m_Storage.m_Data)
+        {
+            buffer->m_RefCount.store(1, std::memory_order_relaxed);
+            buffer->Release();
+            return {};
+        }
+    }
+
+    buffer->m_Width = width;
+    buffer->m_Height = height;
+    buffer->m_Stride = stride;
+    buffer->m_FrameId = 0;
+    buffer->m_CaptureTime = std::chrono::steady_clock::now();
+    buffer->m_Damage.clear();
+    buffer->m_HasDamage = false;
+    buffer->m_HasTileMap = false;
+    buffer->m_RefCount.store(1, std::memory_order_relaxed);
+
+    return WritableFrame(buffer);
+}
+
+void Takoyaki::FramePool::Trim()
+{
+    std::lock_guard<std::mutex> lock(m_State->m_Mutex);
+
+    for (FrameBuffer* buffer : m_State->m_Free)
+        delete buffer;
+
+    m_State->m_BufferCount -= static_cast<uint32_t>(m_State->m_Free.size());
+    m_State->m_Free.clear();
+}
+
+uint32_t Takoyaki::FramePool::GetBufferCount() const
+{
+    std::lock_guard<std::mutex> lock(m_State->m_Mutex);
+    return m_State->m_BufferCount;
+}
+
+uint32_t Takoyaki::FramePool::GetFreeCount() const
+{
+    std::lock_guard<std::mutex> lock(m_State->m_Mutex);
+    return static_cast<uint32_t>(m_State->m_Free.size());
+}
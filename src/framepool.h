@@ -0,0 +1,189 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "frame.h"
+#include "framealloc.h"
+#include "tileclassifier.h"
+
+namespace Takoyaki
+{
+    class FramePool;
+    class WritableFrame;
+
+    // BGRA pixel buffer handed out by a FramePool. A buffer is written once by its producer
+    // through a WritableFrame, then shared read-only through FrameRefs, and goes back to
+    // its pool when the last reference is released.
+    class FrameBuffer
+    {
+    public:
+        inline uint32_t GetWidth() const { return m_Width; }
+        inline uint32_t GetHeight() const { return m_Height; }
+        inline uint32_t GetStride() const { return m_Stride; }
+        inline const uint8_t* GetData() const { return m_Storage.m_Data; }
+        inline const uint32_t* GetRow(uint32_t y) const { return reinterpret_cast<const uint32_t*>(m_Storage.m_Data + static_cast<size_t>(y) * m_Stride); }
+
+        inline uint64_t GetFrameId() const { return m_FrameId; }
+        inline std::chrono::steady_clock::time_point GetCaptureTime() const { return m_CaptureTime; }
+
+        // Rects that changed since the frame the producer published before this one, when it
+        // knows. Without them, anything in the frame may have changed.
+        inline bool HasDamage() const { return m_HasDamage; }
+        inline const std::vector<Rect>& GetDamage() const { return m_Damage; }
+
+        // Class of every tile, when a stage classified the frame before publishing it
+        inline bool HasTileMap() const { return m_HasTileMap; }
+        inline const TileMap& GetTileMap() const { return m_TileMap; }
+
+    private:
+        friend class FramePool;
+        friend class FrameRef;
+        friend class WritableFrame;
+        friend class FrameBroadcaster;
+
+        struct PoolState;
+
+        explicit FrameBuffer(std::shared_ptr<PoolState> pool);
+        ~FrameBuffer();
+
+        void AddRef();
+        void Release();
+
+    private:
+        std::shared_ptr<PoolState> m_Pool;
+        std::atomic<uint32_t> m_RefCount = 0;
+
+        // From the frame allocator, so rows are cache line aligned and padded
+        FrameAllocation m_Storage;
+        uint32_t m_Width = 0;
+        uint32_t m_Height = 0;
+        uint32_t m_Stride = 0;
+
+        uint64_t m_FrameId = 0;
+        std::chrono::steady_clock::time_point m_CaptureTime;
+
+        std::vector<Rect> m_Damage;
+        bool m_HasDamage = false;
+
+        TileMap m_TileMap;
+        bool m_HasTileMap = false;
+    };
+
+    // Shared, read-only reference to a published frame. Copying only bumps a reference count.
+    class FrameRef
+    {
+    public:
+        FrameRef() = default;
+        FrameRef(const FrameRef& other);
+        FrameRef(FrameRef&& other) noexcept;
+        ~FrameRef();
+
+        // Seals a frame that was filled in without going through a broadcaster
+        explicit FrameRef(WritableFrame&& frame);
+
+        FrameRef& operator=(const FrameRef& other);
+        FrameRef& operator=(FrameRef&& other) noexcept;
+
+        void Reset();
+
+        inline const FrameBuffer* Get() const { return m_Buffer; }
+        inline const FrameBuffer* operator->() const { return m_Buffer; }
+        inline explicit operator bool() const { return m_Buffer != nullptr; }
+
+    private:
+        friend class FrameBroadcaster;
+
+        // Takes over a reference that is already held
+        explicit FrameRef(FrameBuffer* buffer) : m_Buffer(buffer) {}
+
+    private:
+        FrameBuffer* m_Buffer = nullptr;
+    };
+
+    // Exclusive, writable handle to a buffer that has not been published yet.
+    class WritableFrame
+    {
+    public:
+        WritableFrame() = default;
+        WritableFrame(const WritableFrame&) = delete;
+        WritableFrame(WritableFrame&& other) noexcept;
+        ~WritableFrame();
+
+        WritableFrame& operator=(const WritableFrame&) = delete;
+        WritableFrame& operator=(WritableFrame&& other) noexcept;
+
+        void Reset();
+
+        FrameView GetView() const;
+        void SetCaptureTime(std::chrono::steady_clock::time_point time);
+        void SetDamage(const std::vector<Rect>& damage);
+        void SetTileMap(const TileMap& tileMap);
+
+        inline const FrameBuffer* Get() const { return m_Buffer; }
+        inline explicit operator bool() const { return m_Buffer != nullptr; }
+
+    private:
+        friend class FramePool;
+        friend class FrameRef;
+        friend class FrameBroadcaster;
+
+        explicit WritableFrame(FrameBuffer* buffer) : m_Buffer(buffer) {}
+
+        FrameBuffer* Detach();
+
+    private:
+        FrameBuffer* m_Buffer = nullptr;
+    };
+
+    // Recycles frame buffers so steady-state capture does not allocate. The pool grows
+    // whenever every buffer is in use rather than waiting for one, so a reader holding on
+    // to frames can never stall the producer. Buffers may outlive the pool, in which case
+    // they are freed on their last release instead of being recycled. Free buffers are
+    // released when the memory budget needs room.
+    class FramePool
+    {
+    public:
+        explicit FramePool(MemoryCategory category = MemoryCategory::Capture);
+        ~FramePool();
+
+        FramePool(const FramePool&) = delete;
+        FramePool& operator=(const FramePool&) = delete;
+
+        WritableFrame Acquire(uint32_t width, uint32_t height);
+
+        // Frees every buffer that is not currently in use
+        void Trim();
+
+    public:
+        uint32_t GetBufferCount() const;
+        uint32_t GetFreeCount() const;
+
+    private:
+        std::shared_ptr<FrameBuffer::PoolState> m_State;
+        MemoryCategory m_Category;
+        uint32_t m_ReclaimerId = 0;
+    };
+}
@@ -0,0 +1,186 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "framesync.h"
+
+#include <algorithm>
+#include <cstdio>
+
+bool Takoyaki::FrameSync::BeginFrame()
+{
+    if (m_IsAcquired || !m_Primitive)
+        return false;
+
+    RunPendingRecovery();
+
+    m_Stats.m_Waits++;
+
+    auto start = std::chrono::steady_clock::now();
+    SyncResult result = m_Primitive->Acquire(m_Options.m_FrameDeadline);
+    auto wait = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+    m_Stats.m_TotalWait += wait;
+    m_Stats.m_MaxWait = std::max(m_Stats.m_MaxWait, wait);
+
+    switch (result)
+    {
+    case SyncResult::Acquired:
+        m_Stats.m_Acquired++;
+        m_IsAcquired = true;
+        return true;
+    case SyncResult::Timeout:
+        DropFrame(FrameDropReason::Timeout);
+        return false;
+    default:
+        DropFrame(FrameDropReason::SyncFailed);
+        return false;
+    }
+}
+
+void Takoyaki::FrameSync::EndFrame()
+{
+    if (!m_IsAcquired)
+        return;
+
+    m_IsAcquired = false;
+
+    if (!m_Primitive->Release())
+    {
+        DropFrame(FrameDropReason::ReleaseFailed);
+        return;
+    }
+
+    m_Stats.m_ConsecutiveDrops = 0;
+}
+
+void Takoyaki::FrameSync::AbortFrame()
+{
+    if (!m_IsAcquired)
+        return;
+
+    m_IsAcquired = false;
+
+    // The render failure is what gets reported, even if the release fails as well
+    m_Primitive->Release();
+    DropFrame(FrameDropReason::RenderFailed);
+}
+
+void Takoyaki::FrameSync::DropPresent()
+{
+    DropFrame(FrameDropReason::PresentFailed);
+}
+
+void Takoyaki::FrameSync::RequestRecovery()
+{
+    m_IsRecoveryPending = true;
+    m_FramesSinceRecovery = 0;
+}
+
+std::string Takoyaki::FrameSync::GetReport() const
+{
+    const FrameSyncStats& stats = m_Stats;
+    const double averageWaitMs = stats.m_Waits ? stats.m_TotalWait.count() / 1000.0 / stats.m_Waits : 0.0;
+
+    char report[512];
+    snprintf(report, sizeof(report),
+        "Frame sync: %llu waits, %llu acquired, average wait %.2f ms, longest %.2f ms\n"
+        "  %llu dropped: %llu timeouts, %llu sync failures, %llu render failures, %llu release failures, %llu present failures, last %s\n"
+        "  %llu recoveries, %llu failed\n",
+        static_cast<unsigned long long>(stats.m_Waits), static_cast<unsigned long long>(stats.m_Acquired), averageWaitMs, stats.m_MaxWait.count() / 1000.0,
+        static_cast<unsigned long long>(stats.GetDroppedCount()), static_cast<unsigned long long>(stats.m_Timeouts),
+        static_cast<unsigned long long>(stats.m_SyncFailures), static_cast<unsigned long long>(stats.m_RenderFailures),
+        static_cast<unsigned long long>(stats.m_ReleaseFailures), static_cast<unsigned long long>(stats.m_PresentFailures), GetDropReasonName(stats.m_LastDropReason),
+        static_cast<unsigned long long>(stats.m_Recoveries), static_cast<unsigned long long>(stats.m_FailedRecoveries));
+
+    return report;
+}
+
+const char* Takoyaki::FrameSync::GetDropReasonName(FrameDropReason reason)
+{
+    switch (reason)
+    {
+    case FrameDropReason::None: return "none";
+    case FrameDropReason::Timeout: return "timeout";
+    case FrameDropReason::SyncFailed: return "sync failed";
+    case FrameDropReason::RenderFailed: return "render failed";
+    case FrameDropReason::ReleaseFailed: return "release failed";
+    case FrameDropReason::PresentFailed: return "present failed";
+    }
+
+    return "unknown";
+}
+
+void Takoyaki::FrameSync::DropFrame(FrameDropReason reason)
+{
+    switch (reason)
+    {
+    case FrameDropReason::Timeout: m_Stats.m_Timeouts++; break;
+    case FrameDropReason::SyncFailed: m_Stats.m_SyncFailures++; break;
+    case FrameDropReason::RenderFailed: m_Stats.m_RenderFailures++; break;
+    case FrameDropReason::ReleaseFailed: m_Stats.m_ReleaseFailures++; break;
+    case FrameDropReason::PresentFailed: m_Stats.m_PresentFailures++; break;
+    default: break;
+    }
+
+    m_Stats.m_LastDropReason = reason;
+    m_Stats.m_ConsecutiveDrops++;
+
+    RunWatchdog();
+}
+
+void Takoyaki::FrameSync::RunWatchdog()
+{
+    // A single late frame is normal when the producer is busy, only act on a stall
+    if (m_Options.m_StallThreshold == 0 || m_Stats.m_ConsecutiveDrops % m_Options.m_StallThreshold != 0)
+        return;
+
+    if (RunRecovery())
+        m_IsRecoveryPending = false;
+}
+
+bool Takoyaki::FrameSync::RunRecovery()
+{
+    if (!m_Recovery)
+        return false;
+
+    if (!m_Recovery())
+    {
+        m_Stats.m_FailedRecoveries++;
+        return false;
+    }
+
+    m_Stats.m_Recoveries++;
+    return true;
+}
+
+void Takoyaki::FrameSync::RunPendingRecovery()
+{
+    if (!m_IsRecoveryPending)
+        return;
+
+    // Right away on the first frame after the request, then at the watchdog's pace, so
+    // resources that cannot be created are not tried again on every frame
+    const uint32_t interval = std::max<uint32_t>(m_Options.m_StallThreshold, 1);
+    if (m_FramesSinceRecovery++ % interval != 0)
+        return;
+
+    if (RunRecovery())
+        m_IsRecoveryPending = false;
+}
@@ -0,0 +1,145 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace Takoyaki
+{
+    enum class SyncResult
+    {
+        Acquired,
+        Timeout,
+        Failed,
+    };
+
+    // Lock shared with the frame producer, such as the keyed mutex on the shared texture
+    class SyncPrimitive
+    {
+    public:
+        virtual ~SyncPrimitive() = default;
+
+        virtual SyncResult Acquire(std::chrono::milliseconds timeout) = 0;
+        virtual bool Release() = 0;
+    };
+
+    enum class FrameDropReason
+    {
+        None,
+        Timeout,        // The producer held on to the frame past the deadline
+        SyncFailed,     // Acquiring the lock returned an error
+        RenderFailed,   // The frame was acquired but could not be drawn
+        ReleaseFailed,  // The frame was drawn but the lock could not be handed back
+        PresentFailed,  // The frame was drawn and handed back but could not be presented
+    };
+
+    struct FrameSyncOptions
+    {
+        // Longest a frame may wait for the producer before it is dropped
+        std::chrono::milliseconds m_FrameDeadline{ 100 };
+
+        // Dropped frames in a row after which the watchdog calls for recovery, and again
+        // every time this many more frames drop while recovery has not helped
+        uint32_t m_StallThreshold = 10;
+    };
+
+    struct FrameSyncStats
+    {
+        uint64_t m_Waits = 0;
+        uint64_t m_Acquired = 0;
+        uint64_t m_Timeouts = 0;
+        uint64_t m_SyncFailures = 0;
+        uint64_t m_RenderFailures = 0;
+        uint64_t m_ReleaseFailures = 0;
+        uint64_t m_PresentFailures = 0;
+        uint64_t m_Recoveries = 0;
+        uint64_t m_FailedRecoveries = 0;
+
+        uint32_t m_ConsecutiveDrops = 0;
+        FrameDropReason m_LastDropReason = FrameDropReason::None;
+
+        std::chrono::microseconds m_TotalWait{ 0 };
+        std::chrono::microseconds m_MaxWait{ 0 };
+
+        inline uint64_t GetDroppedCount() const { return m_Timeouts + m_SyncFailures + m_RenderFailures + m_ReleaseFailures + m_PresentFailures; }
+    };
+
+    // Brackets the consumer side of every frame handed over through a SyncPrimitive. Each
+    // frame waits at most until its deadline and is dropped otherwise, so a stalled producer
+    // costs frames instead of hanging the caller. When frames keep dropping, a watchdog runs
+    // the recovery callback, which is expected to recreate the shared resources. The owner can
+    // also ask for recovery itself, such as when resources could not be resized.
+    class FrameSync
+    {
+    public:
+        using RecoveryFn = std::function<bool()>;
+
+        FrameSync() = default;
+        ~FrameSync() = default;
+
+        // Returns true if the frame was acquired, in which case EndFrame or AbortFrame must follow
+        bool BeginFrame();
+        void EndFrame();
+
+        // Drops an acquired frame that could not be drawn, still releasing the lock
+        void AbortFrame();
+
+        // Drops a frame that went through EndFrame but failed to present
+        void DropPresent();
+
+        // Runs recovery before the next frame is acquired. Until it succeeds it is tried
+        // again every m_StallThreshold frames, which keep going with the old resources.
+        void RequestRecovery();
+
+    public:
+        inline void SetPrimitive(SyncPrimitive* primitive) { m_Primitive = primitive; }
+        inline void SetRecovery(RecoveryFn recovery) { m_Recovery = std::move(recovery); }
+        inline void SetOptions(const FrameSyncOptions& options) { m_Options = options; }
+
+        inline bool IsRecoveryPending() const { return m_IsRecoveryPending; }
+        inline const FrameSyncOptions& GetOptions() const { return m_Options; }
+        inline const FrameSyncStats& GetStats() const { return m_Stats; }
+        inline void ResetStats() { m_Stats = {}; }
+
+        std::string GetReport() const;
+
+        static const char* GetDropReasonName(FrameDropReason reason);
+
+    private:
+        void DropFrame(FrameDropReason reason);
+        void RunWatchdog();
+        bool RunRecovery();
+        void RunPendingRecovery();
+
+    private:
+        SyncPrimitive* m_Primitive = nullptr;
+        RecoveryFn m_Recovery;
+        FrameSyncOptions m_Options;
+        FrameSyncStats m_Stats;
+
+        bool m_IsAcquired = false;
+        bool m_IsRecoveryPending = false;
+        uint32_t m_FramesSinceRecovery = 0;
+    };
+}
@@ -0,0 +1,70 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Compiled with AVX2, FMA and F16C enabled. Only call through PixelKernels.
+
+#include "cropkernels.h"
+
+#include <bit>
+#include <immintrin.h>
+
+namespace
+{
+    // One bit per pixel, set where all of B, G and R are within tolerance
+    inline uint32_t GetMatchMask(const uint32_t* row, const uint32_t* reference, __m256i tolerance)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(reference));
+
+        __m256i difference = _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a));
+        __m256i excess = _mm256_and_si256(_mm256_subs_epu8(difference, tolerance), _mm256_set1_epi32(0x00FFFFFF));
+
+        return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(excess, _mm256_setzero_si256()))));
+    }
+}
+
+uint32_t Takoyaki::Kernels::MatchRowPrefixAvx2(const uint32_t* row, const uint32_t* reference, uint32_t width, uint32_t tolerance)
+{
+    const __m256i limit = _mm256_set1_epi8(static_cast<char>(tolerance > 255 ? 255 : tolerance));
+    uint32_t x = 0;
+
+    for (; x + 8 <= width; x += 8)
+    {
+        uint32_t mask = GetMatchMask(row + x, reference + x, limit);
+        if (mask != 0xFF)
+            return x + static_cast<uint32_t>(std::countr_one(mask));
+    }
+
+    return x + MatchRowPrefixScalar(row + x, reference + x, width - x, tolerance);
+}
+
+uint32_t Takoyaki::Kernels::MatchRowSuffixAvx2(const uint32_t* row, const uint32_t* reference, uint32_t width, uint32_t tolerance)
+{
+    const __m256i limit = _mm256_set1_epi8(static_cast<char>(tolerance > 255 ? 255 : tolerance));
+    uint32_t x = width;
+
+    for (; x >= 8; x -= 8)
+    {
+        uint32_t mask = GetMatchMask(row + x - 8, reference + x - 8, limit);
+        if (mask != 0xFF)
+            return width - x + static_cast<uint32_t>(std::countl_one(mask << 24));
+    }
+
+    return width - x + MatchRowSuffixScalar(row, reference, x, tolerance);
+}
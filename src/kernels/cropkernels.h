@@ -0,0 +1,36 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace Takoyaki::Kernels
+{
+    // Number of pixels at the start (Prefix) or end (Suffix) of row that are within tolerance
+    // of the pixel at the same position in reference, on each of the B, G and R channels.
+    // Alpha is ignored, since captures leave it undefined.
+    uint32_t MatchRowPrefixScalar(const uint32_t* row, const uint32_t* reference, uint32_t width, uint32_t tolerance);
+    uint32_t MatchRowPrefixSse2(const uint32_t* row, const uint32_t* reference, uint32_t width, uint32_t tolerance);
+    uint32_t MatchRowPrefixAvx2(const uint32_t* row, const uint32_t* reference, uint32_t width, uint32_t tolerance);
+
+    uint32_t MatchRowSuffixScalar(const uint32_t* row, const uint32_t* reference, uint32_t width, uint32_t tolerance);
+    uint32_t MatchRowSuffixSse2(const uint32_t* row, const uint32_t* reference, uint32_t width, uint32_t tolerance);
+    uint32_t MatchRowSuffixAvx2(const uint32_t* row, const uint32_t* reference, uint32_t width, uint32_t tolerance);
+}
@@ -0,0 +1,53 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cropkernels.h"
+
+namespace
+{
+    inline bool IsMatch(uint32_t a, uint32_t b, uint32_t tolerance)
+    {
+        for (uint32_t shift = 0; shift < 24; shift += 8)
+        {
+            int32_t difference = static_cast<int32_t>((a >> shift) & 0xFF) - static_cast<int32_t>((b >> shift) & 0xFF);
+            if (static_cast<uint32_t>(difference < 0 ? -difference : difference) > tolerance)
+                return false;
+        }
+
+        return true;
+    }
+}
+
+uint32_t Takoyaki::Kernels::MatchRowPrefixScalar(const uint32_t* row, const uint32_t* reference, uint32_t width, uint32_t tolerance)
+{
+    uint32_t x = 0;
+    while (x < width && IsMatch(row[x], reference[x], tolerance))
+        ++x;
+
+    return x;
+}
+
+uint32_t Takoyaki::Kernels::MatchRowSuffixScalar(const uint32_t* row, const uint32_t* reference, uint32_t width, uint32_t tolerance)
+{
+    uint32_t x = width;
+    while (x > 0 && IsMatch(row[x - 1], reference[x - 1], tolerance))
+        --x;
+
+    return width - x;
+}
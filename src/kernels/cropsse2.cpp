@@ -0,0 +1,70 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Compiled with SSE2 enabled. Only call through PixelKernels.
+
+#include "cropkernels.h"
+
+#include <bit>
+#include <emmintrin.h>
+
+namespace
+{
+    // One bit per pixel, set where all of B, G and R are within tolerance
+    inline uint32_t GetMatchMask(const uint32_t* row, const uint32_t* reference, __m128i tolerance)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(reference));
+
+        __m128i difference = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+        __m128i excess = _mm_and_si128(_mm_subs_epu8(difference, tolerance), _mm_set1_epi32(0x00FFFFFF));
+
+        return static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(excess, _mm_setzero_si128()))));
+    }
+}
+
+uint32_t Takoyaki::Kernels::MatchRowPrefixSse2(const uint32_t* row, const uint32_t* reference, uint32_t width, uint32_t tolerance)
+{
+    const __m128i limit = _mm_set1_epi8(static_cast<char>(tolerance > 255 ? 255 : tolerance));
+    uint32_t x = 0;
+
+    for (; x + 4 <= width; x += 4)
+    {
+        uint32_t mask = GetMatchMask(row + x, reference + x, limit);
+        if (mask != 0xF)
+            return x + static_cast<uint32_t>(std::countr_one(mask));
+    }
+
+    return x + MatchRowPrefixScalar(row + x, reference + x, width - x, tolerance);
+}
+
+uint32_t Takoyaki::Kernels::MatchRowSuffixSse2(const uint32_t* row, const uint32_t* reference, uint32_t width, uint32_t tolerance)
+{
+    const __m128i limit = _mm_set1_epi8(static_cast<char>(tolerance > 255 ? 255 : tolerance));
+    uint32_t x = width;
+
+    for (; x >= 4; x -= 4)
+    {
+        uint32_t mask = GetMatchMask(row + x - 4, reference + x - 4, limit);
+        if (mask != 0xF)
+            return width - x + static_cast<uint32_t>(std::countl_one(mask << 28));
+    }
+
+    return width - x + MatchRowSuffixScalar(row, reference, x, tolerance);
+}
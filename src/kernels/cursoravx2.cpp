@@ -0,0 +1,61 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Compiled with AVX2, FMA and F16C enabled. Only call through PixelKernels.
+
+#include "cursorkernels.h"
+
+#include <immintrin.h>
+
+namespace
+{
+    // Unpacking, shuffling and packing all stay within 128-bit lanes, so pixels come back
+    // out in the order they went in
+    inline __m256i GetInverseAlpha(__m256i pixels)
+    {
+        __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        return _mm256_sub_epi16(_mm256_set1_epi16(255), alpha);
+    }
+
+    inline __m256i ScaleDiv255(__m256i value, __m256i factor)
+    {
+        __m256i scaled = _mm256_add_epi16(_mm256_mullo_epi16(value, factor), _mm256_set1_epi16(128));
+        return _mm256_srli_epi16(_mm256_add_epi16(scaled, _mm256_srli_epi16(scaled, 8)), 8);
+    }
+}
+
+void Takoyaki::Kernels::BlendPremultipliedRowAvx2(const uint32_t* src, uint32_t* dst, uint32_t width)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    uint32_t x = 0;
+
+    for (; x + 8 <= width; x += 8)
+    {
+        __m256i source = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+        __m256i target = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + x));
+
+        __m256i low = ScaleDiv255(_mm256_unpacklo_epi8(target, zero), GetInverseAlpha(_mm256_unpacklo_epi8(source, zero)));
+        __m256i high = ScaleDiv255(_mm256_unpackhi_epi8(target, zero), GetInverseAlpha(_mm256_unpackhi_epi8(source, zero)));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_adds_epu8(source, _mm256_packus_epi16(low, high)));
+    }
+
+    BlendPremultipliedRowScalar(src + x, dst + x, width - x);
+}
@@ -0,0 +1,35 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+
+namespace Takoyaki::Kernels
+{
+    // Premultiplied BGRA over, for every channel including alpha:
+    //
+    //     dst = min(src + div255(dst * (255 - srcAlpha)), 255)
+    //
+    // where div255(x) = (x + 128 + ((x + 128) >> 8)) >> 8 rounds exactly for x <= 255 * 255
+    void BlendPremultipliedRowScalar(const uint32_t* src, uint32_t* dst, uint32_t width);
+    void BlendPremultipliedRowSse2(const uint32_t* src, uint32_t* dst, uint32_t width);
+    void BlendPremultipliedRowAvx2(const uint32_t* src, uint32_t* dst, uint32_t width);
+}
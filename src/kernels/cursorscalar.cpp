@@ -0,0 +1,43 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "cursorkernels.h"
+
+#include <algorithm>
+
+void Takoyaki::Kernels::BlendPremultipliedRowScalar(const uint32_t* src, uint32_t* dst, uint32_t width)
+{
+    for (uint32_t x = 0; x < width; ++x)
+    {
+        uint32_t source = src[x];
+        uint32_t inverseAlpha = 255 - (source >> 24);
+        uint32_t result = 0;
+
+        for (uint32_t shift = 0; shift < 32; shift += 8)
+        {
+            uint32_t scaled = ((dst[x] >> shift) & 0xFF) * inverseAlpha + 128;
+            scaled = (scaled + (scaled >> 8)) >> 8;
+
+            result |= std::min<uint32_t>(((source >> shift) & 0xFF) + scaled, 255) << shift;
+        }
+
+        dst[x] = result;
+    }
+}
@@ -0,0 +1,60 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Compiled with SSE2 enabled. Only call through PixelKernels.
+
+#include "cursorkernels.h"
+
+#include <emmintrin.h>
+
+namespace
+{
+    // 255 - alpha in every 16-bit channel of the two pixels in pixels
+    inline __m128i GetInverseAlpha(__m128i pixels)
+    {
+        __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        return _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+    }
+
+    inline __m128i ScaleDiv255(__m128i value, __m128i factor)
+    {
+        __m128i scaled = _mm_add_epi16(_mm_mullo_epi16(value, factor), _mm_set1_epi16(128));
+        return _mm_srli_epi16(_mm_add_epi16(scaled, _mm_srli_epi16(scaled, 8)), 8);
+    }
+}
+
+void Takoyaki::Kernels::BlendPremultipliedRowSse2(const uint32_t* src, uint32_t* dst, uint32_t width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    uint32_t x = 0;
+
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128i source = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        __m128i target = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + x));
+
+        __m128i low = ScaleDiv255(_mm_unpacklo_epi8(target, zero), GetInverseAlpha(_mm_unpacklo_epi8(source, zero)));
+        __m128i high = ScaleDiv255(_mm_unpackhi_epi8(target, zero), GetInverseAlpha(_mm_unpackhi_epi8(source, zero)));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_adds_epu8(source, _mm_packus_epi16(low, high)));
+    }
+
+    BlendPremultipliedRowScalar(src + x, dst + x, width - x);
+}
@@ -0,0 +1,121 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Compiled with AVX2, FMA and F16C enabled. Only call through PixelKernels.
+
+#include "edgekernels.h"
+
+#include <immintrin.h>
+
+namespace
+{
+    // Luma of eight pixels, one per 32-bit lane, exact in 16-bit arithmetic as for SSE2
+    inline __m256i GetLuma(__m256i pixels)
+    {
+        const __m256i mask = _mm256_set1_epi32(0xFF);
+
+        __m256i blue = _mm256_mullo_epi16(_mm256_and_si256(pixels, mask), _mm256_set1_epi32(29));
+        __m256i green = _mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi32(pixels, 8), mask), _mm256_set1_epi32(150));
+        __m256i red = _mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi32(pixels, 16), mask), _mm256_set1_epi32(77));
+
+        return _mm256_srli_epi32(_mm256_add_epi16(_mm256_add_epi16(blue, green), red), 8);
+    }
+
+    // Sixteen pixels widened to 16 bits, in order
+    inline __m256i Widen(const uint8_t* data)
+    {
+        return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)));
+    }
+
+    // Packs two vectors of sixteen 16-bit values into 32 bytes, in order
+    inline __m256i Narrow(__m256i low, __m256i high)
+    {
+        return _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), _MM_SHUFFLE(3, 1, 2, 0));
+    }
+}
+
+void Takoyaki::Kernels::LumaRowAvx2(const uint32_t* src, uint8_t* dst, uint32_t width)
+{
+    // Packing works within 128-bit lanes, which this permutation undoes
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    uint32_t x = 0;
+
+    for (; x + 32 <= width; x += 32)
+    {
+        __m256i luma0 = GetLuma(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x)));
+        __m256i luma1 = GetLuma(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x + 8)));
+        __m256i luma2 = GetLuma(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x + 16)));
+        __m256i luma3 = GetLuma(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x + 24)));
+
+        __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(luma0, luma1), _mm256_packs_epi32(luma2, luma3));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_permutevar8x32_epi32(packed, order));
+    }
+
+    LumaRowScalar(src + x, dst + x, width - x);
+}
+
+void Takoyaki::Kernels::SobelRowAvx2(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* gradientX, uint8_t* gradientY, uint32_t count)
+{
+    uint32_t x = 0;
+
+    // Loads reach one pixel either side, which the caller guarantees exist
+    for (; x + 32 <= count; x += 32)
+    {
+        __m256i results[4];
+
+        for (uint32_t half = 0; half < 2; ++half)
+        {
+            uint32_t i = x + half * 16;
+
+            __m256i gx = _mm256_add_epi16(_mm256_sub_epi16(Widen(above + i + 1), Widen(above + i - 1)), _mm256_sub_epi16(Widen(below + i + 1), Widen(below + i - 1)));
+            gx = _mm256_add_epi16(gx, _mm256_slli_epi16(_mm256_sub_epi16(Widen(row + i + 1), Widen(row + i - 1)), 1));
+
+            __m256i gy = _mm256_sub_epi16(_mm256_add_epi16(Widen(below + i - 1), Widen(below + i + 1)), _mm256_add_epi16(Widen(above + i - 1), Widen(above + i + 1)));
+            gy = _mm256_add_epi16(gy, _mm256_slli_epi16(_mm256_sub_epi16(Widen(below + i), Widen(above + i)), 1));
+
+            results[half * 2] = _mm256_srli_epi16(_mm256_abs_epi16(gx), 2);
+            results[half * 2 + 1] = _mm256_srli_epi16(_mm256_abs_epi16(gy), 2);
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(gradientX + x), Narrow(results[0], results[2]));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(gradientY + x), Narrow(results[1], results[3]));
+    }
+
+    SobelRowScalar(above + x, row + x, below + x, gradientX + x, gradientY + x, count - x);
+}
+
+void Takoyaki::Kernels::ThresholdRowAvx2(const uint8_t* src, uint64_t* bits, uint32_t width, uint8_t threshold)
+{
+    const __m256i limit = _mm256_set1_epi8(static_cast<char>(threshold));
+    uint32_t word = 0;
+
+    // Unsigned src >= threshold is max(src, threshold) == src
+    for (; word * 64 + 64 <= width; ++word)
+    {
+        __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + word * 64));
+        __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + word * 64 + 32));
+
+        uint32_t lowMask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(low, limit), low)));
+        uint32_t highMask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(high, limit), high)));
+
+        bits[word] = lowMask | (static_cast<uint64_t>(highMask) << 32);
+    }
+
+    ThresholdRowScalar(src + word * 64, bits + word, width - word * 64, threshold);
+}
@@ -0,0 +1,43 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace Takoyaki::Kernels
+{
+    // 8-bit luma of BGRA pixels, (29 B + 150 G + 77 R) >> 8
+    void LumaRowScalar(const uint32_t* src, uint8_t* dst, uint32_t width);
+    void LumaRowSse2(const uint32_t* src, uint8_t* dst, uint32_t width);
+    void LumaRowAvx2(const uint32_t* src, uint8_t* dst, uint32_t width);
+
+    // 3x3 Sobel on luma rows, writing |Gx| / 4 and |Gy| / 4 for count pixels. Reads one
+    // pixel either side of them, so row pointers are to the second pixel of a row and count
+    // is the width less two.
+    void SobelRowScalar(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* gradientX, uint8_t* gradientY, uint32_t count);
+    void SobelRowSse2(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* gradientX, uint8_t* gradientY, uint32_t count);
+    void SobelRowAvx2(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* gradientX, uint8_t* gradientY, uint32_t count);
+
+    // Sets bit x % 64 of bits[x / 64] where src[x] >= threshold, clearing the rest of the
+    // (width + 63) / 64 words
+    void ThresholdRowScalar(const uint8_t* src, uint64_t* bits, uint32_t width, uint8_t threshold);
+    void ThresholdRowSse2(const uint8_t* src, uint64_t* bits, uint32_t width, uint8_t threshold);
+    void ThresholdRowAvx2(const uint8_t* src, uint64_t* bits, uint32_t width, uint8_t threshold);
+}
@@ -0,0 +1,57 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "edgekernels.h"
+
+#include <cstdlib>
+
+void Takoyaki::Kernels::LumaRowScalar(const uint32_t* src, uint8_t* dst, uint32_t width)
+{
+    for (uint32_t x = 0; x < width; ++x)
+    {
+        uint32_t pixel = src[x];
+        dst[x] = static_cast<uint8_t>(((pixel & 0xFF) * 29 + ((pixel >> 8) & 0xFF) * 150 + ((pixel >> 16) & 0xFF) * 77) >> 8);
+    }
+}
+
+void Takoyaki::Kernels::SobelRowScalar(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* gradientX, uint8_t* gradientY, uint32_t count)
+{
+    for (int32_t x = 0; x < static_cast<int32_t>(count); ++x)
+    {
+        int32_t gx = (above[x + 1] - above[x - 1]) + 2 * (row[x + 1] - row[x - 1]) + (below[x + 1] - below[x - 1]);
+        int32_t gy = (below[x - 1] + 2 * below[x] + below[x + 1]) - (above[x - 1] + 2 * above[x] + above[x + 1]);
+
+        gradientX[x] = static_cast<uint8_t>(std::abs(gx) >> 2);
+        gradientY[x] = static_cast<uint8_t>(std::abs(gy) >> 2);
+    }
+}
+
+void Takoyaki::Kernels::ThresholdRowScalar(const uint8_t* src, uint64_t* bits, uint32_t width, uint8_t threshold)
+{
+    for (uint32_t word = 0; word * 64 < width; ++word)
+    {
+        uint64_t value = 0;
+        uint32_t end = width - word * 64 < 64 ? width - word * 64 : 64;
+
+        for (uint32_t i = 0; i < end; ++i)
+            value |= static_cast<uint64_t>(src[word * 64 + i] >= threshold) << i;
+
+        bits[word] = value;
+    }
+}
@@ -0,0 +1,137 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Compiled with SSE2 enabled. Only call through PixelKernels.
+
+#include "edgekernels.h"
+
+#include <emmintrin.h>
+
+namespace
+{
+    // Luma of four pixels, one per 32-bit lane. Every product and the sum fit in 16 bits,
+    // so 16-bit multiplies on the zero-extended channels are exact.
+    inline __m128i GetLuma(__m128i pixels)
+    {
+        const __m128i mask = _mm_set1_epi32(0xFF);
+
+        __m128i blue = _mm_mullo_epi16(_mm_and_si128(pixels, mask), _mm_set1_epi32(29));
+        __m128i green = _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi32(pixels, 8), mask), _mm_set1_epi32(150));
+        __m128i red = _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi32(pixels, 16), mask), _mm_set1_epi32(77));
+
+        return _mm_srli_epi32(_mm_add_epi16(_mm_add_epi16(blue, green), red), 8);
+    }
+
+    inline __m128i Absolute(__m128i value)
+    {
+        return _mm_max_epi16(value, _mm_sub_epi16(_mm_setzero_si128(), value));
+    }
+
+    // |Gx| / 4 and |Gy| / 4 for eight pixels, widened to 16 bits
+    inline void Sobel(__m128i aboveLeft, __m128i above, __m128i aboveRight, __m128i left, __m128i right,
+        __m128i belowLeft, __m128i below, __m128i belowRight, __m128i& outX, __m128i& outY)
+    {
+        __m128i gx = _mm_add_epi16(_mm_sub_epi16(aboveRight, aboveLeft), _mm_sub_epi16(belowRight, belowLeft));
+        gx = _mm_add_epi16(gx, _mm_slli_epi16(_mm_sub_epi16(right, left), 1));
+
+        __m128i gy = _mm_sub_epi16(_mm_add_epi16(belowLeft, belowRight), _mm_add_epi16(aboveLeft, aboveRight));
+        gy = _mm_add_epi16(gy, _mm_slli_epi16(_mm_sub_epi16(below, above), 1));
+
+        outX = _mm_srli_epi16(Absolute(gx), 2);
+        outY = _mm_srli_epi16(Absolute(gy), 2);
+    }
+}
+
+void Takoyaki::Kernels::LumaRowSse2(const uint32_t* src, uint8_t* dst, uint32_t width)
+{
+    uint32_t x = 0;
+
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128i luma0 = GetLuma(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x)));
+        __m128i luma1 = GetLuma(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x + 4)));
+        __m128i luma2 = GetLuma(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x + 8)));
+        __m128i luma3 = GetLuma(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x + 12)));
+
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(luma0, luma1), _mm_packs_epi32(luma2, luma3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), packed);
+    }
+
+    LumaRowScalar(src + x, dst + x, width - x);
+}
+
+void Takoyaki::Kernels::SobelRowSse2(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* gradientX, uint8_t* gradientY, uint32_t count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    uint32_t x = 0;
+
+    // Loads reach one pixel either side, which the caller guarantees exist
+    for (; x + 16 <= count; x += 16)
+    {
+        __m128i taps[8] = {
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + x - 1)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + x)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + x + 1)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x - 1)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x + 1)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + x - 1)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + x)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + x + 1)),
+        };
+
+        __m128i low[8];
+        __m128i high[8];
+        for (int i = 0; i < 8; ++i)
+        {
+            low[i] = _mm_unpacklo_epi8(taps[i], zero);
+            high[i] = _mm_unpackhi_epi8(taps[i], zero);
+        }
+
+        __m128i lowX, lowY, highX, highY;
+        Sobel(low[0], low[1], low[2], low[3], low[4], low[5], low[6], low[7], lowX, lowY);
+        Sobel(high[0], high[1], high[2], high[3], high[4], high[5], high[6], high[7], highX, highY);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(gradientX + x), _mm_packus_epi16(lowX, highX));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(gradientY + x), _mm_packus_epi16(lowY, highY));
+    }
+
+    SobelRowScalar(above + x, row + x, below + x, gradientX + x, gradientY + x, count - x);
+}
+
+void Takoyaki::Kernels::ThresholdRowSse2(const uint8_t* src, uint64_t* bits, uint32_t width, uint8_t threshold)
+{
+    const __m128i limit = _mm_set1_epi8(static_cast<char>(threshold));
+    uint32_t word = 0;
+
+    // Unsigned src >= threshold is max(src, threshold) == src
+    for (; word * 64 + 64 <= width; ++word)
+    {
+        uint64_t value = 0;
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + word * 64 + i * 16));
+            uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(pixels, limit), pixels)));
+            value |= static_cast<uint64_t>(mask) << (i * 16);
+        }
+
+        bits[word] = value;
+    }
+
+    ThresholdRowScalar(src + word * 64, bits + word, width - word * 64, threshold);
+}
@@ -0,0 +1,51 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Compiled with AVX2, FMA and F16C enabled. Only call through PixelKernels.
+
+#include "hashkernels.h"
+
+#include <immintrin.h>
+
+uint64_t Takoyaki::Kernels::HashRowAvx2(const uint32_t* row, uint32_t width)
+{
+    alignas(32) uint32_t lanes[RowHashLanes];
+    for (uint32_t i = 0; i < RowHashLanes; ++i)
+        lanes[i] = GetRowHashSeed(i);
+
+    const __m256i multiplier = _mm256_set1_epi32(static_cast<int>(RowHashMultiplier));
+    __m256i lanesLo = _mm256_load_si256(reinterpret_cast<const __m256i*>(lanes));
+    __m256i lanesHi = _mm256_load_si256(reinterpret_cast<const __m256i*>(lanes + 8));
+    uint32_t x = 0;
+
+    for (; x + 16 <= width; x += 16)
+    {
+        lanesLo = _mm256_mullo_epi32(_mm256_xor_si256(lanesLo, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x))), multiplier);
+        lanesHi = _mm256_mullo_epi32(_mm256_xor_si256(lanesHi, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x + 8))), multiplier);
+    }
+
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), lanesLo);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes + 8), lanesHi);
+
+    for (; x < width; ++x)
+        lanes[x % RowHashLanes] = (lanes[x % RowHashLanes] ^ row[x]) * RowHashMultiplier;
+
+    return FoldRowHashLanes(lanes, width);
+}
@@ -0,0 +1,48 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+
+namespace Takoyaki::Kernels
+{
+    // Row hashes run sixteen independent multiplicative lanes, lane i taking every pixel at
+    // x % 16 == i, so the vector versions need no horizontal work until the final fold and
+    // have several multiply chains in flight. Good enough to find candidate matches, which
+    // callers then confirm with a compare.
+    static constexpr uint32_t RowHashLanes = 16;
+    static constexpr uint32_t RowHashMultiplier = 0x9E3779B1;
+
+    inline uint32_t GetRowHashSeed(uint32_t lane) { return 0x811C9DC5u + lane * 0x7F4A7C15u; }
+
+    inline uint64_t FoldRowHashLanes(const uint32_t* lanes, uint32_t width)
+    {
+        uint64_t hash = 0xCBF29CE484222325ull ^ width;
+        for (uint32_t i = 0; i < RowHashLanes; ++i)
+            hash = (hash ^ lanes[i]) * 0x100000001B3ull;
+
+        return hash;
+    }
+
+    uint64_t HashRowScalar(const uint32_t* row, uint32_t width);
+    uint64_t HashRowSse41(const uint32_t* row, uint32_t width);
+    uint64_t HashRowAvx2(const uint32_t* row, uint32_t width);
+}
@@ -0,0 +1,33 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "hashkernels.h"
+
+uint64_t Takoyaki::Kernels::HashRowScalar(const uint32_t* row, uint32_t width)
+{
+    uint32_t lanes[RowHashLanes];
+    for (uint32_t i = 0; i < RowHashLanes; ++i)
+        lanes[i] = GetRowHashSeed(i);
+
+    for (uint32_t x = 0; x < width; ++x)
+        lanes[x % RowHashLanes] = (lanes[x % RowHashLanes] ^ row[x]) * RowHashMultiplier;
+
+    return FoldRowHashLanes(lanes, width);
+}
@@ -0,0 +1,57 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Compiled with SSE4.1 enabled. Only call through PixelKernels.
+
+#include "hashkernels.h"
+
+#include <smmintrin.h>
+
+uint64_t Takoyaki::Kernels::HashRowSse41(const uint32_t* row, uint32_t width)
+{
+    alignas(16) uint32_t lanes[RowHashLanes];
+    for (uint32_t i = 0; i < RowHashLanes; ++i)
+        lanes[i] = GetRowHashSeed(i);
+
+    const __m128i multiplier = _mm_set1_epi32(static_cast<int>(RowHashMultiplier));
+    __m128i lanes0 = _mm_load_si128(reinterpret_cast<const __m128i*>(lanes));
+    __m128i lanes1 = _mm_load_si128(reinterpret_cast<const __m128i*>(lanes + 4));
+    __m128i lanes2 = _mm_load_si128(reinterpret_cast<const __m128i*>(lanes + 8));
+    __m128i lanes3 = _mm_load_si128(reinterpret_cast<const __m128i*>(lanes + 12));
+    uint32_t x = 0;
+
+    for (; x + 16 <= width; x += 16)
+    {
+        lanes0 = _mm_mullo_epi32(_mm_xor_si128(lanes0, _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x))), multiplier);
+        lanes1 = _mm_mullo_epi32(_mm_xor_si128(lanes1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x + 4))), multiplier);
+        lanes2 = _mm_mullo_epi32(_mm_xor_si128(lanes2, _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x + 8))), multiplier);
+        lanes3 = _mm_mullo_epi32(_mm_xor_si128(lanes3, _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x + 12))), multiplier);
+    }
+
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), lanes0);
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes + 4), lanes1);
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes + 8), lanes2);
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes + 12), lanes3);
+
+    for (; x < width; ++x)
+        lanes[x % RowHashLanes] = (lanes[x % RowHashLanes] ^ row[x]) * RowHashMultiplier;
+
+    return FoldRowHashLanes(lanes, width);
+}
@@ -0,0 +1,127 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Compiled with AVX2, FMA and F16C enabled. Only call through PixelKernels.
+
+#include "maskkernels.h"
+
+#include <algorithm>
+#include <cstring>
+#include <immintrin.h>
+
+void Takoyaki::Kernels::BoxBlurAccumulateAvx2(uint16_t* sums, const uint8_t* add, const uint8_t* sub, uint32_t count)
+{
+    uint32_t i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256i addWords = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(add + i)));
+        __m256i subWords = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(sub + i)));
+        __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sums + i));
+
+        current = _mm256_sub_epi16(_mm256_add_epi16(current, addWords), subWords);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(sums + i), current);
+    }
+
+    BoxBlurAccumulateScalar(sums + i, add + i, sub + i, count - i);
+}
+
+void Takoyaki::Kernels::BoxBlurEmitAvx2(const uint16_t* sums, uint8_t* dst, uint32_t count, uint16_t bias, uint16_t reciprocal)
+{
+    const __m256i biasVector = _mm256_set1_epi16(static_cast<short>(bias));
+    const __m256i reciprocalVector = _mm256_set1_epi16(static_cast<short>(reciprocal));
+    uint32_t i = 0;
+
+    for (; i + 32 <= count; i += 32)
+    {
+        __m256i sumsLo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sums + i));
+        __m256i sumsHi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sums + i + 16));
+
+        __m256i averageLo = _mm256_mulhi_epu16(_mm256_add_epi16(sumsLo, biasVector), reciprocalVector);
+        __m256i averageHi = _mm256_mulhi_epu16(_mm256_add_epi16(sumsHi, biasVector), reciprocalVector);
+
+        // The pack works per 128-bit lane, so put the quadwords back in order afterwards
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(averageLo, averageHi), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+    }
+
+    BoxBlurEmitScalar(sums + i, dst + i, count - i, bias, reciprocal);
+}
+
+void Takoyaki::Kernels::PixelateBandAvx2(uint8_t* data, uint32_t stride, uint32_t width, uint32_t rows, uint32_t blockSize)
+{
+    for (uint32_t blockX = 0; blockX < width; blockX += blockSize)
+    {
+        uint32_t blockWidth = std::min(blockSize, width - blockX);
+
+        // Two pixels worth of per-channel 32-bit sums, folded together at the end
+        __m256i sums = _mm256_setzero_si256();
+
+        for (uint32_t y = 0; y < rows; ++y)
+        {
+            const uint8_t* pixel = data + static_cast<size_t>(y) * stride + blockX * 4;
+            uint32_t x = 0;
+
+            for (; x + 8 <= blockWidth; x += 8)
+            {
+                __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixel + x * 4));
+                __m256i words = _mm256_add_epi16(
+                    _mm256_unpacklo_epi8(bytes, _mm256_setzero_si256()),
+                    _mm256_unpackhi_epi8(bytes, _mm256_setzero_si256()));
+
+                sums = _mm256_add_epi32(sums, _mm256_unpacklo_epi16(words, _mm256_setzero_si256()));
+                sums = _mm256_add_epi32(sums, _mm256_unpackhi_epi16(words, _mm256_setzero_si256()));
+            }
+
+            for (; x + 2 <= blockWidth; x += 2)
+                sums = _mm256_add_epi32(sums, _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pixel + x * 4))));
+
+            if (x < blockWidth)
+            {
+                int32_t last;
+                memcpy(&last, pixel + x * 4, sizeof(last));
+                sums = _mm256_add_epi32(sums, _mm256_cvtepu8_epi32(_mm_cvtsi32_si128(last)));
+            }
+        }
+
+        __m128i folded = _mm_add_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+
+        alignas(16) uint32_t channelSums[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(channelSums), folded);
+
+        uint32_t count = blockWidth * rows;
+        uint32_t average = 0;
+        for (uint32_t c = 0; c < 4; ++c)
+            average |= ((channelSums[c] + count / 2) / count) << (c * 8);
+
+        const __m256i fill = _mm256_set1_epi32(static_cast<int>(average));
+
+        for (uint32_t y = 0; y < rows; ++y)
+        {
+            uint8_t* pixel = data + static_cast<size_t>(y) * stride + blockX * 4;
+            uint32_t x = 0;
+
+            for (; x + 8 <= blockWidth; x += 8)
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixel + x * 4), fill);
+
+            for (; x < blockWidth; ++x)
+                memcpy(pixel + x * 4, &average, sizeof(average));
+        }
+    }
+}
@@ -0,0 +1,50 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace Takoyaki::Kernels
+{
+    // Box blur windows are at most 255 wide, so channel sums always fit in 16 bits. Averages
+    // are computed as ((sum + bias) * reciprocal) >> 16, with bias = window / 2 and
+    // reciprocal = ceil(65536 / window), which stays exact enough without a divide. The
+    // rounded-up reciprocal can overshoot 255 for wide windows, so results saturate.
+    static constexpr uint32_t MaxBoxBlurRadius = 127;
+
+    // Horizontal running-sum blur of one BGRA row, replicating the edge pixels
+    void BoxBlurRowScalar(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t radius, uint16_t bias, uint16_t reciprocal);
+    void BoxBlurRowSse2(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t radius, uint16_t bias, uint16_t reciprocal);
+
+    // sums[i] += add[i] - sub[i], over count bytes
+    void BoxBlurAccumulateScalar(uint16_t* sums, const uint8_t* add, const uint8_t* sub, uint32_t count);
+    void BoxBlurAccumulateSse2(uint16_t* sums, const uint8_t* add, const uint8_t* sub, uint32_t count);
+    void BoxBlurAccumulateAvx2(uint16_t* sums, const uint8_t* add, const uint8_t* sub, uint32_t count);
+
+    // dst[i] = min(((sums[i] + bias) * reciprocal) >> 16, 255), over count bytes
+    void BoxBlurEmitScalar(const uint16_t* sums, uint8_t* dst, uint32_t count, uint16_t bias, uint16_t reciprocal);
+    void BoxBlurEmitSse2(const uint16_t* sums, uint8_t* dst, uint32_t count, uint16_t bias, uint16_t reciprocal);
+    void BoxBlurEmitAvx2(const uint16_t* sums, uint8_t* dst, uint32_t count, uint16_t bias, uint16_t reciprocal);
+
+    // Replaces every blockSize wide run of pixels in a band of rows with its average color
+    void PixelateBandScalar(uint8_t* data, uint32_t stride, uint32_t width, uint32_t rows, uint32_t blockSize);
+    void PixelateBandSse2(uint8_t* data, uint32_t stride, uint32_t width, uint32_t rows, uint32_t blockSize);
+    void PixelateBandAvx2(uint8_t* data, uint32_t stride, uint32_t width, uint32_t rows, uint32_t blockSize);
+}
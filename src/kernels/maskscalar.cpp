@@ -0,0 +1,85 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "maskkernels.h"
+
+#include <algorithm>
+
+void Takoyaki::Kernels::BoxBlurRowScalar(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t radius, uint16_t bias, uint16_t reciprocal)
+{
+    const int32_t lastPixel = static_cast<int32_t>(width) - 1;
+
+    for (uint32_t c = 0; c < 4; ++c)
+    {
+        // Window centered on pixel 0, with the left edge replicated
+        uint32_t sum = src[c] * radius;
+        for (int32_t i = 0; i <= static_cast<int32_t>(radius); ++i)
+            sum += src[std::min(i, lastPixel) * 4 + c];
+
+        for (int32_t x = 0; x <= lastPixel; ++x)
+        {
+            dst[x * 4 + c] = static_cast<uint8_t>(std::min(((sum + bias) * reciprocal) >> 16, 255u));
+
+            int32_t entering = std::min(x + static_cast<int32_t>(radius) + 1, lastPixel);
+            int32_t leaving = std::max(x - static_cast<int32_t>(radius), 0);
+            sum += src[entering * 4 + c];
+            sum -= src[leaving * 4 + c];
+        }
+    }
+}
+
+void Takoyaki::Kernels::BoxBlurAccumulateScalar(uint16_t* sums, const uint8_t* add, const uint8_t* sub, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i)
+        sums[i] = static_cast<uint16_t>(sums[i] + add[i] - sub[i]);
+}
+
+void Takoyaki::Kernels::BoxBlurEmitScalar(const uint16_t* sums, uint8_t* dst, uint32_t count, uint16_t bias, uint16_t reciprocal)
+{
+    for (uint32_t i = 0; i < count; ++i)
+        dst[i] = static_cast<uint8_t>(std::min((static_cast<uint32_t>(sums[i] + bias) * reciprocal) >> 16, 255u));
+}
+
+void Takoyaki::Kernels::PixelateBandScalar(uint8_t* data, uint32_t stride, uint32_t width, uint32_t rows, uint32_t blockSize)
+{
+    for (uint32_t blockX = 0; blockX < width; blockX += blockSize)
+    {
+        uint32_t blockWidth = std::min(blockSize, width - blockX);
+        uint32_t sums[4] = {};
+
+        for (uint32_t y = 0; y < rows; ++y)
+        {
+            const uint8_t* pixel = data + static_cast<size_t>(y) * stride + blockX * 4;
+            for (uint32_t x = 0; x < blockWidth * 4; ++x)
+                sums[x & 3] += pixel[x];
+        }
+
+        uint32_t count = blockWidth * rows;
+        uint8_t average[4];
+        for (uint32_t c = 0; c < 4; ++c)
+            average[c] = static_cast<uint8_t>((sums[c] + count / 2) / count);
+
+        for (uint32_t y = 0; y < rows; ++y)
+        {
+            uint8_t* pixel = data + static_cast<size_t>(y) * stride + blockX * 4;
+            for (uint32_t x = 0; x < blockWidth * 4; ++x)
+                pixel[x] = average[x & 3];
+        }
+    }
+}
@@ -0,0 +1,155 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Compiled with SSE2 enabled. Only call through PixelKernels.
+
+#include "maskkernels.h"
+
+#include <algorithm>
+#include <cstring>
+#include <emmintrin.h>
+
+namespace
+{
+    inline __m128i LoadPixel(const uint8_t* pixel)
+    {
+        int32_t value;
+        memcpy(&value, pixel, sizeof(value));
+        return _mm_unpacklo_epi8(_mm_cvtsi32_si128(value), _mm_setzero_si128());
+    }
+}
+
+void Takoyaki::Kernels::BoxBlurRowSse2(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t radius, uint16_t bias, uint16_t reciprocal)
+{
+    // All four channels of the running sum live in the low 16-bit lanes of one register
+    const int32_t lastPixel = static_cast<int32_t>(width) - 1;
+    const __m128i biasVector = _mm_set1_epi16(static_cast<short>(bias));
+    const __m128i reciprocalVector = _mm_set1_epi16(static_cast<short>(reciprocal));
+
+    __m128i sum = _mm_mullo_epi16(LoadPixel(src), _mm_set1_epi16(static_cast<short>(radius)));
+    for (int32_t i = 0; i <= static_cast<int32_t>(radius); ++i)
+        sum = _mm_add_epi16(sum, LoadPixel(src + std::min(i, lastPixel) * 4));
+
+    for (int32_t x = 0; x <= lastPixel; ++x)
+    {
+        __m128i average = _mm_mulhi_epu16(_mm_add_epi16(sum, biasVector), reciprocalVector);
+        int32_t packed = _mm_cvtsi128_si32(_mm_packus_epi16(average, average));
+        memcpy(dst + x * 4, &packed, sizeof(packed));
+
+        int32_t entering = std::min(x + static_cast<int32_t>(radius) + 1, lastPixel);
+        int32_t leaving = std::max(x - static_cast<int32_t>(radius), 0);
+
+        sum = _mm_add_epi16(sum, LoadPixel(src + entering * 4));
+        sum = _mm_sub_epi16(sum, LoadPixel(src + leaving * 4));
+    }
+}
+
+void Takoyaki::Kernels::BoxBlurAccumulateSse2(uint16_t* sums, const uint8_t* add, const uint8_t* sub, uint32_t count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    uint32_t i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i addBytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(add + i));
+        __m128i subBytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sub + i));
+        __m128i sumsLo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sums + i));
+        __m128i sumsHi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sums + i + 8));
+
+        sumsLo = _mm_sub_epi16(_mm_add_epi16(sumsLo, _mm_unpacklo_epi8(addBytes, zero)), _mm_unpacklo_epi8(subBytes, zero));
+        sumsHi = _mm_sub_epi16(_mm_add_epi16(sumsHi, _mm_unpackhi_epi8(addBytes, zero)), _mm_unpackhi_epi8(subBytes, zero));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + i), sumsLo);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + i + 8), sumsHi);
+    }
+
+    BoxBlurAccumulateScalar(sums + i, add + i, sub + i, count - i);
+}
+
+void Takoyaki::Kernels::BoxBlurEmitSse2(const uint16_t* sums, uint8_t* dst, uint32_t count, uint16_t bias, uint16_t reciprocal)
+{
+    const __m128i biasVector = _mm_set1_epi16(static_cast<short>(bias));
+    const __m128i reciprocalVector = _mm_set1_epi16(static_cast<short>(reciprocal));
+    uint32_t i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i sumsLo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sums + i));
+        __m128i sumsHi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sums + i + 8));
+
+        __m128i averageLo = _mm_mulhi_epu16(_mm_add_epi16(sumsLo, biasVector), reciprocalVector);
+        __m128i averageHi = _mm_mulhi_epu16(_mm_add_epi16(sumsHi, biasVector), reciprocalVector);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(averageLo, averageHi));
+    }
+
+    BoxBlurEmitScalar(sums + i, dst + i, count - i, bias, reciprocal);
+}
+
+void Takoyaki::Kernels::PixelateBandSse2(uint8_t* data, uint32_t stride, uint32_t width, uint32_t rows, uint32_t blockSize)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    for (uint32_t blockX = 0; blockX < width; blockX += blockSize)
+    {
+        uint32_t blockWidth = std::min(blockSize, width - blockX);
+
+        // Per-channel sums in 32-bit lanes, so large blocks cannot overflow
+        __m128i sums = zero;
+
+        for (uint32_t y = 0; y < rows; ++y)
+        {
+            const uint8_t* pixel = data + static_cast<size_t>(y) * stride + blockX * 4;
+            uint32_t x = 0;
+
+            for (; x + 4 <= blockWidth; x += 4)
+            {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixel + x * 4));
+                __m128i words = _mm_add_epi16(_mm_unpacklo_epi8(bytes, zero), _mm_unpackhi_epi8(bytes, zero));
+                __m128i pairs = _mm_add_epi16(words, _mm_srli_si128(words, 8));
+                sums = _mm_add_epi32(sums, _mm_unpacklo_epi16(pairs, zero));
+            }
+
+            for (; x < blockWidth; ++x)
+                sums = _mm_add_epi32(sums, _mm_unpacklo_epi16(LoadPixel(pixel + x * 4), zero));
+        }
+
+        alignas(16) uint32_t channelSums[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(channelSums), sums);
+
+        uint32_t count = blockWidth * rows;
+        uint32_t average = 0;
+        for (uint32_t c = 0; c < 4; ++c)
+            average |= ((channelSums[c] + count / 2) / count) << (c * 8);
+
+        const __m128i fill = _mm_set1_epi32(static_cast<int>(average));
+
+        for (uint32_t y = 0; y < rows; ++y)
+        {
+            uint8_t* pixel = data + static_cast<size_t>(y) * stride + blockX * 4;
+            uint32_t x = 0;
+
+            for (; x + 4 <= blockWidth; x += 4)
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(pixel + x * 4), fill);
+
+            for (; x < blockWidth; ++x)
+                memcpy(pixel + x * 4, &average, sizeof(average));
+        }
+    }
+}
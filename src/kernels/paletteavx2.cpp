@@ -0,0 +1,56 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Compiled with AVX2, FMA and F16C enabled. Only call through PixelKernels.
+
+#include "palettekernels.h"
+
+#include <immintrin.h>
+
+void Takoyaki::Kernels::MapPaletteRowAvx2(const PaletteTable& table, const uint32_t* row, uint8_t* dst, uint32_t width)
+{
+    const __m256i multiplier = _mm256_set1_epi32(static_cast<int>(0x9E3779B1u));
+    const __m128i lowBytes = _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const int* colours = reinterpret_cast<const int*>(table.m_Colours);
+    const int* indices = reinterpret_cast<const int*>(table.m_Indices);
+    uint32_t x = 0;
+
+    for (; x + 8 <= width; x += 8)
+    {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x));
+        __m256i slots = _mm256_srli_epi32(_mm256_mullo_epi32(pixels, multiplier), 32 - PaletteTableBits);
+
+        // A colour is never missing from its home slot's chain, so a home slot holding some
+        // other colour is the only miss, and those few pixels take the probing path
+        __m256i found = _mm256_i32gather_epi32(colours, slots, 4);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(found, pixels)) != -1)
+        {
+            MapPaletteRowScalar(table, row + x, dst + x, 8);
+            continue;
+        }
+
+        // Indices are below 256, so the low byte of each lane is all there is
+        __m256i mapped = _mm256_i32gather_epi32(indices, slots, 4);
+        __m128i low = _mm_shuffle_epi8(_mm256_castsi256_si128(mapped), lowBytes);
+        __m128i high = _mm_shuffle_epi8(_mm256_extracti128_si256(mapped, 1), lowBytes);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x), _mm_unpacklo_epi32(low, high));
+    }
+
+    MapPaletteRowScalar(table, row + x, dst + x, width - x);
+}
@@ -0,0 +1,48 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace Takoyaki::Kernels
+{
+    // Open addressing hash table from colour to palette index, with linear probing. At most
+    // 256 colours in 1024 slots keeps nearly every lookup on its first slot.
+    static constexpr uint32_t PaletteTableBits = 10;
+    static constexpr uint32_t PaletteTableSize = 1 << PaletteTableBits;
+    static constexpr uint32_t PaletteEmptySlot = UINT32_MAX;
+
+    struct PaletteTable
+    {
+        alignas(64) uint32_t m_Colours[PaletteTableSize];
+
+        // Palette index, or PaletteEmptySlot. 32 bits wide so that it can be gathered.
+        alignas(64) uint32_t m_Indices[PaletteTableSize];
+    };
+
+    inline uint32_t GetPaletteSlot(uint32_t colour)
+    {
+        return (colour * 0x9E3779B1u) >> (32 - PaletteTableBits);
+    }
+
+    // Writes the palette index of every pixel of row to dst. Every pixel must be in table.
+    void MapPaletteRowScalar(const PaletteTable& table, const uint32_t* row, uint8_t* dst, uint32_t width);
+    void MapPaletteRowAvx2(const PaletteTable& table, const uint32_t* row, uint8_t* dst, uint32_t width);
+}
@@ -0,0 +1,44 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "palettekernels.h"
+
+void Takoyaki::Kernels::MapPaletteRowScalar(const PaletteTable& table, const uint32_t* row, uint8_t* dst, uint32_t width)
+{
+    // Screen content is mostly runs, which skip the lookup
+    uint32_t previous = 0;
+    uint8_t index = 0;
+    bool hasPrevious = false;
+
+    for (uint32_t x = 0; x < width; ++x)
+    {
+        if (!hasPrevious || row[x] != previous)
+        {
+            uint32_t slot = GetPaletteSlot(row[x]);
+            while (table.m_Colours[slot] != row[x] || table.m_Indices[slot] == PaletteEmptySlot)
+                slot = (slot + 1) & (PaletteTableSize - 1);
+
+            previous = row[x];
+            index = static_cast<uint8_t>(table.m_Indices[slot]);
+            hasPrevious = true;
+        }
+
+        dst[x] = index;
+    }
+}
@@ -0,0 +1,577 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pixelkernels.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    using namespace Takoyaki;
+
+    void BindScalar(PixelKernels& kernels)
+    {
+        kernels.m_TonemapFloat16Row = Kernels::TonemapFloat16RowScalar;
+        kernels.m_Tonemap10BitRow = Kernels::Tonemap10BitRowScalar;
+        kernels.m_BoxBlurRow = Kernels::BoxBlurRowScalar;
+        kernels.m_BoxBlurAccumulate = Kernels::BoxBlurAccumulateScalar;
+        kernels.m_BoxBlurEmit = Kernels::BoxBlurEmitScalar;
+        kernels.m_PixelateBand = Kernels::PixelateBandScalar;
+        kernels.m_AccumulateTileRow = Kernels::AccumulateTileRowScalar;
+        kernels.m_HashRow = Kernels::HashRowScalar;
+        kernels.m_PackRgbRow = Kernels::PackRgbRowScalar;
+        kernels.m_PngFilterSub = Kernels::PngFilterSubScalar;
+        kernels.m_PngFilterUp = Kernels::PngFilterUpScalar;
+        kernels.m_PngFilterPaeth = Kernels::PngFilterPaethScalar;
+        kernels.m_BlendPremultipliedRow = Kernels::BlendPremultipliedRowScalar;
+        kernels.m_MatchRowPrefix = Kernels::MatchRowPrefixScalar;
+        kernels.m_MatchRowSuffix = Kernels::MatchRowSuffixScalar;
+        kernels.m_MapPaletteRow = Kernels::MapPaletteRowScalar;
+        kernels.m_LumaRow = Kernels::LumaRowScalar;
+        kernels.m_SobelRow = Kernels::SobelRowScalar;
+        kernels.m_ThresholdRow = Kernels::ThresholdRowScalar;
+    }
+
+#if TAKOYAKI_X86
+    void BindSse2(PixelKernels& kernels)
+    {
+        kernels.m_BoxBlurRow = Kernels::BoxBlurRowSse2;
+        kernels.m_BoxBlurAccumulate = Kernels::BoxBlurAccumulateSse2;
+        kernels.m_BoxBlurEmit = Kernels::BoxBlurEmitSse2;
+        kernels.m_PixelateBand = Kernels::PixelateBandSse2;
+        kernels.m_AccumulateTileRow = Kernels::AccumulateTileRowSse2;
+        kernels.m_BlendPremultipliedRow = Kernels::BlendPremultipliedRowSse2;
+        kernels.m_MatchRowPrefix = Kernels::MatchRowPrefixSse2;
+        kernels.m_MatchRowSuffix = Kernels::MatchRowSuffixSse2;
+        kernels.m_LumaRow = Kernels::LumaRowSse2;
+        kernels.m_SobelRow = Kernels::SobelRowSse2;
+        kernels.m_ThresholdRow = Kernels::ThresholdRowSse2;
+    }
+
+    void BindSse41(PixelKernels& kernels)
+    {
+        kernels.m_HashRow = Kernels::HashRowSse41;
+        kernels.m_PackRgbRow = Kernels::PackRgbRowSse41;
+        kernels.m_PngFilterSub = Kernels::PngFilterSubSse41;
+        kernels.m_PngFilterUp = Kernels::PngFilterUpSse41;
+        kernels.m_PngFilterPaeth = Kernels::PngFilterPaethSse41;
+    }
+
+    void BindAvx2(PixelKernels& kernels)
+    {
+        kernels.m_TonemapFloat16Row = Kernels::TonemapFloat16RowAvx2;
+        kernels.m_Tonemap10BitRow = Kernels::Tonemap10BitRowAvx2;
+        kernels.m_BoxBlurAccumulate = Kernels::BoxBlurAccumulateAvx2;
+        kernels.m_BoxBlurEmit = Kernels::BoxBlurEmitAvx2;
+        kernels.m_PixelateBand = Kernels::PixelateBandAvx2;
+        kernels.m_AccumulateTileRow = Kernels::AccumulateTileRowAvx2;
+        kernels.m_HashRow = Kernels::HashRowAvx2;
+        kernels.m_PackRgbRow = Kernels::PackRgbRowAvx2;
+        kernels.m_PngFilterSub = Kernels::PngFilterSubAvx2;
+        kernels.m_PngFilterUp = Kernels::PngFilterUpAvx2;
+        kernels.m_PngFilterPaeth = Kernels::PngFilterPaethAvx2;
+        kernels.m_BlendPremultipliedRow = Kernels::BlendPremultipliedRowAvx2;
+        kernels.m_MatchRowPrefix = Kernels::MatchRowPrefixAvx2;
+        kernels.m_MatchRowSuffix = Kernels::MatchRowSuffixAvx2;
+        kernels.m_MapPaletteRow = Kernels::MapPaletteRowAvx2;
+        kernels.m_LumaRow = Kernels::LumaRowAvx2;
+        kernels.m_SobelRow = Kernels::SobelRowAvx2;
+        kernels.m_ThresholdRow = Kernels::ThresholdRowAvx2;
+    }
+
+    void BindAvx512(PixelKernels& kernels)
+    {
+        kernels.m_TonemapFloat16Row = Kernels::TonemapFloat16RowAvx512;
+        kernels.m_Tonemap10BitRow = Kernels::Tonemap10BitRowAvx512;
+    }
+#endif
+
+    // Row widths used by the conformance checks, chosen to hit every vector tail length
+    constexpr uint32_t ConformanceWidths[] = { 1, 3, 7, 8, 9, 15, 16, 17, 31, 33, 64, 127, 1921 };
+    constexpr uint32_t ConformanceRows = 8;
+
+    bool CompareBytes(const char* kernelName, const uint8_t* expected, const uint8_t* actual, size_t size, uint32_t tolerance)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            if (static_cast<uint32_t>(std::abs(expected[i] - actual[i])) <= tolerance)
+                continue;
+
+            printf("Takoyaki: %s mismatch at byte %zu (expected %u, got %u)\n", kernelName, i, expected[i], actual[i]);
+            return false;
+        }
+
+        return true;
+    }
+
+    std::vector<uint8_t> MakeRandomBytes(std::mt19937& rng, size_t size)
+    {
+        std::vector<uint8_t> bytes(size);
+        for (uint8_t& value : bytes)
+            value = static_cast<uint8_t>(rng());
+
+        return bytes;
+    }
+
+    std::vector<uint8_t> MakeRandomEncodeLut(std::mt19937& rng)
+    {
+        return MakeRandomBytes(rng, Kernels::TonemapLutSize + Kernels::TonemapLutPadding);
+    }
+
+    bool CheckTonemapFloat16Row(const PixelKernels& reference, const PixelKernels& kernels, std::mt19937& rng)
+    {
+        std::vector<uint8_t> encodeLut = MakeRandomEncodeLut(rng);
+
+        for (uint32_t width : ConformanceWidths)
+        {
+            // Any bit pattern is valid input, including negatives, infinities and NaNs
+            std::vector<uint16_t> src(static_cast<size_t>(width) * 4 * ConformanceRows);
+            for (uint16_t& value : src)
+                value = static_cast<uint16_t>(rng());
+
+            std::vector<uint32_t> expected(static_cast<size_t>(width) * ConformanceRows);
+            std::vector<uint32_t> actual(expected.size());
+
+            for (uint32_t y = 0; y < ConformanceRows; ++y)
+            {
+                reference.m_TonemapFloat16Row(src.data() + y * width * 4, expected.data() + y * width, width, encodeLut.data());
+                kernels.m_TonemapFloat16Row(src.data() + y * width * 4, actual.data() + y * width, width, encodeLut.data());
+            }
+
+            if (!CompareBytes("TonemapFloat16Row", reinterpret_cast<uint8_t*>(expected.data()), reinterpret_cast<uint8_t*>(actual.data()), expected.size() * 4, 0))
+                return false;
+        }
+
+        return true;
+    }
+
+    bool CheckTonemap10BitRow(const PixelKernels& reference, const PixelKernels& kernels, std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> decodeDistribution(0.0f, 125.0f);
+        std::uniform_real_distribution<float> matrixDistribution(-0.5f, 1.5f);
+
+        // Monotonic like a real transfer function, so nearby codes land on nearby entries
+        std::vector<uint8_t> encodeLut(Kernels::TonemapLutSize + Kernels::TonemapLutPadding, 255);
+        for (uint32_t i = 0; i < Kernels::TonemapLutSize; ++i)
+            encodeLut[i] = static_cast<uint8_t>(std::min<uint32_t>(i >> 6, 255));
+
+        std::vector<float> decodeLut(1024);
+        for (float& value : decodeLut)
+            value = decodeDistribution(rng);
+
+        float matrix[9];
+        for (float& value : matrix)
+            value = matrixDistribution(rng);
+
+        for (uint32_t width : ConformanceWidths)
+        {
+            std::vector<uint32_t> src(static_cast<size_t>(width) * ConformanceRows);
+            for (uint32_t& value : src)
+                value = static_cast<uint32_t>(rng());
+
+            std::vector<uint32_t> expected(src.size());
+            std::vector<uint32_t> actual(src.size());
+
+            for (uint32_t y = 0; y < ConformanceRows; ++y)
+            {
+                reference.m_Tonemap10BitRow(src.data() + y * width, expected.data() + y * width, width, decodeLut.data(), matrix, encodeLut.data());
+                kernels.m_Tonemap10BitRow(src.data() + y * width, actual.data() + y * width, width, decodeLut.data(), matrix, encodeLut.data());
+            }
+
+            // FMA rounds differently from separate multiplies and adds, which can move a
+            // value across a half-float rounding boundary
+            if (!CompareBytes("Tonemap10BitRow", reinterpret_cast<uint8_t*>(expected.data()), reinterpret_cast<uint8_t*>(actual.data()), expected.size() * 4, 1))
+                return false;
+        }
+
+        return true;
+    }
+
+    bool CheckBoxBlur(const PixelKernels& reference, const PixelKernels& kernels, std::mt19937& rng)
+    {
+        for (uint32_t width : ConformanceWidths)
+        {
+            uint32_t radius = 1 + rng() % Kernels::MaxBoxBlurRadius;
+            uint32_t window = radius * 2 + 1;
+            uint16_t bias = static_cast<uint16_t>(window / 2);
+            uint16_t reciprocal = static_cast<uint16_t>((65536 + window - 1) / window);
+
+            std::vector<uint8_t> src = MakeRandomBytes(rng, width * 4);
+            std::vector<uint8_t> expected(src.size());
+            std::vector<uint8_t> actual(src.size());
+
+            reference.m_BoxBlurRow(src.data(), expected.data(), width, radius, bias, reciprocal);
+            kernels.m_BoxBlurRow(src.data(), actual.data(), width, radius, bias, reciprocal);
+            if (!CompareBytes("BoxBlurRow", expected.data(), actual.data(), expected.size(), 0))
+                return false;
+
+            // Sums that are consistent with the window, so adding and removing never wraps
+            std::vector<uint16_t> expectedSums(width * 4);
+            for (uint16_t& sum : expectedSums)
+                sum = static_cast<uint16_t>(255 + rng() % (255 * (window - 2)));
+
+            std::vector<uint16_t> actualSums = expectedSums;
+            std::vector<uint8_t> add = MakeRandomBytes(rng, width * 4);
+
+            reference.m_BoxBlurAccumulate(expectedSums.data(), add.data(), src.data(), width * 4);
+            kernels.m_BoxBlurAccumulate(actualSums.data(), add.data(), src.data(), width * 4);
+            if (!CompareBytes("BoxBlurAccumulate", reinterpret_cast<uint8_t*>(expectedSums.data()), reinterpret_cast<uint8_t*>(actualSums.data()), expectedSums.size() * 2, 0))
+                return false;
+
+            reference.m_BoxBlurEmit(expectedSums.data(), expected.data(), width * 4, bias, reciprocal);
+            kernels.m_BoxBlurEmit(expectedSums.data(), actual.data(), width * 4, bias, reciprocal);
+            if (!CompareBytes("BoxBlurEmit", expected.data(), actual.data(), expected.size(), 0))
+                return false;
+        }
+
+        return true;
+    }
+
+    bool CheckPixelateBand(const PixelKernels& reference, const PixelKernels& kernels, std::mt19937& rng)
+    {
+        for (uint32_t width : ConformanceWidths)
+        {
+            uint32_t blockSize = 1 + rng() % 64;
+            uint32_t rows = 1 + rng() % blockSize;
+            uint32_t stride = width * 4 + 16;
+
+            std::vector<uint8_t> expected = MakeRandomBytes(rng, static_cast<size_t>(stride) * rows);
+            std::vector<uint8_t> actual = expected;
+
+            reference.m_PixelateBand(expected.data(), stride, width, rows, blockSize);
+            kernels.m_PixelateBand(actual.data(), stride, width, rows, blockSize);
+            if (!CompareBytes("PixelateBand", expected.data(), actual.data(), expected.size(), 0))
+                return false;
+        }
+
+        return true;
+    }
+
+    bool CheckAccumulateTileRow(const PixelKernels& reference, const PixelKernels& kernels, std::mt19937& rng)
+    {
+        for (uint32_t width : ConformanceWidths)
+        {
+            // Runs of colours from a small palette, with some rows copied from the previous
+            // frame, so that repeats, unchanged pixels and the colour cap all get exercised
+            std::vector<uint32_t> palette(1 + rng() % 200);
+            for (uint32_t& colour : palette)
+                colour = static_cast<uint32_t>(rng());
+
+            std::vector<uint32_t> previous(static_cast<size_t>(width) * ConformanceRows);
+            std::vector<uint32_t> current(previous.size());
+            for (size_t i = 0; i < current.size(); ++i)
+            {
+                previous[i] = static_cast<uint32_t>(rng());
+                current[i] = (i != 0 && rng() % 4 != 0) ? current[i - 1] ^ (rng() % 2 << 24) : palette[rng() % palette.size()];
+                if (rng() % 3 == 0)
+                    previous[i] = current[i] ^ (rng() % 2 << 31);
+            }
+
+            Kernels::TileStats expected;
+            Kernels::TileStats actual;
+
+            for (uint32_t y = 0; y < ConformanceRows; ++y)
+            {
+                const uint32_t* oldRow = y % 4 == 0 ? nullptr : previous.data() + y * width;
+                bool countColours = y % 3 != 2;
+                reference.m_AccumulateTileRow(current.data() + y * width, oldRow, width, countColours, expected);
+                kernels.m_AccumulateTileRow(current.data() + y * width, oldRow, width, countColours, actual);
+            }
+
+            // Compared field by field, the struct has tail padding
+            uint64_t expectedFields[] = { expected.m_ChangedPixels, expected.m_RepeatPixels, expected.m_ComparedPixels, expected.m_GradientSum,
+                expected.m_ColourBits[0], expected.m_ColourBits[1], expected.m_ColourBits[2], expected.m_ColourBits[3], expected.m_ColourCount };
+            uint64_t actualFields[] = { actual.m_ChangedPixels, actual.m_RepeatPixels, actual.m_ComparedPixels, actual.m_GradientSum,
+                actual.m_ColourBits[0], actual.m_ColourBits[1], actual.m_ColourBits[2], actual.m_ColourBits[3], actual.m_ColourCount };
+
+            if (!CompareBytes("AccumulateTileRow", reinterpret_cast<uint8_t*>(expectedFields), reinterpret_cast<uint8_t*>(actualFields), sizeof(expectedFields), 0))
+                return false;
+        }
+
+        return true;
+    }
+
+    bool CheckHashRow(const PixelKernels& reference, const PixelKernels& kernels, std::mt19937& rng)
+    {
+        for (uint32_t width : ConformanceWidths)
+        {
+            std::vector<uint8_t> row = MakeRandomBytes(rng, width * 4);
+            const uint32_t* pixels = reinterpret_cast<const uint32_t*>(row.data());
+
+            uint64_t expected = reference.m_HashRow(pixels, width);
+            uint64_t actual = kernels.m_HashRow(pixels, width);
+
+            if (!CompareBytes("HashRow", reinterpret_cast<uint8_t*>(&expected), reinterpret_cast<uint8_t*>(&actual), sizeof(expected), 0))
+                return false;
+        }
+
+        return true;
+    }
+
+    bool CheckPngRows(const PixelKernels& reference, const PixelKernels& kernels, std::mt19937& rng)
+    {
+        using Filter = PixelKernels::PngFilterFn PixelKernels::*;
+        constexpr std::pair<const char*, Filter> filters[] = {
+            { "PngFilterSub", &PixelKernels::m_PngFilterSub },
+            { "PngFilterUp", &PixelKernels::m_PngFilterUp },
+            { "PngFilterPaeth", &PixelKernels::m_PngFilterPaeth },
+        };
+
+        for (uint32_t width : ConformanceWidths)
+        {
+            std::vector<uint8_t> src = MakeRandomBytes(rng, width * 4);
+            std::vector<uint8_t> expected(width * Kernels::PngBytesPerPixel);
+            std::vector<uint8_t> actual(expected.size());
+
+            reference.m_PackRgbRow(reinterpret_cast<const uint32_t*>(src.data()), expected.data(), width);
+            kernels.m_PackRgbRow(reinterpret_cast<const uint32_t*>(src.data()), actual.data(), width);
+            if (!CompareBytes("PackRgbRow", expected.data(), actual.data(), expected.size(), 0))
+                return false;
+
+            // Half the rows are near their previous row, like real screen content
+            std::vector<uint8_t> previous = MakeRandomBytes(rng, expected.size());
+            std::vector<uint8_t> row = MakeRandomBytes(rng, expected.size());
+            if (rng() % 2 == 0)
+            {
+                for (size_t i = 0; i < row.size(); ++i)
+                    row[i] = static_cast<uint8_t>(previous[i] + rng() % 5 - 2);
+            }
+
+            for (const auto& [name, filter] : filters)
+            {
+                uint32_t costs[2] = { (reference.*filter)(row.data(), previous.data(), expected.data(), static_cast<uint32_t>(row.size())),
+                    (kernels.*filter)(row.data(), previous.data(), actual.data(), static_cast<uint32_t>(row.size())) };
+
+                if (!CompareBytes(name, expected.data(), actual.data(), expected.size(), 0) ||
+                    !CompareBytes(name, reinterpret_cast<uint8_t*>(&costs[0]), reinterpret_cast<uint8_t*>(&costs[1]), sizeof(costs[0]), 0))
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool CheckBlendPremultipliedRow(const PixelKernels& reference, const PixelKernels& kernels, std::mt19937& rng)
+    {
+        for (uint32_t width : ConformanceWidths)
+        {
+            // Valid premultiplied pixels never have a channel above alpha, but the kernels
+            // must still saturate on ones that do, so mix both
+            std::vector<uint8_t> src = MakeRandomBytes(rng, width * 4);
+            for (size_t i = 0; i < src.size(); i += 4)
+            {
+                uint8_t alpha = rng() % 4 == 0 ? (rng() % 2 == 0 ? 0 : 255) : src[i + 3];
+                src[i + 3] = alpha;
+
+                if (rng() % 8 != 0)
+                {
+                    for (size_t c = 0; c < 3; ++c)
+                        src[i + c] = static_cast<uint8_t>(src[i + c] * alpha / 255);
+                }
+            }
+
+            std::vector<uint8_t> expected = MakeRandomBytes(rng, width * 4);
+            std::vector<uint8_t> actual = expected;
+
+            reference.m_BlendPremultipliedRow(reinterpret_cast<const uint32_t*>(src.data()), reinterpret_cast<uint32_t*>(expected.data()), width);
+            kernels.m_BlendPremultipliedRow(reinterpret_cast<const uint32_t*>(src.data()), reinterpret_cast<uint32_t*>(actual.data()), width);
+
+            if (!CompareBytes("BlendPremultipliedRow", expected.data(), actual.data(), expected.size(), 0))
+                return false;
+        }
+
+        return true;
+    }
+
+    bool CheckMatchRow(const PixelKernels& reference, const PixelKernels& kernels, std::mt19937& rng)
+    {
+        for (uint32_t width : ConformanceWidths)
+        {
+            // The reference row is the row plus noise, with a few pixels pushed further out
+            // so the matching runs end at varying positions
+            std::vector<uint8_t> row = MakeRandomBytes(rng, width * 4);
+            std::vector<uint8_t> target = row;
+            const uint32_t tolerance = rng() % 4 == 0 ? 0 : rng() % 16;
+
+            for (size_t i = 0; i < target.size(); ++i)
+                target[i] = static_cast<uint8_t>(std::clamp<int>(target[i] + static_cast<int>(rng() % (2 * tolerance + 1)) - static_cast<int>(tolerance), 0, 255));
+
+            for (uint32_t outliers = rng() % 3; outliers > 0; --outliers)
+            {
+                size_t i = rng() % target.size();
+                target[i] = static_cast<uint8_t>(target[i] + tolerance + 1 + rng() % 64);
+            }
+
+            const uint32_t* pixels = reinterpret_cast<const uint32_t*>(row.data());
+            const uint32_t* targets = reinterpret_cast<const uint32_t*>(target.data());
+            uint32_t lengths[4] = {
+                reference.m_MatchRowPrefix(pixels, targets, width, tolerance), kernels.m_MatchRowPrefix(pixels, targets, width, tolerance),
+                reference.m_MatchRowSuffix(pixels, targets, width, tolerance), kernels.m_MatchRowSuffix(pixels, targets, width, tolerance) };
+
+            if (!CompareBytes("MatchRowPrefix", reinterpret_cast<uint8_t*>(&lengths[0]), reinterpret_cast<uint8_t*>(&lengths[1]), sizeof(lengths[0]), 0) ||
+                !CompareBytes("MatchRowSuffix", reinterpret_cast<uint8_t*>(&lengths[2]), reinterpret_cast<uint8_t*>(&lengths[3]), sizeof(lengths[0]), 0))
+                return false;
+        }
+
+        return true;
+    }
+
+    bool CheckMapPaletteRow(const PixelKernels& reference, const PixelKernels& kernels, std::mt19937& rng)
+    {
+        // Heap allocated, the table is 8 KB
+        auto table = std::make_unique<Kernels::PaletteTable>();
+
+        for (uint32_t width : ConformanceWidths)
+        {
+            // Few colours in runs, or up to a full palette, which collides more
+            const uint32_t colourCount = rng() % 2 == 0 ? 1 + rng() % 8 : 256;
+            std::vector<uint32_t> colours(colourCount);
+            for (uint32_t& colour : colours)
+                colour = static_cast<uint32_t>(rng());
+
+            std::fill(std::begin(table->m_Indices), std::end(table->m_Indices), Kernels::PaletteEmptySlot);
+            for (uint32_t i = 0; i < colourCount; ++i)
+            {
+                uint32_t slot = Kernels::GetPaletteSlot(colours[i]);
+                while (table->m_Indices[slot] != Kernels::PaletteEmptySlot && table->m_Colours[slot] != colours[i])
+                    slot = (slot + 1) & (Kernels::PaletteTableSize - 1);
+
+                if (table->m_Indices[slot] == Kernels::PaletteEmptySlot)
+                {
+                    table->m_Colours[slot] = colours[i];
+                    table->m_Indices[slot] = i;
+                }
+            }
+
+            std::vector<uint32_t> row(width);
+            for (uint32_t x = 0; x < width; ++x)
+                row[x] = x > 0 && rng() % 2 == 0 ? row[x - 1] : colours[rng() % colourCount];
+
+            std::vector<uint8_t> expected(width);
+            std::vector<uint8_t> actual(width);
+
+            reference.m_MapPaletteRow(*table, row.data(), expected.data(), width);
+            kernels.m_MapPaletteRow(*table, row.data(), actual.data(), width);
+
+            if (!CompareBytes("MapPaletteRow", expected.data(), actual.data(), expected.size(), 0))
+                return false;
+        }
+
+        return true;
+    }
+
+    bool CheckEdgeRows(const PixelKernels& reference, const PixelKernels& kernels, std::mt19937& rng)
+    {
+        for (uint32_t width : ConformanceWidths)
+        {
+            std::vector<uint8_t> src = MakeRandomBytes(rng, width * 4);
+            std::vector<uint8_t> expected(width);
+            std::vector<uint8_t> actual(width);
+
+            reference.m_LumaRow(reinterpret_cast<const uint32_t*>(src.data()), expected.data(), width);
+            kernels.m_LumaRow(reinterpret_cast<const uint32_t*>(src.data()), actual.data(), width);
+            if (!CompareBytes("LumaRow", expected.data(), actual.data(), width, 0))
+                return false;
+
+            const uint8_t threshold = static_cast<uint8_t>(rng());
+            std::vector<uint64_t> expectedBits((width + 63) / 64);
+            std::vector<uint64_t> actualBits(expectedBits.size());
+
+            reference.m_ThresholdRow(src.data(), expectedBits.data(), width, threshold);
+            kernels.m_ThresholdRow(src.data(), actualBits.data(), width, threshold);
+            if (!CompareBytes("ThresholdRow", reinterpret_cast<uint8_t*>(expectedBits.data()), reinterpret_cast<uint8_t*>(actualBits.data()), expectedBits.size() * 8, 0))
+                return false;
+
+            // Sobel reads one pixel either side of the count it writes
+            if (width < 3)
+                continue;
+
+            std::vector<uint8_t> rows = MakeRandomBytes(rng, width * 3);
+            std::vector<uint8_t> expectedX(width - 2), expectedY(width - 2);
+            std::vector<uint8_t> actualX(width - 2), actualY(width - 2);
+
+            reference.m_SobelRow(rows.data() + 1, rows.data() + width + 1, rows.data() + 2 * width + 1, expectedX.data(), expectedY.data(), width - 2);
+            kernels.m_SobelRow(rows.data() + 1, rows.data() + width + 1, rows.data() + 2 * width + 1, actualX.data(), actualY.data(), width - 2);
+
+            if (!CompareBytes("SobelRow", expectedX.data(), actualX.data(), width - 2, 0) ||
+                !CompareBytes("SobelRow", expectedY.data(), actualY.data(), width - 2, 0))
+                return false;
+        }
+
+        return true;
+    }
+}
+
+const Takoyaki::PixelKernels& Takoyaki::GetPixelKernels()
+{
+    static const PixelKernels kernels = BindPixelKernels(GetSimdLevel());
+    return kernels;
+}
+
+Takoyaki::PixelKernels Takoyaki::BindPixelKernels(SimdLevel level)
+{
+    PixelKernels kernels;
+    kernels.m_Level = std::min(level, DetectSimdLevel());
+
+    BindScalar(kernels);
+
+#if TAKOYAKI_X86
+    if (kernels.m_Level >= SimdLevel::Sse2)
+        BindSse2(kernels);
+    if (kernels.m_Level >= SimdLevel::Sse41)
+        BindSse41(kernels);
+    if (kernels.m_Level >= SimdLevel::Avx2)
+        BindAvx2(kernels);
+    if (kernels.m_Level >= SimdLevel::Avx512)
+        BindAvx512(kernels);
+#endif
+
+    return kernels;
+}
+
+bool Takoyaki::CheckPixelKernelConformance(SimdLevel level)
+{
+    PixelKernels reference = BindPixelKernels(SimdLevel::Scalar);
+    PixelKernels kernels = BindPixelKernels(level);
+
+    // Fixed seed so that a failure reproduces on the next run
+    std::mt19937 rng(0x74616B6F);
+
+    bool isConformant = true;
+    isConformant &= CheckTonemapFloat16Row(reference, kernels, rng);
+    isConformant &= CheckTonemap10BitRow(reference, kernels, rng);
+    isConformant &= CheckBoxBlur(reference, kernels, rng);
+    isConformant &= CheckPixelateBand(reference, kernels, rng);
+    isConformant &= CheckAccumulateTileRow(reference, kernels, rng);
+    isConformant &= CheckHashRow(reference, kernels, rng);
+    isConformant &= CheckPngRows(reference, kernels, rng);
+    isConformant &= CheckBlendPremultipliedRow(reference, kernels, rng);
+    isConformant &= CheckMatchRow(reference, kernels, rng);
+    isConformant &= CheckMapPaletteRow(reference, kernels, rng);
+    isConformant &= CheckEdgeRows(reference, kernels, rng);
+
+    printf("Takoyaki: pixel kernels at %s %s\n", GetSimdLevelName(kernels.m_Level), isConformant ? "match the scalar reference" : "do NOT match the scalar reference");
+    return isConformant;
+}
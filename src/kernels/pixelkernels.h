@@ -0,0 +1,89 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "cpufeatures.h"
+#include "cropkernels.h"
+#include "cursorkernels.h"
+#include "edgekernels.h"
+#include "hashkernels.h"
+#include "maskkernels.h"
+#include "palettekernels.h"
+#include "pngkernels.h"
+#include "tilekernels.h"
+#include "tonemapkernels.h"
+
+namespace Takoyaki
+{
+    // Function table for every SIMD pixel kernel. Each entry starts as the scalar reference
+    // and is overridden by each instruction set level in turn, up to the bound level, so a
+    // kernel without a variant for some level keeps the best one below it.
+    struct PixelKernels
+    {
+        using TonemapFloat16RowFn = void(*)(const uint16_t* src, uint32_t* dst, uint32_t width, const uint8_t* encodeLut);
+        using Tonemap10BitRowFn = void(*)(const uint32_t* src, uint32_t* dst, uint32_t width, const float* decodeLut, const float* matrix, const uint8_t* encodeLut);
+        using BoxBlurRowFn = void(*)(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t radius, uint16_t bias, uint16_t reciprocal);
+        using BoxBlurAccumulateFn = void(*)(uint16_t* sums, const uint8_t* add, const uint8_t* sub, uint32_t count);
+        using BoxBlurEmitFn = void(*)(const uint16_t* sums, uint8_t* dst, uint32_t count, uint16_t bias, uint16_t reciprocal);
+        using PixelateBandFn = void(*)(uint8_t* data, uint32_t stride, uint32_t width, uint32_t rows, uint32_t blockSize);
+        using HashRowFn = uint64_t(*)(const uint32_t* row, uint32_t width);
+        using AccumulateTileRowFn = void(*)(const uint32_t* row, const uint32_t* previous, uint32_t width, bool countColours, Kernels::TileStats& stats);
+        using PackRgbRowFn = void(*)(const uint32_t* src, uint8_t* dst, uint32_t width);
+        using PngFilterFn = uint32_t(*)(const uint8_t* row, const uint8_t* previous, uint8_t* dst, uint32_t size);
+        using BlendPremultipliedRowFn = void(*)(const uint32_t* src, uint32_t* dst, uint32_t width);
+        using MatchRowFn = uint32_t(*)(const uint32_t* row, const uint32_t* reference, uint32_t width, uint32_t tolerance);
+        using MapPaletteRowFn = void(*)(const Kernels::PaletteTable& table, const uint32_t* row, uint8_t* dst, uint32_t width);
+        using LumaRowFn = void(*)(const uint32_t* src, uint8_t* dst, uint32_t width);
+        using SobelRowFn = void(*)(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* gradientX, uint8_t* gradientY, uint32_t count);
+        using ThresholdRowFn = void(*)(const uint8_t* src, uint64_t* bits, uint32_t width, uint8_t threshold);
+
+        SimdLevel m_Level = SimdLevel::Scalar;
+
+        TonemapFloat16RowFn m_TonemapFloat16Row = nullptr;
+        Tonemap10BitRowFn m_Tonemap10BitRow = nullptr;
+        BoxBlurRowFn m_BoxBlurRow = nullptr;
+        BoxBlurAccumulateFn m_BoxBlurAccumulate = nullptr;
+        BoxBlurEmitFn m_BoxBlurEmit = nullptr;
+        PixelateBandFn m_PixelateBand = nullptr;
+        AccumulateTileRowFn m_AccumulateTileRow = nullptr;
+        HashRowFn m_HashRow = nullptr;
+        PackRgbRowFn m_PackRgbRow = nullptr;
+        PngFilterFn m_PngFilterSub = nullptr;
+        PngFilterFn m_PngFilterUp = nullptr;
+        PngFilterFn m_PngFilterPaeth = nullptr;
+        BlendPremultipliedRowFn m_BlendPremultipliedRow = nullptr;
+        MatchRowFn m_MatchRowPrefix = nullptr;
+        MatchRowFn m_MatchRowSuffix = nullptr;
+        MapPaletteRowFn m_MapPaletteRow = nullptr;
+        LumaRowFn m_LumaRow = nullptr;
+        SobelRowFn m_SobelRow = nullptr;
+        ThresholdRowFn m_ThresholdRow = nullptr;
+    };
+
+    // Kernels bound to GetSimdLevel(), resolved once on first use
+    const PixelKernels& GetPixelKernels();
+
+    // Kernels bound to a specific level, clamped to what this build and CPU support
+    PixelKernels BindPixelKernels(SimdLevel level);
+
+    // Runs every kernel variant at the given level against the scalar reference on random
+    // frames, printing each mismatch. Returns true if all variants agree.
+    bool CheckPixelKernelConformance(SimdLevel level);
+}
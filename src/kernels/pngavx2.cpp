@@ -0,0 +1,165 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Compiled with AVX2, FMA and F16C enabled. Only call through PixelKernels.
+
+#include "pngkernels.h"
+
+#include <cstdlib>
+#include <immintrin.h>
+
+namespace
+{
+    using namespace Takoyaki::Kernels;
+
+    // Sum of min(v, 256 - v) over the bytes, as four 64-bit quarters
+    inline __m256i GetCost(__m256i filtered)
+    {
+        __m256i magnitude = _mm256_min_epu8(filtered, _mm256_sub_epi8(_mm256_setzero_si256(), filtered));
+        return _mm256_sad_epu8(magnitude, _mm256_setzero_si256());
+    }
+
+    inline uint32_t FoldCost(__m256i cost)
+    {
+        __m128i folded = _mm_add_epi64(_mm256_castsi256_si128(cost), _mm256_extracti128_si256(cost, 1));
+        return static_cast<uint32_t>(_mm_cvtsi128_si32(folded) + _mm_extract_epi32(folded, 2));
+    }
+
+    inline __m256i PaethPredict(__m256i a, __m256i b, __m256i c)
+    {
+        __m256i pa = _mm256_abs_epi16(_mm256_sub_epi16(b, c));
+        __m256i pb = _mm256_abs_epi16(_mm256_sub_epi16(a, c));
+        __m256i pc = _mm256_abs_epi16(_mm256_add_epi16(_mm256_sub_epi16(b, c), _mm256_sub_epi16(a, c)));
+
+        __m256i notA = _mm256_or_si256(_mm256_cmpgt_epi16(pa, pb), _mm256_cmpgt_epi16(pa, pc));
+        __m256i notB = _mm256_cmpgt_epi16(pb, pc);
+
+        return _mm256_blendv_epi8(a, _mm256_blendv_epi8(b, c, notB), notA);
+    }
+}
+
+void Takoyaki::Kernels::PackRgbRowAvx2(const uint32_t* src, uint8_t* dst, uint32_t width)
+{
+    const __m256i shuffle = _mm256_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i compact = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+    uint32_t x = 0;
+
+    // Each store writes 32 bytes of which only 24 are kept, so stop while there is room
+    for (; x + 11 <= width; x += 8)
+    {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+        __m256i packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(pixels, shuffle), compact);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 3), packed);
+    }
+
+    PackRgbRowScalar(src + x, dst + x * 3, width - x);
+}
+
+uint32_t Takoyaki::Kernels::PngFilterSubAvx2(const uint8_t* row, const uint8_t* previous, uint8_t* dst, uint32_t size)
+{
+    if (size < PngBytesPerPixel + 32)
+        return PngFilterSubScalar(row, previous, dst, size);
+
+    uint32_t cost = PngFilterSubScalar(row, previous, dst, PngBytesPerPixel);
+    __m256i costs = _mm256_setzero_si256();
+    uint32_t i = PngBytesPerPixel;
+
+    for (; i + 32 <= size; i += 32)
+    {
+        __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+        __m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i - PngBytesPerPixel));
+        __m256i filtered = _mm256_sub_epi8(current, left);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), filtered);
+        costs = _mm256_add_epi64(costs, GetCost(filtered));
+    }
+
+    for (; i < size; ++i)
+    {
+        dst[i] = static_cast<uint8_t>(row[i] - row[i - PngBytesPerPixel]);
+        cost += GetFilteredByteCost(dst[i]);
+    }
+
+    return cost + FoldCost(costs);
+}
+
+uint32_t Takoyaki::Kernels::PngFilterUpAvx2(const uint8_t* row, const uint8_t* previous, uint8_t* dst, uint32_t size)
+{
+    __m256i costs = _mm256_setzero_si256();
+    uint32_t i = 0;
+
+    for (; i + 32 <= size; i += 32)
+    {
+        __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+        __m256i above = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(previous + i));
+        __m256i filtered = _mm256_sub_epi8(current, above);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), filtered);
+        costs = _mm256_add_epi64(costs, GetCost(filtered));
+    }
+
+    return PngFilterUpScalar(row + i, previous + i, dst + i, size - i) + FoldCost(costs);
+}
+
+uint32_t Takoyaki::Kernels::PngFilterPaethAvx2(const uint8_t* row, const uint8_t* previous, uint8_t* dst, uint32_t size)
+{
+    if (size < PngBytesPerPixel + 32)
+        return PngFilterPaethScalar(row, previous, dst, size);
+
+    uint32_t cost = PngFilterPaethScalar(row, previous, dst, PngBytesPerPixel);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i costs = zero;
+    uint32_t i = PngBytesPerPixel;
+
+    // The unpacks and the pack all work per 128-bit lane, so bytes come back in order
+    for (; i + 32 <= size; i += 32)
+    {
+        __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i - PngBytesPerPixel));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(previous + i));
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(previous + i - PngBytesPerPixel));
+
+        __m256i predictLo = PaethPredict(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero), _mm256_unpacklo_epi8(c, zero));
+        __m256i predictHi = PaethPredict(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero), _mm256_unpackhi_epi8(c, zero));
+        __m256i filtered = _mm256_sub_epi8(current, _mm256_packus_epi16(predictLo, predictHi));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), filtered);
+        costs = _mm256_add_epi64(costs, GetCost(filtered));
+    }
+
+    for (; i < size; ++i)
+    {
+        int32_t a = row[i - PngBytesPerPixel];
+        int32_t b = previous[i];
+        int32_t c = previous[i - PngBytesPerPixel];
+
+        int32_t pa = std::abs(b - c);
+        int32_t pb = std::abs(a - c);
+        int32_t pc = std::abs(a + b - 2 * c);
+        int32_t predictor = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+
+        dst[i] = static_cast<uint8_t>(row[i] - predictor);
+        cost += GetFilteredByteCost(dst[i]);
+    }
+
+    return cost + FoldCost(costs);
+}
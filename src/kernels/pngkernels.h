@@ -0,0 +1,54 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+
+namespace Takoyaki::Kernels
+{
+    // Screenshots are written as 8-bit RGB, captured alpha is not meaningful
+    static constexpr uint32_t PngBytesPerPixel = 3;
+
+    // BGRA pixels to packed RGB bytes
+    void PackRgbRowScalar(const uint32_t* src, uint8_t* dst, uint32_t width);
+    void PackRgbRowSse41(const uint32_t* src, uint8_t* dst, uint32_t width);
+    void PackRgbRowAvx2(const uint32_t* src, uint8_t* dst, uint32_t width);
+
+    // PNG row filters over size bytes of packed RGB, with previous being the unfiltered row
+    // above (all zero for the first row). Each returns the sum of the filtered bytes taken
+    // as signed magnitudes, the usual heuristic for which filter will compress best.
+    uint32_t PngFilterSubScalar(const uint8_t* row, const uint8_t* previous, uint8_t* dst, uint32_t size);
+    uint32_t PngFilterSubSse41(const uint8_t* row, const uint8_t* previous, uint8_t* dst, uint32_t size);
+    uint32_t PngFilterSubAvx2(const uint8_t* row, const uint8_t* previous, uint8_t* dst, uint32_t size);
+
+    uint32_t PngFilterUpScalar(const uint8_t* row, const uint8_t* previous, uint8_t* dst, uint32_t size);
+    uint32_t PngFilterUpSse41(const uint8_t* row, const uint8_t* previous, uint8_t* dst, uint32_t size);
+    uint32_t PngFilterUpAvx2(const uint8_t* row, const uint8_t* previous, uint8_t* dst, uint32_t size);
+
+    uint32_t PngFilterPaethScalar(const uint8_t* row, const uint8_t* previous, uint8_t* dst, uint32_t size);
+    uint32_t PngFilterPaethSse41(const uint8_t* row, const uint8_t* previous, uint8_t* dst, uint32_t size);
+    uint32_t PngFilterPaethAvx2(const uint8_t* row, const uint8_t* previous, uint8_t* dst, uint32_t size);
+
+    inline uint32_t GetFilteredByteCost(uint8_t value)
+    {
+        return value < 128 ? value : 256 - value;
+    }
+}
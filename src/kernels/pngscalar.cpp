@@ -0,0 +1,82 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "pngkernels.h"
+
+#include <cstdlib>
+
+void Takoyaki::Kernels::PackRgbRowScalar(const uint32_t* src, uint8_t* dst, uint32_t width)
+{
+    for (uint32_t x = 0; x < width; ++x)
+    {
+        dst[x * 3 + 0] = static_cast<uint8_t>(src[x] >> 16);
+        dst[x * 3 + 1] = static_cast<uint8_t>(src[x] >> 8);
+        dst[x * 3 + 2] = static_cast<uint8_t>(src[x]);
+    }
+}
+
+uint32_t Takoyaki::Kernels::PngFilterSubScalar(const uint8_t* row, const uint8_t*, uint8_t* dst, uint32_t size)
+{
+    uint32_t cost = 0;
+
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        uint8_t left = i >= PngBytesPerPixel ? row[i - PngBytesPerPixel] : 0;
+        dst[i] = static_cast<uint8_t>(row[i] - left);
+        cost += GetFilteredByteCost(dst[i]);
+    }
+
+    return cost;
+}
+
+uint32_t Takoyaki::Kernels::PngFilterUpScalar(const uint8_t* row, const uint8_t* previous, uint8_t* dst, uint32_t size)
+{
+    uint32_t cost = 0;
+
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        dst[i] = static_cast<uint8_t>(row[i] - previous[i]);
+        cost += GetFilteredByteCost(dst[i]);
+    }
+
+    return cost;
+}
+
+uint32_t Takoyaki::Kernels::PngFilterPaethScalar(const uint8_t* row, const uint8_t* previous, uint8_t* dst, uint32_t size)
+{
+    uint32_t cost = 0;
+
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        int32_t a = i >= PngBytesPerPixel ? row[i - PngBytesPerPixel] : 0;
+        int32_t b = previous[i];
+        int32_t c = i >= PngBytesPerPixel ? previous[i - PngBytesPerPixel] : 0;
+
+        int32_t pa = std::abs(b - c);
+        int32_t pb = std::abs(a - c);
+        int32_t pc = std::abs(a + b - 2 * c);
+        int32_t predictor = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+
+        dst[i] = static_cast<uint8_t>(row[i] - predictor);
+        cost += GetFilteredByteCost(dst[i]);
+    }
+
+    return cost;
+}
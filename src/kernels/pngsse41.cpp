@@ -0,0 +1,160 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Compiled with SSE4.1 enabled. Only call through PixelKernels.
+
+#include "pngkernels.h"
+
+#include <cstdlib>
+#include <smmintrin.h>
+
+namespace
+{
+    using namespace Takoyaki::Kernels;
+
+    // Sum of min(v, 256 - v) over the bytes, as two 64-bit halves
+    inline __m128i GetCost(__m128i filtered)
+    {
+        __m128i magnitude = _mm_min_epu8(filtered, _mm_sub_epi8(_mm_setzero_si128(), filtered));
+        return _mm_sad_epu8(magnitude, _mm_setzero_si128());
+    }
+
+    inline uint32_t FoldCost(__m128i cost)
+    {
+        return static_cast<uint32_t>(_mm_cvtsi128_si32(cost) + _mm_extract_epi32(cost, 2));
+    }
+
+    inline __m128i PaethPredict(__m128i a, __m128i b, __m128i c)
+    {
+        __m128i pa = _mm_abs_epi16(_mm_sub_epi16(b, c));
+        __m128i pb = _mm_abs_epi16(_mm_sub_epi16(a, c));
+        __m128i pc = _mm_abs_epi16(_mm_add_epi16(_mm_sub_epi16(b, c), _mm_sub_epi16(a, c)));
+
+        __m128i notA = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+        __m128i notB = _mm_cmpgt_epi16(pb, pc);
+
+        return _mm_blendv_epi8(a, _mm_blendv_epi8(b, c, notB), notA);
+    }
+}
+
+void Takoyaki::Kernels::PackRgbRowSse41(const uint32_t* src, uint8_t* dst, uint32_t width)
+{
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    uint32_t x = 0;
+
+    // Each store writes 16 bytes of which only 12 are kept, so stop while there is room
+    for (; x + 6 <= width; x += 4)
+    {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 3), _mm_shuffle_epi8(pixels, shuffle));
+    }
+
+    PackRgbRowScalar(src + x, dst + x * 3, width - x);
+}
+
+uint32_t Takoyaki::Kernels::PngFilterSubSse41(const uint8_t* row, const uint8_t* previous, uint8_t* dst, uint32_t size)
+{
+    if (size < PngBytesPerPixel + 16)
+        return PngFilterSubScalar(row, previous, dst, size);
+
+    uint32_t cost = PngFilterSubScalar(row, previous, dst, PngBytesPerPixel);
+    __m128i costs = _mm_setzero_si128();
+    uint32_t i = PngBytesPerPixel;
+
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        __m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i - PngBytesPerPixel));
+        __m128i filtered = _mm_sub_epi8(current, left);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), filtered);
+        costs = _mm_add_epi64(costs, GetCost(filtered));
+    }
+
+    for (; i < size; ++i)
+    {
+        dst[i] = static_cast<uint8_t>(row[i] - row[i - PngBytesPerPixel]);
+        cost += GetFilteredByteCost(dst[i]);
+    }
+
+    return cost + FoldCost(costs);
+}
+
+uint32_t Takoyaki::Kernels::PngFilterUpSse41(const uint8_t* row, const uint8_t* previous, uint8_t* dst, uint32_t size)
+{
+    __m128i costs = _mm_setzero_si128();
+    uint32_t i = 0;
+
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        __m128i above = _mm_loadu_si128(reinterpret_cast<const __m128i*>(previous + i));
+        __m128i filtered = _mm_sub_epi8(current, above);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), filtered);
+        costs = _mm_add_epi64(costs, GetCost(filtered));
+    }
+
+    return PngFilterUpScalar(row + i, previous + i, dst + i, size - i) + FoldCost(costs);
+}
+
+uint32_t Takoyaki::Kernels::PngFilterPaethSse41(const uint8_t* row, const uint8_t* previous, uint8_t* dst, uint32_t size)
+{
+    if (size < PngBytesPerPixel + 16)
+        return PngFilterPaethScalar(row, previous, dst, size);
+
+    // The first pixel has no left neighbour, after that every byte only depends on raw input
+    uint32_t cost = PngFilterPaethScalar(row, previous, dst, PngBytesPerPixel);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i costs = zero;
+    uint32_t i = PngBytesPerPixel;
+
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i - PngBytesPerPixel));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(previous + i));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(previous + i - PngBytesPerPixel));
+
+        __m128i predictLo = PaethPredict(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero));
+        __m128i predictHi = PaethPredict(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero));
+        __m128i filtered = _mm_sub_epi8(current, _mm_packus_epi16(predictLo, predictHi));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), filtered);
+        costs = _mm_add_epi64(costs, GetCost(filtered));
+    }
+
+    for (; i < size; ++i)
+    {
+        int32_t a = row[i - PngBytesPerPixel];
+        int32_t b = previous[i];
+        int32_t c = previous[i - PngBytesPerPixel];
+
+        int32_t pa = std::abs(b - c);
+        int32_t pb = std::abs(a - c);
+        int32_t pc = std::abs(a + b - 2 * c);
+        int32_t predictor = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+
+        dst[i] = static_cast<uint8_t>(row[i] - predictor);
+        cost += GetFilteredByteCost(dst[i]);
+    }
+
+    return cost + FoldCost(costs);
+}
@@ -0,0 +1,70 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+
+namespace Takoyaki::Kernels
+{
+    // Distinct colours stop being counted once a tile reaches this many, since past that
+    // point it is clearly not flat or UI and hashing more pixels is wasted work
+    static constexpr uint32_t TileColourCap = 64;
+
+    // Statistics for one tile, accumulated row by row. Alpha is ignored throughout.
+    struct TileStats
+    {
+        // Pixels that differ from the previous frame
+        uint32_t m_ChangedPixels = 0;
+
+        // Pixels equal to their left neighbour, out of every pixel that has one
+        uint32_t m_RepeatPixels = 0;
+        uint32_t m_ComparedPixels = 0;
+
+        // Sum over B, G and R of the absolute difference to the left neighbour
+        uint32_t m_GradientSum = 0;
+
+        // Colours of pixels starting a new run, hashed into a 256-bit set
+        uint64_t m_ColourBits[4] = {};
+        uint32_t m_ColourCount = 0;
+    };
+
+    inline void AddTileColour(TileStats& stats, uint32_t pixel)
+    {
+        if (stats.m_ColourCount >= TileColourCap)
+            return;
+
+        uint32_t bit = (pixel * 0x9E3779B1u) >> 24;
+        uint64_t mask = uint64_t(1) << (bit & 63);
+
+        if (!(stats.m_ColourBits[bit >> 6] & mask))
+        {
+            stats.m_ColourBits[bit >> 6] |= mask;
+            ++stats.m_ColourCount;
+        }
+    }
+
+    // Adds one row of a tile to its statistics. The first pixel of the row has no left
+    // neighbour and always starts a run. previous may be null when there is no prior frame.
+    // Colour hashing is the only per-run cost, so callers can skip it on some rows.
+    void AccumulateTileRowScalar(const uint32_t* row, const uint32_t* previous, uint32_t width, bool countColours, TileStats& stats);
+    void AccumulateTileRowSse2(const uint32_t* row, const uint32_t* previous, uint32_t width, bool countColours, TileStats& stats);
+    void AccumulateTileRowAvx2(const uint32_t* row, const uint32_t* previous, uint32_t width, bool countColours, TileStats& stats);
+}
@@ -0,0 +1,58 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "tilekernels.h"
+
+#include <cstdlib>
+
+void Takoyaki::Kernels::AccumulateTileRowScalar(const uint32_t* row, const uint32_t* previous, uint32_t width, bool countColours, TileStats& stats)
+{
+    if (width == 0)
+        return;
+
+    if (previous)
+        stats.m_ChangedPixels += ((row[0] ^ previous[0]) & 0x00FFFFFF) != 0;
+
+    if (countColours)
+        AddTileColour(stats, row[0] & 0x00FFFFFF);
+
+    for (uint32_t x = 1; x < width; ++x)
+    {
+        uint32_t pixel = row[x] & 0x00FFFFFF;
+        uint32_t left = row[x - 1] & 0x00FFFFFF;
+
+        if (previous)
+            stats.m_ChangedPixels += pixel != (previous[x] & 0x00FFFFFF);
+
+        if (pixel == left)
+        {
+            ++stats.m_RepeatPixels;
+            continue;
+        }
+
+        for (uint32_t shift = 0; shift < 24; shift += 8)
+            stats.m_GradientSum += std::abs(static_cast<int32_t>((pixel >> shift) & 0xFF) - static_cast<int32_t>((left >> shift) & 0xFF));
+
+        if (countColours)
+            AddTileColour(stats, pixel);
+    }
+
+    stats.m_ComparedPixels += width - 1;
+}
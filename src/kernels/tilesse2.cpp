@@ -0,0 +1,111 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Compiled with SSE2 enabled. Only call through PixelKernels.
+
+#include "tilekernels.h"
+
+#include <bit>
+#include <cstdlib>
+#include <emmintrin.h>
+
+namespace
+{
+    using namespace Takoyaki::Kernels;
+
+    // Adds 4 pixels compared against their left neighbours. Lanes in firstPixelMask have no
+    // left neighbour: they are not compared, but still start a run.
+    inline void AccumulatePixels(__m128i pixels, __m128i left, const uint32_t* row, const uint32_t* previous, __m128i colourMask,
+        uint32_t firstPixelMask, bool countColours, __m128i& gradient, TileStats& stats)
+    {
+        uint32_t same = static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(pixels, left)))) & ~firstPixelMask;
+        stats.m_RepeatPixels += std::popcount(same);
+        gradient = _mm_add_epi64(gradient, _mm_sad_epu8(pixels, left));
+
+        if (previous)
+        {
+            __m128i old = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(previous)), colourMask);
+            stats.m_ChangedPixels += 4 - std::popcount(static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(pixels, old)))));
+        }
+
+        if (countColours && stats.m_ColourCount < TileColourCap)
+        {
+            for (uint32_t runStarts = ~same & 0xF; runStarts; runStarts &= runStarts - 1)
+                AddTileColour(stats, row[std::countr_zero(runStarts)] & 0x00FFFFFF);
+        }
+    }
+}
+
+void Takoyaki::Kernels::AccumulateTileRowSse2(const uint32_t* row, const uint32_t* previous, uint32_t width, bool countColours, TileStats& outStats)
+{
+    // Work on a copy, the counters could otherwise alias the rows and be reloaded every step
+    TileStats stats = outStats;
+    const __m128i colourMask = _mm_set1_epi32(0x00FFFFFF);
+    __m128i gradient = _mm_setzero_si128();
+    uint32_t x = 0;
+
+    // The first vector gets its left neighbours by shifting itself, so the row is never read
+    // before its start. Every later one loads the row again one pixel behind.
+    if (width >= 4)
+    {
+        __m128i pixels = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row)), colourMask);
+        __m128i left = _mm_or_si128(_mm_slli_si128(pixels, 4), _mm_and_si128(pixels, _mm_set_epi32(0, 0, 0, -1)));
+        AccumulatePixels(pixels, left, row, previous, colourMask, 1, countColours, gradient, stats);
+        x = 4;
+    }
+
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128i pixels = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x)), colourMask);
+        __m128i left = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x - 1)), colourMask);
+        AccumulatePixels(pixels, left, row + x, previous ? previous + x : nullptr, colourMask, 0, countColours, gradient, stats);
+    }
+
+    stats.m_GradientSum += static_cast<uint32_t>(_mm_cvtsi128_si32(gradient) + _mm_cvtsi128_si32(_mm_srli_si128(gradient, 8)));
+
+    for (; x < width; ++x)
+    {
+        uint32_t pixel = row[x] & 0x00FFFFFF;
+
+        if (previous)
+            stats.m_ChangedPixels += pixel != (previous[x] & 0x00FFFFFF);
+
+        if (x != 0)
+        {
+            uint32_t left = row[x - 1] & 0x00FFFFFF;
+            if (pixel == left)
+            {
+                ++stats.m_RepeatPixels;
+                continue;
+            }
+
+            for (uint32_t shift = 0; shift < 24; shift += 8)
+                stats.m_GradientSum += std::abs(static_cast<int32_t>((pixel >> shift) & 0xFF) - static_cast<int32_t>((left >> shift) & 0xFF));
+        }
+
+        if (countColours)
+            AddTileColour(stats, pixel);
+    }
+
+    if (width != 0)
+        stats.m_ComparedPixels += width - 1;
+
+    outStats = stats;
+}
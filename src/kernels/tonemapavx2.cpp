@@ -0,0 +1,126 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Compiled with AVX2, FMA and F16C enabled. Only call through PixelKernels.
+
+#include "tonemapkernels.h"
+#include <algorithm>
+#include <immintrin.h>
+
+namespace
+{
+    // Looks up 8 table indices. The table is read 32 bits at a time at byte granularity,
+    // which is why the encode table is padded, and only the low byte is kept.
+    inline __m256i GatherEncode(const uint8_t* encodeLut, __m256i indices)
+    {
+        __m256i values = _mm256_i32gather_epi32(reinterpret_cast<const int*>(encodeLut), indices, 1);
+        return _mm256_and_si256(values, _mm256_set1_epi32(0xFF));
+    }
+
+    // Packs four registers of 8 channel bytes (RGBA of 2 pixels each) into 8 BGRA pixels
+    inline __m256i PackRgbaToBgra(__m256i p01, __m256i p23, __m256i p45, __m256i p67)
+    {
+        // 32 to 16 to 8 bit packs interleave 128-bit lanes, leaving pixels ordered 0 2 4 6 1 3 5 7
+        __m256i words0 = _mm256_packus_epi32(p01, p23);
+        __m256i words1 = _mm256_packus_epi32(p45, p67);
+        __m256i bytes = _mm256_packus_epi16(words0, words1);
+        bytes = _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+
+        const __m256i swapRedBlue = _mm256_setr_epi8(
+            2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+            2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+        bytes = _mm256_shuffle_epi8(bytes, swapRedBlue);
+        return _mm256_or_si256(bytes, _mm256_set1_epi32(static_cast<int>(0xFF000000)));
+    }
+}
+
+void Takoyaki::Kernels::TonemapFloat16RowAvx2(const uint16_t* src, uint32_t* dst, uint32_t width, const uint8_t* encodeLut)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    uint32_t x = 0;
+
+    for (; x + 8 <= width; x += 8)
+    {
+        // Negative halves are negative as int16 as well, so a signed max clamps them to +0
+        __m256i halves0 = _mm256_max_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src)), zero);
+        __m256i halves1 = _mm256_max_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 16)), zero);
+
+        __m256i p01 = GatherEncode(encodeLut, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(halves0)));
+        __m256i p23 = GatherEncode(encodeLut, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(halves0, 1)));
+        __m256i p45 = GatherEncode(encodeLut, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(halves1)));
+        __m256i p67 = GatherEncode(encodeLut, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(halves1, 1)));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), PackRgbaToBgra(p01, p23, p45, p67));
+        src += 32;
+    }
+
+    TonemapFloat16RowScalar(src, dst + x, width - x, encodeLut);
+}
+
+void Takoyaki::Kernels::Tonemap10BitRowAvx2(const uint32_t* src, uint32_t* dst, uint32_t width, const float* decodeLut, const float* matrix, const uint8_t* encodeLut)
+{
+    const __m256i channelMask = _mm256_set1_epi32(0x3FF);
+    const __m256 zero = _mm256_setzero_ps();
+
+    __m256 m[9];
+    for (int i = 0; i < 9; ++i)
+        m[i] = _mm256_set1_ps(matrix[i]);
+
+    // Encode table indices of one chunk, for blue, green and red
+    alignas(32) uint16_t halves[3][TonemapChunkWidth];
+
+    const uint32_t vectorWidth = width & ~7u;
+
+    for (uint32_t chunk = 0; chunk < vectorWidth; chunk += TonemapChunkWidth)
+    {
+        const uint32_t count = std::min(TonemapChunkWidth, vectorWidth - chunk);
+
+        for (uint32_t x = 0; x < count; x += 8)
+        {
+            __m256i packed = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + chunk + x));
+
+            __m256 r = _mm256_i32gather_ps(decodeLut, _mm256_and_si256(packed, channelMask), 4);
+            __m256 g = _mm256_i32gather_ps(decodeLut, _mm256_and_si256(_mm256_srli_epi32(packed, 10), channelMask), 4);
+            __m256 b = _mm256_i32gather_ps(decodeLut, _mm256_and_si256(_mm256_srli_epi32(packed, 20), channelMask), 4);
+
+            __m256 outR = _mm256_fmadd_ps(m[2], b, _mm256_fmadd_ps(m[1], g, _mm256_mul_ps(m[0], r)));
+            __m256 outG = _mm256_fmadd_ps(m[5], b, _mm256_fmadd_ps(m[4], g, _mm256_mul_ps(m[3], r)));
+            __m256 outB = _mm256_fmadd_ps(m[8], b, _mm256_fmadd_ps(m[7], g, _mm256_mul_ps(m[6], r)));
+
+            // Out of gamut components go negative after the matrix, max with +0 as the second
+            // operand also turns -0 into +0 so the half bits are always a valid table index
+            _mm_store_si128(reinterpret_cast<__m128i*>(halves[0] + x), _mm256_cvtps_ph(_mm256_max_ps(outB, zero), _MM_FROUND_TO_NEAREST_INT));
+            _mm_store_si128(reinterpret_cast<__m128i*>(halves[1] + x), _mm256_cvtps_ph(_mm256_max_ps(outG, zero), _MM_FROUND_TO_NEAREST_INT));
+            _mm_store_si128(reinterpret_cast<__m128i*>(halves[2] + x), _mm256_cvtps_ph(_mm256_max_ps(outR, zero), _MM_FROUND_TO_NEAREST_INT));
+        }
+
+        for (uint32_t x = 0; x < count; x += 8)
+        {
+            __m256i bgra = GatherEncode(encodeLut, _mm256_cvtepu16_epi32(_mm_load_si128(reinterpret_cast<const __m128i*>(halves[0] + x))));
+            bgra = _mm256_or_si256(bgra, _mm256_slli_epi32(GatherEncode(encodeLut, _mm256_cvtepu16_epi32(_mm_load_si128(reinterpret_cast<const __m128i*>(halves[1] + x)))), 8));
+            bgra = _mm256_or_si256(bgra, _mm256_slli_epi32(GatherEncode(encodeLut, _mm256_cvtepu16_epi32(_mm_load_si128(reinterpret_cast<const __m128i*>(halves[2] + x)))), 16));
+            bgra = _mm256_or_si256(bgra, _mm256_set1_epi32(static_cast<int>(0xFF000000)));
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + chunk + x), bgra);
+        }
+    }
+
+    Tonemap10BitRowScalar(src + vectorWidth, dst + vectorWidth, width - vectorWidth, decodeLut, matrix, encodeLut);
+}
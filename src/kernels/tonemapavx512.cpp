@@ -0,0 +1,134 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Compiled with AVX-512 F/BW/DQ/VL enabled. Only call through PixelKernels.
+
+#include "tonemapkernels.h"
+#include <algorithm>
+#include <immintrin.h>
+
+// GCC implements the unmasked forms of most AVX-512 intrinsics with an undefined pass-through
+// source, which -Wmaybe-uninitialized reports once they are inlined. The masked forms below
+// give every lane explicitly and compile to the same instructions.
+
+namespace
+{
+    constexpr __mmask16 AllLanes = 0xFFFF;
+
+    inline __m512i GatherEncode(const uint8_t* encodeLut, __m512i indices)
+    {
+        __m512i values = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), AllLanes, indices, encodeLut, 1);
+        return _mm512_and_si512(values, _mm512_set1_epi32(0xFF));
+    }
+
+    inline __m512i WidenHalves(__m256i halves)
+    {
+        return _mm512_maskz_cvtepu16_epi32(AllLanes, halves);
+    }
+
+    inline __m256i NarrowToHalves(__m512 values, __m512 zero)
+    {
+        // Out of gamut components go negative after the matrix, max with +0 as the second
+        // operand also turns -0 into +0 so the half bits are always a valid table index
+        return _mm512_maskz_cvtps_ph(AllLanes, _mm512_maskz_max_ps(AllLanes, values, zero), _MM_FROUND_TO_NEAREST_INT);
+    }
+
+    inline __m512i ExtractChannel(__m512i packed, unsigned int shift)
+    {
+        return _mm512_and_si512(_mm512_maskz_srli_epi32(AllLanes, packed, shift), _mm512_set1_epi32(0x3FF));
+    }
+
+    inline __m512 GatherDecode(const float* decodeLut, __m512i indices)
+    {
+        return _mm512_mask_i32gather_ps(_mm512_setzero_ps(), AllLanes, indices, decodeLut, 4);
+    }
+}
+
+void Takoyaki::Kernels::TonemapFloat16RowAvx512(const uint16_t* src, uint32_t* dst, uint32_t width, const uint8_t* encodeLut)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    const __m256i swapRedBlue = _mm256_setr_epi8(
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    const __m256i opaque = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+
+    uint32_t x = 0;
+
+    for (; x + 8 <= width; x += 8)
+    {
+        __m512i halves = _mm512_max_epi16(_mm512_loadu_si512(src), zero);
+
+        // Narrowing straight from 32 to 8 bits keeps the channel order, unlike the AVX2 packs
+        __m128i p0123 = _mm512_maskz_cvtepi32_epi8(AllLanes, GatherEncode(encodeLut, WidenHalves(_mm512_maskz_extracti64x4_epi64(0xF, halves, 0))));
+        __m128i p4567 = _mm512_maskz_cvtepi32_epi8(AllLanes, GatherEncode(encodeLut, WidenHalves(_mm512_maskz_extracti64x4_epi64(0xF, halves, 1))));
+
+        __m256i bgra = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(p0123), p4567, 1), swapRedBlue);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_or_si256(bgra, opaque));
+        src += 32;
+    }
+
+    TonemapFloat16RowScalar(src, dst + x, width - x, encodeLut);
+}
+
+void Takoyaki::Kernels::Tonemap10BitRowAvx512(const uint32_t* src, uint32_t* dst, uint32_t width, const float* decodeLut, const float* matrix, const uint8_t* encodeLut)
+{
+    const __m512 zero = _mm512_setzero_ps();
+
+    __m512 m[9];
+    for (int i = 0; i < 9; ++i)
+        m[i] = _mm512_set1_ps(matrix[i]);
+
+    alignas(64) uint16_t halves[3][TonemapChunkWidth];
+
+    const uint32_t vectorWidth = width & ~15u;
+
+    for (uint32_t chunk = 0; chunk < vectorWidth; chunk += TonemapChunkWidth)
+    {
+        const uint32_t count = std::min(TonemapChunkWidth, vectorWidth - chunk);
+
+        for (uint32_t x = 0; x < count; x += 16)
+        {
+            __m512i packed = _mm512_loadu_si512(src + chunk + x);
+
+            __m512 r = GatherDecode(decodeLut, ExtractChannel(packed, 0));
+            __m512 g = GatherDecode(decodeLut, ExtractChannel(packed, 10));
+            __m512 b = GatherDecode(decodeLut, ExtractChannel(packed, 20));
+
+            __m512 outR = _mm512_fmadd_ps(m[2], b, _mm512_fmadd_ps(m[1], g, _mm512_mul_ps(m[0], r)));
+            __m512 outG = _mm512_fmadd_ps(m[5], b, _mm512_fmadd_ps(m[4], g, _mm512_mul_ps(m[3], r)));
+            __m512 outB = _mm512_fmadd_ps(m[8], b, _mm512_fmadd_ps(m[7], g, _mm512_mul_ps(m[6], r)));
+
+            _mm256_store_si256(reinterpret_cast<__m256i*>(halves[0] + x), NarrowToHalves(outB, zero));
+            _mm256_store_si256(reinterpret_cast<__m256i*>(halves[1] + x), NarrowToHalves(outG, zero));
+            _mm256_store_si256(reinterpret_cast<__m256i*>(halves[2] + x), NarrowToHalves(outR, zero));
+        }
+
+        for (uint32_t x = 0; x < count; x += 16)
+        {
+            __m512i bgra = GatherEncode(encodeLut, WidenHalves(_mm256_load_si256(reinterpret_cast<const __m256i*>(halves[0] + x))));
+            bgra = _mm512_or_si512(bgra, _mm512_maskz_slli_epi32(AllLanes, GatherEncode(encodeLut, WidenHalves(_mm256_load_si256(reinterpret_cast<const __m256i*>(halves[1] + x)))), 8));
+            bgra = _mm512_or_si512(bgra, _mm512_maskz_slli_epi32(AllLanes, GatherEncode(encodeLut, WidenHalves(_mm256_load_si256(reinterpret_cast<const __m256i*>(halves[2] + x)))), 16));
+            bgra = _mm512_or_si512(bgra, _mm512_set1_epi32(static_cast<int>(0xFF000000)));
+
+            _mm512_storeu_si512(dst + chunk + x, bgra);
+        }
+    }
+
+    Tonemap10BitRowScalar(src + vectorWidth, dst + vectorWidth, width - vectorWidth, decodeLut, matrix, encodeLut);
+}
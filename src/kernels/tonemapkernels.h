@@ -0,0 +1,51 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace Takoyaki::Kernels
+{
+    // Number of entries in the tonemap encode table, one per non-negative half-float
+    static constexpr uint32_t TonemapLutSize = 32768;
+
+    // Extra bytes after the encode table so 32-bit gathers at the last index stay in bounds
+    static constexpr uint32_t TonemapLutPadding = 4;
+
+    // RGBA16F row to BGRA8, indexing encodeLut by the raw half bits of each channel
+    void TonemapFloat16RowScalar(const uint16_t* src, uint32_t* dst, uint32_t width, const uint8_t* encodeLut);
+    void TonemapFloat16RowAvx2(const uint16_t* src, uint32_t* dst, uint32_t width, const uint8_t* encodeLut);
+    void TonemapFloat16RowAvx512(const uint16_t* src, uint32_t* dst, uint32_t width, const uint8_t* encodeLut);
+
+    // The SIMD 10-bit kernels decode and transform this many pixels into a buffer of encode
+    // table indices, then encode them in a second loop. In a single loop the encode gathers
+    // wait on the decode gathers of the same pixels, which measured twice as slow.
+    static constexpr uint32_t TonemapChunkWidth = 256;
+
+    // R10G10B10A2 row to BGRA8. Each channel is decoded to scRGB with decodeLut, transformed
+    // to BT.709 by the row-major 3x3 matrix, then encoded through encodeLut.
+    void Tonemap10BitRowScalar(const uint32_t* src, uint32_t* dst, uint32_t width, const float* decodeLut, const float* matrix, const uint8_t* encodeLut);
+    void Tonemap10BitRowAvx2(const uint32_t* src, uint32_t* dst, uint32_t width, const float* decodeLut, const float* matrix, const uint8_t* encodeLut);
+    void Tonemap10BitRowAvx512(const uint32_t* src, uint32_t* dst, uint32_t width, const float* decodeLut, const float* matrix, const uint8_t* encodeLut);
+
+    // Half-float bit pattern of a non-negative float, rounded to nearest even like F16C
+    uint16_t FloatToHalfBits(float value);
+    float HalfBitsToFloat(uint16_t bits);
+}
@@ -0,0 +1,95 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tonemapkernels.h"
+
+#include <cmath>
+#include <cstring>
+
+uint16_t Takoyaki::Kernels::FloatToHalfBits(float value)
+{
+    if (!(value > 0.0f))
+        return 0;
+
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    // Anything that rounds past the largest finite half becomes infinity
+    if (bits >= 0x477FF000)
+        return 0x7C00;
+
+    // Below the smallest normal half, the value is an integer multiple of 2^-24
+    if (bits < 0x38800000)
+        return static_cast<uint16_t>(std::lrint(value * 16777216.0f));
+
+    // Rebias the exponent and round the mantissa to nearest even
+    return static_cast<uint16_t>((bits - 0x38000000 + 0x0FFF + ((bits >> 13) & 1)) >> 13);
+}
+
+float Takoyaki::Kernels::HalfBitsToFloat(uint16_t bits)
+{
+    uint32_t sign = static_cast<uint32_t>(bits & 0x8000) << 16;
+    uint32_t exponent = (bits >> 10) & 0x1F;
+    uint32_t mantissa = bits & 0x3FF;
+
+    if (exponent == 0)
+    {
+        float value = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign ? -value : value;
+    }
+
+    uint32_t result = sign | (exponent == 0x1F ? 0x7F800000 : (exponent + 112) << 23) | (mantissa << 13);
+
+    float value;
+    memcpy(&value, &result, sizeof(value));
+    return value;
+}
+
+void Takoyaki::Kernels::TonemapFloat16RowScalar(const uint16_t* src, uint32_t* dst, uint32_t width, const uint8_t* encodeLut)
+{
+    for (uint32_t x = 0; x < width; ++x)
+    {
+        // Every negative half, including -0, maps to black
+        uint16_t r = (src[0] & 0x8000) ? 0 : src[0];
+        uint16_t g = (src[1] & 0x8000) ? 0 : src[1];
+        uint16_t b = (src[2] & 0x8000) ? 0 : src[2];
+
+        dst[x] = encodeLut[b] | (encodeLut[g] << 8) | (encodeLut[r] << 16) | 0xFF000000;
+        src += 4;
+    }
+}
+
+void Takoyaki::Kernels::Tonemap10BitRowScalar(const uint32_t* src, uint32_t* dst, uint32_t width, const float* decodeLut, const float* matrix, const uint8_t* encodeLut)
+{
+    for (uint32_t x = 0; x < width; ++x)
+    {
+        float r = decodeLut[src[x] & 0x3FF];
+        float g = decodeLut[(src[x] >> 10) & 0x3FF];
+        float b = decodeLut[(src[x] >> 20) & 0x3FF];
+
+        float outR = matrix[0] * r + matrix[1] * g + matrix[2] * b;
+        float outG = matrix[3] * r + matrix[4] * g + matrix[5] * b;
+        float outB = matrix[6] * r + matrix[7] * g + matrix[8] * b;
+
+        dst[x] = encodeLut[FloatToHalfBits(outB)] |
+            (encodeLut[FloatToHalfBits(outG)] << 8) |
+            (encodeLut[FloatToHalfBits(outR)] << 16) |
+            0xFF000000;
+    }
+}
@@ -0,0 +1,494 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "streamserver.h"
+#include "streamprotocol.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+    // How long the send and accept threads wait before checking whether to stop
+    constexpr std::chrono::milliseconds PollInterval(100);
+
+    // How often backlogs are retried while any viewer has one
+    constexpr std::chrono::milliseconds FlushInterval(1);
+
+    // A viewer whose socket takes nothing for this long is dropped
+    constexpr std::chrono::seconds SendTimeout(2);
+
+    Takoyaki::FrameView GetReadView(const Takoyaki::FrameBuffer& frame)
+    {
+        // The protocol helpers only read through the view
+        return { const_cast<uint8_t*>(frame.GetData()), frame.GetWidth(), frame.GetHeight(), frame.GetStride() };
+    }
+}
+
+Takoyaki::StreamServer::~StreamServer()
+{
+    Stop();
+}
+
+bool Takoyaki::StreamServer::Start(const char* socketPath, FrameBroadcaster& broadcaster)
+{
+    if (m_Running)
+        return false;
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+
+    if (strlen(socketPath) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "Takoyaki: stream socket path is too long.\n");
+        return false;
+    }
+
+    strcpy(address.sun_path, socketPath);
+
+    m_ListenSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_ListenSocket < 0)
+    {
+        fprintf(stderr, "Takoyaki: failed to create stream socket (%s).\n", strerror(errno));
+        return false;
+    }
+
+    // A stale socket file from a previous run would make bind fail
+    unlink(socketPath);
+
+    if (bind(m_ListenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(m_ListenSocket, 4) != 0)
+    {
+        fprintf(stderr, "Takoyaki: failed to listen on %s (%s).\n", socketPath, strerror(errno));
+        close(m_ListenSocket);
+        m_ListenSocket = -1;
+        return false;
+    }
+
+    m_SocketPath = socketPath;
+    m_Broadcaster = &broadcaster;
+    m_Sink = broadcaster.Subscribe({ 1, DropPolicy::DropOldest });
+    m_Stats = {};
+
+    m_Running = true;
+    m_AcceptThread = std::thread(&StreamServer::AcceptLoop, this);
+    m_SendThread = std::thread(&StreamServer::SendLoop, this);
+
+    return true;
+}
+
+void Takoyaki::StreamServer::Stop()
+{
+    if (!m_Running.exchange(false))
+        return;
+
+    m_AcceptThread.join();
+    m_SendThread.join();
+
+    for (Client& client : m_Clients)
+        close(client.m_Socket);
+
+    for (Client& client : m_PendingClients)
+        close(client.m_Socket);
+
+    m_Clients.clear();
+    m_PendingClients.clear();
+    m_LastSent.Reset();
+    GetFrameAllocator().Free(m_MotionReference);
+
+    m_Broadcaster->Unsubscribe(m_Sink);
+    m_Sink.reset();
+    m_Broadcaster = nullptr;
+
+    close(m_ListenSocket);
+    m_ListenSocket = -1;
+    unlink(m_SocketPath.c_str());
+}
+
+Takoyaki::StreamServerStats Takoyaki::StreamServer::GetStats() const
+{
+    std::lock_guard lock(m_StatsMutex);
+    return m_Stats;
+}
+
+void Takoyaki::StreamServer::AcceptLoop()
+{
+    while (m_Running)
+    {
+        pollfd listenPoll = { m_ListenSocket, POLLIN, 0 };
+        if (poll(&listenPoll, 1, static_cast<int>(PollInterval.count())) <= 0)
+            continue;
+
+        // Non-blocking, so one viewer with a full socket cannot stall the send thread
+        int clientSocket = accept4(m_ListenSocket, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (clientSocket < 0)
+            continue;
+
+        Client client;
+        client.m_Socket = clientSocket;
+
+        std::lock_guard lock(m_PendingMutex);
+        m_PendingClients.push_back(std::move(client));
+    }
+}
+
+void Takoyaki::StreamServer::SendLoop()
+{
+    while (m_Running)
+    {
+        {
+            std::lock_guard lock(m_PendingMutex);
+            std::move(m_PendingClients.begin(), m_PendingClients.end(), std::back_inserter(m_Clients));
+
+            std::lock_guard statsLock(m_StatsMutex);
+            m_Stats.m_ClientsAccepted += m_PendingClients.size();
+            m_PendingClients.clear();
+        }
+
+        const bool hasBacklog = FlushClients();
+
+        FrameRef frame;
+        if (m_Sink->WaitPop(frame, hasBacklog ? FlushInterval : PollInterval))
+            SendFrame(frame, true);
+        else if (m_LastSent)
+            SendFrame(m_LastSent, false);   // Still catch new clients up while the screen is idle
+
+        std::lock_guard statsLock(m_StatsMutex);
+        m_Stats.m_ClientCount = static_cast<uint32_t>(m_Clients.size());
+    }
+}
+
+void Takoyaki::StreamServer::SendFrame(const FrameRef& frame, bool isNewFrame)
+{
+    if (m_Clients.empty())
+    {
+        // Nobody is diffing against the last frame, so the next viewer starts from a keyframe anyway
+        if (isNewFrame)
+            m_LastSent = frame;
+
+        return;
+    }
+
+    const uint16_t tileSize = m_TileSize;
+    const bool compress = m_Compress;
+    PaletteBuilder* palette = m_UsePalette ? &m_Palette : nullptr;
+    const FrameView view = GetReadView(*frame.Get());
+    const TileMap* tileMap = frame->HasTileMap() ? &frame->GetTileMap() : nullptr;
+
+    Stream::FrameInfo info;
+    info.m_FrameId = frame->GetFrameId();
+    info.m_CaptureTimeNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(frame->GetCaptureTime().time_since_epoch()).count());
+    info.m_Width = frame->GetWidth();
+    info.m_Height = frame->GetHeight();
+    info.m_TileSize = tileSize;
+
+    // Clients that already have the previous frame get the changed tiles, everyone else a
+    // keyframe. Both messages are built at most once and shared between clients.
+    m_Copies.clear();
+    if (isNewFrame && m_LastSent)
+        DetectMotion(*frame.Get(), *m_LastSent.Get());
+
+    bool canDelta = isNewFrame && m_LastSent && FindChangedTiles(*frame.Get(), *m_LastSent.Get());
+    bool hasDelta = false;
+    bool hasKeyframe = false;
+    bool isDeltaIndexed = false;
+    bool isKeyframeIndexed = false;
+    uint32_t deltaTiles = 0;
+    uint32_t keyframeTiles = 0;
+
+    uint64_t framesSent = 0;
+    uint64_t keyframesSent = 0;
+    uint64_t paletteFramesSent = 0;
+    uint64_t tilesSent = 0;
+    uint64_t copiesSent = 0;
+    uint64_t bytesSent = 0;
+    uint64_t clientsDropped = 0;
+    uint64_t framesSkipped = 0;
+
+    for (size_t i = 0; i < m_Clients.size();)
+    {
+        Client& client = m_Clients[i];
+        const std::vector<uint8_t>* message = nullptr;
+        uint32_t tileCount = 0;
+        bool isIndexed = false;
+
+        if (!client.m_NeedsKeyframe && !isNewFrame)
+        {
+            ++i;
+            continue;
+        }
+
+        // Still taking an earlier frame. Missing this one breaks the chain of deltas, so it
+        // starts again from a keyframe once it has caught up.
+        if (client.HasBacklog())
+        {
+            framesSkipped += isNewFrame;
+            client.m_NeedsKeyframe = true;
+            ++i;
+            continue;
+        }
+
+        if (client.m_NeedsKeyframe || !canDelta)
+        {
+            if (!hasKeyframe)
+            {
+                Stream::FrameInfo keyframeInfo = info;
+                keyframeInfo.m_Flags = Stream::FrameFlagKeyframe;
+                isKeyframeIndexed = Stream::BuildFrameMessage(view, keyframeInfo, nullptr, compress, m_KeyframeMessage, palette, tileMap);
+                memcpy(&keyframeTiles, m_KeyframeMessage.data() + sizeof(Stream::MessageHeader) + offsetof(Stream::FrameInfo, m_TileCount), sizeof(keyframeTiles));
+                hasKeyframe = true;
+            }
+
+            message = &m_KeyframeMessage;
+            tileCount = keyframeTiles;
+            isIndexed = isKeyframeIndexed;
+            ++keyframesSent;
+        }
+        else
+        {
+            if (!hasDelta)
+            {
+                isDeltaIndexed = Stream::BuildFrameMessage(view, info, &m_ChangedTiles, compress, m_DeltaMessage, palette, tileMap, &m_Copies);
+                memcpy(&deltaTiles, m_DeltaMessage.data() + sizeof(Stream::MessageHeader) + offsetof(Stream::FrameInfo, m_TileCount), sizeof(deltaTiles));
+                hasDelta = true;
+            }
+
+            message = &m_DeltaMessage;
+            tileCount = deltaTiles;
+            isIndexed = isDeltaIndexed;
+            copiesSent += m_Copies.size();
+        }
+
+        if (!SendMessage(client, *message))
+        {
+            close(client.m_Socket);
+            m_Clients.erase(m_Clients.begin() + i);
+            ++clientsDropped;
+            continue;
+        }
+
+        client.m_NeedsKeyframe = false;
+        ++framesSent;
+        paletteFramesSent += isIndexed;
+        tilesSent += tileCount;
+        bytesSent += message->size();
+        ++i;
+    }
+
+    if (isNewFrame)
+        m_LastSent = frame;
+
+    std::lock_guard lock(m_StatsMutex);
+    m_Stats.m_FramesSent += framesSent;
+    m_Stats.m_KeyframesSent += keyframesSent;
+    m_Stats.m_PaletteFramesSent += paletteFramesSent;
+    m_Stats.m_TilesSent += tilesSent;
+    m_Stats.m_CopiesSent += copiesSent;
+    m_Stats.m_BytesSent += bytesSent;
+    m_Stats.m_ClientsDropped += clientsDropped;
+    m_Stats.m_FramesSkipped += framesSkipped;
+}
+
+bool Takoyaki::StreamServer::FindChangedTiles(const FrameBuffer& frame, const FrameBuffer& previous)
+{
+    if (frame.GetWidth() != previous.GetWidth() || frame.GetHeight() != previous.GetHeight())
+        return false;
+
+    const uint32_t tileSize = m_TileSize;
+    const uint32_t columns = (frame.GetWidth() + tileSize - 1) / tileSize;
+    const uint32_t rows = (frame.GetHeight() + tileSize - 1) / tileSize;
+
+    m_ChangedTiles.assign(static_cast<size_t>(columns) * rows, 0);
+
+    // After copies, viewers hold the reference rather than the previous frame
+    const FrameView reference = m_Copies.empty() ? GetReadView(previous) : FrameView{ m_MotionReference.m_Data, frame.GetWidth(), frame.GetHeight(), GetPaddedStride(frame.GetWidth()) };
+
+    // Damage only describes the step from the frame right before, and the sink may have
+    // dropped that one. When it applies, tiles it does not touch are known to be unchanged.
+    const bool useDamage = m_Copies.empty() && frame.HasDamage() && frame.GetFrameId() == previous.GetFrameId() + 1;
+    if (useDamage)
+    {
+        m_DamagedTiles.assign(m_ChangedTiles.size(), 0);
+
+        for (const Rect& rect : frame.GetDamage())
+        {
+            int32_t left = std::max(rect.m_X, 0);
+            int32_t top = std::max(rect.m_Y, 0);
+            int32_t right = std::min(rect.m_X + static_cast<int32_t>(rect.m_Width), static_cast<int32_t>(frame.GetWidth()));
+            int32_t bottom = std::min(rect.m_Y + static_cast<int32_t>(rect.m_Height), static_cast<int32_t>(frame.GetHeight()));
+
+            if (right <= left || bottom <= top)
+                continue;
+
+            uint32_t firstColumn = left / tileSize;
+            uint32_t lastColumn = (right - 1) / tileSize;
+
+            for (uint32_t row = top / tileSize; row <= (bottom - 1) / tileSize; ++row)
+                memset(m_DamagedTiles.data() + static_cast<size_t>(row) * columns + firstColumn, 1, lastColumn - firstColumn + 1);
+        }
+    }
+
+    // Walk whole rows so both frames are read front to back, and skip tiles once they are
+    // known to have changed
+    for (uint32_t y = 0; y < frame.GetHeight(); ++y)
+    {
+        uint8_t* changed = m_ChangedTiles.data() + static_cast<size_t>(y / tileSize) * columns;
+        const uint8_t* damaged = useDamage ? m_DamagedTiles.data() + static_cast<size_t>(y / tileSize) * columns : nullptr;
+        const uint32_t* row = frame.GetRow(y);
+        const uint32_t* previousRow = reference.GetRow(y);
+
+        for (uint32_t column = 0; column < columns; ++column)
+        {
+            if (changed[column] || (damaged && !damaged[column]))
+                continue;
+
+            uint32_t x = column * tileSize;
+            uint32_t width = std::min(tileSize, frame.GetWidth() - x);
+            changed[column] = memcmp(row + x, previousRow + x, width * 4) != 0;
+        }
+    }
+
+    return true;
+}
+
+void Takoyaki::StreamServer::DetectMotion(const FrameBuffer& frame, const FrameBuffer& previous)
+{
+    // Frames that come with damage changed under the cursor at most, which never scrolls
+    if (!m_DetectMotion || frame.GetWidth() != previous.GetWidth() || frame.GetHeight() != previous.GetHeight() ||
+        (frame.HasDamage() && frame.GetFrameId() == previous.GetFrameId() + 1))
+        return;
+
+    m_MotionDetector.Detect(GetReadView(previous), GetReadView(frame), m_Motion);
+    if (m_Motion.m_Copies.empty() || m_Motion.m_Copies.size() > UINT16_MAX)
+        return;
+
+    const uint32_t stride = GetPaddedStride(frame.GetWidth());
+    const size_t size = static_cast<size_t>(stride) * frame.GetHeight();
+    if (m_MotionReference.m_Size < size)
+    {
+        GetFrameAllocator().Free(m_MotionReference);
+        m_MotionReference = GetFrameAllocator().Allocate(size, MemoryCategory::Scratch);
+        if (m_MotionReference.m_Data == nullptr)
+            return;
+    }
+
+    const FrameView reference = { m_MotionReference.m_Data, frame.GetWidth(), frame.GetHeight(), stride };
+    for (uint32_t y = 0; y < frame.GetHeight(); ++y)
+        memcpy(reference.GetRow(y), previous.GetRow(y), frame.GetWidth() * 4);
+
+    for (const CopyRectOp& op : m_Motion.m_Copies)
+    {
+        Stream::CopyRect copy = { op.m_Source.m_X, op.m_Source.m_Y, op.m_Source.m_Width, op.m_Source.m_Height, op.m_DestX, op.m_DestY };
+        if (Stream::ApplyCopy(copy, reference))
+            m_Copies.push_back(copy);
+    }
+}
+
+bool Takoyaki::StreamServer::SendMessage(Client& client, const std::vector<uint8_t>& message)
+{
+    // Only ever called once the backlog has gone, so the message can start straight away
+    client.m_Backlog.clear();
+    client.m_BacklogOffset = 0;
+
+    size_t offset = 0;
+
+    while (offset < message.size())
+    {
+        ssize_t sent = send(client.m_Socket, message.data() + offset, message.size() - offset, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            client.m_Backlog.assign(message.begin() + offset, message.end());
+            client.m_LastProgress = std::chrono::steady_clock::now();
+            return true;
+        }
+
+        if (sent <= 0)
+            return false;
+
+        offset += static_cast<size_t>(sent);
+    }
+
+    return true;
+}
+
+bool Takoyaki::StreamServer::FlushBacklog(Client& client)
+{
+    const auto now = std::chrono::steady_clock::now();
+
+    while (client.HasBacklog())
+    {
+        ssize_t sent = send(client.m_Socket, client.m_Backlog.data() + client.m_BacklogOffset, client.m_Backlog.size() - client.m_BacklogOffset, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return now - client.m_LastProgress < SendTimeout;
+
+        if (sent <= 0)
+            return false;
+
+        client.m_BacklogOffset += static_cast<size_t>(sent);
+        client.m_LastProgress = now;
+    }
+
+    client.m_Backlog.clear();
+    client.m_BacklogOffset = 0;
+    return true;
+}
+
+bool Takoyaki::StreamServer::FlushClients()
+{
+    bool hasBacklog = false;
+    uint64_t clientsDropped = 0;
+
+    for (size_t i = 0; i < m_Clients.size();)
+    {
+        Client& client = m_Clients[i];
+
+        if (!FlushBacklog(client))
+        {
+            close(client.m_Socket);
+            m_Clients.erase(m_Clients.begin() + i);
+            ++clientsDropped;
+            continue;
+        }
+
+        hasBacklog |= client.HasBacklog();
+        ++i;
+    }
+
+    if (clientsDropped != 0)
+    {
+        std::lock_guard lock(m_StatsMutex);
+        m_Stats.m_ClientsDropped += clientsDropped;
+    }
+
+    return hasBacklog;
+}
@@ -0,0 +1,154 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "framebroadcaster.h"
+#include "motiondetector.h"
+#include "palettebuilder.h"
+#include "streamprotocol.h"
+
+namespace Takoyaki
+{
+    struct StreamServerStats
+    {
+        uint64_t m_FramesSent = 0;
+        uint64_t m_KeyframesSent = 0;
+        uint64_t m_PaletteFramesSent = 0;
+        uint64_t m_TilesSent = 0;
+        uint64_t m_CopiesSent = 0;
+        uint64_t m_BytesSent = 0;
+        uint64_t m_ClientsAccepted = 0;
+        uint64_t m_ClientsDropped = 0;
+
+        // Frames a viewer missed because its socket was still taking an earlier one
+        uint64_t m_FramesSkipped = 0;
+        uint32_t m_ClientCount = 0;
+    };
+
+    // Streams published frames to local viewers over a Unix domain socket. A viewer gets a
+    // keyframe when it connects, then only the tiles that changed since the previous frame.
+    // Frames come from a depth 1 sink that drops the oldest frame, so the server never holds
+    // up capture. Sends never block: whatever a viewer's socket cannot take is kept for it
+    // and sent first, and the viewer skips frames until it has caught up, then resumes from
+    // a keyframe. So a slow viewer only ever sees fewer, newer frames and never holds up the
+    // others, and one that takes nothing for a while is dropped.
+    class StreamServer
+    {
+    public:
+        StreamServer() = default;
+        ~StreamServer();
+
+        StreamServer(const StreamServer&) = delete;
+        StreamServer& operator=(const StreamServer&) = delete;
+
+        bool Start(const char* socketPath, FrameBroadcaster& broadcaster);
+        void Stop();
+
+    public:
+        // Lets tiles use the solid and run-length encodings when they are smaller than raw
+        inline void SetCompression(bool compress) { m_Compress = compress; }
+        inline void SetTileSize(uint16_t tileSize) { m_TileSize = tileSize; }
+
+        // Sends frames whose tiles have at most 256 colours with a palette and one byte per
+        // pixel, and every other frame as BGRA
+        inline void SetPaletteMode(bool usePalette) { m_UsePalette = usePalette; }
+
+        // Sends scrolled and moved content as copies of what viewers already have, and only
+        // the tiles that still differ once the copies are applied
+        inline void SetMotionDetection(bool detectMotion) { m_DetectMotion = detectMotion; }
+        StreamServerStats GetStats() const;
+
+    private:
+        struct Client
+        {
+            int m_Socket = -1;
+            bool m_NeedsKeyframe = true;
+
+            // Rest of a message the socket could not take at once, and when it last took any
+            std::vector<uint8_t> m_Backlog;
+            size_t m_BacklogOffset = 0;
+            std::chrono::steady_clock::time_point m_LastProgress;
+
+            inline bool HasBacklog() const { return m_BacklogOffset < m_Backlog.size(); }
+        };
+
+        void AcceptLoop();
+        void SendLoop();
+
+        void SendFrame(const FrameRef& frame, bool isNewFrame);
+        bool FindChangedTiles(const FrameBuffer& frame, const FrameBuffer& previous);
+
+        // Fills m_Copies, and m_MotionReference with previous after the copies if there are any
+        void DetectMotion(const FrameBuffer& frame, const FrameBuffer& previous);
+
+        // Both return false if the client has to be dropped
+        bool SendMessage(Client& client, const std::vector<uint8_t>& message);
+        bool FlushBacklog(Client& client);
+
+        // Sends what it can of every backlog and drops clients that failed or stalled.
+        // Returns true if any backlog is left.
+        bool FlushClients();
+
+    private:
+        std::string m_SocketPath;
+        int m_ListenSocket = -1;
+
+        FrameBroadcaster* m_Broadcaster = nullptr;
+        std::shared_ptr<FrameSink> m_Sink;
+
+        std::atomic<bool> m_Running = false;
+        std::thread m_AcceptThread;
+        std::thread m_SendThread;
+
+        std::atomic<bool> m_Compress = true;
+        std::atomic<uint16_t> m_TileSize = 64;
+        std::atomic<bool> m_UsePalette = false;
+        std::atomic<bool> m_DetectMotion = false;
+
+        // Clients accepted since the last send, picked up by the send thread
+        std::mutex m_PendingMutex;
+        std::vector<Client> m_PendingClients;
+
+        // Only touched by the send thread
+        std::vector<Client> m_Clients;
+        FrameRef m_LastSent;
+        std::vector<uint8_t> m_ChangedTiles;
+        std::vector<uint8_t> m_DamagedTiles;
+        std::vector<uint8_t> m_DeltaMessage;
+        std::vector<uint8_t> m_KeyframeMessage;
+        PaletteBuilder m_Palette;
+
+        MotionDetector m_MotionDetector;
+        MotionResult m_Motion;
+        std::vector<Stream::CopyRect> m_Copies;
+        FrameAllocation m_MotionReference;
+
+        mutable std::mutex m_StatsMutex;
+        StreamServerStats m_Stats;
+    };
+}
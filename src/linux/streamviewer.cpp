@@ -0,0 +1,287 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "streamviewer.h"
+#include "streamprotocol.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+    // Anything larger than a raw 8K keyframe is treated as a corrupt stream
+    constexpr uint32_t MaxPayloadSize = 7680 * 4320 * 4 + (1 << 20);
+
+    // Frames are no larger than 8K, in either orientation
+    constexpr uint32_t MaxFrameDimension = 7680;
+    constexpr uint64_t MaxFramePixels = 7680 * 4320;
+}
+
+Takoyaki::StreamViewer::~StreamViewer()
+{
+    Disconnect();
+    GetFrameAllocator().Free(m_Frame);
+}
+
+bool Takoyaki::StreamViewer::Connect(const char* socketPath)
+{
+    Disconnect();
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+
+    if (strlen(socketPath) >= sizeof(address.sun_path))
+        return false;
+
+    strcpy(address.sun_path, socketPath);
+
+    m_Socket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_Socket < 0)
+        return false;
+
+    if (connect(m_Socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        fprintf(stderr, "Takoyaki: failed to connect to %s (%s).\n", socketPath, strerror(errno));
+        Disconnect();
+        return false;
+    }
+
+    m_HasKeyframe = false;
+    m_Stats = {};
+    return true;
+}
+
+void Takoyaki::StreamViewer::Disconnect()
+{
+    if (m_Socket < 0)
+        return;
+
+    close(m_Socket);
+    m_Socket = -1;
+}
+
+bool Takoyaki::StreamViewer::ReceiveFrame()
+{
+    while (m_Socket >= 0)
+    {
+        Stream::MessageHeader header;
+        if (!ReadExact(&header, sizeof(header)))
+            break;
+
+        if (header.m_Magic != Stream::Magic || header.m_Version != Stream::Version || header.m_PayloadSize > MaxPayloadSize)
+        {
+            fprintf(stderr, "Takoyaki: unrecognized stream message.\n");
+            break;
+        }
+
+        m_Payload.resize(header.m_PayloadSize);
+        if (!ReadExact(m_Payload.data(), m_Payload.size()))
+            break;
+
+        m_Stats.m_BytesReceived += sizeof(header) + header.m_PayloadSize;
+
+        // Skip message types from newer servers
+        if (header.m_Type != static_cast<uint16_t>(Stream::MessageType::Frame))
+            continue;
+
+        if (!ApplyFrame(m_Payload.data(), m_Payload.size()))
+        {
+            fprintf(stderr, "Takoyaki: malformed stream frame.\n");
+            break;
+        }
+
+        return true;
+    }
+
+    Disconnect();
+    return false;
+}
+
+Takoyaki::FrameView Takoyaki::StreamViewer::GetFrame() const
+{
+    return { m_Frame.m_Data, m_Width, m_Height, m_Stride };
+}
+
+bool Takoyaki::StreamViewer::ReadExact(void* data, size_t size)
+{
+    uint8_t* bytes = static_cast<uint8_t*>(data);
+
+    while (size > 0)
+    {
+        ssize_t received = recv(m_Socket, bytes, size, 0);
+        if (received < 0 && errno == EINTR)
+            continue;
+
+        if (received <= 0)
+            return false;
+
+        bytes += received;
+        size -= static_cast<size_t>(received);
+    }
+
+    return true;
+}
+
+bool Takoyaki::StreamViewer::ApplyFrame(const uint8_t* payload, size_t size)
+{
+    Stream::FrameInfo info;
+    if (size < sizeof(info))
+        return false;
+
+    memcpy(&info, payload, sizeof(info));
+
+    const bool isKeyframe = (info.m_Flags & Stream::FrameFlagKeyframe) != 0;
+    if (info.m_TileSize == 0 || (!isKeyframe && (!m_HasKeyframe || info.m_Width != m_Width || info.m_Height != m_Height)))
+        return false;
+
+    const uint32_t columns = (info.m_Width + info.m_TileSize - 1) / info.m_TileSize;
+    const uint32_t rows = (info.m_Height + info.m_TileSize - 1) / info.m_TileSize;
+
+    // The size comes from the peer, so it is checked before anything is allocated for it. A
+    // keyframe carries every tile, which needs at least a header each in the payload.
+    if (isKeyframe)
+    {
+        const uint64_t tileCount = static_cast<uint64_t>(columns) * rows;
+
+        if (info.m_Width == 0 || info.m_Height == 0 || info.m_Width > MaxFrameDimension || info.m_Height > MaxFrameDimension ||
+            static_cast<uint64_t>(info.m_Width) * info.m_Height > MaxFramePixels || info.m_TileCount != tileCount ||
+            tileCount * sizeof(Stream::TileHeader) > size - sizeof(info))
+            return false;
+
+        if (!ResizeFrame(info.m_Width, info.m_Height))
+            return false;
+    }
+
+    const FrameView frame = GetFrame();
+    size_t offset = sizeof(info);
+
+    // Copies only make sense on top of the frame the viewer already has
+    Stream::CopyInfo copyInfo;
+    if ((info.m_Flags & Stream::FrameFlagCopies) != 0)
+    {
+        if (isKeyframe || size - offset < sizeof(copyInfo))
+            return false;
+
+        memcpy(&copyInfo, payload + offset, sizeof(copyInfo));
+        offset += sizeof(copyInfo);
+
+        if (size - offset < copyInfo.m_CopyCount * sizeof(Stream::CopyRect))
+            return false;
+
+        for (uint32_t i = 0; i < copyInfo.m_CopyCount; ++i)
+        {
+            Stream::CopyRect copy;
+            memcpy(&copy, payload + offset, sizeof(copy));
+            offset += sizeof(copy);
+
+            if (!Stream::ApplyCopy(copy, frame))
+                return false;
+        }
+    }
+
+    Stream::PaletteInfo paletteInfo;
+    const uint32_t* palette = nullptr;
+
+    if ((info.m_Flags & Stream::FrameFlagPalette) != 0)
+    {
+        if (size - offset < sizeof(paletteInfo))
+            return false;
+
+        memcpy(&paletteInfo, payload + offset, sizeof(paletteInfo));
+        offset += sizeof(paletteInfo);
+
+        if (size - offset < paletteInfo.m_ColourCount * sizeof(uint32_t))
+            return false;
+
+        // Copied out, the payload has no alignment guarantee
+        m_Palette.resize(paletteInfo.m_ColourCount);
+        memcpy(m_Palette.data(), payload + offset, paletteInfo.m_ColourCount * sizeof(uint32_t));
+        offset += paletteInfo.m_ColourCount * sizeof(uint32_t);
+        palette = m_Palette.data();
+    }
+
+    for (uint32_t i = 0; i < info.m_TileCount; ++i)
+    {
+        Stream::TileHeader tile;
+        if (size - offset < sizeof(tile))
+            return false;
+
+        memcpy(&tile, payload + offset, sizeof(tile));
+        offset += sizeof(tile);
+
+        if (tile.m_Column >= columns || tile.m_Row >= rows || size - offset < tile.m_DataSize)
+            return false;
+
+        Rect rect = Stream::GetTileRect(info.m_Width, info.m_Height, info.m_TileSize, tile.m_Column, tile.m_Row);
+        if (!Stream::DecodeTile(payload + offset, tile.m_DataSize, static_cast<Stream::TileEncoding>(tile.m_Encoding), rect, frame, palette, paletteInfo.m_ColourCount))
+            return false;
+
+        offset += tile.m_DataSize;
+    }
+
+    // Both ends use steady_clock, which is CLOCK_MONOTONIC on Linux and shared by processes
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(now - std::chrono::nanoseconds(info.m_CaptureTimeNs));
+
+    m_FrameId = info.m_FrameId;
+    m_HasKeyframe = true;
+
+    m_Stats.m_FramesReceived++;
+    m_Stats.m_KeyframesReceived += isKeyframe;
+    m_Stats.m_TilesReceived += info.m_TileCount;
+    m_Stats.m_CopiesReceived += copyInfo.m_CopyCount;
+    m_Stats.m_LastLatency = latency;
+    m_Stats.m_MaxLatency = std::max(m_Stats.m_MaxLatency, latency);
+    m_Stats.m_TotalLatency += latency;
+
+    return offset == size;
+}
+
+bool Takoyaki::StreamViewer::ResizeFrame(uint32_t width, uint32_t height)
+{
+    if (width == m_Width && height == m_Height && m_Frame.m_Data != nullptr)
+        return true;
+
+    GetFrameAllocator().Free(m_Frame);
+
+    const uint32_t stride = GetPaddedStride(width);
+    m_Frame = GetFrameAllocator().Allocate(static_cast<size_t>(stride) * height, MemoryCategory::Output);
+
+    if (m_Frame.m_Data == nullptr)
+    {
+        // Nothing to apply deltas to until a keyframe that fits arrives
+        fprintf(stderr, "Takoyaki: failed to allocate a %ux%u stream frame.\n", width, height);
+        m_Width = 0;
+        m_Height = 0;
+        m_Stride = 0;
+        m_HasKeyframe = false;
+        return false;
+    }
+
+    m_Width = width;
+    m_Height = height;
+    m_Stride = stride;
+    return true;
+}
@@ -0,0 +1,93 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include "frame.h"
+#include "framealloc.h"
+
+namespace Takoyaki
+{
+    struct StreamViewerStats
+    {
+        uint64_t m_FramesReceived = 0;
+        uint64_t m_KeyframesReceived = 0;
+        uint64_t m_TilesReceived = 0;
+        uint64_t m_CopiesReceived = 0;
+        uint64_t m_BytesReceived = 0;
+
+        // From capture on the server to the frame being reconstructed here
+        std::chrono::microseconds m_LastLatency{ 0 };
+        std::chrono::microseconds m_MaxLatency{ 0 };
+        std::chrono::microseconds m_TotalLatency{ 0 };
+
+        inline std::chrono::microseconds GetAverageLatency() const { return m_FramesReceived ? m_TotalLatency / static_cast<int64_t>(m_FramesReceived) : std::chrono::microseconds(0); }
+    };
+
+    // Reference client for StreamServer. Rebuilds every frame from the keyframe and the
+    // copies and changed tiles that follow it, without drawing anything, so the protocol can be checked
+    // and measured headless.
+    class StreamViewer
+    {
+    public:
+        StreamViewer() = default;
+        ~StreamViewer();
+
+        StreamViewer(const StreamViewer&) = delete;
+        StreamViewer& operator=(const StreamViewer&) = delete;
+
+        bool Connect(const char* socketPath);
+        void Disconnect();
+
+        // Blocks until the next frame has been applied. Returns false once the server goes
+        // away or sends something that does not parse, after which the viewer is disconnected.
+        bool ReceiveFrame();
+
+    public:
+        inline bool IsConnected() const { return m_Socket >= 0; }
+        inline uint64_t GetFrameId() const { return m_FrameId; }
+        inline const StreamViewerStats& GetStats() const { return m_Stats; }
+
+        // The reconstructed frame, valid until the next ReceiveFrame
+        FrameView GetFrame() const;
+
+    private:
+        bool ReadExact(void* data, size_t size);
+        bool ApplyFrame(const uint8_t* payload, size_t size);
+        // False if the frame could not be allocated
+        bool ResizeFrame(uint32_t width, uint32_t height);
+
+    private:
+        int m_Socket = -1;
+
+        FrameAllocation m_Frame;
+        uint32_t m_Width = 0;
+        uint32_t m_Height = 0;
+        uint32_t m_Stride = 0;
+        uint64_t m_FrameId = 0;
+        bool m_HasKeyframe = false;
+
+        std::vector<uint8_t> m_Payload;
+        std::vector<uint32_t> m_Palette;
+        StreamViewerStats m_Stats;
+    };
+}
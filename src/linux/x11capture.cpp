@@ -0,0 +1,380 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "x11capture.h"
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <algorithm>
+#include <cstdio>
+
+#ifdef TAKOYAKI_HAS_XDAMAGE
+#include <X11/extensions/Xdamage.h>
+#endif
+
+#ifdef TAKOYAKI_HAS_XFIXES
+#include <X11/extensions/Xfixes.h>
+#endif
+
+namespace
+{
+    // XShmAttach reports failure asynchronously through the error handler (e.g. when the
+    // X server is remote and cannot see our segment), so trap it during attachment.
+    bool g_ShmAttachFailed = false;
+
+    int ShmAttachErrorHandler(Display*, XErrorEvent*)
+    {
+        g_ShmAttachFailed = true;
+        return 0;
+    }
+}
+
+Takoyaki::X11Capture::~X11Capture()
+{
+    Shutdown();
+}
+
+bool Takoyaki::X11Capture::Initialize(const char* displayName)
+{
+    m_Display = XOpenDisplay(displayName);
+    if (m_Display == nullptr)
+    {
+        fprintf(stderr, "Takoyaki: failed to open X display.\n");
+        return false;
+    }
+
+    int screen = DefaultScreen(m_Display);
+    m_RootWindow = RootWindow(m_Display, screen);
+    m_Visual = DefaultVisual(m_Display, screen);
+    m_Depth = DefaultDepth(m_Display, screen);
+    m_ScreenWidth = static_cast<uint32_t>(DisplayWidth(m_Display, screen));
+    m_ScreenHeight = static_cast<uint32_t>(DisplayHeight(m_Display, screen));
+
+    m_HasShm = XShmQueryExtension(m_Display);
+    if (!m_HasShm)
+        printf("Takoyaki: MIT-SHM is not available, falling back to XGetImage\n");
+
+    InitializeDamage();
+
+#ifdef TAKOYAKI_HAS_XFIXES
+    int fixesEventBase = 0;
+    int fixesErrorBase = 0;
+    m_HasXFixes = XFixesQueryExtension(m_Display, &fixesEventBase, &fixesErrorBase);
+#endif
+
+    m_IsDirty = true;
+    return true;
+}
+
+void Takoyaki::X11Capture::Shutdown()
+{
+    if (m_Display == nullptr)
+        return;
+
+#ifdef TAKOYAKI_HAS_XDAMAGE
+    if (m_Damage != 0)
+        XDamageDestroy(m_Display, m_Damage);
+#endif
+
+    m_Damage = 0;
+    m_HasDamage = false;
+    m_HasXFixes = false;
+
+    ReleaseImage();
+    ReleaseSharedImage();
+
+    XCloseDisplay(m_Display);
+    m_Display = nullptr;
+}
+
+Takoyaki::X11CaptureError Takoyaki::X11Capture::CaptureIntoBuffer(FrameView& outFrame)
+{
+    if (m_Display == nullptr)
+        return X11CaptureError::NotInitialized;
+
+    Rect rect = m_TargetRect;
+    if (!ClampToScreen(rect))
+        return X11CaptureError::InvalidRect;
+
+    if (rect != m_ClampedRect)
+    {
+        m_ClampedRect = rect;
+        m_IsDirty = true;
+    }
+
+    if (ProcessDamageEvents())
+        m_IsDirty = true;
+
+    // Without XDamage there is no way to know if anything changed, so every frame is dirty
+    if (!m_IsDirty && m_HasDamage && m_UseDamage && m_Image != nullptr)
+        return X11CaptureError::NoChange;
+
+    // A failed attach disables MIT-SHM, in which case this frame falls through to XGetImage
+    if (m_HasShm && m_UseShm && !InitializeSharedImage() && m_HasShm)
+        return X11CaptureError::CaptureFailed;
+
+    if (m_HasShm && m_UseShm)
+    {
+        if (!XShmGetImage(m_Display, m_RootWindow, m_Image, m_ClampedRect.m_X, m_ClampedRect.m_Y, AllPlanes))
+            return X11CaptureError::CaptureFailed;
+    }
+    else
+    {
+        ReleaseImage();
+        m_Image = XGetImage(m_Display, m_RootWindow, m_ClampedRect.m_X, m_ClampedRect.m_Y,
+            m_ClampedRect.m_Width, m_ClampedRect.m_Height, AllPlanes, ZPixmap);
+
+        if (m_Image == nullptr)
+            return X11CaptureError::CaptureFailed;
+    }
+
+    // Only 32bpp TrueColor is supported, which on little-endian hosts is laid out as BGRX
+    if (m_Image->bits_per_pixel != 32 || m_Image->byte_order != LSBFirst)
+        return X11CaptureError::UnsupportedFormat;
+
+    GetLastFrame(outFrame);
+
+    m_IsDirty = false;
+    return X11CaptureError::OK;
+}
+
+bool Takoyaki::X11Capture::GetLastFrame(FrameView& outFrame) const
+{
+    if (m_Image == nullptr || m_Image->bits_per_pixel != 32)
+        return false;
+
+    outFrame.m_Data = reinterpret_cast<uint8_t*>(m_Image->data);
+    outFrame.m_Width = static_cast<uint32_t>(m_Image->width);
+    outFrame.m_Height = static_cast<uint32_t>(m_Image->height);
+    outFrame.m_Stride = static_cast<uint32_t>(m_Image->bytes_per_line);
+    return true;
+}
+
+bool Takoyaki::X11Capture::UpdateCursor(CursorCompositor& compositor)
+{
+    if (!m_HasXFixes)
+        return false;
+
+#ifdef TAKOYAKI_HAS_XFIXES
+    XFixesCursorImage* image = XFixesGetCursorImage(m_Display);
+    if (image == nullptr)
+        return false;
+
+    if (!compositor.HasSprite(image->cursor_serial))
+    {
+        // Premultiplied ARGB, one pixel per unsigned long, which is 64 bits on LP64 hosts
+        m_CursorPixels.resize(static_cast<size_t>(image->width) * image->height);
+        for (size_t i = 0; i < m_CursorPixels.size(); ++i)
+            m_CursorPixels[i] = static_cast<uint32_t>(image->pixels[i]);
+
+        compositor.SetSprite(m_CursorPixels.data(), image->width, image->height, image->width, image->xhot, image->yhot, image->cursor_serial, true);
+    }
+
+    compositor.SetPosition(image->x - m_ClampedRect.m_X, image->y - m_ClampedRect.m_Y);
+
+    XFree(image);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Takoyaki::X11Capture::SetTargetRect(Rect rect)
+{
+    if (rect == m_TargetRect)
+        return;
+
+    m_TargetRect = rect;
+    m_IsDirty = true;
+}
+
+void Takoyaki::X11Capture::SetUseSharedMemory(bool useShm)
+{
+    if (useShm == m_UseShm)
+        return;
+
+    m_UseShm = useShm;
+    m_IsDirty = true;
+
+    // The two paths own their XImage differently, so never carry one over
+    ReleaseImage();
+}
+
+bool Takoyaki::X11Capture::InitializeSharedImage()
+{
+    if (m_Image != nullptr &&
+        m_Image->width == static_cast<int>(m_ClampedRect.m_Width) &&
+        m_Image->height == static_cast<int>(m_ClampedRect.m_Height))
+    {
+        return true;
+    }
+
+    ReleaseImage();
+
+    m_Image = XShmCreateImage(m_Display, m_Visual, m_Depth, ZPixmap, nullptr, &m_ShmInfo,
+        m_ClampedRect.m_Width, m_ClampedRect.m_Height);
+
+    if (m_Image == nullptr)
+        return false;
+
+    size_t requiredSize = static_cast<size_t>(m_Image->bytes_per_line) * m_Image->height;
+
+    // Keep the existing segment whenever the new region fits in it, so that shrinking or
+    // moving the selection never goes back to the kernel for a new segment.
+    if (requiredSize > m_ShmCapacity)
+    {
+        ReleaseSharedImage();
+
+        // Round up to a multiple of 64 rows so small growths do not reallocate again
+        size_t rowSize = static_cast<size_t>(m_Image->bytes_per_line);
+        size_t capacity = std::max(requiredSize, rowSize * ((m_Image->height + 63) & ~63));
+
+        m_ShmInfo.shmid = shmget(IPC_PRIVATE, capacity, IPC_CREAT | 0600);
+        if (m_ShmInfo.shmid < 0)
+        {
+            ReleaseImage();
+            return false;
+        }
+
+        m_ShmInfo.shmaddr = static_cast<char*>(shmat(m_ShmInfo.shmid, nullptr, 0));
+        m_ShmInfo.readOnly = False;
+
+        if (m_ShmInfo.shmaddr == reinterpret_cast<char*>(-1))
+        {
+            shmctl(m_ShmInfo.shmid, IPC_RMID, nullptr);
+            m_ShmInfo = {};
+            ReleaseImage();
+            return false;
+        }
+
+        g_ShmAttachFailed = false;
+        XErrorHandler previousHandler = XSetErrorHandler(ShmAttachErrorHandler);
+        XShmAttach(m_Display, &m_ShmInfo);
+        XSync(m_Display, False);
+        XSetErrorHandler(previousHandler);
+
+        // Mark the segment for removal now, it is destroyed once both sides have detached
+        shmctl(m_ShmInfo.shmid, IPC_RMID, nullptr);
+
+        if (g_ShmAttachFailed)
+        {
+            shmdt(m_ShmInfo.shmaddr);
+            m_ShmInfo = {};
+            ReleaseImage();
+
+            printf("Takoyaki: XShmAttach failed, falling back to XGetImage\n");
+            m_HasShm = false;
+            return false;
+        }
+
+        m_ShmCapacity = capacity;
+    }
+
+    m_Image->data = m_ShmInfo.shmaddr;
+    return true;
+}
+
+void Takoyaki::X11Capture::ReleaseSharedImage()
+{
+    if (m_ShmCapacity == 0)
+        return;
+
+    XShmDetach(m_Display, &m_ShmInfo);
+    XSync(m_Display, False);
+    shmdt(m_ShmInfo.shmaddr);
+
+    m_ShmInfo = {};
+    m_ShmCapacity = 0;
+}
+
+void Takoyaki::X11Capture::ReleaseImage()
+{
+    if (m_Image == nullptr)
+        return;
+
+    // Shared images point into the shm segment, which must not be freed by XDestroyImage
+    if (m_ShmCapacity != 0 && m_Image->data == m_ShmInfo.shmaddr)
+        m_Image->data = nullptr;
+
+    XDestroyImage(m_Image);
+    m_Image = nullptr;
+}
+
+void Takoyaki::X11Capture::InitializeDamage()
+{
+#ifdef TAKOYAKI_HAS_XDAMAGE
+    int errorBase = 0;
+    if (!XDamageQueryExtension(m_Display, &m_DamageEventBase, &errorBase))
+    {
+        printf("Takoyaki: XDamage is not available, every frame will be captured\n");
+        return;
+    }
+
+    // Raw rectangles lets us test each damaged area against the capture region without
+    // having to subtract and fetch regions through XFixes every frame.
+    m_Damage = XDamageCreate(m_Display, m_RootWindow, XDamageReportRawRectangles);
+    m_HasDamage = m_Damage != 0;
+#endif
+}
+
+bool Takoyaki::X11Capture::ProcessDamageEvents()
+{
+    if (!m_HasDamage)
+        return false;
+
+    bool isRegionDamaged = false;
+
+#ifdef TAKOYAKI_HAS_XDAMAGE
+    while (XPending(m_Display) > 0)
+    {
+        XEvent event;
+        XNextEvent(m_Display, &event);
+
+        if (event.type != m_DamageEventBase + XDamageNotify)
+            continue;
+
+        const XDamageNotifyEvent& damageEvent = reinterpret_cast<const XDamageNotifyEvent&>(event);
+        const XRectangle& area = damageEvent.area;
+
+        bool intersects =
+            area.x < m_ClampedRect.m_X + static_cast<int32_t>(m_ClampedRect.m_Width) &&
+            area.y < m_ClampedRect.m_Y + static_cast<int32_t>(m_ClampedRect.m_Height) &&
+            area.x + area.width > m_ClampedRect.m_X &&
+            area.y + area.height > m_ClampedRect.m_Y;
+
+        isRegionDamaged |= intersects;
+    }
+#endif
+
+    return isRegionDamaged;
+}
+
+bool Takoyaki::X11Capture::ClampToScreen(Rect& rect) const
+{
+    int32_t left = std::max(rect.m_X, 0);
+    int32_t top = std::max(rect.m_Y, 0);
+    int32_t right = std::min(rect.m_X + static_cast<int32_t>(rect.m_Width), static_cast<int32_t>(m_ScreenWidth));
+    int32_t bottom = std::min(rect.m_Y + static_cast<int32_t>(rect.m_Height), static_cast<int32_t>(m_ScreenHeight));
+
+    if (right <= left || bottom <= top)
+        return false;
+
+    rect = { left, top, static_cast<uint32_t>(right - left), static_cast<uint32_t>(bottom - top) };
+    return true;
+}
@@ -0,0 +1,120 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+
+#include <vector>
+#include "cursorcompositor.h"
+#include "frame.h"
+
+namespace Takoyaki
+{
+    enum class X11CaptureError
+    {
+        OK,
+        NoChange,
+        NotInitialized,
+        InvalidRect,
+        UnsupportedFormat,
+        CaptureFailed,
+    };
+
+    // Native capture backend for X11 desktops. Grabs a region of the root window into a
+    // MIT-SHM segment that is kept alive across frames, and uses XDamage (when available)
+    // to skip frames where nothing inside the region has changed.
+    class X11Capture
+    {
+    public:
+        X11Capture() = default;
+        ~X11Capture();
+
+        bool Initialize(const char* displayName = nullptr);
+        void Shutdown();
+
+        // Captures the current target rect. On success, outFrame points into memory owned
+        // by the backend and stays valid until the next call to CaptureIntoBuffer.
+        X11CaptureError CaptureIntoBuffer(FrameView& outFrame);
+
+        // The image from the last capture, which NoChange leaves as it was, so the cursor
+        // can be drawn into it again without capturing
+        bool GetLastFrame(FrameView& outFrame) const;
+
+        // Gives compositor the cursor shape, converted only when it changes, and its position
+        // relative to the target rect. Returns false when XFixes is not available.
+        bool UpdateCursor(CursorCompositor& compositor);
+
+    public:
+        inline Rect GetTargetRect() const { return m_TargetRect; }
+
+        // The target rect clamped to the screen, as of the last capture
+        inline Rect GetClampedRect() const { return m_ClampedRect; }
+        void SetTargetRect(Rect rect);
+
+        // Forces the plain XGetImage path, mostly useful to compare against MIT-SHM.
+        void SetUseSharedMemory(bool useShm);
+        inline bool IsUsingSharedMemory() const { return m_UseShm; }
+        inline bool IsSharedMemoryAvailable() const { return m_HasShm; }
+
+        // Captures every frame even when XDamage saw no change, to measure the copy itself
+        inline void SetUseDamage(bool useDamage) { m_UseDamage = useDamage; }
+        inline bool IsDamageAvailable() const { return m_HasDamage; }
+        inline bool IsCursorAvailable() const { return m_HasXFixes; }
+        inline Rect GetScreenRect() const { return { 0, 0, m_ScreenWidth, m_ScreenHeight }; }
+
+    private:
+        bool InitializeSharedImage();
+        void ReleaseSharedImage();
+        void ReleaseImage();
+
+        void InitializeDamage();
+        bool ProcessDamageEvents();
+
+        bool ClampToScreen(Rect& rect) const;
+
+    private:
+        Display* m_Display = nullptr;
+        Window m_RootWindow = 0;
+        Visual* m_Visual = nullptr;
+        int m_Depth = 0;
+        uint32_t m_ScreenWidth = 0;
+        uint32_t m_ScreenHeight = 0;
+
+        Rect m_TargetRect = { 0, 0, 1, 1 };
+        Rect m_ClampedRect = { 0, 0, 0, 0 };
+
+        XImage* m_Image = nullptr;
+        XShmSegmentInfo m_ShmInfo = {};
+        size_t m_ShmCapacity = 0;
+        bool m_HasShm = false;
+        bool m_UseShm = true;
+
+        unsigned long m_Damage = 0;
+        int m_DamageEventBase = 0;
+        bool m_HasDamage = false;
+        bool m_UseDamage = true;
+        bool m_IsDirty = true;
+
+        bool m_HasXFixes = false;
+        std::vector<uint32_t> m_CursorPixels;
+    };
+}
@@ -21,6 +21,17 @@
 #include "resource.h"
 #include "outputmanager.h"
 #include "overlaymanager.h"
+#include "framepipeline.h"
+#include "startuptimeline.h"
+#include "edgemap.h"
+#include "memorybudget.h"
+#include "selectioncontroller.h"
+#include "kernels/pixelkernels.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <shlobj.h>
 
 // Coredump for crashes
 #include <dbghelp.h>
@@ -33,36 +44,140 @@
 #define IDM_LABEL                       101
 #define IDM_STARTCAPTURE                102
 #define IDM_STOPCAPTURE                 103
+#define IDM_FIXEDCANVAS                 104
+#define IDM_SCREENSHOT                  105
 
-bool g_Enabled = false;
-bool g_IsOverlayActive = false;
-bool g_IsSelectingRegion = false;
+bool g_UseFixedCanvas = false;
+bool g_ScreenshotRequested = false;
 
-POINT g_StartPoint, g_EndPoint;
+// Overlay, selection and capture state, fed by WndProc and KeyboardProc and read by the
+// message loop and the pipeline stages, which all run on the main thread
+Takoyaki::SelectionController g_Selection;
 
-Tako::TakoRect g_CaptureRect = {
-    .m_X = 0,
-    .m_Y = 0,
-    .m_Width = 1,
-    .m_Height = 1,
-};
-
-Tako::TakoRect g_SelectionRect = {
-    .m_X = 0,
-    .m_Y = 0,
-    .m_Width = 1,
-    .m_Height = 1,
-};
+// Window borders the selection snaps to, from a snapshot taken as the overlay opens
+Takoyaki::EdgeMap g_EdgeMap;
+constexpr int32_t g_SnapRadius = 8;
 
 LRESULT CALLBACK WndProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 LRESULT CALLBACK KeyboardProc(int nCode, WPARAM wParam, LPARAM lParam);
 
+// Pictures\Takoyaki\Takoyaki <date> <time>.png, falling back to the working directory
+std::filesystem::path GetScreenshotPath()
+{
+    std::filesystem::path directory;
+
+    PWSTR pictures = nullptr;
+    if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_Pictures, 0, nullptr, &pictures)))
+        directory = std::filesystem::path(pictures) / L"Takoyaki";
+
+    CoTaskMemFree(pictures);
+
+    std::error_code error;
+    if (!directory.empty() && !std::filesystem::create_directories(directory, error) && error)
+        directory.clear();
+
+    return directory / Takoyaki::ScreenshotWriter::MakeFileName(std::chrono::system_clock::now());
+}
+
+// Copies the virtual screen with GDI and indexes its edges in the background. The copy has
+// to finish before the overlay is shown, or the overlay would be in it.
+void BuildEdgeMap()
+{
+    const int32_t x = GetSystemMetrics(SM_XVIRTUALSCREEN);
+    const int32_t y = GetSystemMetrics(SM_YVIRTUALSCREEN);
+    const int32_t width = GetSystemMetrics(SM_CXVIRTUALSCREEN);
+    const int32_t height = GetSystemMetrics(SM_CYVIRTUALSCREEN);
+
+    if (width <= 0 || height <= 0)
+        return;
+
+    // The bitmap, for as long as this runs, and the copy handed to the edge map, which the
+    // edge map holds until it is done with it. Snapping is only a convenience, so under a
+    // tight memory budget the overlay opens without it.
+    const size_t snapshotBytes = static_cast<size_t>(width) * height * 4;
+    Takoyaki::MemoryReservation snapshotMemory;
+    Takoyaki::MemoryReservation pixelMemory;
+    if (!snapshotMemory.TryReset(Takoyaki::MemoryCategory::Snapshot, snapshotBytes) ||
+        !pixelMemory.TryReset(Takoyaki::MemoryCategory::Snapshot, snapshotBytes))
+    {
+        g_EdgeMap.Clear();
+        return;
+    }
+
+    BITMAPINFO info = {};
+    info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    info.bmiHeader.biWidth = width;
+    info.bmiHeader.biHeight = -height; // Top down
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+
+    HDC screen = GetDC(nullptr);
+    HDC memory = CreateCompatibleDC(screen);
+    void* bits = nullptr;
+    HBITMAP bitmap = CreateDIBSection(screen, &info, DIB_RGB_COLORS, &bits, nullptr, 0);
+
+    if (bitmap != nullptr)
+    {
+        HGDIOBJ previous = SelectObject(memory, bitmap);
+
+        if (BitBlt(memory, 0, 0, width, height, screen, x, y, SRCCOPY))
+        {
+            GdiFlush();
+
+            const uint32_t* pixels = static_cast<const uint32_t*>(bits);
+            g_EdgeMap.BuildAsync(std::vector<uint32_t>(pixels, pixels + static_cast<size_t>(width) * height), width, height, x, y, std::move(pixelMemory));
+        }
+
+        SelectObject(memory, previous);
+        DeleteObject(bitmap);
+    }
+
+    DeleteDC(memory);
+    ReleaseDC(nullptr, screen);
+}
+
+// Moves a point onto the nearest window borders within g_SnapRadius, if the edge map is ready
+void SnapPoint(POINT& point)
+{
+    int32_t x = point.x;
+    int32_t y = point.y;
+
+    if (g_EdgeMap.Snap(x, y, g_SnapRadius))
+        point = { x, y };
+}
+
+Tako::TakoRect ToTakoRect(const Takoyaki::Rect& rect)
+{
+    Tako::TakoRect takoRect;
+    takoRect.m_X = rect.m_X;
+    takoRect.m_Y = rect.m_Y;
+    takoRect.m_Width = rect.m_Width;
+    takoRect.m_Height = rect.m_Height;
+
+    return takoRect;
+}
+
 int WINAPI WinMain(
     _In_ HINSTANCE hInstance,
     _In_opt_ HINSTANCE hPrevInstaunce,
     _In_ LPSTR lpCmdLine,
     _In_ int nShowCmd)
 {
+    // Starts the startup timeline
+    Takoyaki::GetStartupTimeline();
+
+    // --prewarm creates the output device in the background and the overlay windows right
+    // after the tray icon, instead of on first use
+    const bool usePrewarm = lpCmdLine != nullptr && strstr(lpCmdLine, "--prewarm") != nullptr;
+
+    // --budget <MB> caps the pixel memory of snapshots, capture and output. Past it, the
+    // overlay snapshot is taken at a lower resolution and the fixed canvas is sized for the
+    // region instead of the whole desktop.
+    const char* budgetArgument = lpCmdLine != nullptr ? strstr(lpCmdLine, "--budget ") : nullptr;
+    if (budgetArgument != nullptr)
+        Takoyaki::GetMemoryBudget().SetBudget(strtoull(budgetArgument + strlen("--budget "), nullptr, 10) * 1024 * 1024);
+
     // Prevent multiple instances of Takoyaki
     CreateMutexA(0, false, "Local\\Takoyaki");
     if (GetLastError() == ERROR_ALREADY_EXISTS)
@@ -76,8 +191,23 @@ int WINAPI WinMain(
     FILE* fp;
     freopen_s(&fp, "CONOUT$", "w", stdout);
     printf("Takoyaki debug console enabled\n");
+
+    // Validate every SIMD variant this machine can run against the scalar kernels
+    {
+        Takoyaki::ScopedStartupPhase phase("kernel conformance");
+        for (uint32_t i = 0; i <= static_cast<uint32_t>(Takoyaki::DetectSimdLevel()); ++i)
+        {
+            const Takoyaki::SimdLevel level = static_cast<Takoyaki::SimdLevel>(i);
+            if (!Takoyaki::CheckPixelKernelConformance(level))
+                printf("Takoyaki: %s pixel kernels FAILED conformance, run with TAKOYAKI_SIMD_LEVEL below it\n", Takoyaki::GetSimdLevelName(level));
+        }
+    }
+
+    printf("Pixel kernels bound to %s\n", Takoyaki::GetSimdLevelName(Takoyaki::GetPixelKernels().m_Level));
 #endif
 
+    Takoyaki::StartupTimeline::Clock::time_point windowStart = Takoyaki::StartupTimeline::Clock::now();
+
     // Register the window class
     WNDCLASS wc = { 0 };
     wc.lpfnWndProc = WndProc;
@@ -104,6 +234,9 @@ int WINAPI WinMain(
     HMODULE hModule = GetModuleHandle(NULL);
     HHOOK keyboardHook = SetWindowsHookEx(WH_KEYBOARD_LL, KeyboardProc, hModule, 0);
 
+    Takoyaki::GetStartupTimeline().AddPhase("message window", windowStart, Takoyaki::StartupTimeline::Clock::now());
+
+    Takoyaki::StartupTimeline::Clock::time_point takoStart = Takoyaki::StartupTimeline::Clock::now();
     Tako::TakoError err = Tako::Initialize();
     if (err != Tako::TakoError::OK)
     {
@@ -111,12 +244,56 @@ int WINAPI WinMain(
         return 0;
     }
 
+    Takoyaki::GetStartupTimeline().AddPhase("Tako.dll", takoStart, Takoyaki::StartupTimeline::Clock::now());
+
+    // Neither creates anything yet, the overlay windows wait for the first Shift+Win+X and
+    // the output for the first capture
     Takoyaki::OutputManager outputManager;
     Takoyaki::OverlayManager overlayManager;
 
     outputManager.Initialize();
     overlayManager.Initialize();
 
+    outputManager.SetCloseCallback([]() { g_Selection.SetCapturing(false); });
+
+    if (usePrewarm)
+        outputManager.Prewarm();
+
+    // Capture and render run as pipeline stages. They share the D3D immediate context and the
+    // output state with the message loop, so the executor has no workers of its own and the
+    // loop polls it. Every capture goes into the same shared texture, so only one frame can
+    // wait between the two.
+    Takoyaki::Executor executor(0);
+    Takoyaki::FramePipeline pipeline(executor);
+    Tako::TakoError captureError = Tako::TakoError::OK;
+
+    pipeline.AddSource("capture", [&](Takoyaki::PipelineFrame& frame)
+    {
+        if (!g_Selection.IsCapturing() || g_Selection.IsOverlayActive() || !outputManager.IsReady())
+            return Takoyaki::StageResult::Drop;
+
+        captureError = Tako::CaptureIntoBuffer(outputManager.GetSharedTextureHandle(), ToTakoRect(g_Selection.GetCaptureRect()));
+        if (captureError != Tako::TakoError::OK)
+            return Takoyaki::StageResult::Stop;
+
+        frame.m_Region = g_Selection.GetCaptureRect();
+        return Takoyaki::StageResult::Continue;
+    });
+
+    pipeline.AddStage("render", [&](Takoyaki::PipelineFrame& frame)
+    {
+        // A new region recreates the shared texture, losing what was captured into the old one
+        if (!g_Selection.IsCapturing() || frame.m_Region != g_Selection.GetCaptureRect())
+            return Takoyaki::StageResult::Drop;
+
+        if (outputManager.Render())
+            g_Selection.OnFramePresented();
+
+        return Takoyaki::StageResult::Continue;
+    }, 1);
+
+    pipeline.Start();
+
     // Add the icon to the system tray
     NOTIFYICONDATA nid = { 0 };
     nid.cbSize = sizeof(nid);
@@ -127,6 +304,11 @@ int WINAPI WinMain(
     nid.hIcon = LoadIcon(hInstance, MAKEINTRESOURCE(IDI_ICON1));
     lstrcpy(nid.szTip, L"Takoyaki");
     Shell_NotifyIcon(NIM_ADD, &nid);
+    Takoyaki::GetStartupTimeline().Mark("tray");
+
+    // Windows belong to the thread that created them, so the overlay can only be prewarmed here
+    if (usePrewarm)
+        overlayManager.Prewarm();
 
     // Run the message loop
     MSG msg = { 0 };
@@ -139,34 +321,61 @@ int WINAPI WinMain(
             DispatchMessage(&msg);
         }
 
-        overlayManager.SetEnabled(g_IsOverlayActive);
-        outputManager.SetEnabled(g_Enabled);
+        // The snapshot has to be taken before the overlay is shown
+        if (g_Selection.IsOverlayActive() && !g_Selection.IsOverlayShown())
+            BuildEdgeMap();
 
-        if (g_IsOverlayActive)
+        overlayManager.SetEnabled(g_Selection.IsOverlayActive());
+
+        // Region and mode first, so the output that the first capture creates is sized for
+        // them rather than created at the default size and resized straight away
+        outputManager.SetOutputMode(g_UseFixedCanvas ? Takoyaki::OutputMode::FixedCanvas : Takoyaki::OutputMode::MatchRegion);
+        outputManager.SetTargetRect(ToTakoRect(g_Selection.GetCaptureRect()));
+        outputManager.SetEnabled(g_Selection.IsCapturing());
+
+        if (g_Selection.IsOverlayActive())
         {
             SetCapture(hwnd); // Grab Mouse Events
-            overlayManager.SetSelectionRect(g_SelectionRect);
+            overlayManager.SetSelectionRect(ToTakoRect(g_Selection.GetSelectionRect()));
             overlayManager.Update();
+            g_Selection.OnOverlayShown();
         }
         else
         {
             ReleaseCapture(); // Release Mouse Events
-            outputManager.SetTargetRect(g_CaptureRect);
 
-            if (!g_Enabled)
-                continue;
+            // Screenshots are read back a frame or two after they were taken, even if the
+            // capture has been stopped in between
+            outputManager.PollScreenshot();
+            if (g_ScreenshotRequested)
+            {
+                g_ScreenshotRequested = false;
+                outputManager.RequestScreenshot(GetScreenshotPath());
+            }
 
-            Tako::TakoError err = Tako::CaptureIntoBuffer(outputManager.GetSharedTextureHandle(), g_CaptureRect);
-            if (err != Tako::TakoError::OK)
+            if (g_Selection.IsCapturing() && !outputManager.IsReady())
             {
-                MessageBox(nullptr, L"Failed to capture display buffer. (Tako.dll)", L"Takoyaki Error", MB_OK);
+                MessageBox(nullptr, L"Failed to initialize the output window.", L"Takoyaki Error", MB_OK);
                 break;
             }
 
-            outputManager.Render();
+            executor.Poll();
+
+            if (captureError != Tako::TakoError::OK)
+            {
+                MessageBox(nullptr, L"Failed to capture display buffer. (Tako.dll)", L"Takoyaki Error", MB_OK);
+                break;
+            }
         }
     }
 
+    pipeline.Stop();
+    pipeline.Wait();
+
+    printf("%s", g_Selection.GetReport().c_str());
+    printf("%s", outputManager.GetFrameSyncReport().c_str());
+    printf("%s", Takoyaki::GetMemoryBudget().GetReport().c_str());
+
     // Remove the icon from the system tray
     Shell_NotifyIcon(NIM_DELETE, &nid);
 
@@ -183,46 +392,31 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
     switch (msg)
     {
     case WM_LBUTTONDOWN:
-        if (!g_IsOverlayActive)
-            break;
-        if (g_IsSelectingRegion)
+    {
+        if (g_Selection.GetState() != Takoyaki::SelectionState::Overlay)
             break;
 
-        GetPhysicalCursorPos(&g_StartPoint);
-        g_IsSelectingRegion = true;
+        POINT point;
+        GetPhysicalCursorPos(&point);
+        SnapPoint(point);
+        g_Selection.OnPointerDown(point.x, point.y);
         break;
+    }
 
     case WM_MOUSEMOVE:
-        if (!g_IsOverlayActive)
-            break;
-
-        if (!g_IsSelectingRegion)
+    {
+        if (g_Selection.GetState() != Takoyaki::SelectionState::Selecting)
             break;
 
-
-        GetPhysicalCursorPos(&g_EndPoint);
-
-        g_SelectionRect =
-        {
-            std::min(g_StartPoint.x, g_EndPoint.x),
-            std::min(g_StartPoint.y, g_EndPoint.y),
-            static_cast<uint32_t>(std::max(1l, std::abs(g_StartPoint.x - g_EndPoint.x))),
-            static_cast<uint32_t>(std::max(1l, std::abs(g_StartPoint.y - g_EndPoint.y)))
-        };
-
+        POINT point;
+        GetPhysicalCursorPos(&point);
+        SnapPoint(point);
+        g_Selection.OnPointerMove(point.x, point.y);
         break;
+    }
 
     case WM_LBUTTONUP:
-        if (!g_IsOverlayActive)
-            break;
-        if (!g_IsSelectingRegion)
-            break;
-
-        g_IsSelectingRegion = false;
-        g_IsOverlayActive = false;
-        g_CaptureRect = g_SelectionRect;
-        g_SelectionRect = { 0, 0, 1, 1 };
-        g_Enabled = true;
+        g_Selection.OnPointerUp();
         break;
 
     case WM_USER:
@@ -234,18 +428,20 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
             GetCursorPos(&pt);
             HMENU hMenu = CreatePopupMenu();
 
-            if (g_Enabled)
+            if (g_Selection.IsCapturing())
                 AppendMenu(hMenu, MF_GRAYED, IDM_LABEL, L"Status: Capturing");
             else
                 AppendMenu(hMenu, MF_GRAYED, IDM_LABEL, L"Status: Stopped");
 
             AppendMenu(hMenu, MF_SEPARATOR, 0, NULL); // Add separator
 
-            if (g_Enabled)
+            if (g_Selection.IsCapturing())
                 AppendMenu(hMenu, MF_STRING, IDM_STOPCAPTURE, L"Stop Capture");
             else
                 AppendMenu(hMenu, MF_STRING, IDM_STARTCAPTURE, L"Start Capture");
 
+            AppendMenu(hMenu, MF_STRING | (g_Selection.IsCapturing() ? 0 : MF_GRAYED), IDM_SCREENSHOT, L"Save Screenshot");
+            AppendMenu(hMenu, MF_STRING | (g_UseFixedCanvas ? MF_CHECKED : MF_UNCHECKED), IDM_FIXEDCANVAS, L"Fixed 1080p Output");
             AppendMenu(hMenu, MF_STRING, IDM_EXIT, L"Exit");
             TrackPopupMenu(hMenu, TPM_RIGHTBUTTON, pt.x, pt.y, 0, hwnd, NULL);
         }
@@ -258,12 +454,22 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
         }
         else if (lParam == 0 && LOWORD(wParam) == IDM_STARTCAPTURE)
         {
-            g_Enabled = true;
+            g_Selection.SetCapturing(true);
             break;
         }
         else if (lParam == 0 && LOWORD(wParam) == IDM_STOPCAPTURE)
         {
-            g_Enabled = false;
+            g_Selection.SetCapturing(false);
+            break;
+        }
+        else if (lParam == 0 && LOWORD(wParam) == IDM_SCREENSHOT)
+        {
+            g_ScreenshotRequested = true;
+            break;
+        }
+        else if (lParam == 0 && LOWORD(wParam) == IDM_FIXEDCANVAS)
+        {
+            g_UseFixedCanvas = !g_UseFixedCanvas;
             break;
         }
         break;
@@ -291,21 +497,16 @@ LRESULT CALLBACK KeyboardProc(int nCode, WPARAM wParam, LPARAM lParam)
         // Check if the WIN+SHIFT+X key combination was pressed.
         if (pKeyData->vkCode == X_KEY && (GetKeyState(VK_LWIN) & 0x8000) && (GetKeyState(VK_SHIFT) & 0x8000))
         {
-            if (g_IsOverlayActive)
+            if (!g_Selection.OnHotkey())
                 return CallNextHookEx(NULL, nCode, wParam, lParam);
 
-            g_IsOverlayActive = true;
             return 1;
         }
         else if (pKeyData->vkCode == ESC_KEY)
         {
-            if (!g_IsOverlayActive)
+            if (!g_Selection.OnCancel())
                 return CallNextHookEx(NULL, nCode, wParam, lParam);
 
-            g_IsOverlayActive = false;
-            g_IsSelectingRegion = false;
-            g_SelectionRect = { 0, 0, 1, 1 };
-
             return 1;
         }
     }
@@ -0,0 +1,296 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "memorybudget.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+
+namespace
+{
+    // A reclaimer can hand memory to one that already ran, like a pool trimming into the
+    // allocator cache, so a second pass picks that up
+    constexpr uint32_t ReclaimPasses = 2;
+
+    double ToMegabytes(size_t bytes)
+    {
+        return bytes / (1024.0 * 1024.0);
+    }
+}
+
+bool Takoyaki::MemoryBudget::Reserve(MemoryCategory category, size_t bytes)
+{
+    size_t shortfall = GetShortfall(bytes);
+    if (shortfall != 0)
+        Reclaim(shortfall);
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    if (m_Stats.m_Budget != 0 && m_Stats.m_TotalBytes + bytes > m_Stats.m_Budget)
+    {
+        ++m_Stats.m_DeniedReservations;
+        return false;
+    }
+
+    MemoryCategoryUsage& usage = m_Stats.m_Categories[static_cast<size_t>(category)];
+    usage.m_Bytes += bytes;
+    usage.m_PeakBytes = std::max(usage.m_PeakBytes, usage.m_Bytes);
+    ++usage.m_Buffers;
+
+    m_Stats.m_TotalBytes += bytes;
+    m_Stats.m_PeakTotalBytes = std::max(m_Stats.m_PeakTotalBytes, m_Stats.m_TotalBytes);
+    return true;
+}
+
+void Takoyaki::MemoryBudget::Charge(MemoryCategory category, size_t bytes)
+{
+    size_t shortfall = GetShortfall(bytes);
+    if (shortfall != 0)
+        Reclaim(shortfall);
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    if (m_Stats.m_Budget != 0 && m_Stats.m_TotalBytes + bytes > m_Stats.m_Budget)
+        ++m_Stats.m_OverBudgetCharges;
+
+    MemoryCategoryUsage& usage = m_Stats.m_Categories[static_cast<size_t>(category)];
+    usage.m_Bytes += bytes;
+    usage.m_PeakBytes = std::max(usage.m_PeakBytes, usage.m_Bytes);
+    ++usage.m_Buffers;
+
+    m_Stats.m_TotalBytes += bytes;
+    m_Stats.m_PeakTotalBytes = std::max(m_Stats.m_PeakTotalBytes, m_Stats.m_TotalBytes);
+}
+
+void Takoyaki::MemoryBudget::Release(MemoryCategory category, size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    MemoryCategoryUsage& usage = m_Stats.m_Categories[static_cast<size_t>(category)];
+    usage.m_Bytes -= bytes;
+    --usage.m_Buffers;
+
+    m_Stats.m_TotalBytes -= bytes;
+}
+
+void Takoyaki::MemoryBudget::Transfer(MemoryCategory from, MemoryCategory to, size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    MemoryCategoryUsage& source = m_Stats.m_Categories[static_cast<size_t>(from)];
+    source.m_Bytes -= bytes;
+    --source.m_Buffers;
+
+    MemoryCategoryUsage& destination = m_Stats.m_Categories[static_cast<size_t>(to)];
+    destination.m_Bytes += bytes;
+    destination.m_PeakBytes = std::max(destination.m_PeakBytes, destination.m_Bytes);
+    ++destination.m_Buffers;
+}
+
+size_t Takoyaki::MemoryBudget::Reclaim(size_t bytesWanted)
+{
+    std::lock_guard<std::mutex> reclaimLock(m_ReclaimMutex);
+
+    size_t startBytes;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        startBytes = m_Stats.m_TotalBytes;
+        ++m_Stats.m_ReclaimRuns;
+    }
+
+    size_t freedBytes = 0;
+
+    for (uint32_t pass = 0; pass < ReclaimPasses && freedBytes < bytesWanted; ++pass)
+    {
+        for (const Reclaimer& reclaimer : m_Reclaimers)
+        {
+            reclaimer.m_Reclaim(bytesWanted - freedBytes);
+
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            freedBytes = startBytes > m_Stats.m_TotalBytes ? startBytes - m_Stats.m_TotalBytes : 0;
+
+            if (freedBytes >= bytesWanted)
+                break;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Stats.m_ReclaimedBytes += freedBytes;
+    return freedBytes;
+}
+
+uint32_t Takoyaki::MemoryBudget::AddReclaimer(const char* name, ReclaimFn reclaim)
+{
+    std::lock_guard<std::mutex> lock(m_ReclaimMutex);
+
+    uint32_t id = m_NextReclaimerId++;
+    m_Reclaimers.push_back({ id, name, std::move(reclaim) });
+    return id;
+}
+
+void Takoyaki::MemoryBudget::RemoveReclaimer(uint32_t id)
+{
+    std::lock_guard<std::mutex> lock(m_ReclaimMutex);
+    std::erase_if(m_Reclaimers, [id](const Reclaimer& reclaimer) { return reclaimer.m_Id == id; });
+}
+
+void Takoyaki::MemoryBudget::SetBudget(size_t bytes)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stats.m_Budget = bytes;
+    }
+
+    size_t shortfall = GetShortfall(0);
+    if (shortfall != 0)
+        Reclaim(shortfall);
+}
+
+size_t Takoyaki::MemoryBudget::GetBudget() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Stats.m_Budget;
+}
+
+Takoyaki::MemoryBudgetStats Takoyaki::MemoryBudget::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Stats;
+}
+
+std::string Takoyaki::MemoryBudget::GetReport() const
+{
+    MemoryBudgetStats stats = GetStats();
+    char line[160];
+    std::string report;
+
+    if (stats.m_Budget != 0)
+        snprintf(line, sizeof(line), "Pixel memory: %.1f MB of %.1f MB budget, peak %.1f MB\n", ToMegabytes(stats.m_TotalBytes), ToMegabytes(stats.m_Budget), ToMegabytes(stats.m_PeakTotalBytes));
+    else
+        snprintf(line, sizeof(line), "Pixel memory: %.1f MB, no budget, peak %.1f MB\n", ToMegabytes(stats.m_TotalBytes), ToMegabytes(stats.m_PeakTotalBytes));
+
+    report += line;
+
+    for (size_t i = 0; i < MemoryCategoryCount; ++i)
+    {
+        const MemoryCategoryUsage& usage = stats.m_Categories[i];
+        snprintf(line, sizeof(line), "  %-10s %9.1f MB in %4u buffers, peak %9.1f MB\n",
+            GetCategoryName(static_cast<MemoryCategory>(i)), ToMegabytes(usage.m_Bytes), usage.m_Buffers, ToMegabytes(usage.m_PeakBytes));
+        report += line;
+    }
+
+    snprintf(line, sizeof(line), "  %llu reclaims freed %.1f MB, %llu reservations denied, %llu charges over budget\n",
+        static_cast<unsigned long long>(stats.m_ReclaimRuns), ToMegabytes(stats.m_ReclaimedBytes),
+        static_cast<unsigned long long>(stats.m_DeniedReservations), static_cast<unsigned long long>(stats.m_OverBudgetCharges));
+    report += line;
+
+    return report;
+}
+
+const char* Takoyaki::MemoryBudget::GetCategoryName(MemoryCategory category)
+{
+    switch (category)
+    {
+    case MemoryCategory::Snapshot: return "snapshot";
+    case MemoryCategory::Capture: return "capture";
+    case MemoryCategory::Output: return "output";
+    case MemoryCategory::Scratch: return "scratch";
+    case MemoryCategory::Cached: return "cached";
+    default: return "unknown";
+    }
+}
+
+size_t Takoyaki::MemoryBudget::GetShortfall(size_t bytes) const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    if (m_Stats.m_Budget == 0 || m_Stats.m_TotalBytes + bytes <= m_Stats.m_Budget)
+        return 0;
+
+    return m_Stats.m_TotalBytes + bytes - m_Stats.m_Budget;
+}
+
+Takoyaki::MemoryBudget& Takoyaki::GetMemoryBudget()
+{
+    static MemoryBudget budget;
+    return budget;
+}
+
+Takoyaki::MemoryReservation::MemoryReservation(MemoryCategory category, size_t bytes)
+{
+    Reset(category, bytes);
+}
+
+Takoyaki::MemoryReservation::MemoryReservation(MemoryReservation&& other) noexcept
+    : m_Category(other.m_Category)
+    , m_Bytes(std::exchange(other.m_Bytes, 0))
+{
+}
+
+Takoyaki::MemoryReservation::~MemoryReservation()
+{
+    Reset();
+}
+
+Takoyaki::MemoryReservation& Takoyaki::MemoryReservation::operator=(MemoryReservation&& other) noexcept
+{
+    if (this != &other)
+    {
+        Reset();
+        m_Category = other.m_Category;
+        m_Bytes = std::exchange(other.m_Bytes, 0);
+    }
+
+    return *this;
+}
+
+void Takoyaki::MemoryReservation::Reset()
+{
+    if (m_Bytes != 0)
+        GetMemoryBudget().Release(m_Category, std::exchange(m_Bytes, 0));
+}
+
+void Takoyaki::MemoryReservation::Reset(MemoryCategory category, size_t bytes)
+{
+    Reset();
+
+    if (bytes == 0)
+        return;
+
+    GetMemoryBudget().Charge(category, bytes);
+    m_Category = category;
+    m_Bytes = bytes;
+}
+
+bool Takoyaki::MemoryReservation::TryReset(MemoryCategory category, size_t bytes)
+{
+    Reset();
+
+    if (bytes == 0)
+        return true;
+
+    if (!GetMemoryBudget().Reserve(category, bytes))
+        return false;
+
+    m_Category = category;
+    m_Bytes = bytes;
+    return true;
+}
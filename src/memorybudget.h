@@ -0,0 +1,157 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Takoyaki
+{
+    enum class MemoryCategory
+    {
+        Snapshot,   // Full screen snapshots behind the selection overlay
+        Capture,    // Captured frames and the pools they come from
+        Output,     // Shared textures, swap chains and reconstructed output frames
+        Scratch,    // Per-stage working memory
+        Cached,     // Freed blocks kept by the frame allocator for reuse
+        Count,
+    };
+
+    static constexpr size_t MemoryCategoryCount = static_cast<size_t>(MemoryCategory::Count);
+
+    struct MemoryCategoryUsage
+    {
+        size_t m_Bytes = 0;
+        size_t m_PeakBytes = 0;
+        uint32_t m_Buffers = 0;
+    };
+
+    struct MemoryBudgetStats
+    {
+        std::array<MemoryCategoryUsage, MemoryCategoryCount> m_Categories;
+
+        size_t m_TotalBytes = 0;
+        size_t m_PeakTotalBytes = 0;
+        size_t m_Budget = 0;
+
+        uint64_t m_ReclaimRuns = 0;
+        uint64_t m_ReclaimedBytes = 0;
+        uint64_t m_DeniedReservations = 0;
+        uint64_t m_OverBudgetCharges = 0;
+    };
+
+    // Process-wide account of pixel memory, split by category. With a budget set, anything
+    // that would go over it first runs the registered reclaimers, which drop caches and idle
+    // buffers, in the order they were added. Reserve then refuses what still does not fit, so
+    // the caller can fall back to something smaller, while Charge records it anyway for
+    // memory the pipeline cannot do without.
+    class MemoryBudget
+    {
+    public:
+        // Asked to free at least bytesWanted. Must release what it frees through this budget,
+        // and must not take a lock that is held anywhere memory is charged.
+        using ReclaimFn = std::function<void(size_t bytesWanted)>;
+
+        MemoryBudget() = default;
+        ~MemoryBudget() = default;
+
+        MemoryBudget(const MemoryBudget&) = delete;
+        MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+        bool Reserve(MemoryCategory category, size_t bytes);
+        void Charge(MemoryCategory category, size_t bytes);
+        void Release(MemoryCategory category, size_t bytes);
+
+        // Moves bytes between categories without touching the budget, such as a freed block
+        // going into the allocator cache
+        void Transfer(MemoryCategory from, MemoryCategory to, size_t bytes);
+
+        // Runs the reclaimers until the total is at least bytesWanted lower, returns what was freed
+        size_t Reclaim(size_t bytesWanted);
+
+        uint32_t AddReclaimer(const char* name, ReclaimFn reclaim);
+        void RemoveReclaimer(uint32_t id);
+
+    public:
+        // Zero means unlimited. Lowering the budget below the current total reclaims right away.
+        void SetBudget(size_t bytes);
+        size_t GetBudget() const;
+
+        MemoryBudgetStats GetStats() const;
+        std::string GetReport() const;
+
+        static const char* GetCategoryName(MemoryCategory category);
+
+    private:
+        // Bytes that have to be freed before bytes more fit, or zero
+        size_t GetShortfall(size_t bytes) const;
+
+    private:
+        struct Reclaimer
+        {
+            uint32_t m_Id = 0;
+            const char* m_Name = nullptr;
+            ReclaimFn m_Reclaim;
+        };
+
+        mutable std::mutex m_Mutex;
+        MemoryBudgetStats m_Stats;
+
+        // Held while reclaiming, so a reclaimer is never removed while it runs
+        std::mutex m_ReclaimMutex;
+        std::vector<Reclaimer> m_Reclaimers;
+        uint32_t m_NextReclaimerId = 1;
+    };
+
+    MemoryBudget& GetMemoryBudget();
+
+    // Charges a fixed amount for as long as it lives, for buffers that are not allocated
+    // through the frame allocator, such as GPU textures and GDI bitmaps
+    class MemoryReservation
+    {
+    public:
+        MemoryReservation() = default;
+        MemoryReservation(MemoryCategory category, size_t bytes);
+        MemoryReservation(MemoryReservation&& other) noexcept;
+        ~MemoryReservation();
+
+        MemoryReservation(const MemoryReservation&) = delete;
+        MemoryReservation& operator=(const MemoryReservation&) = delete;
+        MemoryReservation& operator=(MemoryReservation&& other) noexcept;
+
+        void Reset();
+        void Reset(MemoryCategory category, size_t bytes);
+
+        // Like Reset, but through Reserve, so nothing is held if the budget refuses it
+        bool TryReset(MemoryCategory category, size_t bytes);
+
+        inline size_t GetSize() const { return m_Bytes; }
+
+    private:
+        MemoryCategory m_Category = MemoryCategory::Scratch;
+        size_t m_Bytes = 0;
+    };
+}
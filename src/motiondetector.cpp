@@ -0,0 +1,324 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "motiondetector.h"
+#include "kernels/pixelkernels.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // Index of the first and one past the last pixel that differs between two rows
+    bool FindRowDifference(const uint32_t* previous, const uint32_t* current, uint32_t width, uint32_t& outLeft, uint32_t& outRight)
+    {
+        if (memcmp(previous, current, static_cast<size_t>(width) * 4) == 0)
+            return false;
+
+        uint32_t left = 0;
+        while (previous[left] == current[left])
+            ++left;
+
+        uint32_t right = width;
+        while (previous[right - 1] == current[right - 1])
+            --right;
+
+        outLeft = left;
+        outRight = right;
+        return true;
+    }
+}
+
+void Takoyaki::MotionDetector::Detect(const FrameView& previous, const FrameView& current, MotionResult& outResult)
+{
+    outResult.m_Copies.clear();
+    outResult.m_DirtyRects.clear();
+
+    if (!current.IsValid())
+        return;
+
+    if (!previous.IsValid() || previous.m_Width != current.m_Width || previous.m_Height != current.m_Height)
+    {
+        outResult.m_DirtyRects.push_back({ 0, 0, current.m_Width, current.m_Height });
+        return;
+    }
+
+    // Split the changed rows into bands separated by unchanged stretches, each with its own
+    // column span, so that a change elsewhere on screen does not widen a scrolling pane's
+    // lines with static content that cannot match
+    m_RowChanged.assign(current.m_Height, 0);
+
+    Rect band;
+    uint32_t bandRight = 0;
+    uint32_t lastChangedRow = 0;
+    bool inBand = false;
+
+    for (uint32_t y = 0; y < current.m_Height; ++y)
+    {
+        uint32_t rowLeft;
+        uint32_t rowRight;
+        if (!FindRowDifference(previous.GetRow(y), current.GetRow(y), current.m_Width, rowLeft, rowRight))
+            continue;
+
+        m_RowChanged[y] = 1;
+
+        if (inBand && y - lastChangedRow > BandGapRows)
+        {
+            band.m_Width = bandRight - band.m_X;
+            band.m_Height = lastChangedRow + 1 - band.m_Y;
+            DetectInBand(previous, current, band, outResult);
+            inBand = false;
+        }
+
+        if (!inBand)
+        {
+            band = { static_cast<int32_t>(rowLeft), static_cast<int32_t>(y), 0, 0 };
+            bandRight = rowRight;
+            inBand = true;
+        }
+
+        band.m_X = std::min(band.m_X, static_cast<int32_t>(rowLeft));
+        bandRight = std::max(bandRight, rowRight);
+        lastChangedRow = y;
+    }
+
+    if (inBand)
+    {
+        band.m_Width = bandRight - band.m_X;
+        band.m_Height = lastChangedRow + 1 - band.m_Y;
+        DetectInBand(previous, current, band, outResult);
+    }
+}
+
+void Takoyaki::MotionDetector::DetectInBand(const FrameView& previous, const FrameView& current, const Rect& bounds, MotionResult& outResult)
+{
+    m_LineChanged.assign(m_RowChanged.begin() + bounds.m_Y, m_RowChanged.begin() + bounds.m_Y + bounds.m_Height);
+
+    HashRows(previous, bounds, m_PreviousHashes);
+    HashRows(current, bounds, m_CurrentHashes);
+
+    if (int32_t shift = FindDominantShift(); shift != 0)
+    {
+        EmitOps(previous, current, bounds, true, shift, outResult);
+        return;
+    }
+
+    // Every column in the bounds counts as changed, since only the rows were compared exactly.
+    // Unchanged columns either match at the shift and get copied onto themselves, or are
+    // refreshed as dirty, which is wasteful but never wrong.
+    m_LineChanged.assign(bounds.m_Width, 1);
+
+    HashColumns(previous, bounds, m_PreviousHashes);
+    HashColumns(current, bounds, m_CurrentHashes);
+
+    if (int32_t shift = FindDominantShift(); shift != 0)
+    {
+        EmitOps(previous, current, bounds, false, shift, outResult);
+        return;
+    }
+
+    outResult.m_DirtyRects.push_back(bounds);
+}
+
+void Takoyaki::MotionDetector::HashRows(const FrameView& frame, const Rect& bounds, std::vector<uint64_t>& outHashes) const
+{
+    const PixelKernels& kernels = GetPixelKernels();
+
+    outHashes.resize(bounds.m_Height);
+    for (uint32_t i = 0; i < bounds.m_Height; ++i)
+        outHashes[i] = kernels.m_HashRow(frame.GetRow(bounds.m_Y + i) + bounds.m_X, bounds.m_Width);
+}
+
+void Takoyaki::MotionDetector::HashColumns(const FrameView& frame, const Rect& bounds, std::vector<uint64_t>& outHashes)
+{
+    // Same lane scheme as the row hash with the image transposed. Lanes are stored lane by
+    // lane, so each frame row updates one contiguous array and the loop vectorizes.
+    const size_t width = bounds.m_Width;
+    m_ColumnLanes.resize(width * Kernels::RowHashLanes);
+
+    for (uint32_t lane = 0; lane < Kernels::RowHashLanes; ++lane)
+        std::fill_n(m_ColumnLanes.begin() + lane * width, width, Kernels::GetRowHashSeed(lane));
+
+    for (uint32_t y = 0; y < bounds.m_Height; ++y)
+    {
+        const uint32_t* row = frame.GetRow(bounds.m_Y + y) + bounds.m_X;
+        uint32_t* states = m_ColumnLanes.data() + (y % Kernels::RowHashLanes) * width;
+
+        for (size_t x = 0; x < width; ++x)
+            states[x] = (states[x] ^ row[x]) * Kernels::RowHashMultiplier;
+    }
+
+    outHashes.resize(width);
+    for (size_t x = 0; x < width; ++x)
+    {
+        uint32_t lanes[Kernels::RowHashLanes];
+        for (uint32_t lane = 0; lane < Kernels::RowHashLanes; ++lane)
+            lanes[lane] = m_ColumnLanes[lane * width + x];
+
+        outHashes[x] = Kernels::FoldRowHashLanes(lanes, bounds.m_Height);
+    }
+}
+
+int32_t Takoyaki::MotionDetector::FindDominantShift()
+{
+    const uint32_t lineCount = static_cast<uint32_t>(m_CurrentHashes.size());
+
+    m_SortedHashes.resize(lineCount);
+    for (uint32_t i = 0; i < lineCount; ++i)
+        m_SortedHashes[i] = { m_PreviousHashes[i], i };
+
+    std::sort(m_SortedHashes.begin(), m_SortedHashes.end());
+
+    // Votes for every shift from -(lineCount - 1) to lineCount - 1
+    m_Votes.assign(static_cast<size_t>(lineCount) * 2, 0);
+
+    for (uint32_t i = 0; i < lineCount; ++i)
+    {
+        if (!m_LineChanged[i])
+            continue;
+
+        // Lines that repeat, like blank ones, cannot say where they came from
+        auto range = std::equal_range(m_SortedHashes.begin(), m_SortedHashes.end(), std::make_pair(m_CurrentHashes[i], 0u),
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        if (std::distance(range.first, range.second) == 1)
+            ++m_Votes[i + lineCount - range.first->second];
+    }
+
+    uint32_t bestVotes = 0;
+    int32_t bestShift = 0;
+
+    for (uint32_t i = 0; i < m_Votes.size(); ++i)
+    {
+        int32_t shift = static_cast<int32_t>(i) - static_cast<int32_t>(lineCount);
+        if (shift != 0 && m_Votes[i] > bestVotes)
+        {
+            bestVotes = m_Votes[i];
+            bestShift = shift;
+        }
+    }
+
+    return bestVotes >= m_MinCopyLines ? bestShift : 0;
+}
+
+bool Takoyaki::MotionDetector::RowsMatch(const FrameView& previous, const FrameView& current, const Rect& bounds, uint32_t previousLine, uint32_t currentLine) const
+{
+    return memcmp(previous.GetRow(bounds.m_Y + previousLine) + bounds.m_X, current.GetRow(bounds.m_Y + currentLine) + bounds.m_X, static_cast<size_t>(bounds.m_Width) * 4) == 0;
+}
+
+void Takoyaki::MotionDetector::ConfirmColumns(const FrameView& previous, const FrameView& current, const Rect& bounds, int32_t shift)
+{
+    // Walks rows rather than columns to stay in memory order, clearing candidates that differ
+    for (uint32_t y = 0; y < bounds.m_Height; ++y)
+    {
+        const uint32_t* previousRow = previous.GetRow(bounds.m_Y + y) + bounds.m_X;
+        const uint32_t* currentRow = current.GetRow(bounds.m_Y + y) + bounds.m_X;
+
+        for (uint32_t i = 0; i < bounds.m_Width; ++i)
+        {
+            if (m_LineMatched[i] && currentRow[i] != previousRow[static_cast<int32_t>(i) - shift])
+                m_LineMatched[i] = 0;
+        }
+    }
+}
+
+void Takoyaki::MotionDetector::EmitOps(const FrameView& previous, const FrameView& current, const Rect& bounds, bool isVertical, int32_t shift, MotionResult& outResult)
+{
+    const uint32_t lineCount = static_cast<uint32_t>(m_CurrentHashes.size());
+    const size_t firstCopy = outResult.m_Copies.size();
+    const size_t firstDirty = outResult.m_DirtyRects.size();
+
+    // Candidates by hash first, then confirmed exactly
+    m_LineMatched.assign(lineCount, 0);
+    for (uint32_t i = 0; i < lineCount; ++i)
+    {
+        int32_t source = static_cast<int32_t>(i) - shift;
+        if (m_LineChanged[i] && source >= 0 && source < static_cast<int32_t>(lineCount) && m_CurrentHashes[i] == m_PreviousHashes[source])
+            m_LineMatched[i] = 1;
+    }
+
+    if (isVertical)
+    {
+        for (uint32_t i = 0; i < lineCount; ++i)
+        {
+            if (m_LineMatched[i])
+                m_LineMatched[i] = RowsMatch(previous, current, bounds, static_cast<int32_t>(i) - shift, i);
+        }
+    }
+    else
+    {
+        ConfirmColumns(previous, current, bounds, shift);
+    }
+
+    auto makeRect = [&](uint32_t first, uint32_t count, int32_t offset) -> Rect
+    {
+        if (isVertical)
+            return { bounds.m_X, bounds.m_Y + static_cast<int32_t>(first) + offset, bounds.m_Width, count };
+
+        return { bounds.m_X + static_cast<int32_t>(first) + offset, bounds.m_Y, count, bounds.m_Height };
+    };
+
+    for (uint32_t i = 0; i < lineCount;)
+    {
+        if (!m_LineChanged[i])
+        {
+            ++i;
+            continue;
+        }
+
+        uint32_t first = i;
+        bool isMatched = m_LineMatched[i];
+        while (i < lineCount && m_LineChanged[i] && m_LineMatched[i] == isMatched)
+            ++i;
+
+        uint32_t count = i - first;
+        if (isMatched && count >= m_MinCopyLines)
+        {
+            Rect dest = makeRect(first, count, 0);
+            outResult.m_Copies.push_back({ makeRect(first, count, -shift), dest.m_X, dest.m_Y });
+            continue;
+        }
+
+        // Short matches are not worth a copy, fold them into the dirty rect before them
+        Rect dirty = makeRect(first, count, 0);
+        if (outResult.m_DirtyRects.size() > firstDirty)
+        {
+            Rect& last = outResult.m_DirtyRects.back();
+            if (isVertical && last.m_Y + static_cast<int32_t>(last.m_Height) == dirty.m_Y)
+            {
+                last.m_Height += dirty.m_Height;
+                continue;
+            }
+
+            if (!isVertical && last.m_X + static_cast<int32_t>(last.m_Width) == dirty.m_X)
+            {
+                last.m_Width += dirty.m_Width;
+                continue;
+            }
+        }
+
+        outResult.m_DirtyRects.push_back(dirty);
+    }
+
+    // Moving content towards higher coordinates overwrites sources further along, so those
+    // copies have to happen first
+    if (shift > 0)
+        std::reverse(outResult.m_Copies.begin() + firstCopy, outResult.m_Copies.end());
+}
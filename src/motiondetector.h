@@ -0,0 +1,100 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <utility>
+#include <vector>
+#include "frame.h"
+
+namespace Takoyaki
+{
+    // Copies m_Source from the previous frame to (m_DestX, m_DestY)
+    struct CopyRectOp
+    {
+        Rect m_Source;
+        int32_t m_DestX = 0;
+        int32_t m_DestY = 0;
+    };
+
+    // Describes how to turn the previous frame into the current one: apply the copies in
+    // order, then refresh the dirty rects from the current frame. Copies are ordered so that
+    // applying them in place on the previous frame never overwrites a later copy's source,
+    // and a single copy must behave like memmove where its source and destination overlap.
+    struct MotionResult
+    {
+        std::vector<CopyRectOp> m_Copies;
+        std::vector<Rect> m_DirtyRects;
+
+        inline bool HasChanges() const { return !m_Copies.empty() || !m_DirtyRects.empty(); }
+    };
+
+    // Finds scrolling between two frames, so that a scroll can be sent as a copy of what the
+    // viewer already has plus the strip that scrolled into view. Changed rows are grouped
+    // into bands, and within a band each line is hashed, every changed line votes for the offset of the unique line in the
+    // previous frame with the same hash, and lines that match at the winning offset become
+    // copies once an exact compare confirms them. Vertical scrolling is tried first, and
+    // horizontal only if no vertical shift wins.
+    class MotionDetector
+    {
+    public:
+        MotionDetector() = default;
+        ~MotionDetector() = default;
+
+        void Detect(const FrameView& previous, const FrameView& current, MotionResult& outResult);
+
+    public:
+        // Shortest run of matching lines worth a copy, and the fewest votes a shift needs
+        inline void SetMinCopyLines(uint32_t lines) { m_MinCopyLines = lines != 0 ? lines : 1; }
+        inline uint32_t GetMinCopyLines() const { return m_MinCopyLines; }
+
+    private:
+        void DetectInBand(const FrameView& previous, const FrameView& current, const Rect& bounds, MotionResult& outResult);
+
+        void HashRows(const FrameView& frame, const Rect& bounds, std::vector<uint64_t>& outHashes) const;
+        void HashColumns(const FrameView& frame, const Rect& bounds, std::vector<uint64_t>& outHashes);
+
+        int32_t FindDominantShift();
+
+        bool RowsMatch(const FrameView& previous, const FrameView& current, const Rect& bounds, uint32_t previousLine, uint32_t currentLine) const;
+        void ConfirmColumns(const FrameView& previous, const FrameView& current, const Rect& bounds, int32_t shift);
+
+        void EmitOps(const FrameView& previous, const FrameView& current, const Rect& bounds, bool isVertical, int32_t shift, MotionResult& outResult);
+
+    private:
+        // Unchanged rows that end a band
+        static constexpr uint32_t BandGapRows = 16;
+
+        uint32_t m_MinCopyLines = 8;
+
+        // Per frame row
+        std::vector<uint8_t> m_RowChanged;
+
+        // Per line of the current band, reused across bands and frames
+        std::vector<uint64_t> m_PreviousHashes;
+        std::vector<uint64_t> m_CurrentHashes;
+        std::vector<uint8_t> m_LineChanged;
+        std::vector<uint8_t> m_LineMatched;
+
+        std::vector<std::pair<uint64_t, uint32_t>> m_SortedHashes;
+        std::vector<uint32_t> m_Votes;
+        std::vector<uint32_t> m_ColumnLanes;
+    };
+}
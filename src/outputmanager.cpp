@@ -19,14 +19,22 @@
 
 #include "outputmanager.h"
 #include <process.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include "data/vs.h"
 #include "data/ps.h"
 
 LRESULT CALLBACK OutputWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam);
-extern bool g_Enabled;
 
 Takoyaki::OutputManager::OutputManager()
     : m_OutputHwnd(nullptr)
+    , m_OutputMode(OutputMode::MatchRegion)
+    , m_CanvasWidth(1920)
+    , m_CanvasHeight(1080)
+    , m_SharedTextureWidth(0)
+    , m_SharedTextureHeight(0)
 {
     m_TargetRect = {
         .m_Width = 1920,
@@ -36,25 +44,33 @@ Takoyaki::OutputManager::OutputManager()
 
 void Takoyaki::OutputManager::Initialize()
 {
-    InitializeWin32Window();
-    InitializeGraphicsApi();
+    m_FrameSync.SetPrimitive(&m_KeyMutexSync);
+    m_FrameSync.SetRecovery([this]() { return RecoverOutput(); });
+
+    m_ScreenshotWriter.SetCompletionCallback([](const ScreenshotResult& result)
+    {
+        if (result.m_IsSaved)
+            printf("Takoyaki: saved %ux%u screenshot in %lld ms\n", result.m_Width, result.m_Height, static_cast<long long>(result.m_TotalTime.count() / 1000));
+    });
 }
 
-void Takoyaki::OutputManager::Render()
+void Takoyaki::OutputManager::Prewarm()
 {
-    while (true)
-    {
-        HRESULT hr = m_KeyMutex->AcquireSync(0, 100);
-        if (hr == static_cast<HRESULT>(WAIT_TIMEOUT))
-            continue;
+    m_GraphicsPhase.Prewarm();
+}
 
-        if (FAILED(hr))
-        {
-            MessageBox(nullptr, L"Failed to acquire sync on key mutex.", L"Takoyaki Error", MB_OK);
-            exit(0);
-        }
+bool Takoyaki::OutputManager::Render()
+{
+    // A frame the producer has not handed over in time is skipped, and the next capture
+    // gets a fresh chance. FrameSync recreates the shared texture if this keeps happening.
+    if (!m_FrameSync.BeginFrame())
+        return false;
 
-        break;
+    // Left without a back buffer by a resize that failed, until recovery brings it back
+    if (!m_BackbufferRtv)
+    {
+        m_FrameSync.AbortFrame();
+        return false;
     }
 
     // Vertices for drawing whole texture
@@ -66,15 +82,24 @@ void Takoyaki::OutputManager::Render()
         DirectX::XMFLOAT2 TexCoord;
     };
 
+    // The shared texture can be larger than the captured region, which is always in its top
+    // left corner. When scaling with linear filtering, keep samples half a texel inside the
+    // region so stale texels beyond it never bleed into the edges.
+    float inset = m_OutputMode == OutputMode::FixedCanvas ? 0.5f : 0.0f;
+    float uMin = inset / m_SharedTextureWidth;
+    float vMin = inset / m_SharedTextureHeight;
+    float uMax = (m_TargetRect.m_Width - inset) / m_SharedTextureWidth;
+    float vMax = (m_TargetRect.m_Height - inset) / m_SharedTextureHeight;
+
     static constexpr uint32_t NumVertices = 6;
     Vertex vertices[NumVertices] =
     {
-        { DirectX::XMFLOAT3(-1.0f, -1.0f, 0), DirectX::XMFLOAT2(0.0f, 1.0f) },
-        { DirectX::XMFLOAT3(-1.0f, 1.0f, 0), DirectX::XMFLOAT2(0.0f, 0.0f) },
-        { DirectX::XMFLOAT3(1.0f, -1.0f, 0), DirectX::XMFLOAT2(1.0f, 1.0f) },
-        { DirectX::XMFLOAT3(1.0f, -1.0f, 0), DirectX::XMFLOAT2(1.0f, 1.0f) },
-        { DirectX::XMFLOAT3(-1.0f, 1.0f, 0), DirectX::XMFLOAT2(0.0f, 0.0f) },
-        { DirectX::XMFLOAT3(1.0f, 1.0f, 0), DirectX::XMFLOAT2(1.0f, 0.0f) },
+        { DirectX::XMFLOAT3(-1.0f, -1.0f, 0), DirectX::XMFLOAT2(uMin, vMax) },
+        { DirectX::XMFLOAT3(-1.0f, 1.0f, 0), DirectX::XMFLOAT2(uMin, vMin) },
+        { DirectX::XMFLOAT3(1.0f, -1.0f, 0), DirectX::XMFLOAT2(uMax, vMax) },
+        { DirectX::XMFLOAT3(1.0f, -1.0f, 0), DirectX::XMFLOAT2(uMax, vMax) },
+        { DirectX::XMFLOAT3(-1.0f, 1.0f, 0), DirectX::XMFLOAT2(uMin, vMin) },
+        { DirectX::XMFLOAT3(1.0f, 1.0f, 0), DirectX::XMFLOAT2(uMax, vMin) },
     };
 
     D3D11_TEXTURE2D_DESC sharedTextureDesc;
@@ -91,8 +116,8 @@ void Takoyaki::OutputManager::Render()
     HRESULT hr = m_GfxContext.GetDevice()->CreateShaderResourceView(m_SharedTexture.Get(), &srvDesc, &shaderResource);
     if (FAILED(hr))
     {
-        MessageBox(nullptr, L"Failed to create SRV while rendering frame.", L"Takoyaki Error", MB_OK);
-        exit(0);
+        m_FrameSync.AbortFrame();
+        return false;
     }
 
     UINT stride = sizeof(Vertex);
@@ -100,6 +125,14 @@ void Takoyaki::OutputManager::Render()
     FLOAT blendFactor[4] = { 0.f, 0.f, 0.f, 0.f };
     m_GfxContext.GetDeviceContext()->OMSetBlendState(nullptr, blendFactor, 0xffffffff);
     m_GfxContext.GetDeviceContext()->OMSetRenderTargets(1, m_BackbufferRtv.GetAddressOf(), nullptr);
+
+    // Letterbox bars
+    if (m_OutputMode == OutputMode::FixedCanvas)
+    {
+        FLOAT clearColor[4] = { 0.f, 0.f, 0.f, 1.f };
+        m_GfxContext.GetDeviceContext()->ClearRenderTargetView(m_BackbufferRtv.Get(), clearColor);
+    }
+
     m_GfxContext.GetDeviceContext()->VSSetShader(m_VertexShader.Get(), nullptr, 0);
     m_GfxContext.GetDeviceContext()->PSSetShader(m_PixelShader.Get(), nullptr, 0);
     m_GfxContext.GetDeviceContext()->PSSetShaderResources(0, 1, &shaderResource);
@@ -121,31 +154,90 @@ void Takoyaki::OutputManager::Render()
     hr = m_GfxContext.GetDevice()->CreateBuffer(&bufferDesc, &initData, &vertexBuffer);
     if (FAILED(hr))
     {
-        MessageBox(nullptr, L"Failed to create vertex buffer while rendering frame.", L"Takoyaki Error", MB_OK);
-        exit(0);
+        shaderResource->Release();
+        m_FrameSync.AbortFrame();
+        return false;
     }
     m_GfxContext.GetDeviceContext()->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
 
+    // The copy is queued while the producer is locked out, so it sees the same frame as the draw
+    if (m_IsScreenshotRequested)
+        CopyScreenshot();
+
     // Draw textured quad onto render target
     m_GfxContext.GetDeviceContext()->Draw(NumVertices, 0);
 
     // Release keyed mutex
-    hr = m_KeyMutex->ReleaseSync(0);
-    if (FAILED(hr))
-    {
-        MessageBox(nullptr, L"Failed to release keyed mutex.", L"Takoyaki Error", MB_OK);
-        exit(0);
-    }
+    m_FrameSync.EndFrame();
 
     vertexBuffer->Release();
     shaderResource->Release();
 
     hr = m_DxgiSwapChain->Present(1, 0);
+    if (FAILED(hr))
+        m_FrameSync.DropPresent();
+
+    if (!m_HasPresented)
+    {
+        m_HasPresented = true;
+        GetStartupTimeline().Mark("first frame");
+        printf("%s", GetStartupTimeline().GetReport().c_str());
+        printf("%s", m_FrameSync.GetReport().c_str());
+        printf("%s", GetMemoryBudget().GetReport().c_str());
+    }
+
+    return SUCCEEDED(hr);
+}
+
+void Takoyaki::OutputManager::RequestScreenshot(std::filesystem::path path)
+{
+    // One screenshot in flight at a time, a second request while the first is still being
+    // copied would only save the same frame again
+    if (m_ScreenshotStaging)
+        return;
+
+    m_ScreenshotPath = std::move(path);
+    m_IsScreenshotRequested = true;
+}
+
+void Takoyaki::OutputManager::PollScreenshot()
+{
+    if (!m_ScreenshotStaging)
+        return;
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    HRESULT hr = m_GfxContext.GetDeviceContext()->Map(m_ScreenshotStaging.Get(), 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+    if (hr == DXGI_ERROR_WAS_STILL_DRAWING)
+        return;
+
+    if (FAILED(hr))
+    {
+        fprintf(stderr, "Takoyaki: failed to read back the screenshot (0x%08lx)\n", static_cast<unsigned long>(hr));
+        m_ScreenshotStaging.Reset();
+        return;
+    }
+
+    D3D11_TEXTURE2D_DESC desc;
+    m_ScreenshotStaging->GetDesc(&desc);
+
+    WritableFrame frame = m_ScreenshotPool.Acquire(desc.Width, desc.Height);
+    FrameView view = frame.GetView();
+
+    for (uint32_t y = 0; y < desc.Height; ++y)
+        memcpy(view.GetRow(y), static_cast<const uint8_t*>(mapped.pData) + static_cast<size_t>(y) * mapped.RowPitch, desc.Width * 4);
+
+    m_GfxContext.GetDeviceContext()->Unmap(m_ScreenshotStaging.Get(), 0);
+    m_ScreenshotStaging.Reset();
+
+    if (!m_ScreenshotWriter.Request(FrameRef(std::move(frame)), { 0, 0, desc.Width, desc.Height }, m_ScreenshotPath))
+        fprintf(stderr, "Takoyaki: too many screenshots pending, dropped %s\n", m_ScreenshotPath.string().c_str());
 }
 
 HANDLE Takoyaki::OutputManager::GetSharedTextureHandle() const
 {
     HANDLE handle = nullptr;
+    if (!m_SharedTexture)
+        return handle;
 
     IDXGIResource* resource = nullptr;
     HRESULT hr = m_SharedTexture->QueryInterface(__uuidof(IDXGIResource), reinterpret_cast<void**>(&resource));
@@ -172,10 +264,25 @@ void Takoyaki::OutputManager::SetTargetRect(Tako::TakoRect rect)
 
     m_TargetRect = rect;
 
+    // Resources created later are sized for whatever the region is by then
+    if (!IsReady())
+        return;
+
     UpdateViewport();
-    InitializeSharedTexture();
-    ResizeSwapChain();
+
+    // The canvas and the shared texture were sized for any region at startup, so changing
+    // the region only moves the viewport, unless the budget kept the texture to an older region
+    if (m_OutputMode == OutputMode::FixedCanvas && rect.m_Width <= m_SharedTextureWidth && rect.m_Height <= m_SharedTextureHeight)
+        return;
+
+    // Whatever cannot be recreated at the new size keeps its old one, and frame sync tries
+    // again from the next frame on
+    bool isRecreated = InitializeSharedTexture();
+    isRecreated &= ResizeSwapChain();
     UpdateWin32Window();
+
+    if (!isRecreated)
+        m_FrameSync.RequestRecovery();
 }
 
 void Takoyaki::OutputManager::SetEnabled(bool isEnabled)
@@ -183,6 +290,14 @@ void Takoyaki::OutputManager::SetEnabled(bool isEnabled)
     if (isEnabled == m_IsEnabled)
         return;
 
+    // The first capture is what creates the output
+    if (isEnabled)
+    {
+        GetStartupTimeline().Mark("first capture");
+        if (!m_OutputPhase.Ensure())
+            return;
+    }
+
     m_IsEnabled = isEnabled;
     
     if (m_IsEnabled)
@@ -191,6 +306,26 @@ void Takoyaki::OutputManager::SetEnabled(bool isEnabled)
         ShowWindow(m_OutputHwnd, SW_HIDE);
 }
 
+void Takoyaki::OutputManager::SetOutputMode(OutputMode mode)
+{
+    if (mode == m_OutputMode)
+        return;
+
+    m_OutputMode = mode;
+
+    if (!IsReady())
+        return;
+
+    bool isRecreated = InitializeSharedTexture();
+    isRecreated &= InitializeSampler();
+    isRecreated &= ResizeSwapChain();
+    UpdateWin32Window();
+    UpdateViewport();
+
+    if (!isRecreated)
+        m_FrameSync.RequestRecovery();
+}
+
 void Takoyaki::OutputManager::InitializeWin32Window()
 {
     WNDCLASS wc = { 0 };
@@ -213,24 +348,44 @@ void Takoyaki::OutputManager::InitializeWin32Window()
         exit(0);
     }
 
+    // For OutputWndProc to find its way back here
+    SetWindowLongPtr(m_OutputHwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(this));
+
     UpdateWin32Window();
 }
 
-void Takoyaki::OutputManager::InitializeGraphicsApi()
+bool Takoyaki::OutputManager::InitializeGraphicsApi()
 {
     m_GfxContext.Initialize();
 
-    InitializeSwapChain();
-    InitializeSharedTexture();
-    InitializeBackbufferRtv();
-    InitializeSampler();
     InitializeBlendState();
     InitializeShaders();
 
+    return true;
+}
+
+bool Takoyaki::OutputManager::InitializeOutput()
+{
+    // Waits for a prewarm that is still running instead of creating a second device
+    if (!m_GraphicsPhase.Ensure())
+        return false;
+
+    // A failed attempt is retried on the next capture, reusing what it did create
+    if (m_OutputHwnd == nullptr)
+        InitializeWin32Window();
+
+    if (!m_DxgiSwapChain && !InitializeSwapChain())
+        return false;
+
+    if (!InitializeSharedTexture() || !InitializeBackbufferRtv() || !InitializeSampler())
+        return false;
+
     UpdateViewport();
+
+    return true;
 }
 
-void Takoyaki::OutputManager::InitializeSwapChain()
+bool Takoyaki::OutputManager::InitializeSwapChain()
 {
     // Get window size
     RECT windowRect;
@@ -256,16 +411,67 @@ void Takoyaki::OutputManager::InitializeSwapChain()
     if (FAILED(hr))
     {
         MessageBox(nullptr, L"Failed to create window swapchain.", L"Takoyaki Error", MB_OK);
-        exit(0);
+        return false;
+    }
+
+    m_SwapChainMemory.Reset(MemoryCategory::Output, static_cast<size_t>(width) * height * 4 * swapChainDesc.BufferCount);
+    return true;
+}
+
+bool Takoyaki::OutputManager::InitializeSharedTexture()
+{
+    if (CreateSharedTexture())
+        return true;
+
+    // Texture creation can fail for many reasons, but one of them is that the requested size
+    // is bigger than what the device supports. In the future, some sort of mandatory downsample
+    // until creation success can be added, if too many people complains about this.
+    if (!m_SharedTexture)
+    {
+        MessageBox(nullptr, L"Failed to create initial shared texture.", L"Takoyaki Error", MB_OK);
+        return false;
     }
+
+    fprintf(stderr, "Takoyaki: failed to create a shared texture for the %dx%d region, which may be too big. Keeping the %ux%u one.\n",
+        static_cast<int>(m_TargetRect.m_Width), static_cast<int>(m_TargetRect.m_Height), m_SharedTextureWidth, m_SharedTextureHeight);
+
+    return false;
 }
 
-void Takoyaki::OutputManager::InitializeSharedTexture()
+bool Takoyaki::OutputManager::CreateSharedTexture()
 {
     D3D11_TEXTURE2D_DESC desc;
     RtlZeroMemory(&desc, sizeof(D3D11_TEXTURE2D_DESC));
+
     desc.Width = m_TargetRect.m_Width;
     desc.Height = m_TargetRect.m_Height;
+
+    // The old texture is still alive until this one replaces it, so both count here
+    MemoryReservation memory;
+
+    if (m_OutputMode == OutputMode::FixedCanvas)
+    {
+        // Large enough for any region on the desktop, so it never has to be recreated. When
+        // the memory budget has no room for that, it is only as large as the region and is
+        // recreated whenever the region outgrows it.
+        const UINT canvasWidth = std::max<UINT>(GetSystemMetrics(SM_CXVIRTUALSCREEN), m_TargetRect.m_Width);
+        const UINT canvasHeight = std::max<UINT>(GetSystemMetrics(SM_CYVIRTUALSCREEN), m_TargetRect.m_Height);
+
+        if (memory.TryReset(MemoryCategory::Output, static_cast<size_t>(canvasWidth) * canvasHeight * 4))
+        {
+            desc.Width = canvasWidth;
+            desc.Height = canvasHeight;
+        }
+        else
+        {
+            printf("Takoyaki: no room in the memory budget for a %ux%u canvas, sizing it for the region\n", canvasWidth, canvasHeight);
+        }
+    }
+
+    // Every captured pixel lands in the texture, so the region itself is charged even over budget
+    if (memory.GetSize() == 0)
+        memory.Reset(MemoryCategory::Output, static_cast<size_t>(desc.Width) * desc.Height * 4);
+
     desc.MipLevels = 1;
     desc.ArraySize = 1;
     desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
@@ -275,77 +481,127 @@ void Takoyaki::OutputManager::InitializeSharedTexture()
     desc.CPUAccessFlags = 0;
     desc.MiscFlags = D3D11_RESOURCE_MISC_SHARED_KEYEDMUTEX;
 
-    HRESULT hr = m_GfxContext.GetDevice()->CreateTexture2D(&desc, nullptr, m_SharedTexture.GetAddressOf());
-    static bool isInitialization = true;
+    wrl::ComPtr<ID3D11Texture2D> texture;
+    wrl::ComPtr<IDXGIKeyedMutex> keyMutex;
 
+    HRESULT hr = m_GfxContext.GetDevice()->CreateTexture2D(&desc, nullptr, texture.GetAddressOf());
     if (FAILED(hr))
-    {
-        // Texture creation can fail for many reasons, but one of them is that the requested size
-        // is bigger than what the device supports. In the future, some sort of mandatory downsample
-        // until creation success can be added, if too many people complains about this.
+        return false;
 
-        if (isInitialization)
-        {
-            MessageBox(nullptr, L"Failed to create initial shared texture.", L"Takoyaki Error", MB_OK);
-        }
-        else
-        {
-            isInitialization = false;
-            MessageBox(nullptr, L"Failed to create initial shared texture. The selected area may be too big.", L"Takoyaki Error", MB_OK);
-        }
+    hr = texture->QueryInterface(__uuidof(IDXGIKeyedMutex), reinterpret_cast<void**>(keyMutex.GetAddressOf()));
+    if (FAILED(hr))
+        return false;
 
-        exit(0);
+    m_SharedTexture = std::move(texture);
+    m_KeyMutex = std::move(keyMutex);
+    m_SharedTextureMemory = std::move(memory);
+    m_SharedTextureWidth = desc.Width;
+    m_SharedTextureHeight = desc.Height;
+
+    return true;
+}
+
+bool Takoyaki::OutputManager::RecoverOutput()
+{
+    // A producer that never gives the keyed mutex back, or a mutex that was abandoned, leaves
+    // the texture unusable. The capture side picks up the new one through its shared handle
+    // on the next frame. If creation fails the old texture is kept and the watchdog retries.
+    bool isRecovered = CreateSharedTexture();
+
+    // Recreating the sampler is cheap, and it may have failed along with a mode change
+    isRecovered &= InitializeSampler();
+
+    uint32_t width, height;
+    GetOutputSize(width, height);
+
+    DXGI_SWAP_CHAIN_DESC1 desc;
+    m_DxgiSwapChain->GetDesc1(&desc);
+
+    if (!m_BackbufferRtv || desc.Width != width || desc.Height != height)
+    {
+        isRecovered &= ResizeSwapChain();
+        UpdateWin32Window();
     }
 
-    // Get keyed mutex
-    hr = m_SharedTexture->QueryInterface(__uuidof(IDXGIKeyedMutex), reinterpret_cast<void**>(m_KeyMutex.GetAddressOf()));
-    if (FAILED(hr))
+    return isRecovered;
+}
+
+Takoyaki::SyncResult Takoyaki::KeyedMutexSync::Acquire(std::chrono::milliseconds timeout)
+{
+    HRESULT hr = m_Mutex->AcquireSync(0, static_cast<DWORD>(timeout.count()));
+    if (hr == static_cast<HRESULT>(WAIT_TIMEOUT))
+        return SyncResult::Timeout;
+
+    // WAIT_ABANDONED is a success code, but the producer is gone and the contents are undefined
+    if (FAILED(hr) || hr == static_cast<HRESULT>(WAIT_ABANDONED))
     {
-        MessageBox(nullptr, L"Failed to obtain shared texture mutex.", L"Takoyaki Error", MB_OK);
-        exit(0);
+        if (hr == static_cast<HRESULT>(WAIT_ABANDONED))
+            m_Mutex->ReleaseSync(0);
+
+        return SyncResult::Failed;
     }
+
+    return SyncResult::Acquired;
 }
 
-void Takoyaki::OutputManager::InitializeBackbufferRtv()
+bool Takoyaki::KeyedMutexSync::Release()
+{
+    return SUCCEEDED(m_Mutex->ReleaseSync(0));
+}
+
+bool Takoyaki::OutputManager::InitializeBackbufferRtv()
 {
     ID3D11Texture2D* backBuffer = nullptr;
     HRESULT hr = m_DxgiSwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), reinterpret_cast<void**>(&backBuffer));
 
     if (FAILED(hr))
     {
-        MessageBox(nullptr, L"Failed to obtain backbuffer from swapchain.", L"Takoyaki Error", MB_OK);
-        exit(0);
+        fprintf(stderr, "Takoyaki: failed to obtain the back buffer from the swap chain (0x%08lx)\n", static_cast<unsigned long>(hr));
+        return false;
     }
 
-    hr = m_GfxContext.GetDevice()->CreateRenderTargetView(backBuffer, nullptr, m_BackbufferRtv.GetAddressOf());
+    hr = m_GfxContext.GetDevice()->CreateRenderTargetView(backBuffer, nullptr, m_BackbufferRtv.ReleaseAndGetAddressOf());
     backBuffer->Release();
     if (FAILED(hr))
     {
-        MessageBox(nullptr, L"Failed to create backbuffer RTV.", L"Takoyaki Error", MB_OK);
-        exit(0);
+        fprintf(stderr, "Takoyaki: failed to create the back buffer RTV (0x%08lx)\n", static_cast<unsigned long>(hr));
+        m_BackbufferRtv.Reset();
+        return false;
     }
 
     // Set new render target
     m_GfxContext.GetDeviceContext()->OMSetRenderTargets(1, m_BackbufferRtv.GetAddressOf(), nullptr);
+    return true;
 }
 
-void Takoyaki::OutputManager::InitializeSampler()
+bool Takoyaki::OutputManager::InitializeSampler()
 {
     D3D11_SAMPLER_DESC sampleDesc;
     RtlZeroMemory(&sampleDesc, sizeof(sampleDesc));
-    sampleDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_POINT;
+    // Regions are copied 1:1 unless they are scaled onto the canvas
+    if (m_OutputMode == OutputMode::FixedCanvas)
+        sampleDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+    else
+        sampleDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_POINT;
+
     sampleDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
     sampleDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
     sampleDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
     sampleDesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
     sampleDesc.MinLOD = 0;
     sampleDesc.MaxLOD = D3D11_FLOAT32_MAX;
-    HRESULT hr = m_GfxContext.GetDevice()->CreateSamplerState(&sampleDesc, &m_Sampler);
+
+    // The old sampler stays in use if a new one cannot be created
+    wrl::ComPtr<ID3D11SamplerState> sampler;
+    HRESULT hr = m_GfxContext.GetDevice()->CreateSamplerState(&sampleDesc, sampler.GetAddressOf());
     if (FAILED(hr))
     {
-        MessageBox(nullptr, L"Failed to create sampler state.", L"Takoyaki Error", MB_OK);
-        exit(0);
+        fprintf(stderr, "Takoyaki: failed to create the sampler state (0x%08lx)\n", static_cast<unsigned long>(hr));
+        return false;
     }
+
+    m_Sampler = std::move(sampler);
+    return true;
 }
 
 void Takoyaki::OutputManager::InitializeBlendState()
@@ -406,27 +662,39 @@ void Takoyaki::OutputManager::InitializeShaders()
     }
 }
 
-void Takoyaki::OutputManager::ResizeSwapChain()
+bool Takoyaki::OutputManager::ResizeSwapChain()
 {
-    m_BackbufferRtv->Release();
+    // Every reference to the buffers has to be gone before they can be resized, including
+    // the render target bound to the context
+    m_BackbufferRtv.Reset();
+    m_GfxContext.GetDeviceContext()->OMSetRenderTargets(0, nullptr, nullptr);
 
     DXGI_SWAP_CHAIN_DESC desc;
     m_DxgiSwapChain->GetDesc(&desc);
 
+    uint32_t width, height;
+    GetOutputSize(width, height);
+
     HRESULT hr = m_DxgiSwapChain->ResizeBuffers(
         desc.BufferCount,
-        m_TargetRect.m_Width,
-        m_TargetRect.m_Height,
+        width,
+        height,
         desc.BufferDesc.Format,
         desc.Flags);
 
     if (FAILED(hr))
     {
-        MessageBox(nullptr, L"Failed to resize swapchain buffers.", L"Takoyaki Error", MB_OK);
-        exit(0);
+        // The old buffers are still there, so frames keep going to them until recovery
+        // manages the resize
+        fprintf(stderr, "Takoyaki: failed to resize the swap chain to %ux%u (0x%08lx), keeping %ux%u\n",
+            width, height, static_cast<unsigned long>(hr), desc.BufferDesc.Width, desc.BufferDesc.Height);
+        InitializeBackbufferRtv();
+        return false;
     }
 
-    InitializeBackbufferRtv();
+    m_SwapChainMemory.Reset(MemoryCategory::Output, static_cast<size_t>(width) * height * 4 * desc.BufferCount);
+
+    return InitializeBackbufferRtv();
 }
 
 void Takoyaki::OutputManager::UpdateViewport()
@@ -438,12 +706,70 @@ void Takoyaki::OutputManager::UpdateViewport()
     vp.MaxDepth = 1.0f;
     vp.TopLeftX = 0;
     vp.TopLeftY = 0;
+
+    if (m_OutputMode == OutputMode::FixedCanvas)
+    {
+        // Preserve the aspect ratio of the region and center it on the canvas
+        float scale = std::min(
+            static_cast<float>(m_CanvasWidth) / m_TargetRect.m_Width,
+            static_cast<float>(m_CanvasHeight) / m_TargetRect.m_Height);
+
+        vp.Width = std::round(m_TargetRect.m_Width * scale);
+        vp.Height = std::round(m_TargetRect.m_Height * scale);
+        vp.TopLeftX = std::floor((m_CanvasWidth - vp.Width) / 2.0f);
+        vp.TopLeftY = std::floor((m_CanvasHeight - vp.Height) / 2.0f);
+    }
+
     m_GfxContext.GetDeviceContext()->RSSetViewports(1, &vp);
 }
 
+void Takoyaki::OutputManager::CopyScreenshot()
+{
+    m_IsScreenshotRequested = false;
+
+    // The region is always in the top left corner of the shared texture
+    D3D11_TEXTURE2D_DESC desc;
+    RtlZeroMemory(&desc, sizeof(D3D11_TEXTURE2D_DESC));
+    desc.Width = std::min<UINT>(m_TargetRect.m_Width, m_SharedTextureWidth);
+    desc.Height = std::min<UINT>(m_TargetRect.m_Height, m_SharedTextureHeight);
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_STAGING;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+    HRESULT hr = m_GfxContext.GetDevice()->CreateTexture2D(&desc, nullptr, m_ScreenshotStaging.ReleaseAndGetAddressOf());
+    if (FAILED(hr))
+    {
+        fprintf(stderr, "Takoyaki: failed to create the screenshot staging texture (0x%08lx)\n", static_cast<unsigned long>(hr));
+        m_ScreenshotStaging.Reset();
+        return;
+    }
+
+    D3D11_BOX box = { 0, 0, 0, desc.Width, desc.Height, 1 };
+    m_GfxContext.GetDeviceContext()->CopySubresourceRegion(m_ScreenshotStaging.Get(), 0, 0, 0, 0, m_SharedTexture.Get(), 0, &box);
+}
+
 void Takoyaki::OutputManager::UpdateWin32Window()
 {
-    MoveWindow(m_OutputHwnd, -32000, -32000, m_TargetRect.m_Width, m_TargetRect.m_Height, false);
+    uint32_t width, height;
+    GetOutputSize(width, height);
+
+    MoveWindow(m_OutputHwnd, -32000, -32000, width, height, false);
+}
+
+void Takoyaki::OutputManager::GetOutputSize(uint32_t& width, uint32_t& height) const
+{
+    if (m_OutputMode == OutputMode::FixedCanvas)
+    {
+        width = m_CanvasWidth;
+        height = m_CanvasHeight;
+        return;
+    }
+
+    width = m_TargetRect.m_Width;
+    height = m_TargetRect.m_Height;
 }
 
 LRESULT CALLBACK OutputWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
@@ -452,7 +778,10 @@ LRESULT CALLBACK OutputWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lP
     {
     case WM_CLOSE:
     {
-        g_Enabled = false;
+        auto* outputManager = reinterpret_cast<Takoyaki::OutputManager*>(GetWindowLongPtr(hWnd, GWLP_USERDATA));
+        if (outputManager != nullptr)
+            outputManager->OnWindowClose();
+
         break;
     }
     case WM_SIZE:
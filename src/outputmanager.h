@@ -28,50 +28,128 @@
 #include <DirectXMath.h>
 #include <wrl.h>
 
+#include <filesystem>
+#include <functional>
+
 #include "Tako/includes/api.h"
+#include "framepool.h"
+#include "framesync.h"
+#include "memorybudget.h"
+#include "screenshotwriter.h"
+#include "startuptimeline.h"
 
 namespace wrl = Microsoft::WRL;
 
 namespace Takoyaki
 {
+    enum class OutputMode
+    {
+        // Output window and swap chain always match the size of the capture region
+        MatchRegion,
+
+        // Output stays at a fixed canvas size, with the region scaled to fit and letterboxed
+        FixedCanvas,
+    };
+
+    // Keyed mutex of the shared texture, which both sides acquire with key 0. Holds a
+    // reference to the owner's pointer, so it follows the texture when it is recreated.
+    class KeyedMutexSync : public SyncPrimitive
+    {
+    public:
+        explicit KeyedMutexSync(const wrl::ComPtr<IDXGIKeyedMutex>& mutex) : m_Mutex(mutex) {}
+
+        SyncResult Acquire(std::chrono::milliseconds timeout) override;
+        bool Release() override;
+
+    private:
+        const wrl::ComPtr<IDXGIKeyedMutex>& m_Mutex;
+    };
+
     class OutputManager
     {
     public:
         OutputManager();
         ~OutputManager() = default;
 
+        // Only hooks up frame sync and the screenshot writer. The device, window and swap
+        // chain are created when capture is first enabled, so an idle tray icon costs nothing.
         void Initialize();
-        void Render();
+
+        // Creates the device and shaders on a background thread ahead of the first capture
+        void Prewarm();
+
+        // Returns false if there was no frame to present
+        bool Render();
+
+        // Copies the region out of the next rendered frame and saves it to path on the
+        // screenshot writer's thread. The copy is read back by PollScreenshot once the GPU
+        // has finished it, so neither call waits on the GPU or the encoder.
+        void RequestScreenshot(std::filesystem::path path);
+        void PollScreenshot();
 
     public:
         HANDLE GetSharedTextureHandle() const;
         Tako::TakoRect GetTargetRect() const;
         void SetTargetRect(Tako::TakoRect rect);
         void SetEnabled(bool isEnabled);
+        void SetOutputMode(OutputMode mode);
+
+        // Called on the message loop thread when the output window is asked to close, which
+        // is up to the owner to turn into stopping the capture
+        inline void SetCloseCallback(std::function<void()> callback) { m_CloseCallback = std::move(callback); }
+        inline void OnWindowClose() const { if (m_CloseCallback) m_CloseCallback(); }
+
+        inline bool IsReady() const { return m_OutputPhase.IsReady(); }
+        inline OutputMode GetOutputMode() const { return m_OutputMode; }
+        inline const FrameSyncStats& GetFrameSyncStats() const { return m_FrameSync.GetStats(); }
+        inline std::string GetFrameSyncReport() const { return m_FrameSync.GetReport(); }
 
     private:
+        // Device and device state, which can be created on any thread
+        bool InitializeGraphicsApi();
+
+        // Window and everything sized to it, which must be created on the message loop thread
+        bool InitializeOutput();
+
         void InitializeWin32Window();
-        void InitializeGraphicsApi();
 
-        void InitializeSwapChain();
-        void InitializeSharedTexture();
-        void InitializeBackbufferRtv();
-        void InitializeSampler();
+        // Return false, keeping what was there before, if the resource could not be created
+        bool InitializeSwapChain();
+        bool InitializeSharedTexture();
+        bool CreateSharedTexture();
+        bool InitializeBackbufferRtv();
+        bool InitializeSampler();
         void InitializeBlendState();
         void InitializeShaders();
 
-        void ResizeSwapChain();
+        // Recovery callback of the frame sync. Recreates the shared texture, and the swap
+        // chain buffers if they no longer match the output size.
+        bool RecoverOutput();
+
+        bool ResizeSwapChain();
         void UpdateViewport();
         void UpdateWin32Window();
 
+        void GetOutputSize(uint32_t& width, uint32_t& height) const;
+
+        void CopyScreenshot();
+
     private:
         HWND m_OutputHwnd;
 
         Tako::GraphicContext m_GfxContext;
         Tako::TakoRect m_TargetRect;
 
+        OutputMode m_OutputMode;
+        uint32_t m_CanvasWidth;
+        uint32_t m_CanvasHeight;
+        uint32_t m_SharedTextureWidth;
+        uint32_t m_SharedTextureHeight;
+
         wrl::ComPtr<IDXGISwapChain1> m_DxgiSwapChain;
         wrl::ComPtr<IDXGIKeyedMutex> m_KeyMutex;
+        KeyedMutexSync m_KeyMutexSync{ m_KeyMutex };
+        FrameSync m_FrameSync;
 
         wrl::ComPtr<ID3D11RenderTargetView> m_BackbufferRtv;
         wrl::ComPtr<ID3D11SamplerState> m_Sampler;
@@ -81,6 +159,22 @@ namespace Takoyaki
         wrl::ComPtr<ID3D11InputLayout> m_InputLayout;
         wrl::ComPtr<ID3D11Texture2D> m_SharedTexture;
 
-        bool m_IsEnabled;
+        MemoryReservation m_SharedTextureMemory;
+        MemoryReservation m_SwapChainMemory;
+
+        ScreenshotWriter m_ScreenshotWriter;
+        FramePool m_ScreenshotPool{ MemoryCategory::Snapshot };
+        wrl::ComPtr<ID3D11Texture2D> m_ScreenshotStaging;
+        std::filesystem::path m_ScreenshotPath;
+        bool m_IsScreenshotRequested = false;
+
+        bool m_IsEnabled = false;
+        bool m_HasPresented = false;
+
+        std::function<void()> m_CloseCallback;
+
+        // Declared last so a prewarm still running is joined before anything it touches is destroyed
+        LazyPhase m_GraphicsPhase{ "output device", [this]() { return InitializeGraphicsApi(); } };
+        LazyPhase m_OutputPhase{ "output window", [this]() { return InitializeOutput(); } };
     };
 }
\ No newline at end of file
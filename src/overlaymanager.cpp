@@ -28,15 +28,22 @@ LRESULT CALLBACK OverlayWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM l
 
 void Takoyaki::OverlayManager::Initialize()
 {
-    InitializeWin32Window();
     g_OverlayManager = this;
 }
 
+void Takoyaki::OverlayManager::Prewarm()
+{
+    m_WindowPhase.Ensure();
+}
+
 void Takoyaki::OverlayManager::SetEnabled(bool isEnabled)
 {
     if (isEnabled == m_IsEnabled)
         return;
 
+    if (isEnabled && !m_WindowPhase.Ensure())
+        return;
+
     m_IsEnabled = isEnabled;
 
     SetCursor(LoadCursor(NULL, IDC_CROSS));
@@ -49,7 +56,17 @@ void Takoyaki::OverlayManager::SetEnabled(bool isEnabled)
             ShowWindow(monitor.first, SW_HIDE);
 
         if (m_IsEnabled)
+        {
+            ReleaseSnapshot(monitor.first);
             m_FullScreenCaptures[monitor.first] = g_OverlayManager->GetDisplaySnapshot(monitor.first, monitor.second.rcMonitor);
+        }
+    }
+
+    // The snapshots are only drawn while selecting, so give their memory back right away
+    if (!m_IsEnabled)
+    {
+        for (auto monitor : m_MonitorInfos)
+            ReleaseSnapshot(monitor.first);
     }
 }
 
@@ -68,6 +85,8 @@ void Takoyaki::OverlayManager::Update()
 
 void Takoyaki::OverlayManager::Shutdown()
 {
+    for (auto monitor : m_MonitorInfos)
+        ReleaseSnapshot(monitor.first);
 }
 
 void Takoyaki::OverlayManager::InitializeWin32Window()
@@ -123,16 +142,70 @@ HBITMAP Takoyaki::OverlayManager::GetDisplaySnapshot(HWND hWnd, RECT rect)
     if (m_MonitorInfos.find(hWnd) == m_MonitorInfos.end())
         return NULL;
 
+    const int width = rect.right - rect.left;
+    const int height = rect.bottom - rect.top;
+
+    // The snapshot is only the backdrop of the selection, so when the memory budget has no
+    // room for it at full size it is taken at half or quarter size and stretched when drawn.
+    // The quarter size one is charged even over budget, the overlay cannot do without.
+    MemoryReservation& memory = m_SnapshotMemory[hWnd];
+    uint32_t divisor = 1;
+
+    for (; divisor < MaxSnapshotDivisor; divisor *= 2)
+    {
+        if (memory.TryReset(MemoryCategory::Snapshot, static_cast<size_t>(width / divisor) * (height / divisor) * 4))
+            break;
+    }
+
+    if (divisor == MaxSnapshotDivisor)
+        memory.Reset(MemoryCategory::Snapshot, static_cast<size_t>(width / divisor) * (height / divisor) * 4);
+
     HDC screenDc = GetDC(hWnd);
     HDC compatibleDc = CreateCompatibleDC(screenDc);
-    HBITMAP bitmap = CreateCompatibleBitmap(screenDc, rect.right - rect.left, rect.bottom - rect.top);
+    HBITMAP bitmap = CreateCompatibleBitmap(screenDc, width / divisor, height / divisor);
     HGDIOBJ oldBitmap = SelectObject(compatibleDc, bitmap);
-    BitBlt(compatibleDc, 0, 0, rect.right - rect.left, rect.bottom - rect.top, screenDc, rect.left, rect.top, SRCCOPY);
+
+    if (divisor == 1)
+    {
+        BitBlt(compatibleDc, 0, 0, width, height, screenDc, rect.left, rect.top, SRCCOPY);
+    }
+    else
+    {
+        SetStretchBltMode(compatibleDc, HALFTONE);
+        SetBrushOrgEx(compatibleDc, 0, 0, NULL);
+        StretchBlt(compatibleDc, 0, 0, width / divisor, height / divisor, screenDc, rect.left, rect.top, width, height, SRCCOPY);
+    }
+
     SelectObject(compatibleDc, oldBitmap);
     DeleteDC(compatibleDc);
     ReleaseDC(NULL, screenDc);
+
+    if (bitmap)
+        m_SnapshotDivisors[hWnd] = divisor;
+    else
+        memory.Reset();
+
     return bitmap;
+}
+
+uint32_t Takoyaki::OverlayManager::GetSnapshotDivisor(HWND hWnd) const
+{
+    auto divisor = m_SnapshotDivisors.find(hWnd);
+    return divisor != m_SnapshotDivisors.end() ? divisor->second : 1;
+}
 
+void Takoyaki::OverlayManager::ReleaseSnapshot(HWND hWnd)
+{
+    auto snapshot = m_FullScreenCaptures.find(hWnd);
+    if (snapshot == m_FullScreenCaptures.end())
+        return;
+
+    if (snapshot->second)
+        DeleteObject(snapshot->second);
+
+    m_FullScreenCaptures.erase(snapshot);
+    m_SnapshotMemory.erase(hWnd);
+    m_SnapshotDivisors.erase(hWnd);
 }
 
 LRESULT CALLBACK OverlayWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
@@ -179,7 +252,17 @@ LRESULT CALLBACK OverlayWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM l
         HDC miscHdc = CreateCompatibleDC(hdc);
         HBITMAP fullScreenSnapshot = g_OverlayManager->GetFullScreenCaptures().at(hWnd);
         SelectObject(miscHdc, fullScreenSnapshot);
-        BitBlt(rtHdc, 0, 0, screenWidth, screenHeight, miscHdc, fullScreenRect.left, fullScreenRect.top, SRCCOPY);
+
+        const int divisor = static_cast<int>(g_OverlayManager->GetSnapshotDivisor(hWnd));
+        if (divisor == 1)
+        {
+            BitBlt(rtHdc, 0, 0, screenWidth, screenHeight, miscHdc, fullScreenRect.left, fullScreenRect.top, SRCCOPY);
+        }
+        else
+        {
+            SetStretchBltMode(rtHdc, COLORONCOLOR);
+            StretchBlt(rtHdc, 0, 0, screenWidth, screenHeight, miscHdc, fullScreenRect.left / divisor, fullScreenRect.top / divisor, screenWidth / divisor, screenHeight / divisor, SRCCOPY);
+        }
 
         // Darken screen
         HBITMAP darkenTarget = CreateCompatibleBitmap(hdc, screenWidth, screenHeight);
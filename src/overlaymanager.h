@@ -29,6 +29,8 @@
 #include <wrl.h>
 #include <unordered_map>
 #include "Tako/includes/api.h"
+#include "memorybudget.h"
+#include "startuptimeline.h"
 
 namespace wrl = Microsoft::WRL;
 
@@ -40,7 +42,11 @@ namespace Takoyaki
         OverlayManager() = default;
         ~OverlayManager() = default;
 
+        // The overlay windows are only created the first time the overlay is shown, or by Prewarm.
+        // Both have to happen on the message loop thread, which the windows belong to.
         void Initialize();
+        void Prewarm();
+
         void SetEnabled(bool isEnabled);
         void SetSelectionRect(Tako::TakoRect rect);
         void Update();
@@ -51,15 +57,25 @@ namespace Takoyaki
         inline const std::unordered_map<HWND, MONITORINFOEX>& GetMonitorInfos() const { return m_MonitorInfos; }
         inline const std::unordered_map<HWND, HBITMAP>& GetFullScreenCaptures() const { return m_FullScreenCaptures; }
 
+        // 1 for a full size snapshot, up to MaxSnapshotDivisor when the memory budget only had
+        // room for a smaller one
+        static constexpr uint32_t MaxSnapshotDivisor = 4;
+        uint32_t GetSnapshotDivisor(HWND hWnd) const;
+
     private:
         void InitializeWin32Window();
         HBITMAP GetDisplaySnapshot(HWND hWnd, RECT rect);
+        void ReleaseSnapshot(HWND hWnd);
 
     private:
         std::unordered_map<HWND, MONITORINFOEX> m_MonitorInfos;
         std::unordered_map<HWND, HBITMAP> m_FullScreenCaptures;
+        std::unordered_map<HWND, MemoryReservation> m_SnapshotMemory;
+        std::unordered_map<HWND, uint32_t> m_SnapshotDivisors;
 
         uint32_t m_NumMonitors = 0;
-        bool m_IsEnabled;
+        bool m_IsEnabled = false;
+
+        LazyPhase m_WindowPhase{ "overlay windows", [this]() { InitializeWin32Window(); return true; } };
     };
 }
\ No newline at end of file
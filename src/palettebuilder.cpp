@@ -0,0 +1,84 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "palettebuilder.h"
+#include <algorithm>
+#include "kernels/pixelkernels.h"
+
+Takoyaki::PaletteBuilder::PaletteBuilder() :
+    m_Table(std::make_unique<Kernels::PaletteTable>())
+{
+    m_Colours.reserve(MaxColours);
+    Reset();
+}
+
+void Takoyaki::PaletteBuilder::Reset()
+{
+    std::fill(std::begin(m_Table->m_Indices), std::end(m_Table->m_Indices), Kernels::PaletteEmptySlot);
+    m_Colours.clear();
+    m_IsOverflowed = false;
+}
+
+bool Takoyaki::PaletteBuilder::AddRect(const FrameView& frame, const Rect& rect)
+{
+    if (m_IsOverflowed)
+        return false;
+
+    Kernels::PaletteTable& table = *m_Table;
+    uint32_t previous = 0;
+    bool hasPrevious = false;
+
+    for (uint32_t y = 0; y < rect.m_Height; ++y)
+    {
+        const uint32_t* row = frame.GetRow(rect.m_Y + y) + rect.m_X;
+
+        for (uint32_t x = 0; x < rect.m_Width; ++x)
+        {
+            if (hasPrevious && row[x] == previous)
+                continue;
+
+            previous = row[x];
+            hasPrevious = true;
+
+            uint32_t slot = Kernels::GetPaletteSlot(row[x]);
+            while (table.m_Indices[slot] != Kernels::PaletteEmptySlot && table.m_Colours[slot] != row[x])
+                slot = (slot + 1) & (Kernels::PaletteTableSize - 1);
+
+            if (table.m_Indices[slot] != Kernels::PaletteEmptySlot)
+                continue;
+
+            if (m_Colours.size() == MaxColours)
+            {
+                m_IsOverflowed = true;
+                return false;
+            }
+
+            table.m_Colours[slot] = row[x];
+            table.m_Indices[slot] = static_cast<uint32_t>(m_Colours.size());
+            m_Colours.push_back(row[x]);
+        }
+    }
+
+    return true;
+}
+
+void Takoyaki::PaletteBuilder::MapRow(const uint32_t* row, uint8_t* dst, uint32_t width) const
+{
+    GetPixelKernels().m_MapPaletteRow(*m_Table, row, dst, width);
+}
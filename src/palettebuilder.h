@@ -0,0 +1,63 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "frame.h"
+#include "kernels/palettekernels.h"
+
+namespace Takoyaki
+{
+    // Builds an exact palette for content with few colours, such as terminals, editors and
+    // slides, so that it can be sent as one byte per pixel. Colours are counted into a small
+    // hash table that stays in L1, skipping runs of the same colour, and the count gives up as
+    // soon as there are more colours than fit, so photos and video cost little before the
+    // caller falls back to BGRA.
+    class PaletteBuilder
+    {
+    public:
+        static constexpr uint32_t MaxColours = 256;
+
+        PaletteBuilder();
+        ~PaletteBuilder() = default;
+
+        // Starts a new palette
+        void Reset();
+
+        // Adds every colour in rect. Returns false once the palette has overflowed, after
+        // which it stays unusable until Reset.
+        bool AddRect(const FrameView& frame, const Rect& rect);
+
+        // Writes the palette index of each pixel. Every pixel must have been added.
+        void MapRow(const uint32_t* row, uint8_t* dst, uint32_t width) const;
+
+    public:
+        inline bool IsOverflowed() const { return m_IsOverflowed; }
+        inline const std::vector<uint32_t>& GetColours() const { return m_Colours; }
+        inline const Kernels::PaletteTable& GetTable() const { return *m_Table; }
+
+    private:
+        // Heap allocated, the table is 8 KB
+        std::unique_ptr<Kernels::PaletteTable> m_Table;
+        std::vector<uint32_t> m_Colours;
+        bool m_IsOverflowed = false;
+    };
+}
@@ -0,0 +1,259 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "pngencoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include "deflate.h"
+#include "framealloc.h"
+#include "kernels/pixelkernels.h"
+
+namespace
+{
+    using namespace Takoyaki;
+
+    // Bands are sized by filtered bytes, small enough that every thread gets several and
+    // large enough that the dictionary each band starts without barely costs anything
+    constexpr size_t TargetBandSize = 512 * 1024;
+
+    constexpr uint8_t Signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+    // Deflate with a 32 KB window, flagged as the fast compression level
+    constexpr uint8_t ZlibHeader[2] = { 0x78, 0x5E };
+
+    enum PngFilter : uint8_t
+    {
+        PngFilterSub = 1,
+        PngFilterUp = 2,
+        PngFilterPaeth = 4,
+    };
+
+    inline void StoreBigEndian(uint8_t* out, uint32_t value)
+    {
+        out[0] = static_cast<uint8_t>(value >> 24);
+        out[1] = static_cast<uint8_t>(value >> 16);
+        out[2] = static_cast<uint8_t>(value >> 8);
+        out[3] = static_cast<uint8_t>(value);
+    }
+
+    // Appends the chunk header and reserves the data, which the caller fills in before
+    // closing the chunk
+    size_t BeginChunk(std::vector<uint8_t>& out, const char* type)
+    {
+        size_t start = out.size();
+        out.resize(start + 8);
+        memcpy(out.data() + start + 4, type, 4);
+        return start;
+    }
+
+    void EndChunk(std::vector<uint8_t>& out, size_t start)
+    {
+        size_t dataSize = out.size() - start - 8;
+        StoreBigEndian(out.data() + start, static_cast<uint32_t>(dataSize));
+
+        uint32_t crc = Crc32(out.data() + start + 4, dataSize + 4);
+        out.resize(out.size() + 4);
+        StoreBigEndian(out.data() + out.size() - 4, crc);
+    }
+
+    // Runs work for every task index on up to threadCount threads, the caller included.
+    // Each thread builds its own state once, so buffers and compressors are not shared.
+    template<typename State>
+    void ForEachTask(uint32_t taskCount, uint32_t threadCount, const std::function<void(State&, uint32_t)>& work)
+    {
+        std::atomic<uint32_t> nextTask = 0;
+        auto run = [&]()
+        {
+            State state;
+            for (uint32_t task = nextTask++; task < taskCount; task = nextTask++)
+                work(state, task);
+        };
+
+        std::vector<std::thread> threads;
+        for (uint32_t i = 1; i < std::min(threadCount, taskCount); ++i)
+            threads.emplace_back(run);
+
+        run();
+
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+
+    struct FilterState
+    {
+        std::vector<uint8_t> m_Current;
+        std::vector<uint8_t> m_Previous;
+        std::vector<uint8_t> m_Candidates[3];
+    };
+
+    struct DeflateState
+    {
+        DeflateCompressor m_Compressor;
+    };
+}
+
+bool Takoyaki::PngEncoder::Encode(const FrameView& frame, const Rect& region, std::vector<uint8_t>& outPng)
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    int32_t left = std::max(region.m_X, 0);
+    int32_t top = std::max(region.m_Y, 0);
+    int32_t right = std::min<int64_t>(static_cast<int64_t>(region.m_X) + region.m_Width, frame.m_Width);
+    int32_t bottom = std::min<int64_t>(static_cast<int64_t>(region.m_Y) + region.m_Height, frame.m_Height);
+
+    if (!frame.IsValid() || right <= left || bottom <= top)
+        return false;
+
+    const uint32_t width = static_cast<uint32_t>(right - left);
+    const uint32_t height = static_cast<uint32_t>(bottom - top);
+    const uint32_t rowBytes = width * Kernels::PngBytesPerPixel;
+    const size_t rowSize = rowBytes + 1;
+
+    uint32_t threadCount = m_ThreadCount != 0 ? m_ThreadCount : std::max(std::thread::hardware_concurrency(), 1u);
+    uint32_t bandRows = static_cast<uint32_t>(std::clamp<size_t>(TargetBandSize / rowSize, 1, height));
+    uint32_t bandCount = (height + bandRows - 1) / bandRows;
+
+    // Every row of the image after filtering, each led by its filter type byte
+    FrameAllocation filtered = GetFrameAllocator().Allocate(rowSize * height, MemoryCategory::Scratch);
+    const PixelKernels& kernels = GetPixelKernels();
+
+    auto getSourceRow = [&](uint32_t y) { return frame.GetRow(top + y) + left; };
+
+    ForEachTask<FilterState>(bandCount, threadCount, [&](FilterState& state, uint32_t band)
+    {
+        if (state.m_Current.size() != rowBytes)
+        {
+            state.m_Current.resize(rowBytes);
+            state.m_Previous.resize(rowBytes);
+            for (std::vector<uint8_t>& candidate : state.m_Candidates)
+                candidate.resize(rowBytes);
+        }
+
+        uint32_t firstRow = band * bandRows;
+        uint32_t lastRow = std::min(firstRow + bandRows, height);
+
+        if (firstRow == 0)
+            std::fill(state.m_Previous.begin(), state.m_Previous.end(), 0);
+        else
+            kernels.m_PackRgbRow(getSourceRow(firstRow - 1), state.m_Previous.data(), width);
+
+        for (uint32_t y = firstRow; y < lastRow; ++y)
+        {
+            kernels.m_PackRgbRow(getSourceRow(y), state.m_Current.data(), width);
+
+            const uint8_t* current = state.m_Current.data();
+            const uint8_t* previous = state.m_Previous.data();
+            uint32_t costs[3] = {
+                kernels.m_PngFilterSub(current, previous, state.m_Candidates[0].data(), rowBytes),
+                kernels.m_PngFilterUp(current, previous, state.m_Candidates[1].data(), rowBytes),
+                kernels.m_PngFilterPaeth(current, previous, state.m_Candidates[2].data(), rowBytes),
+            };
+
+            static constexpr uint8_t FilterTypes[3] = { PngFilterSub, PngFilterUp, PngFilterPaeth };
+            uint32_t best = static_cast<uint32_t>(std::min_element(costs, costs + 3) - costs);
+
+            uint8_t* out = filtered.m_Data + rowSize * y;
+            out[0] = FilterTypes[best];
+            memcpy(out + 1, state.m_Candidates[best].data(), rowBytes);
+
+            std::swap(state.m_Current, state.m_Previous);
+        }
+    });
+
+    auto filterTime = std::chrono::steady_clock::now();
+
+    std::vector<std::vector<uint8_t>> bandChunks(bandCount);
+    std::vector<uint32_t> bandAdlers(bandCount);
+
+    ForEachTask<DeflateState>(bandCount, threadCount, [&](DeflateState& state, uint32_t band)
+    {
+        size_t start = rowSize * band * bandRows;
+        size_t size = rowSize * (std::min(band * bandRows + bandRows, height) - band * bandRows);
+        const uint8_t* data = filtered.m_Data + start;
+
+        std::vector<uint8_t>& chunk = bandChunks[band];
+        chunk.reserve(size / 2 + 64);
+
+        size_t chunkStart = BeginChunk(chunk, "IDAT");
+        if (band == 0)
+            chunk.insert(chunk.end(), ZlibHeader, ZlibHeader + sizeof(ZlibHeader));
+
+        state.m_Compressor.SetMaxChainLength(m_MaxChainLength);
+        state.m_Compressor.Compress(data, size, start, band + 1 == bandCount, chunk);
+        EndChunk(chunk, chunkStart);
+
+        bandAdlers[band] = Adler32(data, size);
+    });
+
+    auto deflateTime = std::chrono::steady_clock::now();
+
+    uint32_t adler = bandAdlers[0];
+    for (uint32_t band = 1; band < bandCount; ++band)
+    {
+        size_t bandSize = rowSize * (std::min(band * bandRows + bandRows, height) - band * bandRows);
+        adler = CombineAdler32(adler, bandAdlers[band], bandSize);
+    }
+
+    size_t encodedSize = sizeof(Signature) + 25 + 16 + 12;
+    for (const std::vector<uint8_t>& chunk : bandChunks)
+        encodedSize += chunk.size();
+
+    outPng.clear();
+    outPng.reserve(encodedSize);
+    outPng.insert(outPng.end(), Signature, Signature + sizeof(Signature));
+
+    // 8 bits per channel, RGB, deflate, adaptive filtering, not interlaced
+    size_t header = BeginChunk(outPng, "IHDR");
+    uint8_t headerData[13] = { 0, 0, 0, 0, 0, 0, 0, 0, 8, 2, 0, 0, 0 };
+    StoreBigEndian(headerData, width);
+    StoreBigEndian(headerData + 4, height);
+    outPng.insert(outPng.end(), headerData, headerData + sizeof(headerData));
+    EndChunk(outPng, header);
+
+    for (const std::vector<uint8_t>& chunk : bandChunks)
+        outPng.insert(outPng.end(), chunk.begin(), chunk.end());
+
+    // The zlib trailer goes in one last IDAT of its own, the decoder sees one stream
+    size_t trailer = BeginChunk(outPng, "IDAT");
+    outPng.resize(outPng.size() + 4);
+    StoreBigEndian(outPng.data() + outPng.size() - 4, adler);
+    EndChunk(outPng, trailer);
+
+    EndChunk(outPng, BeginChunk(outPng, "IEND"));
+
+    GetFrameAllocator().Free(filtered);
+
+    auto endTime = std::chrono::steady_clock::now();
+    m_LastStats.m_FilterTime = std::chrono::duration_cast<std::chrono::microseconds>(filterTime - startTime);
+    m_LastStats.m_DeflateTime = std::chrono::duration_cast<std::chrono::microseconds>(deflateTime - filterTime);
+    m_LastStats.m_TotalTime = std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime);
+    m_LastStats.m_Width = width;
+    m_LastStats.m_Height = height;
+    m_LastStats.m_FilteredSize = rowSize * height;
+    m_LastStats.m_EncodedSize = outPng.size();
+    m_LastStats.m_BandCount = bandCount;
+    m_LastStats.m_ThreadCount = std::min(threadCount, bandCount);
+
+    return true;
+}
@@ -0,0 +1,74 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include "frame.h"
+
+namespace Takoyaki
+{
+    struct PngEncodeStats
+    {
+        std::chrono::microseconds m_FilterTime{ 0 };
+        std::chrono::microseconds m_DeflateTime{ 0 };
+        std::chrono::microseconds m_TotalTime{ 0 };
+
+        // Size of the image written, the region after clipping to the frame
+        uint32_t m_Width = 0;
+        uint32_t m_Height = 0;
+
+        size_t m_FilteredSize = 0;
+        size_t m_EncodedSize = 0;
+        uint32_t m_BandCount = 0;
+        uint32_t m_ThreadCount = 0;
+    };
+
+    // Writes frames as 8-bit RGB PNGs, quickly enough for full 4K screenshots on demand.
+    // The image is cut into bands of rows. Every band is packed, filtered with the SIMD
+    // kernels (each row takes whichever of Sub, Up and Paeth scores lowest) and deflated on
+    // its own thread, with the 32 KB before the band as dictionary, then written as its
+    // own IDAT chunk. The zlib Adler-32 is combined from the per-band sums, so nothing
+    // walks the whole image serially.
+    class PngEncoder
+    {
+    public:
+        PngEncoder() = default;
+        ~PngEncoder() = default;
+
+        // Encodes the part of frame inside region. Returns false when the region does not
+        // overlap the frame.
+        bool Encode(const FrameView& frame, const Rect& region, std::vector<uint8_t>& outPng);
+
+    public:
+        inline const PngEncodeStats& GetLastStats() const { return m_LastStats; }
+
+        // Worker threads per encode, including the caller. 0 uses one per hardware thread.
+        inline void SetThreadCount(uint32_t count) { m_ThreadCount = count; }
+        inline void SetMaxChainLength(uint32_t length) { m_MaxChainLength = length; }
+
+    private:
+        uint32_t m_ThreadCount = 0;
+        uint32_t m_MaxChainLength = 8;
+        PngEncodeStats m_LastStats;
+    };
+}
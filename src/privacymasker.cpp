@@ -0,0 +1,144 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "privacymasker.h"
+#include "kernels/pixelkernels.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // Intersects a mask with the frame, returning false if nothing is left
+    bool ClipToFrame(const Takoyaki::Rect& rect, const Takoyaki::FrameView& frame, Takoyaki::Rect& clipped)
+    {
+        int64_t left = std::max<int64_t>(rect.m_X, 0);
+        int64_t top = std::max<int64_t>(rect.m_Y, 0);
+        int64_t right = std::min<int64_t>(static_cast<int64_t>(rect.m_X) + rect.m_Width, frame.m_Width);
+        int64_t bottom = std::min<int64_t>(static_cast<int64_t>(rect.m_Y) + rect.m_Height, frame.m_Height);
+
+        if (left >= right || top >= bottom)
+            return false;
+
+        clipped.m_X = static_cast<int32_t>(left);
+        clipped.m_Y = static_cast<int32_t>(top);
+        clipped.m_Width = static_cast<uint32_t>(right - left);
+        clipped.m_Height = static_cast<uint32_t>(bottom - top);
+        return true;
+    }
+}
+
+void Takoyaki::PrivacyMasker::SetMasks(const std::vector<PrivacyMask>& masks)
+{
+    m_Masks = masks;
+}
+
+void Takoyaki::PrivacyMasker::AddMask(const PrivacyMask& mask)
+{
+    m_Masks.push_back(mask);
+}
+
+void Takoyaki::PrivacyMasker::ClearMasks()
+{
+    m_Masks.clear();
+}
+
+void Takoyaki::PrivacyMasker::Apply(const FrameView& frame, int32_t originX, int32_t originY)
+{
+    if (!frame.IsValid())
+        return;
+
+    for (const PrivacyMask& mask : m_Masks)
+    {
+        Rect shifted = { mask.m_Rect.m_X - originX, mask.m_Rect.m_Y - originY, mask.m_Rect.m_Width, mask.m_Rect.m_Height };
+
+        Rect rect;
+        if (!ClipToFrame(shifted, frame, rect))
+            continue;
+
+        if (mask.m_Style == MaskStyle::Blur)
+            Blur(frame, rect, std::clamp(mask.m_Strength, 1u, Kernels::MaxBoxBlurRadius));
+        else
+            Pixelate(frame, rect, shifted, std::max(mask.m_Strength, 1u));
+    }
+
+    m_Scratch.Reset();
+}
+
+void Takoyaki::PrivacyMasker::Blur(const FrameView& frame, const Rect& rect, uint32_t radius)
+{
+    const PixelKernels& kernels = GetPixelKernels();
+
+    const uint32_t window = radius * 2 + 1;
+    const uint16_t bias = static_cast<uint16_t>(window / 2);
+    const uint16_t reciprocal = static_cast<uint16_t>((65536 + window - 1) / window);
+
+    const uint32_t rowBytes = rect.m_Width * 4;
+    const int32_t lastRow = static_cast<int32_t>(rect.m_Height) - 1;
+
+    uint8_t* blurRows = m_Scratch.AllocateArray<uint8_t>(static_cast<size_t>(rowBytes) * rect.m_Height);
+    uint16_t* columnSums = m_Scratch.AllocateArray<uint16_t>(rowBytes);
+    uint8_t* zeroRow = m_Scratch.AllocateArray<uint8_t>(rowBytes);
+    memset(zeroRow, 0, rowBytes);
+
+    auto frameRow = [&](int32_t y) { return reinterpret_cast<uint8_t*>(frame.GetRow(rect.m_Y + y) + rect.m_X); };
+    auto blurRow = [&](int32_t y) { return blurRows + static_cast<size_t>(y) * rowBytes; };
+
+    // Horizontal pass into scratch, since the vertical pass still needs the unblurred rows
+    for (int32_t y = 0; y <= lastRow; ++y)
+        kernels.m_BoxBlurRow(frameRow(y), blurRow(y), rect.m_Width, radius, bias, reciprocal);
+
+    // Vertical pass keeps a running sum per byte column, with the top edge replicated
+    const uint8_t* firstRow = blurRow(0);
+    for (uint32_t i = 0; i < rowBytes; ++i)
+        columnSums[i] = static_cast<uint16_t>(firstRow[i] * radius);
+
+    for (int32_t y = 0; y <= static_cast<int32_t>(radius); ++y)
+        kernels.m_BoxBlurAccumulate(columnSums, blurRow(std::min(y, lastRow)), zeroRow, rowBytes);
+
+    for (int32_t y = 0; y <= lastRow; ++y)
+    {
+        kernels.m_BoxBlurEmit(columnSums, frameRow(y), rowBytes, bias, reciprocal);
+
+        int32_t entering = std::min(y + static_cast<int32_t>(radius) + 1, lastRow);
+        int32_t leaving = std::max(y - static_cast<int32_t>(radius), 0);
+        kernels.m_BoxBlurAccumulate(columnSums, blurRow(entering), blurRow(leaving), rowBytes);
+    }
+}
+
+void Takoyaki::PrivacyMasker::Pixelate(const FrameView& frame, const Rect& rect, const Rect& grid, uint32_t blockSize)
+{
+    const PixelKernels& kernels = GetPixelKernels();
+
+    // Blocks are aligned to the unclipped mask origin, so the grid does not move with the
+    // frame or with a crop, and blocks cut by the frame edge are averaged over what is left
+    const uint32_t firstColumns = std::min((blockSize - static_cast<uint32_t>(rect.m_X - grid.m_X) % blockSize) % blockSize, rect.m_Width);
+    uint32_t rows = std::min(blockSize - static_cast<uint32_t>(rect.m_Y - grid.m_Y) % blockSize, rect.m_Height);
+
+    for (uint32_t y = 0; y < rect.m_Height; y += rows, rows = std::min(blockSize, rect.m_Height - y))
+    {
+        uint8_t* band = reinterpret_cast<uint8_t*>(frame.GetRow(rect.m_Y + y) + rect.m_X);
+        if (firstColumns != 0)
+            kernels.m_PixelateBand(band, frame.m_Stride, firstColumns, rows, blockSize);
+
+        if (firstColumns < rect.m_Width)
+            kernels.m_PixelateBand(band + firstColumns * 4, frame.m_Stride, rect.m_Width - firstColumns, rows, blockSize);
+    }
+}
@@ -0,0 +1,80 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <vector>
+#include "frame.h"
+#include "framealloc.h"
+
+namespace Takoyaki
+{
+    enum class MaskStyle
+    {
+        Blur,
+        Pixelate,
+    };
+
+    struct PrivacyMask
+    {
+        // Relative to the capture rect, clipped to the frame when applied
+        Rect m_Rect;
+        MaskStyle m_Style = MaskStyle::Blur;
+
+        // Blur radius in pixels, or the pixelation block size
+        uint32_t m_Strength = 16;
+    };
+
+    // Hides parts of a captured frame in place. Blur is a separable running-sum box blur, so
+    // its cost per pixel does not depend on the radius, and only pixels inside a mask are
+    // read or written.
+    class PrivacyMasker
+    {
+    public:
+        PrivacyMasker() = default;
+        ~PrivacyMasker() = default;
+
+        PrivacyMasker(const PrivacyMasker&) = delete;
+        PrivacyMasker& operator=(const PrivacyMasker&) = delete;
+
+        // The frame may be cropped out of the capture rect the masks are relative to, with its
+        // top left corner at originX, originY in it
+        void Apply(const FrameView& frame, int32_t originX = 0, int32_t originY = 0);
+
+    public:
+        inline const std::vector<PrivacyMask>& GetMasks() const { return m_Masks; }
+        inline bool HasMasks() const { return !m_Masks.empty(); }
+
+        void SetMasks(const std::vector<PrivacyMask>& masks);
+        void AddMask(const PrivacyMask& mask);
+        void ClearMasks();
+
+    private:
+        void Blur(const FrameView& frame, const Rect& rect, uint32_t radius);
+        void Pixelate(const FrameView& frame, const Rect& rect, const Rect& grid, uint32_t blockSize);
+
+    private:
+        std::vector<PrivacyMask> m_Masks;
+
+        // Blur scratch for every mask in a frame, all given back at once when the frame is
+        // done. Charged to the memory budget as scratch, and no allocation once warmed up.
+        FrameArena m_Scratch;
+    };
+}
@@ -0,0 +1,153 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "screenshotwriter.h"
+
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+
+Takoyaki::ScreenshotWriter::ScreenshotWriter()
+{
+    m_Thread = std::thread(&ScreenshotWriter::WriterLoop, this);
+}
+
+Takoyaki::ScreenshotWriter::~ScreenshotWriter()
+{
+    // Requests already queued are still written, a screenshot the user asked for is not
+    // thrown away on exit
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_IsStopping = true;
+    }
+
+    m_Condition.notify_all();
+    m_Thread.join();
+}
+
+bool Takoyaki::ScreenshotWriter::Request(FrameRef frame, const Rect& region, std::filesystem::path path)
+{
+    if (!frame)
+        return false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_Jobs.size() >= MaxPendingRequests)
+            return false;
+
+        m_Jobs.push_back({ std::move(frame), region, std::move(path), std::chrono::steady_clock::now() });
+    }
+
+    m_Condition.notify_all();
+    return true;
+}
+
+void Takoyaki::ScreenshotWriter::WaitUntilIdle()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Condition.wait(lock, [this]() { return m_Jobs.empty() && !m_IsBusy; });
+}
+
+std::string Takoyaki::ScreenshotWriter::MakeFileName(std::chrono::system_clock::time_point time)
+{
+    std::time_t seconds = std::chrono::system_clock::to_time_t(time);
+    std::tm local = {};
+
+#ifdef _WIN32
+    localtime_s(&local, &seconds);
+#else
+    localtime_r(&seconds, &local);
+#endif
+
+    char name[64];
+    strftime(name, sizeof(name), "Takoyaki %Y-%m-%d %H-%M-%S.png", &local);
+    return name;
+}
+
+void Takoyaki::ScreenshotWriter::SetCompletionCallback(CompletionCallback callback)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Callback = std::move(callback);
+}
+
+void Takoyaki::ScreenshotWriter::WriterLoop()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+
+    while (true)
+    {
+        m_Condition.wait(lock, [this]() { return m_IsStopping || !m_Jobs.empty(); });
+        if (m_Jobs.empty())
+            return;
+
+        Job job = std::move(m_Jobs.front());
+        m_Jobs.pop_front();
+        m_IsBusy = true;
+        lock.unlock();
+
+        ScreenshotResult result = Write(job);
+
+        // The frame goes back to its pool before anyone is told the write is done
+        job.m_Frame.Reset();
+
+        lock.lock();
+        CompletionCallback callback = m_Callback;
+        lock.unlock();
+
+        if (callback)
+            callback(result);
+
+        lock.lock();
+        m_IsBusy = false;
+        m_Condition.notify_all();
+    }
+}
+
+Takoyaki::ScreenshotResult Takoyaki::ScreenshotWriter::Write(const Job& job)
+{
+    ScreenshotResult result;
+    result.m_Path = job.m_Path;
+
+    const FrameBuffer& buffer = *job.m_Frame.Get();
+    FrameView view = { const_cast<uint8_t*>(buffer.GetData()), buffer.GetWidth(), buffer.GetHeight(), buffer.GetStride() };
+
+    if (!m_Encoder.Encode(view, job.m_Region, m_Png))
+    {
+        fprintf(stderr, "Takoyaki: screenshot region is outside the frame\n");
+        return result;
+    }
+
+    std::ofstream file(job.m_Path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(m_Png.data()), static_cast<std::streamsize>(m_Png.size()));
+    file.close();
+
+    const PngEncodeStats& stats = m_Encoder.GetLastStats();
+    result.m_IsSaved = file.good();
+    result.m_Width = stats.m_Width;
+    result.m_Height = stats.m_Height;
+    result.m_FileSize = m_Png.size();
+    result.m_EncodeStats = stats;
+    result.m_TotalTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - job.m_RequestTime);
+
+    if (!result.m_IsSaved)
+        fprintf(stderr, "Takoyaki: failed to write screenshot %s\n", job.m_Path.string().c_str());
+
+    return result;
+}
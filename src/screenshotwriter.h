@@ -0,0 +1,104 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "framepool.h"
+#include "pngencoder.h"
+
+namespace Takoyaki
+{
+    struct ScreenshotResult
+    {
+        std::filesystem::path m_Path;
+        bool m_IsSaved = false;
+
+        uint32_t m_Width = 0;
+        uint32_t m_Height = 0;
+        size_t m_FileSize = 0;
+
+        // From the request to the file being written, and the encoder's part of that
+        std::chrono::microseconds m_TotalTime{ 0 };
+        PngEncodeStats m_EncodeStats;
+    };
+
+    // Saves regions of captured frames as PNG files on a background thread. A request only
+    // takes a reference to the frame, so the capture loop never waits on encoding or disk.
+    class ScreenshotWriter
+    {
+    public:
+        using CompletionCallback = std::function<void(const ScreenshotResult&)>;
+
+        static constexpr size_t MaxPendingRequests = 4;
+
+        ScreenshotWriter();
+        ~ScreenshotWriter();
+
+        ScreenshotWriter(const ScreenshotWriter&) = delete;
+        ScreenshotWriter& operator=(const ScreenshotWriter&) = delete;
+
+        // Queues region of frame to be written to path. Returns false, without queueing,
+        // when MaxPendingRequests are already waiting.
+        bool Request(FrameRef frame, const Rect& region, std::filesystem::path path);
+
+        // Blocks until every queued request has been written
+        void WaitUntilIdle();
+
+        // "Takoyaki 2023-05-14 18-30-05.png" style file name for the given local time
+        static std::string MakeFileName(std::chrono::system_clock::time_point time);
+
+    public:
+        // Called on the writer thread after every request, whether or not it was saved
+        void SetCompletionCallback(CompletionCallback callback);
+        inline PngEncoder& GetEncoder() { return m_Encoder; }
+
+    private:
+        struct Job
+        {
+            FrameRef m_Frame;
+            Rect m_Region;
+            std::filesystem::path m_Path;
+            std::chrono::steady_clock::time_point m_RequestTime;
+        };
+
+        void WriterLoop();
+        ScreenshotResult Write(const Job& job);
+
+    private:
+        PngEncoder m_Encoder;
+        std::vector<uint8_t> m_Png;
+
+        std::mutex m_Mutex;
+        std::condition_variable m_Condition;
+        std::deque<Job> m_Jobs;
+        CompletionCallback m_Callback;
+        bool m_IsBusy = false;
+        bool m_IsStopping = false;
+
+        std::thread m_Thread;
+    };
+}
@@ -0,0 +1,223 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "selectioncontroller.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+bool Takoyaki::SelectionController::OnHotkey(Clock::time_point time)
+{
+    if (IsOverlayActive())
+        return false;
+
+    m_SelectionRect = { 0, 0, 1, 1 };
+    m_IsOverlayShown = false;
+    m_IsOverlayPending = true;
+    m_HotkeyTime = time;
+
+    Transition(SelectionEvent::Hotkey, SelectionState::Overlay, time);
+    return true;
+}
+
+bool Takoyaki::SelectionController::OnCancel(Clock::time_point time)
+{
+    if (!IsOverlayActive())
+        return false;
+
+    m_SelectionRect = { 0, 0, 1, 1 };
+    m_IsOverlayShown = false;
+    m_IsOverlayPending = false;
+
+    Transition(SelectionEvent::Cancel, SelectionState::Inactive, time);
+    return true;
+}
+
+bool Takoyaki::SelectionController::OnPointerDown(int32_t x, int32_t y, Clock::time_point time)
+{
+    if (m_State != SelectionState::Overlay)
+        return false;
+
+    m_StartX = m_EndX = x;
+    m_StartY = m_EndY = y;
+    UpdateSelectionRect();
+
+    Transition(SelectionEvent::PointerDown, SelectionState::Selecting, time);
+    return true;
+}
+
+bool Takoyaki::SelectionController::OnPointerMove(int32_t x, int32_t y, Clock::time_point time)
+{
+    (void)time;
+
+    if (m_State != SelectionState::Selecting)
+        return false;
+
+    // Moves only change the rect, so they are not worth a transition each
+    m_EndX = x;
+    m_EndY = y;
+    UpdateSelectionRect();
+    return true;
+}
+
+bool Takoyaki::SelectionController::OnPointerUp(Clock::time_point time)
+{
+    if (m_State != SelectionState::Selecting)
+        return false;
+
+    m_CaptureRect = m_SelectionRect;
+    m_SelectionRect = { 0, 0, 1, 1 };
+    m_IsOverlayShown = false;
+    m_IsOverlayPending = false;
+    m_IsCapturing = true;
+    m_IsFramePending = true;
+    m_CaptureStartTime = time;
+
+    Transition(SelectionEvent::PointerUp, SelectionState::Inactive, time);
+    return true;
+}
+
+void Takoyaki::SelectionController::SetCapturing(bool isCapturing, Clock::time_point time)
+{
+    if (m_IsCapturing == isCapturing)
+        return;
+
+    m_IsCapturing = isCapturing;
+    m_IsFramePending = isCapturing;
+    m_CaptureStartTime = time;
+
+    Transition(isCapturing ? SelectionEvent::StartCapture : SelectionEvent::StopCapture, m_State, time);
+}
+
+void Takoyaki::SelectionController::OnOverlayShown(Clock::time_point time)
+{
+    if (!IsOverlayActive() || m_IsOverlayShown)
+        return;
+
+    m_IsOverlayShown = true;
+
+    if (m_IsOverlayPending)
+    {
+        m_IsOverlayPending = false;
+        AddSample(m_Latencies.m_HotkeyToOverlay, m_HotkeyTime, time);
+    }
+}
+
+void Takoyaki::SelectionController::OnFramePresented(Clock::time_point time)
+{
+    // A frame presented while the overlay is up is left over from before it
+    if (!m_IsFramePending || !m_IsCapturing || IsOverlayActive())
+        return;
+
+    m_IsFramePending = false;
+    AddSample(m_Latencies.m_SelectToFirstFrame, m_CaptureStartTime, time);
+}
+
+void Takoyaki::SelectionController::ClearHistory()
+{
+    m_Transitions.clear();
+    m_Latencies.m_HotkeyToOverlay.clear();
+    m_Latencies.m_SelectToFirstFrame.clear();
+}
+
+std::string Takoyaki::SelectionController::GetReport() const
+{
+    char line[160];
+    snprintf(line, sizeof(line), "Selection: %s, %s, %zu transitions\n",
+        GetSelectionStateName(m_State), m_IsCapturing ? "capturing" : "stopped", m_Transitions.size());
+
+    std::string report = line;
+
+    auto addLatencies = [&](const char* name, std::vector<std::chrono::microseconds> samples)
+    {
+        if (samples.empty())
+        {
+            snprintf(line, sizeof(line), "  %s: no samples\n", name);
+            report += line;
+            return;
+        }
+
+        std::sort(samples.begin(), samples.end());
+        auto percentile = [&](size_t percent) { return samples[(samples.size() - 1) * percent / 100].count() / 1000.0; };
+
+        snprintf(line, sizeof(line), "  %s: %zu samples, median %.2f ms, p95 %.2f ms, max %.2f ms\n",
+            name, samples.size(), percentile(50), percentile(95), samples.back().count() / 1000.0);
+        report += line;
+    };
+
+    addLatencies("hotkey to overlay", m_Latencies.m_HotkeyToOverlay);
+    addLatencies("selection to first frame", m_Latencies.m_SelectToFirstFrame);
+
+    return report;
+}
+
+void Takoyaki::SelectionController::Transition(SelectionEvent event, SelectionState state, Clock::time_point time)
+{
+    if (m_Transitions.size() >= MaxTransitions)
+        m_Transitions.erase(m_Transitions.begin());
+
+    m_Transitions.push_back({ event, m_State, state, time });
+    m_State = state;
+}
+
+void Takoyaki::SelectionController::UpdateSelectionRect()
+{
+    m_SelectionRect =
+    {
+        std::min(m_StartX, m_EndX),
+        std::min(m_StartY, m_EndY),
+        static_cast<uint32_t>(std::max(1, std::abs(m_StartX - m_EndX))),
+        static_cast<uint32_t>(std::max(1, std::abs(m_StartY - m_EndY)))
+    };
+}
+
+void Takoyaki::SelectionController::AddSample(std::vector<std::chrono::microseconds>& samples, Clock::time_point start, Clock::time_point end)
+{
+    if (samples.size() >= MaxSamples)
+        samples.erase(samples.begin());
+
+    samples.push_back(std::chrono::duration_cast<std::chrono::microseconds>(end - start));
+}
+
+const char* Takoyaki::GetSelectionStateName(SelectionState state)
+{
+    switch (state)
+    {
+    case SelectionState::Inactive: return "inactive";
+    case SelectionState::Overlay: return "overlay";
+    case SelectionState::Selecting: return "selecting";
+    default: return "unknown";
+    }
+}
+
+const char* Takoyaki::GetSelectionEventName(SelectionEvent event)
+{
+    switch (event)
+    {
+    case SelectionEvent::Hotkey: return "hotkey";
+    case SelectionEvent::Cancel: return "cancel";
+    case SelectionEvent::PointerDown: return "pointer down";
+    case SelectionEvent::PointerMove: return "pointer move";
+    case SelectionEvent::PointerUp: return "pointer up";
+    case SelectionEvent::StartCapture: return "start capture";
+    case SelectionEvent::StopCapture: return "stop capture";
+    default: return "unknown";
+    }
+}
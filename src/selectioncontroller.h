@@ -0,0 +1,148 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "frame.h"
+
+namespace Takoyaki
+{
+    enum class SelectionState
+    {
+        Inactive,   // No overlay, capturing or not
+        Overlay,    // Overlay up, waiting for the first press
+        Selecting,  // Dragging out a region
+    };
+
+    enum class SelectionEvent
+    {
+        Hotkey,
+        Cancel,
+        PointerDown,
+        PointerMove,
+        PointerUp,
+        StartCapture,
+        StopCapture,
+    };
+
+    struct SelectionTransition
+    {
+        SelectionEvent m_Event = SelectionEvent::Hotkey;
+        SelectionState m_From = SelectionState::Inactive;
+        SelectionState m_To = SelectionState::Inactive;
+        std::chrono::steady_clock::time_point m_Time;
+    };
+
+    // How long between an input and what it should make visible
+    struct SelectionLatencies
+    {
+        std::vector<std::chrono::microseconds> m_HotkeyToOverlay;
+        std::vector<std::chrono::microseconds> m_SelectToFirstFrame;
+    };
+
+    // The selection overlay and capture region as a state machine, fed input events from
+    // whatever owns the window and the hotkey, and told by the frame loop when the overlay
+    // has been shown and when a frame has been presented. Every event that changes the state
+    // is kept with its timestamp, so the time from the hotkey to the overlay and from the
+    // end of a selection to its first frame can be measured. Not thread safe, all calls are
+    // expected from the thread that runs the message loop.
+    class SelectionController
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        // Transitions and latency samples beyond these drop the oldest
+        static constexpr size_t MaxTransitions = 256;
+        static constexpr size_t MaxSamples = 1024;
+
+        SelectionController() = default;
+        ~SelectionController() = default;
+
+        // Each returns true if the event was used, so a keyboard hook knows whether to pass
+        // it on. The hotkey opens the overlay and cancel closes it without changing anything.
+        bool OnHotkey(Clock::time_point time = Clock::now());
+        bool OnCancel(Clock::time_point time = Clock::now());
+
+        // A press starts the selection and releasing it starts capturing the region between
+        // the press and the last move, in physical screen coordinates
+        bool OnPointerDown(int32_t x, int32_t y, Clock::time_point time = Clock::now());
+        bool OnPointerMove(int32_t x, int32_t y, Clock::time_point time = Clock::now());
+        bool OnPointerUp(Clock::time_point time = Clock::now());
+
+        // From the tray menu, keeps the current region
+        void SetCapturing(bool isCapturing, Clock::time_point time = Clock::now());
+
+        // From the frame loop. Only the first of each after the hotkey, or after a selection
+        // or capture start, is a latency sample.
+        void OnOverlayShown(Clock::time_point time = Clock::now());
+        void OnFramePresented(Clock::time_point time = Clock::now());
+
+    public:
+        inline SelectionState GetState() const { return m_State; }
+        inline bool IsOverlayActive() const { return m_State != SelectionState::Inactive; }
+        inline bool IsOverlayShown() const { return m_IsOverlayShown; }
+        inline bool IsCapturing() const { return m_IsCapturing; }
+
+        // The rect being dragged out, 1x1 at the origin when there is none
+        inline Rect GetSelectionRect() const { return m_SelectionRect; }
+        inline Rect GetCaptureRect() const { return m_CaptureRect; }
+
+        inline const std::vector<SelectionTransition>& GetTransitions() const { return m_Transitions; }
+        inline const SelectionLatencies& GetLatencies() const { return m_Latencies; }
+        void ClearHistory();
+
+        std::string GetReport() const;
+
+    private:
+        void Transition(SelectionEvent event, SelectionState state, Clock::time_point time);
+        void UpdateSelectionRect();
+
+        static void AddSample(std::vector<std::chrono::microseconds>& samples, Clock::time_point start, Clock::time_point end);
+
+    private:
+        SelectionState m_State = SelectionState::Inactive;
+        bool m_IsOverlayShown = false;
+        bool m_IsCapturing = false;
+
+        int32_t m_StartX = 0;
+        int32_t m_StartY = 0;
+        int32_t m_EndX = 0;
+        int32_t m_EndY = 0;
+
+        Rect m_SelectionRect = { 0, 0, 1, 1 };
+        Rect m_CaptureRect = { 0, 0, 1, 1 };
+
+        // When the latency being waited for started, if one is
+        bool m_IsOverlayPending = false;
+        bool m_IsFramePending = false;
+        Clock::time_point m_HotkeyTime;
+        Clock::time_point m_CaptureStartTime;
+
+        std::vector<SelectionTransition> m_Transitions;
+        SelectionLatencies m_Latencies;
+    };
+
+    const char* GetSelectionStateName(SelectionState state);
+    const char* GetSelectionEventName(SelectionEvent event);
+}
@@ -0,0 +1,193 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "startuptimeline.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+Takoyaki::StartupTimeline::StartupTimeline()
+    : m_Origin(Clock::now())
+{
+}
+
+void Takoyaki::StartupTimeline::Restart()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    m_Origin = Clock::now();
+    m_Phases.clear();
+    m_Milestones.clear();
+}
+
+void Takoyaki::StartupTimeline::AddPhase(const char* name, Clock::time_point start, Clock::time_point end, bool isBackground)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    m_Phases.push_back({
+        .m_Name = name,
+        .m_Start = GetOffset(start),
+        .m_Duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start),
+        .m_IsBackground = isBackground,
+    });
+}
+
+void Takoyaki::StartupTimeline::Mark(const char* name)
+{
+    Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    for (const StartupMilestone& milestone : m_Milestones)
+    {
+        if (strcmp(milestone.m_Name, name) == 0)
+            return;
+    }
+
+    m_Milestones.push_back({ name, GetOffset(now) });
+}
+
+bool Takoyaki::StartupTimeline::GetMilestone(const char* name, std::chrono::microseconds& outTime) const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    for (const StartupMilestone& milestone : m_Milestones)
+    {
+        if (strcmp(milestone.m_Name, name) == 0)
+        {
+            outTime = milestone.m_Time;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::vector<Takoyaki::StartupPhase> Takoyaki::StartupTimeline::GetPhases() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Phases;
+}
+
+std::vector<Takoyaki::StartupMilestone> Takoyaki::StartupTimeline::GetMilestones() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Milestones;
+}
+
+std::string Takoyaki::StartupTimeline::GetReport() const
+{
+    std::vector<StartupPhase> phases = GetPhases();
+    std::vector<StartupMilestone> milestones = GetMilestones();
+
+    // Phases are added when they finish, so sort them back into the order they started
+    std::stable_sort(phases.begin(), phases.end(), [](const StartupPhase& a, const StartupPhase& b) { return a.m_Start < b.m_Start; });
+
+    char line[160];
+    std::string report = "Startup timeline:\n";
+
+    for (const StartupPhase& phase : phases)
+    {
+        snprintf(line, sizeof(line), "  %9.2f ms  %8.2f ms  %s%s\n",
+            phase.m_Start.count() / 1000.0, phase.m_Duration.count() / 1000.0, phase.m_Name, phase.m_IsBackground ? " (background)" : "");
+        report += line;
+    }
+
+    for (const StartupMilestone& milestone : milestones)
+    {
+        snprintf(line, sizeof(line), "  %s at %.2f ms\n", milestone.m_Name, milestone.m_Time.count() / 1000.0);
+        report += line;
+    }
+
+    return report;
+}
+
+std::chrono::microseconds Takoyaki::StartupTimeline::GetOffset(Clock::time_point time) const
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(time - m_Origin);
+}
+
+Takoyaki::StartupTimeline& Takoyaki::GetStartupTimeline()
+{
+    static StartupTimeline timeline;
+    return timeline;
+}
+
+Takoyaki::LazyPhase::LazyPhase(const char* name, InitFn init, StartupTimeline& timeline)
+    : m_Name(name)
+    , m_Init(std::move(init))
+    , m_Timeline(timeline)
+{
+}
+
+Takoyaki::LazyPhase::~LazyPhase()
+{
+    if (m_PrewarmThread.joinable())
+        m_PrewarmThread.join();
+}
+
+bool Takoyaki::LazyPhase::Ensure()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Condition.wait(lock, [this]() { return m_State != State::Running; });
+
+    if (m_State == State::Ready)
+        return true;
+
+    m_State = State::Running;
+    lock.unlock();
+
+    return Run(false);
+}
+
+void Takoyaki::LazyPhase::Prewarm()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    // A prewarm that failed is left for Ensure to retry where the result is needed
+    if (m_State != State::Pending || m_PrewarmThread.joinable())
+        return;
+
+    m_State = State::Running;
+    m_PrewarmThread = std::thread([this]() { Run(true); });
+}
+
+bool Takoyaki::LazyPhase::IsReady() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_State == State::Ready;
+}
+
+bool Takoyaki::LazyPhase::Run(bool isBackground)
+{
+    StartupTimeline::Clock::time_point start = StartupTimeline::Clock::now();
+    bool isReady = m_Init();
+    m_Timeline.AddPhase(m_Name, start, StartupTimeline::Clock::now(), isBackground);
+
+    if (!isReady)
+        fprintf(stderr, "Takoyaki: failed to initialize %s\n", m_Name);
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_State = isReady ? State::Ready : State::Pending;
+    }
+
+    m_Condition.notify_all();
+    return isReady;
+}
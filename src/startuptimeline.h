@@ -0,0 +1,155 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Takoyaki
+{
+    struct StartupPhase
+    {
+        const char* m_Name = nullptr;
+
+        // Both relative to the start of the timeline
+        std::chrono::microseconds m_Start{ 0 };
+        std::chrono::microseconds m_Duration{ 0 };
+
+        bool m_IsBackground = false;
+    };
+
+    struct StartupMilestone
+    {
+        const char* m_Name = nullptr;
+        std::chrono::microseconds m_Time{ 0 };
+    };
+
+    // When each phase of startup ran and how long it took, along with milestones such as
+    // the tray icon appearing or the first frame being presented. Names are string literals.
+    class StartupTimeline
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        StartupTimeline();
+        ~StartupTimeline() = default;
+
+        StartupTimeline(const StartupTimeline&) = delete;
+        StartupTimeline& operator=(const StartupTimeline&) = delete;
+
+        // Clears everything and starts counting from now
+        void Restart();
+
+        void AddPhase(const char* name, Clock::time_point start, Clock::time_point end, bool isBackground = false);
+
+        // Only the first time a milestone is reached is kept
+        void Mark(const char* name);
+
+    public:
+        // Returns false if the milestone has not been reached yet
+        bool GetMilestone(const char* name, std::chrono::microseconds& outTime) const;
+
+        std::vector<StartupPhase> GetPhases() const;
+        std::vector<StartupMilestone> GetMilestones() const;
+        std::string GetReport() const;
+
+    private:
+        std::chrono::microseconds GetOffset(Clock::time_point time) const;
+
+    private:
+        mutable std::mutex m_Mutex;
+        Clock::time_point m_Origin;
+
+        std::vector<StartupPhase> m_Phases;
+        std::vector<StartupMilestone> m_Milestones;
+    };
+
+    // Started on the first call, which is the start of startup for the process
+    StartupTimeline& GetStartupTimeline();
+
+    // Adds the enclosing scope to the timeline as a phase
+    class ScopedStartupPhase
+    {
+    public:
+        explicit ScopedStartupPhase(const char* name, StartupTimeline& timeline = GetStartupTimeline())
+            : m_Name(name), m_Timeline(timeline), m_Start(StartupTimeline::Clock::now()) {}
+
+        ~ScopedStartupPhase() { m_Timeline.AddPhase(m_Name, m_Start, StartupTimeline::Clock::now()); }
+
+        ScopedStartupPhase(const ScopedStartupPhase&) = delete;
+        ScopedStartupPhase& operator=(const ScopedStartupPhase&) = delete;
+
+    private:
+        const char* m_Name;
+        StartupTimeline& m_Timeline;
+        StartupTimeline::Clock::time_point m_Start;
+    };
+
+    // Initialization deferred until something first needs it. Prewarm starts it early on a
+    // background thread, and whoever needs it then waits for that run instead of starting a
+    // second one. A run that fails is tried again on the next Ensure.
+    class LazyPhase
+    {
+    public:
+        using InitFn = std::function<bool()>;
+
+        LazyPhase(const char* name, InitFn init, StartupTimeline& timeline = GetStartupTimeline());
+        ~LazyPhase();
+
+        LazyPhase(const LazyPhase&) = delete;
+        LazyPhase& operator=(const LazyPhase&) = delete;
+
+        // Runs the phase on the calling thread unless it already ran, returns whether it succeeded
+        bool Ensure();
+
+        // Only for phases that may run off the thread that later uses them
+        void Prewarm();
+
+    public:
+        bool IsReady() const;
+
+    private:
+        enum class State
+        {
+            Pending,
+            Running,
+            Ready,
+        };
+
+        bool Run(bool isBackground);
+
+    private:
+        const char* m_Name;
+        InitFn m_Init;
+        StartupTimeline& m_Timeline;
+
+        mutable std::mutex m_Mutex;
+        std::condition_variable m_Condition;
+        State m_State = State::Pending;
+
+        std::thread m_PrewarmThread;
+    };
+}
@@ -0,0 +1,345 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "streamprotocol.h"
+
+#include <cstring>
+
+namespace
+{
+    template<typename T>
+    void Append(std::vector<uint8_t>& message, const T& value)
+    {
+        size_t offset = message.size();
+        message.resize(offset + sizeof(T));
+        memcpy(message.data() + offset, &value, sizeof(T));
+    }
+
+    struct RleRun
+    {
+        uint16_t m_Count;
+        uint32_t m_Pixel;
+    };
+
+    constexpr size_t RleRunSize = sizeof(uint16_t) + sizeof(uint32_t);
+}
+
+void Takoyaki::Stream::EncodeTile(const FrameView& frame, const Rect& tile, uint16_t column, uint16_t row, bool compress, std::vector<uint8_t>& outMessage, const PaletteBuilder* palette)
+{
+    const size_t rawSize = static_cast<size_t>(tile.m_Width) * tile.m_Height * 4;
+    const size_t indexedSize = static_cast<size_t>(tile.m_Width) * tile.m_Height;
+
+    TileHeader header;
+    header.m_Column = column;
+    header.m_Row = row;
+
+    // Count runs first, the tile is small enough to stay in cache for the second pass
+    size_t runCount = 0;
+    if (compress)
+    {
+        uint32_t current = frame.GetRow(tile.m_Y)[tile.m_X];
+        uint32_t length = 0;
+
+        for (uint32_t y = 0; y < tile.m_Height; ++y)
+        {
+            const uint32_t* pixels = frame.GetRow(tile.m_Y + y) + tile.m_X;
+            for (uint32_t x = 0; x < tile.m_Width; ++x)
+            {
+                if (pixels[x] == current && length < UINT16_MAX)
+                {
+                    ++length;
+                    continue;
+                }
+
+                ++runCount;
+                current = pixels[x];
+                length = 1;
+            }
+        }
+
+        ++runCount;
+    }
+
+    if (compress && runCount == 1)
+    {
+        header.m_Encoding = static_cast<uint8_t>(TileEncoding::Solid);
+        header.m_DataSize = 4;
+        Append(outMessage, header);
+        Append(outMessage, frame.GetRow(tile.m_Y)[tile.m_X]);
+        return;
+    }
+
+    if (compress && runCount * RleRunSize < (palette ? indexedSize : rawSize))
+    {
+        header.m_Encoding = static_cast<uint8_t>(TileEncoding::Rle);
+        header.m_DataSize = static_cast<uint32_t>(runCount * RleRunSize);
+        Append(outMessage, header);
+
+        uint32_t current = frame.GetRow(tile.m_Y)[tile.m_X];
+        uint16_t length = 0;
+
+        for (uint32_t y = 0; y < tile.m_Height; ++y)
+        {
+            const uint32_t* pixels = frame.GetRow(tile.m_Y + y) + tile.m_X;
+            for (uint32_t x = 0; x < tile.m_Width; ++x)
+            {
+                if (pixels[x] == current && length < UINT16_MAX)
+                {
+                    ++length;
+                    continue;
+                }
+
+                Append(outMessage, length);
+                Append(outMessage, current);
+                current = pixels[x];
+                length = 1;
+            }
+        }
+
+        Append(outMessage, length);
+        Append(outMessage, current);
+        return;
+    }
+
+    if (palette)
+    {
+        header.m_Encoding = static_cast<uint8_t>(TileEncoding::Indexed);
+        header.m_DataSize = static_cast<uint32_t>(indexedSize);
+        Append(outMessage, header);
+
+        size_t offset = outMessage.size();
+        outMessage.resize(offset + indexedSize);
+
+        for (uint32_t y = 0; y < tile.m_Height; ++y)
+            palette->MapRow(frame.GetRow(tile.m_Y + y) + tile.m_X, outMessage.data() + offset + static_cast<size_t>(y) * tile.m_Width, tile.m_Width);
+
+        return;
+    }
+
+    header.m_Encoding = static_cast<uint8_t>(TileEncoding::Raw);
+    header.m_DataSize = static_cast<uint32_t>(rawSize);
+    Append(outMessage, header);
+
+    size_t offset = outMessage.size();
+    outMessage.resize(offset + rawSize);
+
+    for (uint32_t y = 0; y < tile.m_Height; ++y)
+        memcpy(outMessage.data() + offset + static_cast<size_t>(y) * tile.m_Width * 4, frame.GetRow(tile.m_Y + y) + tile.m_X, tile.m_Width * 4);
+}
+
+bool Takoyaki::Stream::DecodeTile(const uint8_t* data, uint32_t dataSize, TileEncoding encoding, const Rect& tile, const FrameView& frame, const uint32_t* palette, uint32_t paletteSize)
+{
+    switch (encoding)
+    {
+    case TileEncoding::Raw:
+    {
+        if (dataSize != tile.m_Width * tile.m_Height * 4)
+            return false;
+
+        for (uint32_t y = 0; y < tile.m_Height; ++y)
+            memcpy(frame.GetRow(tile.m_Y + y) + tile.m_X, data + static_cast<size_t>(y) * tile.m_Width * 4, tile.m_Width * 4);
+
+        return true;
+    }
+    case TileEncoding::Solid:
+    {
+        if (dataSize != 4)
+            return false;
+
+        uint32_t pixel;
+        memcpy(&pixel, data, sizeof(pixel));
+
+        for (uint32_t y = 0; y < tile.m_Height; ++y)
+        {
+            uint32_t* pixels = frame.GetRow(tile.m_Y + y) + tile.m_X;
+            for (uint32_t x = 0; x < tile.m_Width; ++x)
+                pixels[x] = pixel;
+        }
+
+        return true;
+    }
+    case TileEncoding::Rle:
+    {
+        if (dataSize % RleRunSize != 0)
+            return false;
+
+        uint32_t x = 0;
+        uint32_t y = 0;
+
+        for (size_t offset = 0; offset < dataSize; offset += RleRunSize)
+        {
+            RleRun run;
+            memcpy(&run.m_Count, data + offset, sizeof(run.m_Count));
+            memcpy(&run.m_Pixel, data + offset + sizeof(run.m_Count), sizeof(run.m_Pixel));
+
+            for (uint32_t i = 0; i < run.m_Count; ++i)
+            {
+                if (y >= tile.m_Height)
+                    return false;
+
+                frame.GetRow(tile.m_Y + y)[tile.m_X + x] = run.m_Pixel;
+                if (++x == tile.m_Width)
+                {
+                    x = 0;
+                    ++y;
+                }
+            }
+        }
+
+        return y == tile.m_Height;
+    }
+    case TileEncoding::Indexed:
+    {
+        if (dataSize != tile.m_Width * tile.m_Height)
+            return false;
+
+        for (uint32_t y = 0; y < tile.m_Height; ++y)
+        {
+            const uint8_t* indices = data + static_cast<size_t>(y) * tile.m_Width;
+            uint32_t* pixels = frame.GetRow(tile.m_Y + y) + tile.m_X;
+
+            for (uint32_t x = 0; x < tile.m_Width; ++x)
+            {
+                if (indices[x] >= paletteSize)
+                    return false;
+
+                pixels[x] = palette[indices[x]];
+            }
+        }
+
+        return true;
+    }
+    }
+
+    return false;
+}
+
+bool Takoyaki::Stream::ApplyCopy(const CopyRect& copy, const FrameView& frame)
+{
+    auto isInside = [&](int32_t x, int32_t y)
+    {
+        return x >= 0 && y >= 0 && static_cast<uint64_t>(x) + copy.m_Width <= frame.m_Width && static_cast<uint64_t>(y) + copy.m_Height <= frame.m_Height;
+    };
+
+    if (!isInside(copy.m_SourceX, copy.m_SourceY) || !isInside(copy.m_DestX, copy.m_DestY))
+        return false;
+
+    // Rows are walked away from the destination so overlapping ones are read before they are
+    // overwritten, and memmove takes care of overlap within a row
+    const bool isUpward = copy.m_DestY > copy.m_SourceY;
+    for (uint32_t i = 0; i < copy.m_Height; ++i)
+    {
+        uint32_t y = isUpward ? copy.m_Height - 1 - i : i;
+        memmove(frame.GetRow(copy.m_DestY + y) + copy.m_DestX, frame.GetRow(copy.m_SourceY + y) + copy.m_SourceX, copy.m_Width * 4);
+    }
+
+    return true;
+}
+
+bool Takoyaki::Stream::BuildFrameMessage(const FrameView& frame, const FrameInfo& info, const std::vector<uint8_t>* changedTiles, bool compress, std::vector<uint8_t>& outMessage,
+    PaletteBuilder* palette, const TileMap* tileMap, const std::vector<CopyRect>* copies)
+{
+    const uint32_t columns = (frame.m_Width + info.m_TileSize - 1) / info.m_TileSize;
+    const uint32_t rows = (frame.m_Height + info.m_TileSize - 1) / info.m_TileSize;
+
+    if (tileMap && (tileMap->m_TileSize != info.m_TileSize || tileMap->m_Columns != columns || tileMap->m_Rows != rows))
+        tileMap = nullptr;
+
+    FrameInfo patchedInfo = info;
+
+    if (copies && !copies->empty())
+        patchedInfo.m_Flags |= FrameFlagCopies;
+
+    // Only the tiles being sent need to fit the palette
+    if (palette)
+    {
+        palette->Reset();
+
+        for (uint32_t row = 0; row < rows && !palette->IsOverflowed(); ++row)
+        {
+            for (uint32_t column = 0; column < columns; ++column)
+            {
+                if (changedTiles && !(*changedTiles)[static_cast<size_t>(row) * columns + column])
+                    continue;
+
+                if (!palette->AddRect(frame, GetTileRect(frame.m_Width, frame.m_Height, info.m_TileSize, column, row)))
+                    break;
+            }
+        }
+
+        if (palette->IsOverflowed())
+            palette = nullptr;
+        else
+            patchedInfo.m_Flags |= FrameFlagPalette;
+    }
+
+    outMessage.clear();
+    Append(outMessage, MessageHeader());
+    Append(outMessage, patchedInfo);
+
+    if (patchedInfo.m_Flags & FrameFlagCopies)
+    {
+        CopyInfo copyInfo;
+        copyInfo.m_CopyCount = static_cast<uint16_t>(copies->size());
+        Append(outMessage, copyInfo);
+
+        for (const CopyRect& copy : *copies)
+            Append(outMessage, copy);
+    }
+
+    if (palette)
+    {
+        PaletteInfo paletteInfo;
+        paletteInfo.m_ColourCount = static_cast<uint16_t>(palette->GetColours().size());
+        Append(outMessage, paletteInfo);
+
+        for (uint32_t colour : palette->GetColours())
+            Append(outMessage, colour);
+    }
+
+    uint32_t tileCount = 0;
+    for (uint32_t row = 0; row < rows; ++row)
+    {
+        for (uint32_t column = 0; column < columns; ++column)
+        {
+            if (changedTiles && !(*changedTiles)[static_cast<size_t>(row) * columns + column])
+                continue;
+
+            // Counting runs costs a full pass over the tile, wasted on photos and video
+            TileClass tileClass = tileMap ? tileMap->GetTile(column, row).m_Class : TileClass::Text;
+            bool compressTile = compress && tileClass != TileClass::Natural && tileClass != TileClass::Motion;
+
+            Rect tile = GetTileRect(frame.m_Width, frame.m_Height, info.m_TileSize, column, row);
+            EncodeTile(frame, tile, static_cast<uint16_t>(column), static_cast<uint16_t>(row), compressTile, outMessage, palette);
+            ++tileCount;
+        }
+    }
+
+    // Patch the sizes in now that the tiles are known
+    MessageHeader header;
+    header.m_Type = static_cast<uint16_t>(MessageType::Frame);
+    header.m_PayloadSize = static_cast<uint32_t>(outMessage.size() - sizeof(MessageHeader));
+    memcpy(outMessage.data(), &header, sizeof(header));
+
+    patchedInfo.m_TileCount = tileCount;
+    memcpy(outMessage.data() + sizeof(MessageHeader), &patchedInfo, sizeof(patchedInfo));
+
+    return palette != nullptr;
+}
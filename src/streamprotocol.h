@@ -0,0 +1,146 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "frame.h"
+#include "palettebuilder.h"
+#include "tileclassifier.h"
+
+namespace Takoyaki::Stream
+{
+    // Every message is a MessageHeader followed by payloadSize bytes. All fields are little
+    // endian and structs are packed by construction, so they are copied as is on the x86 and
+    // ARM hosts Takoyaki runs on.
+    static constexpr uint32_t Magic = 0x4F4B4154; // "TAKO"
+    static constexpr uint16_t Version = 3;
+
+    enum class MessageType : uint16_t
+    {
+        Frame = 1,
+    };
+
+    enum class TileEncoding : uint8_t
+    {
+        Raw,     // Rows of BGRA pixels, tile width * 4 bytes each
+        Solid,   // One BGRA pixel filling the whole tile
+        Rle,     // Runs of (uint16_t count, uint32_t pixel) in row-major order
+        Indexed, // Rows of palette indices, tile width bytes each, only in frames with a palette
+    };
+
+    enum FrameFlags : uint16_t
+    {
+        FrameFlagKeyframe = 1 << 0,
+        FrameFlagPalette = 1 << 1,
+        FrameFlagCopies = 1 << 2,
+    };
+
+    struct MessageHeader
+    {
+        uint32_t m_Magic = Magic;
+        uint16_t m_Version = Version;
+        uint16_t m_Type = 0;
+        uint32_t m_PayloadSize = 0;
+    };
+
+    // Start of a Frame payload, followed by m_TileCount tiles
+    struct FrameInfo
+    {
+        uint64_t m_FrameId = 0;
+
+        // steady_clock nanoseconds when the frame was captured, which on Linux is
+        // CLOCK_MONOTONIC and so comparable between processes on the same machine
+        uint64_t m_CaptureTimeNs = 0;
+
+        uint32_t m_Width = 0;
+        uint32_t m_Height = 0;
+        uint16_t m_TileSize = 0;
+        uint16_t m_Flags = 0;
+        uint32_t m_TileCount = 0;
+    };
+
+    // Follows FrameInfo when FrameFlagCopies is set, followed by m_CopyCount CopyRects. Only
+    // delta frames carry copies.
+    struct CopyInfo
+    {
+        uint16_t m_CopyCount = 0;
+        uint16_t m_Reserved = 0;
+    };
+
+    // Moves a rect of the frame the viewer already has, for a scroll or a moved window. The
+    // copies are applied in order before any tile, each as if through a temporary.
+    struct CopyRect
+    {
+        int32_t m_SourceX = 0;
+        int32_t m_SourceY = 0;
+        uint32_t m_Width = 0;
+        uint32_t m_Height = 0;
+        int32_t m_DestX = 0;
+        int32_t m_DestY = 0;
+    };
+
+    // Follows any copies when FrameFlagPalette is set, followed by m_ColourCount BGRA colours
+    struct PaletteInfo
+    {
+        uint16_t m_ColourCount = 0;
+        uint16_t m_Reserved = 0;
+    };
+
+    // Followed by m_DataSize bytes in m_Encoding
+    struct TileHeader
+    {
+        uint16_t m_Column = 0;
+        uint16_t m_Row = 0;
+        uint8_t m_Encoding = 0;
+        uint8_t m_Reserved[3] = {};
+        uint32_t m_DataSize = 0;
+    };
+
+    static_assert(sizeof(MessageHeader) == 12 && sizeof(FrameInfo) == 32 && sizeof(CopyInfo) == 4 && sizeof(CopyRect) == 24);
+    static_assert(sizeof(PaletteInfo) == 4 && sizeof(TileHeader) == 12);
+
+    // Appends one tile of frame, taking the smallest encoding when compress is set. With a
+    // palette that holds every colour of the tile, the tile is indexed instead of raw.
+    void EncodeTile(const FrameView& frame, const Rect& tile, uint16_t column, uint16_t row, bool compress, std::vector<uint8_t>& outMessage, const PaletteBuilder* palette = nullptr);
+
+    // Writes an encoded tile into frame. Returns false if the data does not fit the tile, or
+    // an indexed tile refers past the end of palette.
+    bool DecodeTile(const uint8_t* data, uint32_t dataSize, TileEncoding encoding, const Rect& tile, const FrameView& frame, const uint32_t* palette = nullptr, uint32_t paletteSize = 0);
+
+    // Applies a copy to frame in place. Returns false if either rect is not inside the frame.
+    bool ApplyCopy(const CopyRect& copy, const FrameView& frame);
+
+    // Builds a Frame message from the tiles whose index is set in changedTiles, or from every
+    // tile when changedTiles is null, after the copies if there are any. Given a palette, the message carries one whenever its
+    // tiles have at most PaletteBuilder::MaxColours colours between them, and BGRA otherwise.
+    // Given a tile map with the same tile size, photo and video tiles are sent without trying
+    // the run-length encodings, which they almost never fit. Returns true if it has a palette.
+    bool BuildFrameMessage(const FrameView& frame, const FrameInfo& info, const std::vector<uint8_t>* changedTiles, bool compress, std::vector<uint8_t>& outMessage,
+        PaletteBuilder* palette = nullptr, const TileMap* tileMap = nullptr, const std::vector<CopyRect>* copies = nullptr);
+
+    inline Rect GetTileRect(uint32_t width, uint32_t height, uint32_t tileSize, uint32_t column, uint32_t row)
+    {
+        uint32_t x = column * tileSize;
+        uint32_t y = row * tileSize;
+        return { static_cast<int32_t>(x), static_cast<int32_t>(y), width - x < tileSize ? width - x : tileSize, height - y < tileSize ? height - y : tileSize };
+    }
+}
@@ -0,0 +1,153 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "tileclassifier.h"
+#include "kernels/pixelkernels.h"
+
+#include <algorithm>
+
+namespace
+{
+    // A tile is moving once it has changed this many frames in a row, by at least a quarter
+    // of its pixels. Typing or a blinking caret changes far fewer pixels.
+    constexpr uint8_t MotionStreak = 3;
+    constexpr uint32_t MotionChangedFraction = 4;
+
+    // Below this many colours a tile is UI no matter what its edges look like
+    constexpr uint32_t TextColourLimit = 16;
+
+    // Average colour step between differing neighbours above which edges count as sharp
+    constexpr uint32_t SharpGradient = 64;
+
+    // Colours are only counted on every few rows. Text and UI repeat their few colours on
+    // every row, so sampling barely changes the count but saves hashing every run.
+    constexpr uint32_t ColourSampleRows = 4;
+}
+
+Takoyaki::Rect Takoyaki::TileMap::GetTileRect(uint32_t column, uint32_t row) const
+{
+    uint32_t x = column * m_TileSize;
+    uint32_t y = row * m_TileSize;
+    return { static_cast<int32_t>(x), static_cast<int32_t>(y), std::min(m_TileSize, m_Width - x), std::min(m_TileSize, m_Height - y) };
+}
+
+Takoyaki::TileClassifier::TileClassifier(uint32_t tileSize)
+    : m_TileSize(std::max(tileSize, 8u))
+{
+}
+
+void Takoyaki::TileClassifier::Reset()
+{
+    std::fill(m_ChangeStreaks.begin(), m_ChangeStreaks.end(), 0);
+}
+
+void Takoyaki::TileClassifier::Classify(const FrameView& frame, const FrameView* previous, TileMap& outMap)
+{
+    Classify(frame, previous, outMap, GetPixelKernels());
+}
+
+void Takoyaki::TileClassifier::Classify(const FrameView& frame, const FrameView* previous, TileMap& outMap, const PixelKernels& kernels)
+{
+
+    const uint32_t columns = (frame.m_Width + m_TileSize - 1) / m_TileSize;
+    const uint32_t rows = (frame.m_Height + m_TileSize - 1) / m_TileSize;
+
+    if (outMap.m_Columns != columns || outMap.m_Rows != rows || m_ChangeStreaks.size() != static_cast<size_t>(columns) * rows)
+        m_ChangeStreaks.assign(static_cast<size_t>(columns) * rows, 0);
+
+    outMap.m_TileSize = m_TileSize;
+    outMap.m_Columns = columns;
+    outMap.m_Rows = rows;
+    outMap.m_Width = frame.m_Width;
+    outMap.m_Height = frame.m_Height;
+    outMap.m_Tiles.resize(static_cast<size_t>(columns) * rows);
+
+    if (!frame.IsValid())
+        return;
+
+    const bool hasPrevious = previous && previous->IsValid() && previous->m_Width == frame.m_Width && previous->m_Height == frame.m_Height;
+    m_BandStats.resize(columns);
+
+    for (uint32_t tileRow = 0; tileRow < rows; ++tileRow)
+    {
+        std::fill(m_BandStats.begin(), m_BandStats.end(), Kernels::TileStats());
+
+        const uint32_t top = tileRow * m_TileSize;
+        const uint32_t bottom = std::min(top + m_TileSize, frame.m_Height);
+
+        // Walk the band row by row so each frame row is read once, front to back
+        for (uint32_t y = top; y < bottom; ++y)
+        {
+            const uint32_t* row = frame.GetRow(y);
+            const uint32_t* oldRow = hasPrevious ? previous->GetRow(y) : nullptr;
+            const bool countColours = (y - top) % ColourSampleRows == 0;
+
+            for (uint32_t column = 0; column < columns; ++column)
+            {
+                uint32_t x = column * m_TileSize;
+                uint32_t width = std::min(m_TileSize, frame.m_Width - x);
+                kernels.m_AccumulateTileRow(row + x, oldRow ? oldRow + x : nullptr, width, countColours, m_BandStats[column]);
+            }
+        }
+
+        for (uint32_t column = 0; column < columns; ++column)
+        {
+            const Kernels::TileStats& stats = m_BandStats[column];
+            size_t index = static_cast<size_t>(tileRow) * columns + column;
+            uint32_t pixelCount = std::min(m_TileSize, frame.m_Width - column * m_TileSize) * (bottom - top);
+
+            TileInfo& tile = outMap.m_Tiles[index];
+            tile.m_IsChanged = !hasPrevious || stats.m_ChangedPixels != 0;
+            tile.m_ColourCount = static_cast<uint8_t>(stats.m_ColourCount);
+
+            // Only a sizable change keeps a streak going, so a caret does not turn into motion
+            uint8_t& streak = m_ChangeStreaks[index];
+            if (hasPrevious && stats.m_ChangedPixels * MotionChangedFraction >= pixelCount)
+                streak = static_cast<uint8_t>(std::min(streak + 1, 255));
+            else
+                streak = 0;
+
+            tile.m_Class = ClassifyTile(stats, streak);
+        }
+    }
+}
+
+Takoyaki::TileClass Takoyaki::TileClassifier::ClassifyTile(const Kernels::TileStats& stats, uint8_t changeStreak) const
+{
+    // Rows with no edges that all hash to one colour
+    const bool isFlat = stats.m_ColourCount <= 1 && stats.m_GradientSum == 0;
+
+    if (changeStreak >= MotionStreak && !isFlat)
+        return TileClass::Motion;
+
+    if (isFlat)
+        return TileClass::Flat;
+
+    if (stats.m_ColourCount < TextColourLimit || stats.m_RepeatPixels * 2 >= stats.m_ComparedPixels)
+        return TileClass::Text;
+
+    // Some runs but many colours, such as anti-aliased text over a gradient: decide by how
+    // sharp the edges between differing pixels are
+    uint32_t edgePixels = stats.m_ComparedPixels - stats.m_RepeatPixels;
+    if (stats.m_RepeatPixels * 8 >= stats.m_ComparedPixels && stats.m_GradientSum >= edgePixels * SharpGradient)
+        return TileClass::Text;
+
+    return TileClass::Natural;
+}
@@ -0,0 +1,97 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <vector>
+#include "frame.h"
+#include "kernels/tilekernels.h"
+
+namespace Takoyaki
+{
+    struct PixelKernels;
+
+    enum class TileClass : uint8_t
+    {
+        Flat,       // A single colour
+        Text,       // Text and UI: few colours, long runs and sharp edges
+        Natural,    // Photos and gradients: many colours and soft edges
+        Motion,     // Large changes for several frames in a row, such as video
+    };
+
+    struct TileInfo
+    {
+        TileClass m_Class = TileClass::Flat;
+        bool m_IsChanged = false;
+
+        // Lower bound on distinct colours, saturating at Kernels::TileColourCap
+        uint8_t m_ColourCount = 0;
+    };
+
+    // Per-frame tile metadata, laid out row by row. Tiles on the right and bottom edges
+    // may be smaller than the tile size.
+    struct TileMap
+    {
+        uint32_t m_TileSize = 0;
+        uint32_t m_Columns = 0;
+        uint32_t m_Rows = 0;
+        uint32_t m_Width = 0;
+        uint32_t m_Height = 0;
+        std::vector<TileInfo> m_Tiles;
+
+        inline const TileInfo& GetTile(uint32_t column, uint32_t row) const { return m_Tiles[static_cast<size_t>(row) * m_Columns + column]; }
+        Rect GetTileRect(uint32_t column, uint32_t row) const;
+    };
+
+    // Labels every tile of a frame so later stages can treat text and video differently.
+    // Colour, run length and gradient statistics and the change against the previous frame
+    // all come from a single SIMD pass over the pixels, and a short per-tile history of
+    // changes separates motion from one-off updates such as typing.
+    class TileClassifier
+    {
+    public:
+        explicit TileClassifier(uint32_t tileSize = 64);
+        ~TileClassifier() = default;
+
+        // previous may be null, or a different size after the region changed, in which case
+        // every tile counts as changed and the history starts over
+        void Classify(const FrameView& frame, const FrameView* previous, TileMap& outMap);
+
+        // Same, through the given kernels instead of the bound ones, for comparing SIMD levels
+        void Classify(const FrameView& frame, const FrameView* previous, TileMap& outMap, const PixelKernels& kernels);
+
+        void Reset();
+
+    public:
+        inline uint32_t GetTileSize() const { return m_TileSize; }
+
+    private:
+        TileClass ClassifyTile(const Kernels::TileStats& stats, uint8_t changeStreak) const;
+
+    private:
+        uint32_t m_TileSize;
+
+        // Statistics for one band of tiles, reused across bands and frames
+        std::vector<Kernels::TileStats> m_BandStats;
+
+        // Consecutive frames each tile has changed in
+        std::vector<uint8_t> m_ChangeStreaks;
+    };
+}
@@ -0,0 +1,229 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tonemapper.h"
+#include "kernels/pixelkernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // scRGB defines 1.0 as 80 nits
+    constexpr float ScRgbWhiteNits = 80.0f;
+
+    constexpr float Bt2020ToBt709[9] =
+    {
+         1.6605f, -0.5876f, -0.0728f,
+        -0.1246f,  1.1329f, -0.0083f,
+        -0.0182f, -0.1006f,  1.1187f,
+    };
+
+    // SMPTE ST 2084 constants
+    constexpr float PqM1 = 2610.0f / 16384.0f;
+    constexpr float PqM2 = 2523.0f / 4096.0f * 128.0f;
+    constexpr float PqC1 = 3424.0f / 4096.0f;
+    constexpr float PqC2 = 2413.0f / 4096.0f * 32.0f;
+    constexpr float PqC3 = 2392.0f / 4096.0f * 32.0f;
+
+    float PqToNits(float encoded)
+    {
+        float p = std::pow(std::clamp(encoded, 0.0f, 1.0f), 1.0f / PqM2);
+        return 10000.0f * std::pow(std::max(p - PqC1, 0.0f) / (PqC2 - PqC3 * p), 1.0f / PqM1);
+    }
+
+    float NitsToPq(float nits)
+    {
+        float y = std::pow(std::clamp(nits / 10000.0f, 0.0f, 1.0f), PqM1);
+        return std::pow((PqC1 + PqC2 * y) / (1.0f + PqC3 * y), PqM2);
+    }
+
+    float LinearToSrgb(float linear)
+    {
+        return linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+    }
+
+    float HableCurve(float x)
+    {
+        constexpr float A = 0.15f, B = 0.50f, C = 0.10f, D = 0.20f, E = 0.02f, F = 0.30f;
+        return ((x * (A * x + C * B) + D * E) / (x * (A * x + B) + D * F)) - E / F;
+    }
+
+    // ITU-R BT.2390 EETF, rolling off [0, sourcePeak] into [0, targetPeak] in the PQ domain
+    float Bt2390(float nits, float sourcePeak, float targetPeak)
+    {
+        float sourcePq = NitsToPq(sourcePeak);
+        float e1 = std::min(NitsToPq(nits) / sourcePq, 1.0f);
+        float maxLum = NitsToPq(targetPeak) / sourcePq;
+        float kneeStart = 1.5f * maxLum - 0.5f;
+
+        float e2 = e1;
+        if (e1 > kneeStart)
+        {
+            float t = (e1 - kneeStart) / (1.0f - kneeStart);
+            float t2 = t * t;
+            float t3 = t2 * t;
+            e2 = (2.0f * t3 - 3.0f * t2 + 1.0f) * kneeStart +
+                (t3 - 2.0f * t2 + t) * (1.0f - kneeStart) +
+                (-2.0f * t3 + 3.0f * t2) * maxLum;
+        }
+
+        return PqToNits(e2 * sourcePq);
+    }
+}
+
+Takoyaki::Tonemapper::Tonemapper()
+{
+    BuildLuts();
+}
+
+bool Takoyaki::Tonemapper::Convert(const HdrFrameView& src, const FrameView& dst) const
+{
+    return Convert(src, dst, GetPixelKernels());
+}
+
+bool Takoyaki::Tonemapper::Convert(const HdrFrameView& src, const FrameView& dst, const PixelKernels& kernels) const
+{
+    if (src.m_Data == nullptr || !dst.IsValid())
+        return false;
+
+    if (src.m_Width != dst.m_Width || src.m_Height != dst.m_Height)
+        return false;
+
+    const uint8_t* encodeLut = m_EncodeLut.data();
+
+    for (uint32_t y = 0; y < src.m_Height; ++y)
+    {
+        const uint8_t* srcRow = src.m_Data + static_cast<size_t>(y) * src.m_Stride;
+        uint32_t* dstRow = dst.GetRow(y);
+
+        switch (src.m_Format)
+        {
+        case HdrFormat::ScRgbFloat16:
+        {
+            const uint16_t* halves = reinterpret_cast<const uint16_t*>(srcRow);
+            kernels.m_TonemapFloat16Row(halves, dstRow, src.m_Width, encodeLut);
+            break;
+        }
+        case HdrFormat::Hdr10:
+        {
+            const uint32_t* packed = reinterpret_cast<const uint32_t*>(srcRow);
+            kernels.m_Tonemap10BitRow(packed, dstRow, src.m_Width, m_PqDecodeLut.data(), Bt2020ToBt709, encodeLut);
+            break;
+        }
+        }
+    }
+
+    return true;
+}
+
+void Takoyaki::Tonemapper::ConvertReference(const HdrFrameView& src, const FrameView& dst) const
+{
+    auto encode = [this](float scRgb) -> uint32_t
+    {
+        return static_cast<uint32_t>(std::lround(TonemapToDisplay(scRgb) * 255.0f));
+    };
+
+    for (uint32_t y = 0; y < src.m_Height; ++y)
+    {
+        const uint8_t* srcRow = src.m_Data + static_cast<size_t>(y) * src.m_Stride;
+        uint32_t* dstRow = dst.GetRow(y);
+
+        for (uint32_t x = 0; x < src.m_Width; ++x)
+        {
+            float rgb[3];
+
+            if (src.m_Format == HdrFormat::ScRgbFloat16)
+            {
+                const uint16_t* halves = reinterpret_cast<const uint16_t*>(srcRow) + x * 4;
+                for (int c = 0; c < 3; ++c)
+                    rgb[c] = Kernels::HalfBitsToFloat(halves[c]);
+            }
+            else
+            {
+                uint32_t packed = reinterpret_cast<const uint32_t*>(srcRow)[x];
+                float decoded[3];
+
+                for (int c = 0; c < 3; ++c)
+                    decoded[c] = PqToNits(((packed >> (10 * c)) & 0x3FF) / 1023.0f) / ScRgbWhiteNits;
+
+                const float* m = Bt2020ToBt709;
+                for (int c = 0; c < 3; ++c)
+                    rgb[c] = m[c * 3] * decoded[0] + m[c * 3 + 1] * decoded[1] + m[c * 3 + 2] * decoded[2];
+            }
+
+            dstRow[x] = encode(rgb[2]) | (encode(rgb[1]) << 8) | (encode(rgb[0]) << 16) | 0xFF000000;
+        }
+    }
+}
+
+void Takoyaki::Tonemapper::SetSettings(const TonemapSettings& settings)
+{
+    m_Settings = settings;
+    m_Settings.m_PaperWhiteNits = std::clamp(m_Settings.m_PaperWhiteNits, 1.0f, 10000.0f);
+    m_Settings.m_PeakNits = std::clamp(m_Settings.m_PeakNits, m_Settings.m_PaperWhiteNits, 10000.0f);
+
+    BuildLuts();
+}
+
+void Takoyaki::Tonemapper::BuildLuts()
+{
+    m_EncodeLut.assign(Kernels::TonemapLutSize + Kernels::TonemapLutPadding, 0);
+
+    for (uint32_t i = 0; i < Kernels::TonemapLutSize; ++i)
+    {
+        float scRgb = Kernels::HalfBitsToFloat(static_cast<uint16_t>(i));
+
+        // Infinities and NaNs sit at the top of the positive half range
+        if (!std::isfinite(scRgb))
+        {
+            m_EncodeLut[i] = 255;
+            continue;
+        }
+
+        m_EncodeLut[i] = static_cast<uint8_t>(std::lround(TonemapToDisplay(scRgb) * 255.0f));
+    }
+
+    for (uint32_t i = 0; i < 1024; ++i)
+        m_PqDecodeLut[i] = PqToNits(i / 1023.0f) / ScRgbWhiteNits;
+}
+
+float Takoyaki::Tonemapper::TonemapToDisplay(float scRgb) const
+{
+    float nits = std::max(scRgb, 0.0f) * ScRgbWhiteNits;
+    float relative = nits / m_Settings.m_PaperWhiteNits;
+    float white = m_Settings.m_PeakNits / m_Settings.m_PaperWhiteNits;
+    float mapped = 0.0f;
+
+    switch (m_Settings.m_Operator)
+    {
+    case TonemapOperator::Reinhard:
+        // Extended Reinhard, reaching 1.0 exactly at the configured peak
+        mapped = relative * (1.0f + relative / (white * white)) / (1.0f + relative);
+        break;
+    case TonemapOperator::Hable:
+        mapped = HableCurve(relative * 2.0f) / HableCurve(white * 2.0f);
+        break;
+    case TonemapOperator::Bt2390:
+        mapped = Bt2390(nits, m_Settings.m_PeakNits, m_Settings.m_PaperWhiteNits) / m_Settings.m_PaperWhiteNits;
+        break;
+    }
+
+    return LinearToSrgb(std::clamp(mapped, 0.0f, 1.0f));
+}
@@ -0,0 +1,100 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include "frame.h"
+
+namespace Takoyaki
+{
+    struct PixelKernels;
+
+    enum class HdrFormat
+    {
+        ScRgbFloat16,   // DXGI_FORMAT_R16G16B16A16_FLOAT, linear BT.709, 1.0 = 80 nits
+        Hdr10,          // DXGI_FORMAT_R10G10B10A2_UNORM, PQ encoded BT.2020
+    };
+
+    enum class TonemapOperator
+    {
+        Reinhard,
+        Hable,
+        Bt2390,
+    };
+
+    struct TonemapSettings
+    {
+        TonemapOperator m_Operator = TonemapOperator::Bt2390;
+
+        // Luminance that maps to SDR white in the output
+        float m_PaperWhiteNits = 200.0f;
+
+        // Brightest luminance expected in the source, mapped to the top of the curve
+        float m_PeakNits = 1000.0f;
+    };
+
+    // Non-owning view of an HDR or 10-bit frame in CPU memory.
+    struct HdrFrameView
+    {
+        const uint8_t* m_Data = nullptr;
+        uint32_t m_Width = 0;
+        uint32_t m_Height = 0;
+        uint32_t m_Stride = 0;
+        HdrFormat m_Format = HdrFormat::ScRgbFloat16;
+    };
+
+    // Converts HDR and 10-bit desktop frames into the 8-bit BGRA frames used by the rest of
+    // the pipeline. Every source format is first brought to linear scRGB units, and the
+    // tonemap curve and sRGB encoding are folded into a single table indexed by the
+    // half-float bit pattern of that value, so the per-pixel work is a couple of table
+    // lookups regardless of which operator is selected.
+    class Tonemapper
+    {
+    public:
+        Tonemapper();
+        ~Tonemapper() = default;
+
+        bool Convert(const HdrFrameView& src, const FrameView& dst) const;
+
+        // Same, through the given kernels instead of the bound ones, for comparing SIMD levels
+        bool Convert(const HdrFrameView& src, const FrameView& dst, const PixelKernels& kernels) const;
+
+        // Slow float implementation of the same conversion, used to validate the fast paths.
+        void ConvertReference(const HdrFrameView& src, const FrameView& dst) const;
+
+    public:
+        inline const TonemapSettings& GetSettings() const { return m_Settings; }
+        void SetSettings(const TonemapSettings& settings);
+
+    private:
+        void BuildLuts();
+        float TonemapToDisplay(float scRgb) const;
+
+    private:
+        TonemapSettings m_Settings;
+
+        // Tonemapped sRGB value for every non-negative half, padded for 32-bit gathers
+        std::vector<uint8_t> m_EncodeLut;
+
+        // 10-bit PQ code to linear scRGB units
+        std::array<float, 1024> m_PqDecodeLut;
+    };
+}
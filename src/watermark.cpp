@@ -0,0 +1,295 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "watermark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+    constexpr uint64_t TimestampMask = (uint64_t(1) << 48) - 1;
+
+    // Fills the bits CRC-16 leaves free, so a block of random content is rejected twice over
+    constexpr uint16_t TrailerPattern = 0xA55A;
+
+    constexpr uint32_t White = 0xffffffff;
+    constexpr uint32_t Black = 0xff000000;
+
+    // Blocks that ended up with cells smaller than this cannot be sampled reliably
+    constexpr float MinCellPixels = 2.0f;
+
+    // Clock cells must be at least this far apart in luma to count as a block
+    constexpr uint32_t MinContrast = 64;
+
+    uint16_t Crc16(const uint8_t* data, size_t size)
+    {
+        // CRC-16/CCITT-FALSE
+        uint16_t crc = 0xffff;
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            crc ^= static_cast<uint16_t>(data[i] << 8);
+            for (uint32_t bit = 0; bit < 8; ++bit)
+                crc = static_cast<uint16_t>((crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1);
+        }
+
+        return crc;
+    }
+
+    uint16_t GetChecksum(const Takoyaki::WatermarkData& data)
+    {
+        uint8_t bytes[10];
+        for (uint32_t i = 0; i < 4; ++i)
+            bytes[i] = static_cast<uint8_t>(data.m_FrameId >> (i * 8));
+
+        for (uint32_t i = 0; i < 6; ++i)
+            bytes[4 + i] = static_cast<uint8_t>(data.m_TimestampUs >> (i * 8));
+
+        return Crc16(bytes, sizeof(bytes));
+    }
+
+    // The payload rows as 16-bit words, top to bottom
+    void GetPayloadRows(const Takoyaki::WatermarkData& data, uint16_t (&rows)[Takoyaki::Watermark::Rows - 1])
+    {
+        uint64_t timestamp = data.m_TimestampUs & TimestampMask;
+
+        rows[0] = static_cast<uint16_t>(data.m_FrameId >> 16);
+        rows[1] = static_cast<uint16_t>(data.m_FrameId);
+        rows[2] = static_cast<uint16_t>(timestamp >> 32);
+        rows[3] = static_cast<uint16_t>(timestamp >> 16);
+        rows[4] = static_cast<uint16_t>(timestamp);
+        rows[5] = GetChecksum({ data.m_FrameId, timestamp });
+        rows[6] = TrailerPattern;
+    }
+
+    uint32_t GetLuma(uint32_t pixel)
+    {
+        uint32_t b = pixel & 0xff;
+        uint32_t g = (pixel >> 8) & 0xff;
+        uint32_t r = (pixel >> 16) & 0xff;
+        return (77 * r + 150 * g + 29 * b) >> 8;
+    }
+
+    // Average luma over the middle half of a cell, away from edges that scaling blurred
+    uint32_t SampleCell(const Takoyaki::FrameView& frame, const Takoyaki::Rect& blockRect, float cellWidth, float cellHeight, uint32_t column, uint32_t row)
+    {
+        int32_t x0 = blockRect.m_X + static_cast<int32_t>(std::floor((column + 0.25f) * cellWidth));
+        int32_t x1 = blockRect.m_X + static_cast<int32_t>(std::ceil((column + 0.75f) * cellWidth));
+        int32_t y0 = blockRect.m_Y + static_cast<int32_t>(std::floor((row + 0.25f) * cellHeight));
+        int32_t y1 = blockRect.m_Y + static_cast<int32_t>(std::ceil((row + 0.75f) * cellHeight));
+
+        uint32_t sum = 0;
+        uint32_t count = 0;
+
+        for (int32_t y = y0; y < y1; ++y)
+        {
+            const uint32_t* pixels = frame.GetRow(y);
+            for (int32_t x = x0; x < x1; ++x)
+            {
+                sum += GetLuma(pixels[x]);
+                ++count;
+            }
+        }
+
+        return count ? sum / count : 0;
+    }
+}
+
+uint64_t Takoyaki::Watermark::GetTimestampUs(std::chrono::steady_clock::time_point time)
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count()) & TimestampMask;
+}
+
+void Takoyaki::Watermark::Encode(const FrameView& frame, int32_t x, int32_t y, const WatermarkData& data, uint32_t cellSize)
+{
+    uint16_t rows[Rows - 1];
+    GetPayloadRows(data, rows);
+
+    const int32_t left = std::max(x, 0);
+    const int32_t top = std::max(y, 0);
+    const int32_t right = std::min(x + static_cast<int32_t>(GetWidth(cellSize)), static_cast<int32_t>(frame.m_Width));
+    const int32_t bottom = std::min(y + static_cast<int32_t>(GetHeight(cellSize)), static_cast<int32_t>(frame.m_Height));
+
+    for (int32_t py = top; py < bottom; ++py)
+    {
+        uint32_t row = static_cast<uint32_t>(py - y) / cellSize;
+        uint32_t* pixels = frame.GetRow(py);
+
+        for (int32_t px = left; px < right; ++px)
+        {
+            uint32_t column = static_cast<uint32_t>(px - x) / cellSize;
+            bool isWhite = row == 0 ? (column & 1) == 0 : ((rows[row - 1] >> (Columns - 1 - column)) & 1) != 0;
+            pixels[px] = isWhite ? White : Black;
+        }
+    }
+}
+
+bool Takoyaki::Watermark::Decode(const FrameView& frame, const Rect& blockRect, WatermarkData& outData)
+{
+    if (blockRect.m_X < 0 || blockRect.m_Y < 0 ||
+        blockRect.m_X + blockRect.m_Width > frame.m_Width || blockRect.m_Y + blockRect.m_Height > frame.m_Height)
+        return false;
+
+    const float cellWidth = static_cast<float>(blockRect.m_Width) / Columns;
+    const float cellHeight = static_cast<float>(blockRect.m_Height) / Rows;
+    if (cellWidth < MinCellPixels || cellHeight < MinCellPixels)
+        return false;
+
+    // Black and white levels from the clock row, which also has to look like one
+    uint32_t whiteSum = 0;
+    uint32_t blackSum = 0;
+    uint32_t whiteMin = 255;
+    uint32_t blackMax = 0;
+
+    for (uint32_t column = 0; column < Columns; ++column)
+    {
+        uint32_t luma = SampleCell(frame, blockRect, cellWidth, cellHeight, column, 0);
+
+        if ((column & 1) == 0)
+        {
+            whiteSum += luma;
+            whiteMin = std::min(whiteMin, luma);
+        }
+        else
+        {
+            blackSum += luma;
+            blackMax = std::max(blackMax, luma);
+        }
+    }
+
+    uint32_t white = whiteSum / (Columns / 2);
+    uint32_t black = blackSum / (Columns / 2);
+    uint32_t threshold = (white + black) / 2;
+
+    if (white < black + MinContrast || whiteMin <= threshold || blackMax >= threshold)
+        return false;
+
+    uint16_t rows[Rows - 1] = {};
+    for (uint32_t row = 1; row < Rows; ++row)
+    {
+        for (uint32_t column = 0; column < Columns; ++column)
+        {
+            if (SampleCell(frame, blockRect, cellWidth, cellHeight, column, row) > threshold)
+                rows[row - 1] |= static_cast<uint16_t>(1 << (Columns - 1 - column));
+        }
+    }
+
+    WatermarkData data;
+    data.m_FrameId = (static_cast<uint32_t>(rows[0]) << 16) | rows[1];
+    data.m_TimestampUs = (static_cast<uint64_t>(rows[2]) << 32) | (static_cast<uint64_t>(rows[3]) << 16) | rows[4];
+
+    if (rows[5] != GetChecksum(data) || rows[6] != TrailerPattern)
+        return false;
+
+    outData = data;
+    return true;
+}
+
+Takoyaki::Rect Takoyaki::Watermark::GetScaledBlockRect(int32_t x, int32_t y, uint32_t cellSize, float scaleX, float scaleY, int32_t offsetX, int32_t offsetY)
+{
+    return {
+        offsetX + static_cast<int32_t>(std::lround(x * scaleX)),
+        offsetY + static_cast<int32_t>(std::lround(y * scaleY)),
+        static_cast<uint32_t>(std::lround(GetWidth(cellSize) * scaleX)),
+        static_cast<uint32_t>(std::lround(GetHeight(cellSize) * scaleY)),
+    };
+}
+
+void Takoyaki::LatencyReport::AddFrame(const WatermarkData& data, std::chrono::steady_clock::time_point outputTime)
+{
+    if (m_HasLastFrame)
+    {
+        if (data.m_FrameId == m_LastFrameId)
+            ++m_DuplicateFrames;
+        else if (data.m_FrameId > m_LastFrameId + 1)
+            m_DroppedFrames += data.m_FrameId - m_LastFrameId - 1;
+    }
+
+    m_LastFrameId = data.m_FrameId;
+    m_HasLastFrame = true;
+
+    // Both timestamps wrap at 48 bits, so take the difference modulo that and sign extend it
+    uint64_t difference = (Watermark::GetTimestampUs(outputTime) - data.m_TimestampUs) & TimestampMask;
+    int64_t latency = static_cast<int64_t>(difference << 16) >> 16;
+
+    m_Latencies.push_back(latency);
+    m_IsSorted = false;
+}
+
+void Takoyaki::LatencyReport::AddUndecodable()
+{
+    ++m_UndecodableFrames;
+}
+
+void Takoyaki::LatencyReport::Reset()
+{
+    *this = LatencyReport();
+}
+
+std::chrono::microseconds Takoyaki::LatencyReport::GetPercentile(double percentile) const
+{
+    if (m_Latencies.empty())
+        return std::chrono::microseconds(0);
+
+    if (!m_IsSorted)
+    {
+        m_Sorted = m_Latencies;
+        std::sort(m_Sorted.begin(), m_Sorted.end());
+        m_IsSorted = true;
+    }
+
+    // Nearest rank
+    double rank = std::ceil(std::clamp(percentile, 0.0, 100.0) / 100.0 * m_Sorted.size());
+    size_t index = rank > 0 ? static_cast<size_t>(rank) - 1 : 0;
+    return std::chrono::microseconds(m_Sorted[index]);
+}
+
+std::chrono::microseconds Takoyaki::LatencyReport::GetAverage() const
+{
+    if (m_Latencies.empty())
+        return std::chrono::microseconds(0);
+
+    int64_t sum = 0;
+    for (int64_t latency : m_Latencies)
+        sum += latency;
+
+    return std::chrono::microseconds(sum / static_cast<int64_t>(m_Latencies.size()));
+}
+
+std::string Takoyaki::LatencyReport::GetReport() const
+{
+    char report[320];
+    snprintf(report, sizeof(report),
+        "Capture to output latency over %llu frames: avg %.2f ms, p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms\n"
+        "  %llu dropped, %llu duplicated, %llu without a readable watermark\n",
+        static_cast<unsigned long long>(m_Latencies.size()),
+        GetAverage().count() / 1000.0,
+        GetPercentile(50).count() / 1000.0,
+        GetPercentile(90).count() / 1000.0,
+        GetPercentile(99).count() / 1000.0,
+        GetPercentile(100).count() / 1000.0,
+        static_cast<unsigned long long>(m_DroppedFrames),
+        static_cast<unsigned long long>(m_DuplicateFrames),
+        static_cast<unsigned long long>(m_UndecodableFrames));
+
+    return report;
+}
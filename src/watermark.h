@@ -0,0 +1,109 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "frame.h"
+
+namespace Takoyaki
+{
+    struct WatermarkData
+    {
+        uint32_t m_FrameId = 0;
+
+        // steady_clock microseconds, truncated to 48 bits, which wraps after about 9 years
+        uint64_t m_TimestampUs = 0;
+    };
+
+    // Diagnostic block stamped into a corner of a captured frame, so that the frame ID and
+    // capture time can be read back from whatever the frame ends up in. The block is a grid
+    // of black and white cells, big enough to survive scaling and filtering:
+    //
+    //     row 0       alternating white and black clock cells, which give the decoder its
+    //                 black and white levels
+    //     rows 1..7   16 bits each, the 32-bit frame ID, the 48-bit timestamp and a CRC-16
+    //                 over both, most significant bit first
+    class Watermark
+    {
+    public:
+        static constexpr uint32_t Columns = 16;
+        static constexpr uint32_t Rows = 8;
+        static constexpr uint32_t DefaultCellSize = 8;
+
+        static uint64_t GetTimestampUs(std::chrono::steady_clock::time_point time);
+
+        // Size of the block at the given cell size, before any scaling
+        static inline uint32_t GetWidth(uint32_t cellSize = DefaultCellSize) { return Columns * cellSize; }
+        static inline uint32_t GetHeight(uint32_t cellSize = DefaultCellSize) { return Rows * cellSize; }
+
+        // Writes the block with its top left corner at (x, y), clipped to the frame
+        static void Encode(const FrameView& frame, int32_t x, int32_t y, const WatermarkData& data, uint32_t cellSize = DefaultCellSize);
+
+        // Reads a block that now covers blockRect, after however it was scaled on the way.
+        // Returns false when the block is missing, too small to read or fails its CRC.
+        static bool Decode(const FrameView& frame, const Rect& blockRect, WatermarkData& outData);
+
+        // Where a block encoded at (x, y) lands after scaling by (scaleX, scaleY) and moving
+        // by (offsetX, offsetY), as an output that letterboxes or resizes the region would
+        static Rect GetScaledBlockRect(int32_t x, int32_t y, uint32_t cellSize, float scaleX, float scaleY, int32_t offsetX = 0, int32_t offsetY = 0);
+    };
+
+    // Distribution of capture to output latency read back from watermarks
+    class LatencyReport
+    {
+    public:
+        LatencyReport() = default;
+        ~LatencyReport() = default;
+
+        // Adds a frame seen at outputTime. Frame IDs that were skipped since the last one
+        // are counted as dropped, and repeats of the same ID as duplicates.
+        void AddFrame(const WatermarkData& data, std::chrono::steady_clock::time_point outputTime);
+        void AddUndecodable();
+        void Reset();
+
+    public:
+        inline uint64_t GetFrameCount() const { return m_Latencies.size(); }
+        inline uint64_t GetDroppedCount() const { return m_DroppedFrames; }
+        inline uint64_t GetDuplicateCount() const { return m_DuplicateFrames; }
+        inline uint64_t GetUndecodableCount() const { return m_UndecodableFrames; }
+
+        // Latency at the given percentile, from 0 to 100
+        std::chrono::microseconds GetPercentile(double percentile) const;
+        std::chrono::microseconds GetAverage() const;
+
+        std::string GetReport() const;
+
+    private:
+        std::vector<int64_t> m_Latencies;
+        mutable std::vector<int64_t> m_Sorted;
+        mutable bool m_IsSorted = true;
+
+        uint32_t m_LastFrameId = 0;
+        bool m_HasLastFrame = false;
+
+        uint64_t m_DroppedFrames = 0;
+        uint64_t m_DuplicateFrames = 0;
+        uint64_t m_UndecodableFrames = 0;
+    };
+}
@@ -0,0 +1,183 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Checks that the frame pipeline stops allocating once warmed up, without a display. Frames
+// are acquired from a broadcaster and published to a fast and a slow viewer, masked with
+// blurs of a different size every frame, and given per frame scratch from an arena, the way
+// takostream's stages use them. After the warm-up frames, neither operator new nor the
+// system allocator behind the frame allocator may be reached again, and every frame row and
+// scratch block must be cache line aligned. Exits with 1 if any check fails.
+//
+//     takoalloc [-H]
+//
+// -H backs frames with transparent huge pages, as takostream does, and reports how many.
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+#include "framealloc.h"
+#include "framebroadcaster.h"
+#include "privacymasker.h"
+
+namespace
+{
+    std::atomic<uint64_t> g_NewCount = 0;
+
+    constexpr uint32_t FrameWidth = 1920;
+    constexpr uint32_t FrameHeight = 1080;
+    constexpr uint32_t WarmupFrames = 50;
+    constexpr uint32_t SteadyFrames = 250;
+
+    void* CountedAllocate(size_t size, size_t alignment)
+    {
+        ++g_NewCount;
+
+        void* memory = alignment > alignof(std::max_align_t) ? aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1)) : malloc(size);
+        if (memory == nullptr)
+            throw std::bad_alloc();
+
+        return memory;
+    }
+
+    class Check
+    {
+    public:
+        explicit Check(const char* name) : m_Name(name) {}
+
+        void Expect(bool condition, const char* what)
+        {
+            if (!condition)
+                m_Failures += std::string(m_Failures.empty() ? "" : ", ") + what;
+        }
+
+        bool Finish()
+        {
+            printf("%-24s %s\n", m_Name, m_Failures.empty() ? "ok" : ("FAILED: " + m_Failures).c_str());
+            return m_Failures.empty();
+        }
+
+    private:
+        const char* m_Name;
+        std::string m_Failures;
+    };
+
+    bool IsAligned(const void* pointer)
+    {
+        return (reinterpret_cast<uintptr_t>(pointer) & (Takoyaki::FrameAlignment - 1)) == 0;
+    }
+}
+
+// The nothrow and array forms forward to these, so every allocation is counted
+void* operator new(size_t size) { return CountedAllocate(size, 0); }
+void* operator new(size_t size, std::align_val_t alignment) { return CountedAllocate(size, static_cast<size_t>(alignment)); }
+void operator delete(void* memory) noexcept { free(memory); }
+void operator delete(void* memory, size_t) noexcept { free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { free(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { free(memory); }
+
+int main(int argc, char** argv)
+{
+    const bool useHugePages = argc > 1 && strcmp(argv[1], "-H") == 0;
+
+    Takoyaki::FrameAllocator& allocator = Takoyaki::GetFrameAllocator();
+    allocator.SetUseHugePages(useHugePages);
+
+    Takoyaki::FrameBroadcaster broadcaster;
+    std::shared_ptr<Takoyaki::FrameSink> fastViewer = broadcaster.Subscribe({ 2 });
+    std::shared_ptr<Takoyaki::FrameSink> slowViewer = broadcaster.Subscribe({ 1 });
+
+    // Three mask layouts, so the arena sees a different working set from frame to frame
+    std::vector<Takoyaki::PrivacyMask> layouts[3] =
+    {
+        { { { 100, 100, 640, 360 }, Takoyaki::MaskStyle::Blur, 16 }, { { 1200, 700, 300, 200 }, Takoyaki::MaskStyle::Pixelate, 12 } },
+        { { { 0, 0, 1920, 120 }, Takoyaki::MaskStyle::Blur, 4 }, { { 1500, 200, 400, 800 }, Takoyaki::MaskStyle::Blur, 24 } },
+        { { { 1700, 900, 400, 400 }, Takoyaki::MaskStyle::Blur, 8 } },
+    };
+    Takoyaki::PrivacyMasker masker;
+
+    // Stand-in for an encoder stage's per frame scratch, a row of tile hashes and a delta row
+    Takoyaki::FrameArena scratch(64 * 1024);
+
+    Check frames("frame rows");
+    Check arena("stage scratch");
+
+    uint64_t newCount = 0;
+    Takoyaki::FrameAllocatorStats warmStats;
+    Takoyaki::FrameRef frame;
+
+    for (uint32_t i = 0; i < WarmupFrames + SteadyFrames; ++i)
+    {
+        if (i == WarmupFrames)
+        {
+            newCount = g_NewCount;
+            warmStats = allocator.GetStats();
+        }
+
+        Takoyaki::WritableFrame writable = broadcaster.AcquireFrame(FrameWidth, FrameHeight);
+        Takoyaki::FrameView view = writable.GetView();
+        frames.Expect(IsAligned(view.m_Data) && view.m_Stride % Takoyaki::FrameAlignment == 0, "unaligned row");
+
+        for (uint32_t y = 0; y < FrameHeight; ++y)
+            memset(view.GetRow(y), static_cast<int>((i + y) & 0xFF), FrameWidth * 4);
+
+        masker.SetMasks(layouts[i % 3]);
+        masker.Apply(view);
+
+        const size_t tiles = ((FrameWidth + 63) / 64) * (1 + i % 3);
+        uint64_t* hashes = scratch.AllocateArray<uint64_t>(tiles);
+        uint8_t* delta = scratch.AllocateArray<uint8_t>(FrameWidth * 4 * (1 + i % 2));
+        arena.Expect(IsAligned(hashes) && IsAligned(delta), "unaligned block");
+        memset(hashes, 0, tiles * sizeof(uint64_t));
+        memset(delta, 0, FrameWidth * 4);
+        scratch.Reset();
+
+        broadcaster.Publish(std::move(writable));
+
+        fastViewer->TryPop(frame);
+        if (i % 2 == 1)
+            slowViewer->TryPop(frame);
+        frame = {};
+    }
+
+    const uint64_t steadyNews = g_NewCount - newCount;
+    const Takoyaki::FrameAllocatorStats stats = allocator.GetStats();
+
+    Check steady("steady state");
+    steady.Expect(steadyNews == 0, "operator new reached");
+    steady.Expect(stats.m_SystemAllocations == warmStats.m_SystemAllocations, "system allocator reached");
+
+    printf("%u steady frames: %llu operator new, %llu system allocations (%llu while warming up), %llu on huge pages\n",
+        SteadyFrames,
+        static_cast<unsigned long long>(steadyNews),
+        static_cast<unsigned long long>(stats.m_SystemAllocations - warmStats.m_SystemAllocations),
+        static_cast<unsigned long long>(warmStats.m_SystemAllocations),
+        static_cast<unsigned long long>(stats.m_HugePageAllocations));
+    printf("stage scratch peak %zu KB in a %zu KB arena\n", scratch.GetPeakBytes() / 1024, scratch.GetCapacity() / 1024);
+
+    bool passed = frames.Finish();
+    passed = arena.Finish() && passed;
+    passed = steady.Finish() && passed;
+
+    return passed ? 0 : 1;
+}
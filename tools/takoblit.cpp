@@ -0,0 +1,123 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Benchmarks the Blitter paths against memcpy on this machine. Every fixed ratio is run
+// through its own kernel and through the generic lookup table path, for every format.
+//
+//     takoblit [iterations]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "blitter.h"
+#include "framealloc.h"
+
+namespace
+{
+    struct Case
+    {
+        uint32_t m_SrcWidth;
+        uint32_t m_SrcHeight;
+        uint32_t m_DstWidth;
+        uint32_t m_DstHeight;
+    };
+
+    constexpr Case Cases[] = {
+        { 3840, 2160, 3840, 2160 },
+        { 3840, 2160, 1920, 1080 },
+        { 5760, 3240, 1920, 1080 },
+        { 3840, 2160, 2560, 1440 },
+        { 2400, 1350, 1920, 1080 },
+    };
+
+    constexpr const char* FormatNames[] = { "gray8", "bgra8", "rgba16" };
+
+    // Best of several runs, in seconds
+    template<typename Function>
+    double Measure(uint32_t iterations, Function&& function)
+    {
+        double best = 1e9;
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            auto start = std::chrono::steady_clock::now();
+            function();
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+
+        return best;
+    }
+
+    Takoyaki::FrameView MakeView(Takoyaki::FrameAllocation& allocation, uint32_t width, uint32_t height, uint32_t bytesPerPixel)
+    {
+        uint32_t stride = (width * bytesPerPixel + Takoyaki::FrameAlignment - 1) & ~static_cast<uint32_t>(Takoyaki::FrameAlignment - 1);
+        allocation = Takoyaki::GetFrameAllocator().Allocate(static_cast<size_t>(stride) * height);
+        memset(allocation.m_Data, 0x5A, static_cast<size_t>(stride) * height);
+        return { allocation.m_Data, width, height, stride };
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t iterations = argc > 1 ? std::max(atoi(argv[1]), 1) : 20;
+
+    // Reference bandwidth, reading and writing one 4K BGRA frame
+    {
+        std::vector<uint8_t> src(3840 * 2160 * 4, 1);
+        std::vector<uint8_t> dst(src.size());
+        double seconds = Measure(iterations, [&]() { memcpy(dst.data(), src.data(), src.size()); });
+        printf("memcpy 4K bgra8: %.2f ms, %.1f GB/s\n\n", seconds * 1000.0, 2.0 * src.size() / seconds / 1e9);
+    }
+
+    printf("%-7s %-22s %-9s %10s %10s %12s %10s\n", "format", "scale", "path", "fixed ms", "GB/s", "generic ms", "GB/s");
+
+    for (uint32_t format = 0; format < 3; ++format)
+    {
+        Takoyaki::BlitFormat blitFormat = static_cast<Takoyaki::BlitFormat>(format);
+        uint32_t bytesPerPixel = Takoyaki::Blitter::GetBytesPerPixel(blitFormat);
+
+        for (const Case& test : Cases)
+        {
+            Takoyaki::FrameAllocation srcAllocation;
+            Takoyaki::FrameAllocation dstAllocation;
+            Takoyaki::FrameView src = MakeView(srcAllocation, test.m_SrcWidth, test.m_SrcHeight, bytesPerPixel);
+            Takoyaki::FrameView dst = MakeView(dstAllocation, test.m_DstWidth, test.m_DstHeight, bytesPerPixel);
+
+            // Every sampled source row is read whole, since the samples share cache lines
+            double traffic = static_cast<double>(test.m_DstHeight) * (test.m_SrcWidth + test.m_DstWidth) * bytesPerPixel;
+
+            Takoyaki::BlitPath path = Takoyaki::Blitter::SelectPath(test.m_SrcWidth, test.m_DstWidth);
+            double fixed = Measure(iterations, [&]() { Takoyaki::Blitter::Blit(src, dst, blitFormat); });
+            double generic = Measure(iterations, [&]() { Takoyaki::Blitter::BlitGeneric(src, dst, blitFormat); });
+
+            char scale[32];
+            snprintf(scale, sizeof(scale), "%ux%u->%ux%u", test.m_SrcWidth, test.m_SrcHeight, test.m_DstWidth, test.m_DstHeight);
+            printf("%-7s %-22s %-9s %10.2f %10.1f %12.2f %10.1f\n", FormatNames[format], scale, Takoyaki::Blitter::GetPathName(path),
+                fixed * 1000.0, traffic / fixed / 1e9, generic * 1000.0, traffic / generic / 1e9);
+
+            Takoyaki::GetFrameAllocator().Free(srcAllocation);
+            Takoyaki::GetFrameAllocator().Free(dstAllocation);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,213 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Checks the memory budget against synthetic allocations, without a display: that frames,
+// snapshots and the allocator cache are charged to the right categories, that lowering the
+// budget reclaims idle pool buffers and cached blocks, that Reserve refuses what does not fit
+// while Charge records it as over budget, that a refused reservation can fall back to a
+// smaller one the way the overlay snapshot does, that the edge map holds the charge for its
+// snapshot copy until it is done with it, and that everything is given back at the end.
+// Exits with 1 if any check fails.
+//
+//     takobudget
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include "edgemap.h"
+#include "framealloc.h"
+#include "framebroadcaster.h"
+#include "memorybudget.h"
+
+namespace
+{
+    using Takoyaki::MemoryCategory;
+
+    constexpr size_t Megabyte = 1024 * 1024;
+    constexpr uint32_t FrameWidth = 3840;
+    constexpr uint32_t FrameHeight = 2160;
+    constexpr size_t FrameBytes = static_cast<size_t>(FrameWidth) * FrameHeight * 4;
+
+    class Check
+    {
+    public:
+        explicit Check(const char* name) : m_Name(name) {}
+
+        void Expect(bool condition, const char* what)
+        {
+            if (!condition)
+                m_Failures += std::string(m_Failures.empty() ? "" : ", ") + what;
+        }
+
+        bool Finish()
+        {
+            printf("%-24s %s\n", m_Name, m_Failures.empty() ? "ok" : ("FAILED: " + m_Failures).c_str());
+            if (!m_Failures.empty())
+                printf("%s", Takoyaki::GetMemoryBudget().GetReport().c_str());
+
+            return m_Failures.empty();
+        }
+
+    private:
+        const char* m_Name;
+        std::string m_Failures;
+    };
+
+    size_t GetCategoryBytes(MemoryCategory category)
+    {
+        return Takoyaki::GetMemoryBudget().GetStats().m_Categories[static_cast<size_t>(category)].m_Bytes;
+    }
+}
+
+int main()
+{
+    Takoyaki::MemoryBudget& budget = Takoyaki::GetMemoryBudget();
+    Takoyaki::FrameAllocator& allocator = Takoyaki::GetFrameAllocator();
+    bool isPassing = true;
+
+    {
+        Takoyaki::FrameBroadcaster broadcaster;
+        std::vector<Takoyaki::FrameRef> held;
+
+        {
+            Check check("categories");
+
+            for (uint32_t i = 0; i < 6; ++i)
+                held.push_back(broadcaster.Publish(broadcaster.AcquireFrame(FrameWidth, FrameHeight)));
+
+            Takoyaki::MemoryReservation snapshot(MemoryCategory::Snapshot, 3 * FrameBytes);
+
+            // Freed scratch goes into the allocator cache rather than back to the system
+            Takoyaki::FrameAllocation scratch = allocator.Allocate(16 * Megabyte);
+            check.Expect(GetCategoryBytes(MemoryCategory::Scratch) >= 16 * Megabyte, "scratch not charged");
+            allocator.Free(scratch);
+
+            check.Expect(GetCategoryBytes(MemoryCategory::Capture) >= 6 * FrameBytes, "frames not charged to capture");
+            check.Expect(GetCategoryBytes(MemoryCategory::Snapshot) == 3 * FrameBytes, "snapshot not charged");
+            check.Expect(GetCategoryBytes(MemoryCategory::Scratch) == 0, "freed scratch still charged");
+            check.Expect(GetCategoryBytes(MemoryCategory::Cached) >= 16 * Megabyte, "freed scratch not cached");
+            isPassing &= check.Finish();
+        }
+
+        {
+            Check check("reclaim on lower budget");
+
+            // Four frames go idle in the pool, which together with the cache is all that can go
+            held.resize(2);
+            const size_t heldBytes = GetCategoryBytes(MemoryCategory::Capture);
+            budget.SetBudget(heldBytes / 2);
+
+            Takoyaki::MemoryBudgetStats stats = budget.GetStats();
+            check.Expect(stats.m_ReclaimRuns >= 1, "no reclaim ran");
+            check.Expect(GetCategoryBytes(MemoryCategory::Cached) == 0, "allocator cache kept");
+            check.Expect(GetCategoryBytes(MemoryCategory::Capture) >= 2 * FrameBytes && GetCategoryBytes(MemoryCategory::Capture) < 3 * FrameBytes, "idle pool buffers kept or held frames dropped");
+            isPassing &= check.Finish();
+        }
+
+        {
+            Check check("reserve and charge");
+
+            budget.SetBudget(budget.GetStats().m_TotalBytes + 64 * Megabyte);
+            const uint64_t denied = budget.GetStats().m_DeniedReservations;
+            const uint64_t overBudget = budget.GetStats().m_OverBudgetCharges;
+
+            check.Expect(budget.Reserve(MemoryCategory::Output, 48 * Megabyte), "reservation within budget refused");
+            check.Expect(!budget.Reserve(MemoryCategory::Output, 32 * Megabyte), "reservation over budget accepted");
+            check.Expect(budget.GetStats().m_DeniedReservations == denied + 1, "refusal not counted");
+
+            budget.Charge(MemoryCategory::Output, 32 * Megabyte);
+            check.Expect(budget.GetStats().m_OverBudgetCharges == overBudget + 1, "charge over budget not counted");
+
+            budget.Release(MemoryCategory::Output, 32 * Megabyte);
+            budget.Release(MemoryCategory::Output, 48 * Megabyte);
+            check.Expect(GetCategoryBytes(MemoryCategory::Output) == 0, "output not given back");
+            isPassing &= check.Finish();
+        }
+
+        {
+            Check check("downscaled fallback");
+
+            // Room for a quarter of a 4K snapshot but not all of it, so the overlay's loop
+            // settles on half size
+            budget.SetBudget(budget.GetStats().m_TotalBytes + FrameBytes / 3);
+
+            Takoyaki::MemoryReservation snapshot;
+            uint32_t divisor = 1;
+            for (; divisor < 4; divisor *= 2)
+            {
+                if (snapshot.TryReset(MemoryCategory::Snapshot, (FrameWidth / divisor) * (FrameHeight / divisor) * 4))
+                    break;
+            }
+
+            check.Expect(divisor == 2, "did not fall back to half size");
+            check.Expect(snapshot.GetSize() == FrameBytes / 4, "half size snapshot not held");
+
+            snapshot.Reset();
+            check.Expect(!snapshot.TryReset(MemoryCategory::Snapshot, FrameBytes) && snapshot.GetSize() == 0, "refused reservation still held");
+            isPassing &= check.Finish();
+        }
+
+        budget.SetBudget(0);
+    }
+
+    {
+        Check check("edge map snapshot");
+
+        // The copy main.cpp hands over from its GDI bitmap, as a blank 4K desktop
+        const size_t before = GetCategoryBytes(MemoryCategory::Snapshot);
+        Takoyaki::MemoryReservation pixelMemory;
+        check.Expect(pixelMemory.TryReset(MemoryCategory::Snapshot, FrameBytes), "snapshot copy refused");
+
+        Takoyaki::EdgeMap edgeMap;
+        edgeMap.BuildAsync(std::vector<uint32_t>(static_cast<size_t>(FrameWidth) * FrameHeight), FrameWidth, FrameHeight, 0, 0, std::move(pixelMemory));
+        check.Expect(pixelMemory.GetSize() == 0, "charge not handed to the edge map");
+        check.Expect(GetCategoryBytes(MemoryCategory::Snapshot) <= before + FrameBytes, "snapshot copy charged twice");
+
+        // The build thread gives the copy back right after the map is ready
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while ((!edgeMap.IsReady() || GetCategoryBytes(MemoryCategory::Snapshot) != before) && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::yield();
+
+        check.Expect(edgeMap.IsReady(), "edge map not built");
+        check.Expect(GetCategoryBytes(MemoryCategory::Snapshot) == before, "snapshot copy still charged after the build");
+
+        edgeMap.Clear();
+        check.Expect(GetCategoryBytes(MemoryCategory::Snapshot) == before, "snapshot copy charged after Clear");
+        isPassing &= check.Finish();
+    }
+
+    {
+        Check check("everything given back");
+
+        allocator.Trim();
+        Takoyaki::MemoryBudgetStats stats = budget.GetStats();
+        check.Expect(stats.m_TotalBytes == 0, "bytes still charged");
+
+        for (const Takoyaki::MemoryCategoryUsage& usage : stats.m_Categories)
+            check.Expect(usage.m_Bytes == 0 && usage.m_Buffers == 0, "category not empty");
+
+        isPassing &= check.Finish();
+    }
+
+    printf("%s", budget.GetReport().c_str());
+    return isPassing ? 0 : 1;
+}
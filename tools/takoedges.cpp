@@ -0,0 +1,135 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Benchmarks the selection edge map on a synthetic 4K desktop of overlapping windows: the
+// time to build it, how many edges it keeps, how long a snap takes, and how close snaps
+// near each window border land to it.
+//
+//     takoedges [lookups]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "edgemap.h"
+
+namespace
+{
+    constexpr uint32_t Width = 3840;
+    constexpr uint32_t Height = 2160;
+    constexpr int32_t SnapRadius = 12;
+
+    struct Window
+    {
+        int32_t m_X;
+        int32_t m_Y;
+        int32_t m_Width;
+        int32_t m_Height;
+    };
+
+    // A soft gradient wallpaper, then windows with a one pixel border, a title bar and
+    // lines of text-like noise, later windows on top
+    void MakeDesktop(std::vector<uint32_t>& pixels, const std::vector<Window>& windows, std::mt19937& rng)
+    {
+        for (uint32_t y = 0; y < Height; ++y)
+        {
+            for (uint32_t x = 0; x < Width; ++x)
+                pixels[static_cast<size_t>(y) * Width + x] = 0xFF000000 | ((x * 96 / Width) << 16) | ((y * 96 / Height) << 8) | 0x60;
+        }
+
+        for (const Window& window : windows)
+        {
+            for (int32_t y = window.m_Y; y < window.m_Y + window.m_Height; ++y)
+            {
+                for (int32_t x = window.m_X; x < window.m_X + window.m_Width; ++x)
+                {
+                    bool isBorder = x == window.m_X || y == window.m_Y || x == window.m_X + window.m_Width - 1 || y == window.m_Y + window.m_Height - 1;
+                    bool isTitle = y < window.m_Y + 32;
+                    bool isText = !isTitle && (y - window.m_Y) % 20 < 12 && rng() % 5 == 0;
+
+                    pixels[static_cast<size_t>(y) * Width + x] = isBorder ? 0xFF505050 : isTitle ? 0xFFE8E8E8 : isText ? 0xFF202020 : 0xFFFFFFFF;
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t lookups = argc > 1 ? std::max(atoi(argv[1]), 1) : 1000000;
+
+    std::mt19937 rng(7);
+    std::vector<Window> windows;
+    for (uint32_t i = 0; i < 12; ++i)
+    {
+        int32_t width = 400 + static_cast<int32_t>(rng() % 1600);
+        int32_t height = 300 + static_cast<int32_t>(rng() % 1000);
+        windows.push_back({ static_cast<int32_t>(rng() % (Width - width)), static_cast<int32_t>(rng() % (Height - height)), width, height });
+    }
+
+    std::vector<uint32_t> pixels(static_cast<size_t>(Width) * Height);
+    MakeDesktop(pixels, windows, rng);
+
+    Takoyaki::EdgeMap edges;
+    Takoyaki::FrameView frame = { reinterpret_cast<uint8_t*>(pixels.data()), Width, Height, Width * 4 };
+
+    edges.Build(frame, 0, 0);
+    printf("%s", edges.GetReport().c_str());
+
+    // Random points, most of which find nothing and so search the whole radius
+    std::vector<std::pair<int32_t, int32_t>> points(4096);
+    for (auto& point : points)
+        point = { static_cast<int32_t>(rng() % Width), static_cast<int32_t>(rng() % Height) };
+
+    // The hit count depends on every lookup, so none of them can be optimized away
+    uint32_t hits = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < lookups; ++i)
+    {
+        const auto& [x, y] = points[i % points.size()];
+        int32_t snapped = 0;
+        hits += edges.SnapX(x, y, SnapRadius, snapped);
+        hits += edges.SnapY(x, y, SnapRadius, snapped);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("Snap: %.0f ns per corner (an x and a y lookup), radius %d, %.1f%% found an edge\n",
+        seconds * 1e9 / lookups, SnapRadius, 100.0 * hits / (2.0 * lookups));
+
+    // Near the left and top border of the topmost window, which nothing covers
+    const Window& top = windows.back();
+    uint32_t near = 0;
+    uint32_t total = 0;
+
+    for (int32_t offset = -8; offset <= 8; ++offset)
+    {
+        int32_t snappedX = 0;
+        int32_t snappedY = 0;
+
+        total += 2;
+        near += edges.SnapX(top.m_X + offset, top.m_Y + top.m_Height / 2, SnapRadius, snappedX) && std::abs(snappedX - top.m_X) <= 1;
+        near += edges.SnapY(top.m_X + top.m_Width / 2, top.m_Y + offset, SnapRadius, snappedY) && std::abs(snappedY - top.m_Y) <= 1;
+    }
+
+    printf("Border snaps within a pixel: %u of %u\n", near, total);
+    return 0;
+}
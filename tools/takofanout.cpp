@@ -0,0 +1,256 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Stress run of the frame broadcaster and pool, without a display, meant to be built with
+// -fsanitize=address or -fsanitize=thread as well as on its own. One thread publishes as fast
+// as it can, switching the frame size every so often so pool buffers are reallocated, to a
+// fast sink that drops the oldest frame, a slow one that drops the newest, and a sink that a
+// consumer keeps subscribing and unsubscribing. Consumers release frames on their own threads
+// while the publisher acquires them. The broadcaster is destroyed while consumers still hold
+// frames and are waiting on their sinks, and one frame is read after that. Checks that every
+// frame holds the pixels stamped for its ID, that IDs only go up within a sink, that every
+// frame a sink received was either popped or counted as dropped, that the pool stays bounded
+// and that every buffer is given back at the end. Exits with 1 if any check fails.
+//
+//     takofanout [frames]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include "framebroadcaster.h"
+#include "memorybudget.h"
+
+namespace
+{
+    // Sum of the queue depths, what each consumer holds, the publisher's frame and the one
+    // kept for reading after the broadcaster is gone, with room for frames in flight
+    constexpr uint32_t MaxPoolBuffers = 16;
+
+    class Check
+    {
+    public:
+        explicit Check(const char* name) : m_Name(name) {}
+
+        void Expect(bool condition, const char* what)
+        {
+            if (!condition && m_Failures.find(what) == std::string::npos)
+                m_Failures += std::string(m_Failures.empty() ? "" : ", ") + what;
+        }
+
+        bool Finish()
+        {
+            printf("%-24s %s\n", m_Name, m_Failures.empty() ? "ok" : ("FAILED: " + m_Failures).c_str());
+            return m_Failures.empty();
+        }
+
+    private:
+        const char* m_Name;
+        std::string m_Failures;
+    };
+
+    uint32_t GetStamp(uint64_t frameId, uint32_t y)
+    {
+        return static_cast<uint32_t>(frameId * 2654435761u) ^ y;
+    }
+
+    // Counted by the consumer thread, read once it has been joined
+    struct ConsumerStats
+    {
+        uint64_t m_Popped = 0;
+        uint64_t m_Received = 0;
+        uint64_t m_Dropped = 0;
+        uint64_t m_BadPixels = 0;
+        uint64_t m_OutOfOrder = 0;
+    };
+
+    void CheckFrame(const Takoyaki::FrameRef& frame, uint64_t& lastId, bool& hasLast, ConsumerStats& stats)
+    {
+        for (uint32_t y = 0; y < frame->GetHeight(); ++y)
+        {
+            const uint32_t* row = frame->GetRow(y);
+            uint32_t stamp = GetStamp(frame->GetFrameId(), y);
+            stats.m_BadPixels += (row[0] != stamp) + (row[frame->GetWidth() - 1] != stamp);
+        }
+
+        stats.m_OutOfOrder += hasLast && frame->GetFrameId() <= lastId;
+        lastId = frame->GetFrameId();
+        hasLast = true;
+    }
+
+    // Pops until the broadcaster is gone and the sink has been drained
+    void Consume(const std::shared_ptr<Takoyaki::FrameSink>& sink, std::chrono::microseconds work, ConsumerStats& stats)
+    {
+        Takoyaki::FrameRef frame;
+        uint64_t lastId = 0;
+        bool hasLast = false;
+
+        while (!sink->IsClosed() || sink->TryPop(frame))
+        {
+            if (!frame && !sink->WaitPop(frame, std::chrono::milliseconds(10)))
+                continue;
+
+            CheckFrame(frame, lastId, hasLast, stats);
+            ++stats.m_Popped;
+
+            if (work.count() != 0)
+                std::this_thread::sleep_for(work);
+
+            // Released here, on the consumer thread, while the publisher acquires
+            frame.Reset();
+        }
+
+        stats.m_Received += sink->GetReceivedCount();
+        stats.m_Dropped += sink->GetDroppedCount();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t frames = argc > 1 ? std::max(atoi(argv[1]), 100) : 20000;
+
+    auto broadcaster = std::make_unique<Takoyaki::FrameBroadcaster>();
+    std::shared_ptr<Takoyaki::FrameSink> fastSink = broadcaster->Subscribe({ 2, Takoyaki::DropPolicy::DropOldest });
+    std::shared_ptr<Takoyaki::FrameSink> slowSink = broadcaster->Subscribe({ 3, Takoyaki::DropPolicy::DropNewest });
+
+    ConsumerStats fastStats;
+    ConsumerStats slowStats;
+    ConsumerStats churnStats;
+    std::atomic<bool> isPublishing = true;
+
+    std::thread fastThread([&]() { Consume(fastSink, std::chrono::microseconds(0), fastStats); });
+    std::thread slowThread([&]() { Consume(slowSink, std::chrono::microseconds(2000), slowStats); });
+
+    // Subscribes, takes a few frames and unsubscribes again, for as long as frames come
+    std::thread churnThread([&]()
+    {
+        while (isPublishing)
+        {
+            std::shared_ptr<Takoyaki::FrameSink> sink = broadcaster->Subscribe({ 1, Takoyaki::DropPolicy::DropOldest });
+
+            Takoyaki::FrameRef frame;
+            uint64_t lastId = 0;
+            bool hasLast = false;
+            for (int i = 0; i < 5 && sink->WaitPop(frame, std::chrono::milliseconds(10)); ++i)
+            {
+                CheckFrame(frame, lastId, hasLast, churnStats);
+                ++churnStats.m_Popped;
+            }
+
+            broadcaster->Unsubscribe(sink);
+            while (sink->TryPop(frame))
+            {
+                CheckFrame(frame, lastId, hasLast, churnStats);
+                ++churnStats.m_Popped;
+            }
+
+            churnStats.m_Received += sink->GetReceivedCount();
+            churnStats.m_Dropped += sink->GetDroppedCount();
+        }
+    });
+
+    Check pool("pool");
+    Takoyaki::FrameRef kept;
+    uint32_t maxBuffers = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < frames; ++i)
+    {
+        const bool isSmall = (i / 1000) % 2 == 1;
+        Takoyaki::WritableFrame writable = broadcaster->AcquireFrame(isSmall ? 320 : 640, isSmall ? 180 : 360);
+        pool.Expect(static_cast<bool>(writable), "acquire failed");
+        if (!writable)
+            continue;
+
+        // The ID Publish is about to give the frame
+        const uint64_t frameId = broadcaster->GetPublishedCount();
+        Takoyaki::FrameView view = writable.GetView();
+        for (uint32_t y = 0; y < view.m_Height; ++y)
+        {
+            view.GetRow(y)[0] = GetStamp(frameId, y);
+            view.GetRow(y)[view.m_Width - 1] = GetStamp(frameId, y);
+        }
+
+        Takoyaki::FrameRef published = broadcaster->Publish(std::move(writable));
+        pool.Expect(published->GetFrameId() == frameId, "unexpected frame ID");
+
+        if (i == frames / 2)
+            kept = published;
+
+        maxBuffers = std::max(maxBuffers, broadcaster->GetPool().GetBufferCount());
+
+        // Lets consumers in between publishes even on a single core
+        std::this_thread::yield();
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    const uint64_t published = broadcaster->GetPublishedCount();
+
+    isPublishing = false;
+    churnThread.join();
+
+    // Consumers are still waiting on their sinks and may hold frames
+    broadcaster.reset();
+    fastThread.join();
+    slowThread.join();
+
+    pool.Expect(maxBuffers <= MaxPoolBuffers, "pool grew past its bound");
+
+    ConsumerStats keptStats;
+    uint64_t keptId = 0;
+    bool hasKept = false;
+    CheckFrame(kept, keptId, hasKept, keptStats);
+    pool.Expect(keptStats.m_BadPixels == 0, "kept frame changed after the broadcaster went");
+    kept.Reset();
+
+    const size_t frameBytes = Takoyaki::GetMemoryBudget().GetStats().m_Categories[static_cast<size_t>(Takoyaki::MemoryCategory::Capture)].m_Bytes;
+    pool.Expect(frameBytes == 0, "frame memory still charged");
+
+    printf("%llu frames published in %.1f ms, at most %u pool buffers\n", static_cast<unsigned long long>(published), elapsed.count(), maxBuffers);
+
+    bool passed = pool.Finish();
+
+    struct Sink
+    {
+        const char* m_Name;
+        const ConsumerStats& m_Stats;
+        bool m_IsWholeRun;
+    };
+
+    const Sink sinks[] = { { "fast sink", fastStats, true }, { "slow sink", slowStats, true }, { "churning sinks", churnStats, false } };
+    for (const Sink& sink : sinks)
+    {
+        Check check(sink.m_Name);
+        check.Expect(sink.m_Stats.m_BadPixels == 0, "frame holds another frame's pixels");
+        check.Expect(sink.m_Stats.m_OutOfOrder == 0, "frame IDs went back");
+        check.Expect(sink.m_Stats.m_Popped + sink.m_Stats.m_Dropped == sink.m_Stats.m_Received, "frames lost");
+        check.Expect(!sink.m_IsWholeRun || sink.m_Stats.m_Received == published, "frames not received");
+        passed = check.Finish() && passed;
+
+        printf("  %llu received, %llu popped, %llu dropped\n", static_cast<unsigned long long>(sink.m_Stats.m_Received),
+            static_cast<unsigned long long>(sink.m_Stats.m_Popped), static_cast<unsigned long long>(sink.m_Stats.m_Dropped));
+    }
+
+    return passed ? 0 : 1;
+}
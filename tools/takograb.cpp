@@ -0,0 +1,170 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Measures how fast a region of the X11 desktop is grabbed through MIT-SHM and through plain
+// XGetImage. Every frame is copied in full, even where XDamage saw no change, then the cost
+// of a frame that XDamage lets the capture skip is measured separately. Any X server will
+// do, including a headless one:
+//
+//     xvfb-run -s "-screen 0 3840x2160x24" takograb [frames] [x y width height]
+//
+// Without a region, the whole screen, 1920x1080 and 640x480 are measured.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "x11capture.h"
+
+namespace
+{
+    struct Result
+    {
+        double m_Seconds = 0.0;
+        uint32_t m_Frames = 0;
+        bool m_IsFailed = false;
+    };
+
+    // Copies the first frame out, then times the rest
+    Result Measure(Takoyaki::X11Capture& capture, uint32_t frames, std::vector<uint8_t>& outFirstFrame)
+    {
+        Result result;
+        Takoyaki::FrameView frame;
+
+        if (capture.CaptureIntoBuffer(frame) != Takoyaki::X11CaptureError::OK)
+        {
+            result.m_IsFailed = true;
+            return result;
+        }
+
+        outFirstFrame.resize(static_cast<size_t>(frame.m_Width) * frame.m_Height * 4);
+        for (uint32_t y = 0; y < frame.m_Height; ++y)
+            memcpy(outFirstFrame.data() + static_cast<size_t>(y) * frame.m_Width * 4, frame.GetRow(y), frame.m_Width * 4);
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (; result.m_Frames < frames; ++result.m_Frames)
+        {
+            if (capture.CaptureIntoBuffer(frame) != Takoyaki::X11CaptureError::OK)
+            {
+                result.m_IsFailed = true;
+                break;
+            }
+        }
+
+        result.m_Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+
+    void PrintResult(const char* path, const Result& result, const Takoyaki::Rect& rect)
+    {
+        if (result.m_IsFailed || result.m_Frames == 0)
+        {
+            printf("  %-10s capture FAILED\n", path);
+            return;
+        }
+
+        const double frameSeconds = result.m_Seconds / result.m_Frames;
+        printf("  %-10s %8.2f ms %9.1f fps %10.1f MB/s\n", path, frameSeconds * 1000.0, 1.0 / frameSeconds,
+            static_cast<double>(rect.m_Width) * rect.m_Height * 4 / frameSeconds / (1024.0 * 1024.0));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t frames = argc > 1 ? static_cast<uint32_t>(std::max(atoi(argv[1]), 1)) : 200;
+
+    Takoyaki::X11Capture capture;
+    if (!capture.Initialize())
+        return 1;
+
+    const Takoyaki::Rect screen = capture.GetScreenRect();
+    std::vector<Takoyaki::Rect> regions;
+
+    if (argc > 5)
+    {
+        regions.push_back({ atoi(argv[2]), atoi(argv[3]), static_cast<uint32_t>(atoi(argv[4])), static_cast<uint32_t>(atoi(argv[5])) });
+    }
+    else
+    {
+        regions.push_back(screen);
+        if (screen.m_Width > 1920 && screen.m_Height > 1080)
+            regions.push_back({ 0, 0, 1920, 1080 });
+        if (screen.m_Width > 640 && screen.m_Height > 480)
+            regions.push_back({ 0, 0, 640, 480 });
+    }
+
+    printf("%ux%u screen, MIT-SHM %s, XDamage %s, %u frames per run\n", screen.m_Width, screen.m_Height,
+        capture.IsSharedMemoryAvailable() ? "available" : "NOT available", capture.IsDamageAvailable() ? "available" : "not available", frames);
+
+    bool isFailed = false;
+
+    for (const Takoyaki::Rect& region : regions)
+    {
+        capture.SetTargetRect(region);
+        capture.SetUseDamage(false);
+        printf("%ux%u at %d,%d\n", region.m_Width, region.m_Height, region.m_X, region.m_Y);
+
+        std::vector<uint8_t> shmFrame;
+        capture.SetUseSharedMemory(true);
+        Result shm = Measure(capture, frames, shmFrame);
+
+        // A failed attach turns MIT-SHM off for good, and the run above was XGetImage after all
+        const bool isShmMeasured = capture.IsSharedMemoryAvailable();
+        PrintResult(isShmMeasured ? "MIT-SHM" : "(no SHM)", shm, capture.GetClampedRect());
+
+        std::vector<uint8_t> plainFrame;
+        capture.SetUseSharedMemory(false);
+        Result plain = Measure(capture, frames, plainFrame);
+        PrintResult("XGetImage", plain, capture.GetClampedRect());
+
+        isFailed |= shm.m_IsFailed || plain.m_IsFailed;
+
+        if (isShmMeasured && !shm.m_IsFailed && !plain.m_IsFailed)
+        {
+            printf("  MIT-SHM is %.2fx the rate of XGetImage, first frames %s\n", (plain.m_Seconds / plain.m_Frames) / (shm.m_Seconds / shm.m_Frames),
+                shmFrame == plainFrame ? "match" : "differ (did the desktop change?)");
+        }
+    }
+
+    // What a frame costs when XDamage reports nothing new inside the region
+    if (capture.IsDamageAvailable())
+    {
+        capture.SetTargetRect(regions.front());
+        capture.SetUseSharedMemory(true);
+        capture.SetUseDamage(true);
+
+        Takoyaki::FrameView frame;
+        capture.CaptureIntoBuffer(frame);
+
+        uint32_t skipped = 0;
+        const auto start = std::chrono::steady_clock::now();
+
+        for (uint32_t i = 0; i < frames; ++i)
+            skipped += capture.CaptureIntoBuffer(frame) == Takoyaki::X11CaptureError::NoChange;
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("With XDamage: %u of %u frames skipped as unchanged, %.3f ms a frame\n", skipped, frames, seconds * 1000.0 / frames);
+    }
+
+    return isFailed ? 1 : 0;
+}
@@ -0,0 +1,47 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Checks every SIMD variant of the pixel kernels this machine can run against the scalar
+// reference, on random rows of every vector tail length: tonemapping, masking, tile
+// statistics, hashing, PNG filters, cursor blending, crop matching, palette mapping and
+// edge detection. Mismatches are printed as they are found. Exits with 1 if any level does
+// not match.
+//
+//     takokernels
+
+#include <cstdio>
+#include "cpufeatures.h"
+#include "kernels/pixelkernels.h"
+
+int main()
+{
+    const Takoyaki::SimdLevel detected = Takoyaki::DetectSimdLevel();
+    printf("Detected %s, pixel kernels bound to %s\n", Takoyaki::GetSimdLevelName(detected), Takoyaki::GetSimdLevelName(Takoyaki::GetPixelKernels().m_Level));
+
+    uint32_t failedLevels = 0;
+    for (uint32_t i = 0; i <= static_cast<uint32_t>(detected); ++i)
+    {
+        if (!Takoyaki::CheckPixelKernelConformance(static_cast<Takoyaki::SimdLevel>(i)))
+            ++failedLevels;
+    }
+
+    printf("%u of %u levels match the scalar reference\n", static_cast<uint32_t>(detected) + 1 - failedLevels, static_cast<uint32_t>(detected) + 1);
+    return failedLevels == 0 ? 0 : 1;
+}
@@ -0,0 +1,245 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Checks the privacy masker on noise frames, without a display: that the blur matches a naive
+// box blur with replicated edges to within one step, that pixelation blocks are uniform and
+// stay on a grid anchored at the mask origin when the mask is clipped, that masking a frame
+// cropped out of the region gives the same pixels as masking the whole region except in
+// blocks cut by the crop, and that nothing outside a mask is touched. Then reports what
+// masking a 1080p frame costs. Exits with 1 if any check fails.
+//
+//     takomask
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "privacymasker.h"
+
+namespace
+{
+    using Takoyaki::MaskStyle;
+    using Takoyaki::Rect;
+
+    class Check
+    {
+    public:
+        explicit Check(const char* name) : m_Name(name) {}
+
+        void Expect(bool condition, const char* what)
+        {
+            if (!condition && m_Failures.find(what) == std::string::npos)
+                m_Failures += std::string(m_Failures.empty() ? "" : ", ") + what;
+        }
+
+        bool Finish()
+        {
+            printf("%-24s %s\n", m_Name, m_Failures.empty() ? "ok" : ("FAILED: " + m_Failures).c_str());
+            return m_Failures.empty();
+        }
+
+    private:
+        const char* m_Name;
+        std::string m_Failures;
+    };
+
+    class NoiseFrame
+    {
+    public:
+        NoiseFrame(uint32_t width, uint32_t height, uint32_t seed)
+            : m_Pixels(static_cast<size_t>(width) * height * 4)
+            , m_Width(width)
+            , m_Height(height)
+        {
+            std::mt19937 random(seed);
+            for (uint8_t& value : m_Pixels)
+                value = static_cast<uint8_t>(random());
+        }
+
+        inline Takoyaki::FrameView GetView() { return { m_Pixels.data(), m_Width, m_Height, m_Width * 4 }; }
+        inline const uint8_t* GetPixel(int32_t x, int32_t y) const { return m_Pixels.data() + (static_cast<size_t>(y) * m_Width + x) * 4; }
+        inline bool IsInside(int32_t x, int32_t y, const Rect& rect) const
+        {
+            return x >= rect.m_X && y >= rect.m_Y && x < rect.m_X + static_cast<int32_t>(rect.m_Width) && y < rect.m_Y + static_cast<int32_t>(rect.m_Height);
+        }
+
+    public:
+        std::vector<uint8_t> m_Pixels;
+        uint32_t m_Width;
+        uint32_t m_Height;
+    };
+
+    bool CheckBlur()
+    {
+        Check check("blur reference");
+
+        for (uint32_t radius : { 1u, 5u, 16u, 40u })
+        {
+            NoiseFrame frame(640, 480, radius);
+            const NoiseFrame original = frame;
+            const Rect rect = { 37, 23, 211, 97 };
+
+            Takoyaki::PrivacyMasker masker;
+            masker.AddMask({ rect, MaskStyle::Blur, radius });
+            masker.Apply(frame.GetView());
+
+            const int32_t window = static_cast<int32_t>(radius) * 2 + 1;
+            for (int32_t y = 0; y < static_cast<int32_t>(frame.m_Height); ++y)
+            {
+                for (int32_t x = 0; x < static_cast<int32_t>(frame.m_Width); ++x)
+                {
+                    if (!frame.IsInside(x, y, rect))
+                    {
+                        check.Expect(memcmp(frame.GetPixel(x, y), original.GetPixel(x, y), 4) == 0, "pixel outside changed");
+                        continue;
+                    }
+
+                    for (int32_t c = 0; c < 4; ++c)
+                    {
+                        int32_t sum = 0;
+                        for (int32_t dy = -static_cast<int32_t>(radius); dy <= static_cast<int32_t>(radius); ++dy)
+                        {
+                            int32_t sourceY = std::clamp(y + dy, rect.m_Y, rect.m_Y + static_cast<int32_t>(rect.m_Height) - 1);
+                            for (int32_t dx = -static_cast<int32_t>(radius); dx <= static_cast<int32_t>(radius); ++dx)
+                                sum += original.GetPixel(std::clamp(x + dx, rect.m_X, rect.m_X + static_cast<int32_t>(rect.m_Width) - 1), sourceY)[c];
+                        }
+
+                        int32_t expected = (sum + window * window / 2) / (window * window);
+                        check.Expect(abs(frame.GetPixel(x, y)[c] - expected) <= 1, "blur off by more than one");
+                    }
+                }
+            }
+        }
+
+        return check.Finish();
+    }
+
+    bool CheckPixelateGrid()
+    {
+        Check check("pixelate grid");
+
+        // Hangs off the top left corner, so the first row and column of blocks are cut
+        const uint32_t blockSize = 8;
+        const Rect mask = { -5, -3, 100, 60 };
+        const Rect rect = { 0, 0, 95, 57 };
+
+        NoiseFrame frame(320, 240, 7);
+        const NoiseFrame original = frame;
+
+        Takoyaki::PrivacyMasker masker;
+        masker.AddMask({ mask, MaskStyle::Pixelate, blockSize });
+        masker.Apply(frame.GetView());
+
+        for (int32_t y = 0; y < static_cast<int32_t>(frame.m_Height); ++y)
+        {
+            for (int32_t x = 0; x < static_cast<int32_t>(frame.m_Width); ++x)
+            {
+                if (!frame.IsInside(x, y, rect))
+                {
+                    check.Expect(memcmp(frame.GetPixel(x, y), original.GetPixel(x, y), 4) == 0, "pixel outside changed");
+                    continue;
+                }
+
+                // Every pixel matches the first one of its block that is inside the frame
+                int32_t blockX = std::max(mask.m_X + (x - mask.m_X) / static_cast<int32_t>(blockSize) * static_cast<int32_t>(blockSize), 0);
+                int32_t blockY = std::max(mask.m_Y + (y - mask.m_Y) / static_cast<int32_t>(blockSize) * static_cast<int32_t>(blockSize), 0);
+                check.Expect(memcmp(frame.GetPixel(x, y), frame.GetPixel(blockX, blockY), 4) == 0, "block not uniform or off the grid");
+            }
+        }
+
+        return check.Finish();
+    }
+
+    bool CheckCroppedFrame()
+    {
+        Check check("cropped frame");
+
+        // The first mask lies inside the crop, the others are cut by its left and top edges
+        const Rect crop = { 50, 60, 400, 480 };
+        std::vector<Takoyaki::PrivacyMask> masks =
+        {
+            { { 100, 100, 200, 150 }, MaskStyle::Blur, 9 },
+            { { 20, 400, 300, 100 }, MaskStyle::Pixelate, 8 },
+            { { 420, 30, 100, 100 }, MaskStyle::Pixelate, 7 },
+        };
+
+        // Pixelation blocks that straddle the crop edge average fewer pixels inside the crop
+        auto isCutBlock = [&](int32_t x, int32_t y)
+        {
+            return (y >= 400 && y < 500 && x < 52) || (x >= 420 && y < 130 && (y < 65 || x >= 448));
+        };
+
+        NoiseFrame whole(800, 600, 11);
+        NoiseFrame cropped = whole;
+
+        Takoyaki::PrivacyMasker masker;
+        masker.SetMasks(masks);
+        masker.Apply(whole.GetView());
+        masker.Apply(cropped.GetView().GetSubView(crop), crop.m_X, crop.m_Y);
+
+        for (int32_t y = crop.m_Y; y < crop.m_Y + static_cast<int32_t>(crop.m_Height); ++y)
+        {
+            for (int32_t x = crop.m_X; x < crop.m_X + static_cast<int32_t>(crop.m_Width); ++x)
+            {
+                if (!isCutBlock(x, y))
+                    check.Expect(memcmp(whole.GetPixel(x, y), cropped.GetPixel(x, y), 4) == 0, "differs from the whole region");
+            }
+        }
+
+        return check.Finish();
+    }
+
+    void MeasureFrame()
+    {
+        NoiseFrame frame(1920, 1080, 1);
+
+        Takoyaki::PrivacyMasker masker;
+        masker.AddMask({ { 200, 100, 400, 60 }, MaskStyle::Blur, 24 });
+        masker.AddMask({ { 1500, 600, 500, 800 }, MaskStyle::Blur, 127 });
+        masker.AddMask({ { 100, 700, 300, 300 }, MaskStyle::Pixelate, 16 });
+        masker.AddMask({ { -10, -10, 100, 100 }, MaskStyle::Pixelate, 7 });
+
+        for (int i = 0; i < 5; ++i)
+            masker.Apply(frame.GetView());
+
+        const int iterations = 200;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            masker.Apply(frame.GetView());
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        printf("1080p frame with 2 blurs and 2 pixelations: %.3f ms\n", elapsed.count() / iterations);
+    }
+}
+
+int main()
+{
+    bool passed = CheckBlur();
+    passed = CheckPixelateGrid() && passed;
+    passed = CheckCroppedFrame() && passed;
+
+    MeasureFrame();
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,178 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Benchmarks palette output on synthetic frames: counting colours, mapping pixels to
+// indices at every SIMD level, and the size of a keyframe with and without a palette.
+//
+//     takopalette [iterations]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "kernels/pixelkernels.h"
+#include "palettebuilder.h"
+#include "streamprotocol.h"
+
+namespace
+{
+    constexpr uint32_t Width = 1920;
+    constexpr uint32_t Height = 1080;
+
+    // Best of several runs, in seconds
+    template<typename Function>
+    double Measure(uint32_t iterations, Function&& function)
+    {
+        double best = 1e9;
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            auto start = std::chrono::steady_clock::now();
+            function();
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+
+        return best;
+    }
+
+    // Lines of 8x16 glyph cells in a few foreground colours on a dark background, with
+    // anti-aliased edges as blends of the two, like a terminal
+    void MakeTerminal(std::vector<uint32_t>& pixels, uint32_t colourCount)
+    {
+        std::mt19937 rng(1);
+        std::vector<uint32_t> colours(colourCount);
+        for (uint32_t& colour : colours)
+            colour = 0xFF000000 | (rng() & 0xFFFFFF);
+
+        for (uint32_t y = 0; y < Height; ++y)
+        {
+            std::mt19937 lineRng(y / 16);
+            for (uint32_t x = 0; x < Width; x += 8)
+            {
+                uint32_t cell = lineRng();
+                uint32_t colour = colours[1 + cell % (colourCount - 1)];
+                bool isBlank = cell % 3 == 0 || x > (cell >> 8) % Width + 400;
+
+                for (uint32_t i = 0; i < 8; ++i)
+                    pixels[static_cast<size_t>(y) * Width + x + i] = !isBlank && (rng() % 4) == 0 ? colour : colours[0];
+            }
+        }
+    }
+
+    void MakePhoto(std::vector<uint32_t>& pixels)
+    {
+        std::mt19937 rng(2);
+        for (uint32_t y = 0; y < Height; ++y)
+        {
+            for (uint32_t x = 0; x < Width; ++x)
+                pixels[static_cast<size_t>(y) * Width + x] = 0xFF000000 | ((x * 255 / Width) << 16) | ((y * 255 / Height) << 8) | (rng() & 0x3F);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t iterations = argc > 1 ? std::max(atoi(argv[1]), 1) : 20;
+
+    std::vector<uint32_t> pixels(static_cast<size_t>(Width) * Height);
+    std::vector<uint8_t> indices(Width);
+    std::vector<uint8_t> message;
+
+    Takoyaki::FrameView frame = { reinterpret_cast<uint8_t*>(pixels.data()), Width, Height, Width * 4 };
+    const Takoyaki::Rect rect = { 0, 0, Width, Height };
+    const double megapixels = Width * Height / 1e6;
+
+    Takoyaki::Stream::FrameInfo info;
+    info.m_Width = Width;
+    info.m_Height = Height;
+    info.m_TileSize = 64;
+    info.m_Flags = Takoyaki::Stream::FrameFlagKeyframe;
+
+    struct Content
+    {
+        const char* m_Name;
+        uint32_t m_Colours;
+    };
+
+    constexpr Content Contents[] = { { "terminal 16", 16 }, { "terminal 256", 256 }, { "photo", 0 } };
+
+    printf("%-13s %8s %10s %10s %10s %12s %12s %12s\n", "content", "colours", "count ms", "map ms", "MP/s", "bgra KB", "palette KB", "raw only KB");
+
+    for (const Content& content : Contents)
+    {
+        if (content.m_Colours != 0)
+            MakeTerminal(pixels, content.m_Colours);
+        else
+            MakePhoto(pixels);
+
+        Takoyaki::PaletteBuilder palette;
+        double count = Measure(iterations, [&]() { palette.Reset(); palette.AddRect(frame, rect); });
+
+        char colours[16];
+        snprintf(colours, sizeof(colours), palette.IsOverflowed() ? ">%u" : "%u", palette.IsOverflowed() ? Takoyaki::PaletteBuilder::MaxColours : static_cast<uint32_t>(palette.GetColours().size()));
+
+        double map = 0.0;
+        if (!palette.IsOverflowed())
+        {
+            map = Measure(iterations, [&]()
+            {
+                for (uint32_t y = 0; y < Height; ++y)
+                    palette.MapRow(frame.GetRow(y), indices.data(), Width);
+            });
+        }
+
+        // Solid and run-length tiles either way, then raw or indexed for the rest, and last
+        // indexed against raw alone
+        Takoyaki::Stream::BuildFrameMessage(frame, info, nullptr, true, message);
+        size_t bgraSize = message.size();
+        Takoyaki::Stream::BuildFrameMessage(frame, info, nullptr, true, message, &palette);
+        size_t paletteSize = message.size();
+        Takoyaki::Stream::BuildFrameMessage(frame, info, nullptr, false, message);
+        size_t rawSize = message.size();
+
+        printf("%-13s %8s %10.2f %10.2f %10.1f %12.1f %12.1f %12.1f\n", content.m_Name, colours, count * 1000.0, map * 1000.0,
+            map > 0 ? megapixels / map : 0.0, bgraSize / 1024.0, paletteSize / 1024.0, rawSize / 1024.0);
+    }
+
+    // Index mapping alone at each level, on the 256 colour terminal, which misses its home
+    // slot the most
+    MakeTerminal(pixels, 256);
+
+    Takoyaki::PaletteBuilder palette;
+    palette.AddRect(frame, rect);
+
+    printf("\n%-8s %10s %10s\n", "level", "map ms", "MP/s");
+    for (uint32_t level = 0; level < static_cast<uint32_t>(Takoyaki::SimdLevel::Count); ++level)
+    {
+        Takoyaki::PixelKernels kernels = Takoyaki::BindPixelKernels(static_cast<Takoyaki::SimdLevel>(level));
+        if (kernels.m_Level != static_cast<Takoyaki::SimdLevel>(level))
+            continue;
+
+        double map = Measure(iterations, [&]()
+        {
+            for (uint32_t y = 0; y < Height; ++y)
+                kernels.m_MapPaletteRow(palette.GetTable(), frame.GetRow(y), indices.data(), Width);
+        });
+
+        printf("%-8s %10.2f %10.1f\n", Takoyaki::GetSimdLevelName(kernels.m_Level), map * 1000.0, megapixels / map);
+    }
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Runs a capture, render and present pipeline headless, with stages that stand in for the
+// real ones by waiting as long as they would on the GPU and display. The same graph is run
+// once polled from a single thread, which is the old sequential loop, and once on worker
+// threads, where the stages overlap across frames.
+//
+//     takopipe [frames] [capture ms] [render ms] [present ms]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "framepipeline.h"
+
+namespace
+{
+    struct Options
+    {
+        uint64_t m_Frames = 240;
+        std::chrono::microseconds m_Capture{ 4000 };
+        std::chrono::microseconds m_Render{ 3000 };
+        std::chrono::microseconds m_Present{ 5000 };
+    };
+
+    void Run(const Options& options, uint32_t threadCount)
+    {
+        Takoyaki::Executor executor(threadCount);
+        Takoyaki::FramePipeline pipeline(executor);
+        Takoyaki::FramePool pool;
+
+        pipeline.AddSource("capture", [&](Takoyaki::PipelineFrame& frame)
+        {
+            if (frame.m_Sequence >= options.m_Frames)
+                return Takoyaki::StageResult::Stop;
+
+            std::this_thread::sleep_for(options.m_Capture);
+
+            frame.m_Region = { 0, 0, 640, 360 };
+            frame.m_Writable = pool.Acquire(frame.m_Region.m_Width, frame.m_Region.m_Height);
+
+            Takoyaki::FrameView view = frame.m_Writable.GetView();
+            for (uint32_t y = 0; y < view.m_Height; ++y)
+                memset(view.GetRow(y), static_cast<int>(frame.m_Sequence + y), view.m_Width * 4);
+
+            return Takoyaki::StageResult::Continue;
+        });
+
+        pipeline.AddStage("render", [&](Takoyaki::PipelineFrame& frame)
+        {
+            frame.m_Frame = Takoyaki::FrameRef(std::move(frame.m_Writable));
+            std::this_thread::sleep_for(options.m_Render);
+            return Takoyaki::StageResult::Continue;
+        });
+
+        uint64_t expected = 0;
+        uint64_t outOfOrder = 0;
+
+        pipeline.AddStage("present", [&](Takoyaki::PipelineFrame& frame)
+        {
+            if (frame.m_Sequence != expected++ || !frame.m_Frame)
+                ++outOfOrder;
+
+            std::this_thread::sleep_for(options.m_Present);
+            return Takoyaki::StageResult::Continue;
+        });
+
+        pipeline.Start();
+        pipeline.Wait();
+
+        printf("%s, %u worker threads:\n%s", threadCount == 0 ? "Polled from one thread" : "Executor", threadCount, pipeline.GetReport().c_str());
+
+        if (outOfOrder != 0)
+            printf("  %llu frames out of order or missing pixels\n", static_cast<unsigned long long>(outOfOrder));
+
+        printf("\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+
+    if (argc > 1)
+        options.m_Frames = strtoull(argv[1], nullptr, 10);
+    if (argc > 2)
+        options.m_Capture = std::chrono::microseconds(static_cast<int64_t>(atof(argv[2]) * 1000));
+    if (argc > 3)
+        options.m_Render = std::chrono::microseconds(static_cast<int64_t>(atof(argv[3]) * 1000));
+    if (argc > 4)
+        options.m_Present = std::chrono::microseconds(static_cast<int64_t>(atof(argv[4]) * 1000));
+
+    Run(options, 0);
+    Run(options, 3);
+
+    return 0;
+}
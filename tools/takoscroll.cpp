@@ -0,0 +1,269 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Checks scroll and move detection without a display. First the motion detector on its own:
+// for panes scrolled up, down, left and right, with and without an unrelated change, applying
+// its copies and dirty rects to the previous frame must rebuild the current one exactly.
+// Then end to end: a stream server and viewer on a local socket, with a document scrolling
+// in an editor pane and a status bar that changes now and then, once without and once with
+// motion detection. Every frame the viewer rebuilds must match the one published, and with
+// detection the viewer has to receive copies and less data. Exits with 1 if any check fails.
+//
+//     takoscroll [frames]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "framebroadcaster.h"
+#include "motiondetector.h"
+#include "streamprotocol.h"
+#include "streamserver.h"
+#include "streamviewer.h"
+
+namespace
+{
+    // Pane of a scrolling document inside static window chrome
+    constexpr uint32_t PaneLeft = 300;
+    constexpr uint32_t PaneTop = 100;
+    constexpr uint32_t PaneMargin = 50;
+
+    constexpr uint32_t StreamWidth = 1280;
+    constexpr uint32_t StreamHeight = 720;
+    constexpr uint32_t ScrollPerFrame = 7;
+
+    class Check
+    {
+    public:
+        explicit Check(const char* name) : m_Name(name) {}
+
+        void Expect(bool condition, const char* what)
+        {
+            if (!condition && m_Failures.find(what) == std::string::npos)
+                m_Failures += std::string(m_Failures.empty() ? "" : ", ") + what;
+        }
+
+        bool Finish()
+        {
+            printf("%-36s %s\n", m_Name.c_str(), m_Failures.empty() ? "ok" : ("FAILED: " + m_Failures).c_str());
+            return m_Failures.empty();
+        }
+
+    private:
+        std::string m_Name;
+        std::string m_Failures;
+    };
+
+    // Text-like content at document coordinates: sparse dark glyphs on white, with a tint
+    // that changes every 16 lines so that no two stretches of the document look alike
+    uint32_t GetDocumentPixel(int32_t x, int32_t y)
+    {
+        uint32_t hash = static_cast<uint32_t>(x) * 73856093u ^ static_cast<uint32_t>(y) * 19349663u;
+        return ((hash >> 8) % 7 == 0 ? 0xFF000000 : 0xFFFFFFFF) ^ ((static_cast<uint32_t>(y) / 16) & 0xF);
+    }
+
+    struct Image
+    {
+        Image(uint32_t width, uint32_t height) : m_Pixels(static_cast<size_t>(width) * height), m_Width(width), m_Height(height) {}
+
+        inline Takoyaki::FrameView GetView() { return { reinterpret_cast<uint8_t*>(m_Pixels.data()), m_Width, m_Height, m_Width * 4 }; }
+        inline bool IsInPane(uint32_t x, uint32_t y) const { return x >= PaneLeft && y >= PaneTop && y < m_Height - PaneMargin; }
+
+        std::vector<uint32_t> m_Pixels;
+        uint32_t m_Width;
+        uint32_t m_Height;
+    };
+
+    // The pane shows the document from (scrollX, scrollY), everything else stays put
+    void DrawDesktop(Image& image, int32_t scrollX, int32_t scrollY)
+    {
+        for (uint32_t y = 0; y < image.m_Height; ++y)
+        {
+            for (uint32_t x = 0; x < image.m_Width; ++x)
+            {
+                bool isPane = image.IsInPane(x, y);
+                image.m_Pixels[static_cast<size_t>(y) * image.m_Width + x] = GetDocumentPixel(x + (isPane ? scrollX : 0), y + (isPane ? scrollY : 0));
+            }
+        }
+    }
+
+    bool CheckDetector(uint32_t width, uint32_t height, int32_t scrollX, int32_t scrollY, bool hasOtherChange)
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "%ux%u scroll (%d, %d)%s", width, height, scrollX, scrollY, hasOtherChange ? " + edit" : "");
+        Check check(name);
+
+        Image previous(width, height);
+        Image current(width, height);
+        DrawDesktop(previous, 0, 0);
+        DrawDesktop(current, scrollX, scrollY);
+
+        if (hasOtherChange)
+        {
+            for (uint32_t y = 20; y < 30; ++y)
+                std::fill_n(current.m_Pixels.begin() + y * width + 50, 30, 0xFF123456);
+        }
+
+        Takoyaki::MotionDetector detector;
+        Takoyaki::MotionResult motion;
+        detector.Detect(previous.GetView(), current.GetView(), motion);
+
+        // What a viewer holding the previous frame ends up with
+        Image rebuilt = previous;
+        for (const Takoyaki::CopyRectOp& op : motion.m_Copies)
+        {
+            Takoyaki::Stream::CopyRect copy = { op.m_Source.m_X, op.m_Source.m_Y, op.m_Source.m_Width, op.m_Source.m_Height, op.m_DestX, op.m_DestY };
+            check.Expect(Takoyaki::Stream::ApplyCopy(copy, rebuilt.GetView()), "copy outside the frame");
+        }
+
+        size_t dirtyPixels = 0;
+        for (const Takoyaki::Rect& rect : motion.m_DirtyRects)
+        {
+            for (uint32_t y = 0; y < rect.m_Height; ++y)
+                memcpy(rebuilt.GetView().GetRow(rect.m_Y + y) + rect.m_X, current.GetView().GetRow(rect.m_Y + y) + rect.m_X, rect.m_Width * 4);
+
+            dirtyPixels += static_cast<size_t>(rect.m_Width) * rect.m_Height;
+        }
+
+        check.Expect(!motion.m_Copies.empty(), "no copies");
+        check.Expect(rebuilt.m_Pixels == current.m_Pixels, "rebuilt frame differs");
+
+        // The pane is most of the frame, so a found scroll leaves only a strip dirty
+        check.Expect(dirtyPixels * 4 < static_cast<size_t>(width) * height, "most of the frame dirty");
+
+        const int iterations = 20;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            detector.Detect(previous.GetView(), current.GetView(), motion);
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        bool passed = check.Finish();
+        printf("  %zu copies, %zu dirty rects, %.1f%% of pixels dirty, %.2f ms\n", motion.m_Copies.size(), motion.m_DirtyRects.size(),
+            100.0 * dirtyPixels / (static_cast<double>(width) * height), elapsed.count() / iterations);
+
+        return passed;
+    }
+
+    struct StreamResult
+    {
+        bool m_Passed = false;
+        Takoyaki::StreamViewerStats m_Stats;
+    };
+
+    // Publishes one frame at a time and waits for the viewer to rebuild it, so that no frame
+    // is skipped and every one can be compared
+    StreamResult RunStream(uint32_t frames, bool detectMotion)
+    {
+        Check check(detectMotion ? "stream with motion detection" : "stream without");
+
+        const std::string socketPath = "/tmp/takoscroll-" + std::to_string(getpid()) + ".sock";
+
+        Takoyaki::FrameBroadcaster broadcaster;
+        Takoyaki::StreamServer server;
+        server.SetMotionDetection(detectMotion);
+
+        StreamResult result;
+        if (!server.Start(socketPath.c_str(), broadcaster))
+        {
+            check.Expect(false, "server did not start");
+            return result;
+        }
+
+        Takoyaki::StreamViewer viewer;
+        check.Expect(viewer.Connect(socketPath.c_str()), "viewer did not connect");
+
+        Image desktop(StreamWidth, StreamHeight);
+        for (uint32_t i = 0; i < frames && viewer.IsConnected(); ++i)
+        {
+            DrawDesktop(desktop, 0, static_cast<int32_t>(i * ScrollPerFrame));
+
+            // A status bar below the pane that changes every few frames
+            if (i % 5 == 0)
+            {
+                for (uint32_t y = StreamHeight - 20; y < StreamHeight - 10; ++y)
+                    std::fill_n(desktop.m_Pixels.begin() + y * StreamWidth + 20 + i, 40, 0xFF2060A0);
+            }
+
+            Takoyaki::WritableFrame writable = broadcaster.AcquireFrame(StreamWidth, StreamHeight);
+            Takoyaki::FrameView view = writable.GetView();
+            for (uint32_t y = 0; y < StreamHeight; ++y)
+                memcpy(view.GetRow(y), desktop.GetView().GetRow(y), StreamWidth * 4);
+
+            // Frame IDs start at 0, which is also what the viewer reports before its first frame
+            const uint64_t frameId = broadcaster.Publish(std::move(writable))->GetFrameId();
+            while (viewer.ReceiveFrame() && viewer.GetFrameId() != frameId)
+                ;
+
+            check.Expect(viewer.IsConnected(), "viewer disconnected");
+            if (!viewer.IsConnected())
+                break;
+
+            const Takoyaki::FrameView rebuilt = viewer.GetFrame();
+            for (uint32_t y = 0; y < StreamHeight; ++y)
+                check.Expect(memcmp(rebuilt.GetRow(y), desktop.GetView().GetRow(y), StreamWidth * 4) == 0, "rebuilt frame differs");
+        }
+
+        result.m_Stats = viewer.GetStats();
+        viewer.Disconnect();
+        server.Stop();
+
+        if (detectMotion)
+            check.Expect(result.m_Stats.m_CopiesReceived != 0, "no copies received");
+
+        result.m_Passed = check.Finish();
+        printf("  %llu frames, %llu tiles, %llu copies, %.2f MB\n",
+            static_cast<unsigned long long>(result.m_Stats.m_FramesReceived),
+            static_cast<unsigned long long>(result.m_Stats.m_TilesReceived),
+            static_cast<unsigned long long>(result.m_Stats.m_CopiesReceived),
+            result.m_Stats.m_BytesReceived / (1024.0 * 1024.0));
+
+        return result;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t frames = argc > 1 ? std::max(atoi(argv[1]), 2) : 60;
+
+    // A viewer that stops responding would otherwise hang the check
+    alarm(120);
+
+    bool passed = CheckDetector(1920, 1080, 0, 37, false);
+    passed = CheckDetector(1920, 1080, 0, -120, true) && passed;
+    passed = CheckDetector(1920, 1080, 64, 0, false) && passed;
+    passed = CheckDetector(1920, 1080, -5, 0, true) && passed;
+    passed = CheckDetector(3840, 2160, 0, 3, false) && passed;
+
+    StreamResult plain = RunStream(frames, false);
+    StreamResult motion = RunStream(frames, true);
+    passed = plain.m_Passed && motion.m_Passed && passed;
+
+    Check saving("motion detection saves data");
+    saving.Expect(motion.m_Stats.m_BytesReceived < plain.m_Stats.m_BytesReceived, "no less data");
+    passed = saving.Finish() && passed;
+    printf("  %.1f%% of the data without it\n", 100.0 * motion.m_Stats.m_BytesReceived / std::max<double>(static_cast<double>(plain.m_Stats.m_BytesReceived), 1.0));
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,372 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Replays an input event script against the selection controller, from a loop shaped like
+// the tray app's message loop: one input event handled per iteration, the edge map snapshot
+// taken before the overlay shows, and capture and present run as frame pipeline stages that
+// the loop polls. A synthetic display stands in for desktop duplication and the swap chain,
+// with a new desktop image and a vertical blank every refresh interval. Events are stamped
+// with their script time rather than when the loop got to them, so the latencies include
+// any time they spent queued behind a present.
+//
+//     takoselect [script] [refresh ms]
+//
+// A script has one event per line, at a time in ms from the start, and # starts a comment:
+//
+//     <ms> hotkey | cancel | down <x> <y> | move <x> <y> | up | start | stop
+//
+// Without a script, or with -, a built-in one makes a few selections on a 2560x1440 desktop.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "edgemap.h"
+#include "framepipeline.h"
+#include "selectioncontroller.h"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    constexpr uint32_t Width = 2560;
+    constexpr uint32_t Height = 1440;
+    constexpr int32_t SnapRadius = 8;
+
+    // Left over after the last event, for the last selection's first frame
+    constexpr std::chrono::milliseconds Tail{ 250 };
+
+    struct ScriptEvent
+    {
+        std::chrono::microseconds m_Time{ 0 };
+        Takoyaki::SelectionEvent m_Event = Takoyaki::SelectionEvent::Hotkey;
+        int32_t m_X = 0;
+        int32_t m_Y = 0;
+    };
+
+    // Selections dragged from a little off the corners of the windows below, so they snap,
+    // one cancelled, and a stop and start from the tray
+    // Selections dragged from a little off the corners of the windows below, so they snap,
+    // one over the wallpaper, one cancelled, and a stop and start from the tray
+    const char* BuiltInScript = R"(
+        0    hotkey
+        400  down 206 125
+        420  move 400 300
+        440  move 800 600
+        460  move 1095 815
+        500  up
+        1500 hotkey
+        1900 down 1305 395
+        1940 move 2000 900
+        1980 move 2395 1195
+        2000 up
+        3000 hotkey
+        3200 cancel
+        3600 stop
+        3800 start
+        4500 hotkey
+        4900 down 395 905
+        4950 move 1195 1345
+        5000 up
+        6000 hotkey
+        6300 down 1400 60
+        6320 move 1800 200
+        6340 move 2200 300
+        6360 up
+    )";
+
+    struct Window
+    {
+        int32_t m_X;
+        int32_t m_Y;
+        int32_t m_Width;
+        int32_t m_Height;
+    };
+
+    const Window Windows[] =
+    {
+        { 200, 120, 900, 700 },
+        { 1300, 400, 1100, 800 },
+        { 400, 900, 800, 450 },
+    };
+
+    bool ParseScript(const std::string& text, std::vector<ScriptEvent>& outEvents)
+    {
+        std::istringstream lines(text);
+        std::string line;
+        uint32_t lineNumber = 0;
+
+        while (std::getline(lines, line))
+        {
+            ++lineNumber;
+            line = line.substr(0, line.find('#'));
+
+            std::istringstream fields(line);
+            double time = 0.0;
+            std::string name;
+
+            if (!(fields >> time))
+                continue;
+
+            ScriptEvent event;
+            event.m_Time = std::chrono::microseconds(static_cast<int64_t>(time * 1000));
+
+            bool isValid = static_cast<bool>(fields >> name);
+            if (name == "hotkey")
+                event.m_Event = Takoyaki::SelectionEvent::Hotkey;
+            else if (name == "cancel")
+                event.m_Event = Takoyaki::SelectionEvent::Cancel;
+            else if (name == "down")
+                event.m_Event = Takoyaki::SelectionEvent::PointerDown;
+            else if (name == "move")
+                event.m_Event = Takoyaki::SelectionEvent::PointerMove;
+            else if (name == "up")
+                event.m_Event = Takoyaki::SelectionEvent::PointerUp;
+            else if (name == "start")
+                event.m_Event = Takoyaki::SelectionEvent::StartCapture;
+            else if (name == "stop")
+                event.m_Event = Takoyaki::SelectionEvent::StopCapture;
+            else
+                isValid = false;
+
+            if (event.m_Event == Takoyaki::SelectionEvent::PointerDown || event.m_Event == Takoyaki::SelectionEvent::PointerMove)
+                isValid = isValid && static_cast<bool>(fields >> event.m_X >> event.m_Y);
+
+            if (!isValid)
+            {
+                fprintf(stderr, "Takoyaki: line %u of the script is not an event: %s\n", lineNumber, line.c_str());
+                return false;
+            }
+
+            outEvents.push_back(event);
+        }
+
+        // Replayed in time order, whatever order they were written in
+        std::stable_sort(outEvents.begin(), outEvents.end(), [](const ScriptEvent& a, const ScriptEvent& b) { return a.m_Time < b.m_Time; });
+        return true;
+    }
+
+    // Stands in for desktop duplication and the swap chain. The desktop is redrawn every
+    // refresh interval, and a capture only gets a frame if there has been one since the last.
+    class SyntheticDisplay
+    {
+    public:
+        explicit SyntheticDisplay(std::chrono::microseconds refresh) : m_Refresh(refresh), m_Start(Clock::now()), m_Pixels(static_cast<size_t>(Width) * Height)
+        {
+            for (uint32_t y = 0; y < Height; ++y)
+            {
+                for (uint32_t x = 0; x < Width; ++x)
+                    m_Pixels[static_cast<size_t>(y) * Width + x] = 0xFF000000 | ((x * 96 / Width) << 16) | ((y * 96 / Height) << 8) | 0x60;
+            }
+
+            for (const Window& window : Windows)
+            {
+                for (int32_t y = window.m_Y; y < window.m_Y + window.m_Height; ++y)
+                {
+                    for (int32_t x = window.m_X; x < window.m_X + window.m_Width; ++x)
+                    {
+                        bool isBorder = x == window.m_X || y == window.m_Y || x == window.m_X + window.m_Width - 1 || y == window.m_Y + window.m_Height - 1;
+                        m_Pixels[static_cast<size_t>(y) * Width + x] = isBorder ? 0xFF505050 : y < window.m_Y + 32 ? 0xFFE8E8E8 : 0xFFFFFFFF;
+                    }
+                }
+            }
+        }
+
+        inline Takoyaki::FrameView GetDesktop() { return { reinterpret_cast<uint8_t*>(m_Pixels.data()), Width, Height, Width * 4 }; }
+        inline const std::vector<uint32_t>& GetPixels() const { return m_Pixels; }
+
+        // False if the desktop has not been redrawn since the last frame acquired
+        bool AcquireFrame()
+        {
+            uint64_t frame = GetFrameNumber(Clock::now());
+            if (frame == m_LastFrame)
+                return false;
+
+            m_LastFrame = frame;
+            return true;
+        }
+
+        // What Present with a sync interval of one waits for
+        void WaitForVblank() const
+        {
+            std::this_thread::sleep_until(m_Start + m_Refresh * (GetFrameNumber(Clock::now()) + 1));
+        }
+
+    private:
+        inline uint64_t GetFrameNumber(Clock::time_point time) const { return static_cast<uint64_t>((time - m_Start) / m_Refresh); }
+
+    private:
+        std::chrono::microseconds m_Refresh;
+        Clock::time_point m_Start;
+        std::vector<uint32_t> m_Pixels;
+        uint64_t m_LastFrame = UINT64_MAX;
+    };
+}
+
+int main(int argc, char** argv)
+{
+    std::string script = BuiltInScript;
+
+    if (argc > 1 && strcmp(argv[1], "-") != 0)
+    {
+        std::ifstream file(argv[1]);
+        if (!file)
+        {
+            fprintf(stderr, "Takoyaki: failed to open %s\n", argv[1]);
+            return 1;
+        }
+
+        std::ostringstream contents;
+        contents << file.rdbuf();
+        script = contents.str();
+    }
+
+    const double refreshMs = argc > 2 ? atof(argv[2]) : 1000.0 / 60.0;
+    if (refreshMs <= 0.0)
+    {
+        fprintf(stderr, "Takoyaki: the refresh interval must be positive\n");
+        return 1;
+    }
+
+    std::vector<ScriptEvent> events;
+    if (!ParseScript(script, events))
+        return 1;
+
+    SyntheticDisplay display(std::chrono::microseconds(static_cast<int64_t>(refreshMs * 1000)));
+    Takoyaki::SelectionController selection;
+    Takoyaki::EdgeMap edgeMap;
+
+    // Polled from the loop, as in the tray app
+    Takoyaki::Executor executor(0);
+    Takoyaki::FramePipeline pipeline(executor);
+    Takoyaki::FramePool pool;
+
+    pipeline.AddSource("capture", [&](Takoyaki::PipelineFrame& frame)
+    {
+        if (!selection.IsCapturing() || selection.IsOverlayActive() || !display.AcquireFrame())
+            return Takoyaki::StageResult::Drop;
+
+        // Clamped to the desktop, the way the capture is
+        Takoyaki::Rect rect = selection.GetCaptureRect();
+        int32_t left = std::clamp(rect.m_X, 0, static_cast<int32_t>(Width));
+        int32_t top = std::clamp(rect.m_Y, 0, static_cast<int32_t>(Height));
+        int32_t right = std::clamp(rect.m_X + static_cast<int32_t>(rect.m_Width), left, static_cast<int32_t>(Width));
+        int32_t bottom = std::clamp(rect.m_Y + static_cast<int32_t>(rect.m_Height), top, static_cast<int32_t>(Height));
+
+        if (right == left || bottom == top)
+            return Takoyaki::StageResult::Drop;
+
+        Takoyaki::FrameView desktop = display.GetDesktop().GetSubView({ left, top, static_cast<uint32_t>(right - left), static_cast<uint32_t>(bottom - top) });
+
+        frame.m_Region = rect;
+        frame.m_Writable = pool.Acquire(desktop.m_Width, desktop.m_Height);
+
+        Takoyaki::FrameView view = frame.m_Writable.GetView();
+        for (uint32_t y = 0; y < view.m_Height; ++y)
+            memcpy(view.GetRow(y), desktop.GetRow(y), static_cast<size_t>(view.m_Width) * 4);
+
+        return Takoyaki::StageResult::Continue;
+    });
+
+    pipeline.AddStage("present", [&](Takoyaki::PipelineFrame& frame)
+    {
+        // A frame of a region since replaced is not worth showing
+        if (!selection.IsCapturing() || frame.m_Region != selection.GetCaptureRect())
+            return Takoyaki::StageResult::Drop;
+
+        frame.m_Frame = Takoyaki::FrameRef(std::move(frame.m_Writable));
+        display.WaitForVblank();
+        selection.OnFramePresented();
+
+        return Takoyaki::StageResult::Continue;
+    }, 1);
+
+    pipeline.Start();
+
+    const Clock::time_point start = Clock::now();
+    const Clock::time_point end = start + (events.empty() ? std::chrono::microseconds(0) : events.back().m_Time) + Tail;
+    std::chrono::microseconds maxQueued{ 0 };
+    size_t next = 0;
+
+    while (Clock::now() < end)
+    {
+        bool isBusy = false;
+
+        // One event per iteration, like PeekMessage
+        if (next < events.size() && start + events[next].m_Time <= Clock::now())
+        {
+            ScriptEvent event = events[next++];
+            Clock::time_point time = start + event.m_Time;
+            maxQueued = std::max(maxQueued, std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - time));
+
+            switch (event.m_Event)
+            {
+            case Takoyaki::SelectionEvent::Hotkey: selection.OnHotkey(time); break;
+            case Takoyaki::SelectionEvent::Cancel: selection.OnCancel(time); break;
+            case Takoyaki::SelectionEvent::PointerDown: edgeMap.Snap(event.m_X, event.m_Y, SnapRadius); selection.OnPointerDown(event.m_X, event.m_Y, time); break;
+            case Takoyaki::SelectionEvent::PointerMove: edgeMap.Snap(event.m_X, event.m_Y, SnapRadius); selection.OnPointerMove(event.m_X, event.m_Y, time); break;
+            case Takoyaki::SelectionEvent::PointerUp: selection.OnPointerUp(time); break;
+            case Takoyaki::SelectionEvent::StartCapture: selection.SetCapturing(true, time); break;
+            case Takoyaki::SelectionEvent::StopCapture: selection.SetCapturing(false, time); break;
+            }
+
+            isBusy = true;
+        }
+
+        if (selection.IsOverlayActive() && !selection.IsOverlayShown())
+        {
+            // The snapshot is copied before the overlay can be in it, and indexed in the
+            // background, then the overlay appears with the next composition
+            edgeMap.BuildAsync(display.GetPixels(), Width, Height, 0, 0);
+            display.WaitForVblank();
+            selection.OnOverlayShown();
+            isBusy = true;
+        }
+
+        if (!selection.IsOverlayActive())
+            isBusy |= executor.Poll() != 0;
+
+        if (!isBusy)
+            std::this_thread::yield();
+    }
+
+    pipeline.Stop();
+    pipeline.Wait();
+
+    printf("Transitions:\n");
+    for (const Takoyaki::SelectionTransition& transition : selection.GetTransitions())
+    {
+        printf("  %9.2f ms  %-13s  %s -> %s\n", std::chrono::duration<double, std::milli>(transition.m_Time - start).count(),
+            Takoyaki::GetSelectionEventName(transition.m_Event), Takoyaki::GetSelectionStateName(transition.m_From), Takoyaki::GetSelectionStateName(transition.m_To));
+    }
+
+    Takoyaki::Rect capture = selection.GetCaptureRect();
+    printf("Last capture rect: %d,%d %ux%u\n", capture.m_X, capture.m_Y, capture.m_Width, capture.m_Height);
+    printf("Longest an event waited for the loop: %.2f ms\n", maxQueued.count() / 1000.0);
+    printf("%s%s", edgeMap.GetReport().c_str(), selection.GetReport().c_str());
+
+    return 0;
+}
@@ -0,0 +1,83 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Saves one PNG screenshot of a region of the X11 desktop, and prints how long the
+// encode took.
+//
+//     takoshot [output path] [x y width height]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "screenshotwriter.h"
+#include "x11capture.h"
+
+int main(int argc, char** argv)
+{
+    const char* outputPath = argc > 1 ? argv[1] : nullptr;
+
+    Takoyaki::X11Capture capture;
+    if (!capture.Initialize())
+        return 1;
+
+    Takoyaki::Rect rect = capture.GetScreenRect();
+    if (argc > 5)
+        rect = { atoi(argv[2]), atoi(argv[3]), static_cast<uint32_t>(atoi(argv[4])), static_cast<uint32_t>(atoi(argv[5])) };
+
+    capture.SetTargetRect(rect);
+
+    Takoyaki::FrameView captured;
+    if (capture.CaptureIntoBuffer(captured) != Takoyaki::X11CaptureError::OK)
+    {
+        fprintf(stderr, "Takoyaki: failed to capture the screen\n");
+        return 1;
+    }
+
+    // The capture buffer is reused by the next grab, so the writer gets its own copy
+    Takoyaki::FramePool pool(Takoyaki::MemoryCategory::Snapshot);
+    Takoyaki::WritableFrame frame = pool.Acquire(captured.m_Width, captured.m_Height);
+    Takoyaki::FrameView view = frame.GetView();
+
+    for (uint32_t y = 0; y < captured.m_Height; ++y)
+        memcpy(view.GetRow(y), captured.GetRow(y), captured.m_Width * 4);
+
+    Takoyaki::ScreenshotWriter writer;
+    bool isSaved = false;
+
+    writer.SetCompletionCallback([&isSaved](const Takoyaki::ScreenshotResult& result)
+    {
+        isSaved = result.m_IsSaved;
+        if (!isSaved)
+            return;
+
+        const Takoyaki::PngEncodeStats& stats = result.m_EncodeStats;
+        printf("%s: %ux%u, %.2f MB, encoded in %.1f ms (filter %.1f ms, deflate %.1f ms, %u bands on %u threads)\n",
+            result.m_Path.string().c_str(), result.m_Width, result.m_Height, result.m_FileSize / (1024.0 * 1024.0),
+            stats.m_TotalTime.count() / 1000.0, stats.m_FilterTime.count() / 1000.0, stats.m_DeflateTime.count() / 1000.0,
+            stats.m_BandCount, stats.m_ThreadCount);
+    });
+
+    std::filesystem::path path = outputPath ? outputPath : Takoyaki::ScreenshotWriter::MakeFileName(std::chrono::system_clock::now());
+    writer.Request(Takoyaki::FrameRef(std::move(frame)), { 0, 0, captured.m_Width, captured.m_Height }, path);
+    writer.WaitUntilIdle();
+
+    return isSaved ? 0 : 1;
+}
@@ -0,0 +1,373 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Captures a region of the X11 desktop and serves it on the stream socket.
+//
+//     takostream [-w] [-c] [-a] [-p] [-t] [-s] [-b megabytes] [-m x,y,width,height[,blur|pixelate[,strength]]]...
+//                [socket path] [x y width height] [fps]
+//
+// -w stamps every frame with a frame ID and capture time watermark for takoview -w.
+// -c draws the cursor into the frames. While only the cursor moves, frames are published
+// with just its old and new footprints marked as damaged.
+// -a crops away borders of the region that stay one colour or never change, so that only
+// the rect inside them is captured and sent.
+// -p sends frames with at most 256 colours as palette indices, one byte per pixel.
+// -t classifies every tile as flat, text, photo or video before the frame is published, and
+// attaches the map to it. Photo and video tiles are then sent without trying run-length
+// coding, and the share of each class is printed at exit.
+// -s finds scrolled and moved content and sends it as copies of what viewers already have,
+// followed by only the tiles that still differ.
+// -b caps the pixel memory of captured frames and stage scratch. Over it, idle pool buffers
+// and cached blocks are given back, and the report at exit counts what went over anyway.
+// -m blurs or pixelates a rect of the region in every frame before it leaves the process, and
+// can be repeated. The rect is relative to the region, and strength is the blur radius or
+// the pixelation block size.
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "autocropper.h"
+#include "cursorcompositor.h"
+#include "framealloc.h"
+#include "framebroadcaster.h"
+#include "framepipeline.h"
+#include "memorybudget.h"
+#include "privacymasker.h"
+#include "startuptimeline.h"
+#include "streamserver.h"
+#include "tileclassifier.h"
+#include "watermark.h"
+#include "x11capture.h"
+
+namespace
+{
+    volatile sig_atomic_t g_Running = 1;
+
+    void HandleSignal(int)
+    {
+        g_Running = 0;
+    }
+
+    bool ParseMask(const char* text, Takoyaki::PrivacyMask& outMask)
+    {
+        char style[16] = "blur";
+        int fields = sscanf(text, "%d,%d,%u,%u,%15[a-z],%u", &outMask.m_Rect.m_X, &outMask.m_Rect.m_Y, &outMask.m_Rect.m_Width, &outMask.m_Rect.m_Height, style, &outMask.m_Strength);
+        if (fields < 4 || outMask.m_Rect.m_Width == 0 || outMask.m_Rect.m_Height == 0)
+            return false;
+
+        if (strcmp(style, "blur") == 0)
+            outMask.m_Style = Takoyaki::MaskStyle::Blur;
+        else if (strcmp(style, "pixelate") == 0)
+            outMask.m_Style = Takoyaki::MaskStyle::Pixelate;
+        else
+            return false;
+
+        return true;
+    }
+
+    Takoyaki::FrameView GetReadView(const Takoyaki::FrameRef& frame)
+    {
+        // The classifier only reads through the view
+        return { const_cast<uint8_t*>(frame->GetData()), frame->GetWidth(), frame->GetHeight(), frame->GetStride() };
+    }
+
+    bool Overlaps(const Takoyaki::Rect& a, const Takoyaki::Rect& b)
+    {
+        return a.m_X < b.m_X + static_cast<int32_t>(b.m_Width) && b.m_X < a.m_X + static_cast<int32_t>(a.m_Width) &&
+            a.m_Y < b.m_Y + static_cast<int32_t>(b.m_Height) && b.m_Y < a.m_Y + static_cast<int32_t>(a.m_Height);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Takoyaki::StartupTimeline& timeline = Takoyaki::GetStartupTimeline();
+
+    bool useWatermark = false;
+    bool useCursor = false;
+    bool useAutoCrop = false;
+    bool usePalette = false;
+    bool useClassifier = false;
+    bool useMotion = false;
+    Takoyaki::PrivacyMasker masker;
+    for (; argc > 1 && argv[1][0] == '-' && argv[1][1] != '\0'; --argc, ++argv)
+    {
+        if (strcmp(argv[1], "-w") == 0)
+            useWatermark = true;
+        else if (strcmp(argv[1], "-c") == 0)
+            useCursor = true;
+        else if (strcmp(argv[1], "-a") == 0)
+            useAutoCrop = true;
+        else if (strcmp(argv[1], "-p") == 0)
+            usePalette = true;
+        else if (strcmp(argv[1], "-t") == 0)
+            useClassifier = true;
+        else if (strcmp(argv[1], "-s") == 0)
+            useMotion = true;
+        else if (strcmp(argv[1], "-m") == 0 && argc > 2)
+        {
+            Takoyaki::PrivacyMask mask;
+            if (!ParseMask(argv[2], mask))
+            {
+                fprintf(stderr, "Takoyaki: Invalid mask %s, expected x,y,width,height[,blur|pixelate[,strength]]\n", argv[2]);
+                return 1;
+            }
+
+            masker.AddMask(mask);
+            --argc;
+            ++argv;
+        }
+        else if (strcmp(argv[1], "-b") == 0 && argc > 2)
+        {
+            Takoyaki::GetMemoryBudget().SetBudget(strtoull(argv[2], nullptr, 10) * 1024 * 1024);
+            --argc;
+            ++argv;
+        }
+        else
+            break;
+    }
+
+    const char* socketPath = argc > 1 ? argv[1] : "/tmp/takoyaki.sock";
+
+    // Every stage walks whole frames, which at 1080p and up are well past a huge page
+    Takoyaki::GetFrameAllocator().SetUseHugePages(true);
+
+    Takoyaki::X11Capture capture;
+    {
+        Takoyaki::ScopedStartupPhase phase("X11 capture");
+        if (!capture.Initialize())
+            return 1;
+    }
+
+    Takoyaki::Rect rect = capture.GetScreenRect();
+    if (argc > 5)
+        rect = { atoi(argv[2]), atoi(argv[3]), static_cast<uint32_t>(atoi(argv[4])), static_cast<uint32_t>(atoi(argv[5])) };
+
+    const int fps = argc > 6 ? atoi(argv[6]) : 60;
+    capture.SetTargetRect(rect);
+
+    if (useCursor && !capture.IsCursorAvailable())
+    {
+        fprintf(stderr, "Takoyaki: XFixes is not available, the cursor will not be drawn\n");
+        useCursor = false;
+    }
+
+    Takoyaki::CursorCompositor cursor;
+    std::vector<Takoyaki::Rect> damage;
+
+    Takoyaki::AutoCropper cropper;
+    Takoyaki::Rect probedRect = rect;
+
+    Takoyaki::FrameBroadcaster broadcaster;
+    Takoyaki::StreamServer server;
+    server.SetPaletteMode(usePalette);
+    server.SetMotionDetection(useMotion);
+    {
+        Takoyaki::ScopedStartupPhase phase("stream server");
+        if (!server.Start(socketPath, broadcaster))
+            return 1;
+    }
+
+    signal(SIGINT, HandleSignal);
+    signal(SIGTERM, HandleSignal);
+
+    const auto interval = std::chrono::microseconds(1000000 / (fps > 0 ? fps : 60));
+    auto next = std::chrono::steady_clock::now();
+
+    // Capturing the next frame overlaps with stamping and publishing the one before it
+    Takoyaki::Executor executor(2);
+    Takoyaki::FramePipeline pipeline(executor);
+
+    pipeline.AddSource("capture", [&](Takoyaki::PipelineFrame& frame)
+    {
+        std::this_thread::sleep_until(next);
+        next += interval;
+
+        Takoyaki::FrameView captured;
+        frame.m_StartTime = std::chrono::steady_clock::now();
+
+        // Probes capture the whole region, every other frame only the crop inside it
+        const bool isProbe = useAutoCrop && cropper.BeginFrame();
+        if (useAutoCrop)
+        {
+            Takoyaki::Rect crop = cropper.GetCropRect();
+            capture.SetTargetRect(isProbe ? rect : Takoyaki::Rect{ probedRect.m_X + crop.m_X, probedRect.m_Y + crop.m_Y, crop.m_Width, crop.m_Height });
+        }
+
+        // The cursor is drawn into the capture's own image, which is only replaced when the
+        // desktop changes, so a cursor move alone can be sent as two small damage rects
+        const Takoyaki::X11CaptureError error = capture.CaptureIntoBuffer(captured);
+        const bool isReplaced = error == Takoyaki::X11CaptureError::OK;
+        damage.clear();
+
+        // Analysed before the cursor is drawn, which would otherwise count as content
+        if (isProbe && isReplaced)
+        {
+            probedRect = capture.GetClampedRect();
+            cropper.Analyze(captured);
+        }
+
+        if (useCursor && (isReplaced || (error == Takoyaki::X11CaptureError::NoChange && capture.GetLastFrame(captured))))
+        {
+            cursor.SetVisible(capture.UpdateCursor(cursor));
+
+            cursor.Composite(captured, isReplaced, damage);
+            if (!isReplaced && damage.empty())
+                return Takoyaki::StageResult::Drop;
+        }
+        else if (!isReplaced)
+        {
+            return Takoyaki::StageResult::Drop;
+        }
+
+        // Where the frame lies on screen, which with -a is only the crop inside the region
+        Takoyaki::Rect covered = capture.GetClampedRect();
+        if (isProbe && isReplaced)
+        {
+            Takoyaki::Rect crop = cropper.GetCropRect();
+            captured = captured.GetSubView(crop);
+            covered.m_X += crop.m_X;
+            covered.m_Y += crop.m_Y;
+        }
+
+        covered.m_Width = captured.m_Width;
+        covered.m_Height = captured.m_Height;
+
+        frame.m_Region = covered;
+        frame.m_Writable = broadcaster.AcquireFrame(captured.m_Width, captured.m_Height);
+        Takoyaki::FrameView view = frame.m_Writable.GetView();
+
+        for (uint32_t y = 0; y < captured.m_Height; ++y)
+            memcpy(view.GetRow(y), captured.GetRow(y), captured.m_Width * 4);
+
+        if (!isReplaced)
+        {
+            const size_t cursorDamage = damage.size();
+
+            // The watermark changes every frame, so it is always part of the damage
+            if (useWatermark)
+                damage.push_back({ 0, 0, Takoyaki::Watermark::GetWidth(), Takoyaki::Watermark::GetHeight() });
+
+            // A mask spreads a change under it over its whole rect, so it is damaged as a whole
+            for (const Takoyaki::PrivacyMask& mask : masker.GetMasks())
+            {
+                Takoyaki::Rect masked = { mask.m_Rect.m_X + rect.m_X - covered.m_X, mask.m_Rect.m_Y + rect.m_Y - covered.m_Y, mask.m_Rect.m_Width, mask.m_Rect.m_Height };
+                if (std::any_of(damage.begin(), damage.begin() + cursorDamage, [&](const Takoyaki::Rect& damaged) { return Overlaps(damaged, masked); }))
+                    damage.push_back(masked);
+            }
+
+            frame.m_Writable.SetDamage(damage);
+        }
+
+        frame.m_Writable.SetCaptureTime(frame.m_StartTime);
+        return Takoyaki::StageResult::Continue;
+    });
+
+    // Masked before the watermark is stamped, which has to stay readable
+    if (masker.HasMasks())
+    {
+        pipeline.AddStage("mask", [&](Takoyaki::PipelineFrame& frame)
+        {
+            masker.Apply(frame.m_Writable.GetView(), frame.m_Region.m_X - rect.m_X, frame.m_Region.m_Y - rect.m_Y);
+            return Takoyaki::StageResult::Continue;
+        });
+    }
+
+    // Every captured frame is published, so the sequence is the frame ID it will get
+    if (useWatermark)
+    {
+        pipeline.AddStage("watermark", [](Takoyaki::PipelineFrame& frame)
+        {
+            Takoyaki::Watermark::Encode(frame.m_Writable.GetView(), 0, 0, { static_cast<uint32_t>(frame.m_Sequence), Takoyaki::Watermark::GetTimestampUs(frame.m_StartTime) });
+            return Takoyaki::StageResult::Continue;
+        });
+    }
+
+    // Classified while publishing, as the change history needs the frame published right
+    // before this one, and this is the only stage that sees frames in order after it
+    Takoyaki::TileClassifier classifier(64);
+    Takoyaki::TileMap tileMap;
+    Takoyaki::FrameRef previous;
+    uint64_t classCounts[4] = {};
+
+    pipeline.AddStage("publish", [&](Takoyaki::PipelineFrame& frame)
+    {
+        if (useClassifier)
+        {
+            const Takoyaki::FrameView previousView = previous ? GetReadView(previous) : Takoyaki::FrameView{};
+            classifier.Classify(frame.m_Writable.GetView(), previous ? &previousView : nullptr, tileMap);
+            frame.m_Writable.SetTileMap(tileMap);
+
+            for (const Takoyaki::TileInfo& tile : tileMap.m_Tiles)
+                ++classCounts[static_cast<size_t>(tile.m_Class)];
+        }
+
+        Takoyaki::FrameRef published = broadcaster.Publish(std::move(frame.m_Writable));
+        if (useClassifier)
+            previous = std::move(published);
+
+        if (broadcaster.GetPublishedCount() == 1)
+            timeline.Mark("first frame");
+
+        return Takoyaki::StageResult::Continue;
+    });
+
+    pipeline.Start();
+
+    while (g_Running && !pipeline.IsDone())
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    pipeline.Stop();
+    pipeline.Wait();
+
+    server.Stop();
+
+    Takoyaki::StreamServerStats stats = server.GetStats();
+    printf("%llu frames (%llu keyframes, %llu with a palette), %llu tiles, %llu copies, %.2f MB sent to %llu viewers\n",
+        static_cast<unsigned long long>(stats.m_FramesSent),
+        static_cast<unsigned long long>(stats.m_KeyframesSent),
+        static_cast<unsigned long long>(stats.m_PaletteFramesSent),
+        static_cast<unsigned long long>(stats.m_TilesSent),
+        static_cast<unsigned long long>(stats.m_CopiesSent),
+        stats.m_BytesSent / (1024.0 * 1024.0),
+        static_cast<unsigned long long>(stats.m_ClientsAccepted));
+    printf("%llu frames skipped by viewers still taking an earlier one, %llu viewers dropped\n",
+        static_cast<unsigned long long>(stats.m_FramesSkipped),
+        static_cast<unsigned long long>(stats.m_ClientsDropped));
+
+    printf("%s", pipeline.GetReport().c_str());
+    if (useAutoCrop)
+        printf("%s", cropper.GetReport().c_str());
+
+    if (useClassifier)
+    {
+        const double tiles = std::max<double>(static_cast<double>(classCounts[0] + classCounts[1] + classCounts[2] + classCounts[3]), 1.0);
+        printf("Tiles: %.1f%% flat, %.1f%% text, %.1f%% photo, %.1f%% video\n",
+            classCounts[0] * 100.0 / tiles, classCounts[1] * 100.0 / tiles, classCounts[2] * 100.0 / tiles, classCounts[3] * 100.0 / tiles);
+    }
+    printf("%s", timeline.GetReport().c_str());
+    printf("%s", Takoyaki::GetMemoryBudget().GetReport().c_str());
+
+    return 0;
+}
@@ -0,0 +1,317 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Checks the frame sync policy against a lock that replays a script instead of waiting on a
+// real producer: that a stalled producer costs dropped frames and never more than the
+// deadline per frame, that the watchdog recovers at every multiple of the stall threshold,
+// that every failure is counted as its own reason, including presents that fail after the
+// lock is handed back, that recovery the owner asks for runs on the next frame and is retried
+// at the watchdog's pace until it succeeds, and that the lock is always handed back.
+// Exits with 1 if any scenario does not behave.
+//
+//     takosync
+
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <thread>
+#include "framesync.h"
+
+namespace
+{
+    using Takoyaki::SyncResult;
+
+    // Replays its script, then acquires every time. A timeout sleeps through the whole
+    // deadline like a producer holding on to the frame would.
+    class ScriptedLock : public Takoyaki::SyncPrimitive
+    {
+    public:
+        void Push(SyncResult result, uint32_t count = 1)
+        {
+            m_Script.insert(m_Script.end(), count, result);
+        }
+
+        SyncResult Acquire(std::chrono::milliseconds timeout) override
+        {
+            SyncResult result = SyncResult::Acquired;
+            if (!m_Script.empty())
+            {
+                result = m_Script.front();
+                m_Script.pop_front();
+            }
+
+            if (result == SyncResult::Timeout)
+                std::this_thread::sleep_for(timeout);
+
+            m_HeldCount += result == SyncResult::Acquired;
+            return result;
+        }
+
+        bool Release() override
+        {
+            --m_HeldCount;
+            return !m_IsReleaseFailing;
+        }
+
+    public:
+        int32_t m_HeldCount = 0;
+        bool m_IsReleaseFailing = false;
+
+    private:
+        std::deque<SyncResult> m_Script;
+    };
+
+    class Scenario
+    {
+    public:
+        explicit Scenario(const char* name) : m_Name(name) {}
+
+        void Expect(bool condition, const char* what)
+        {
+            if (!condition)
+                m_Failures += std::string(m_Failures.empty() ? "" : ", ") + what;
+        }
+
+        bool Finish(const Takoyaki::FrameSync& sync)
+        {
+            printf("%-20s %s\n", m_Name, m_Failures.empty() ? "ok" : ("FAILED: " + m_Failures).c_str());
+            if (!m_Failures.empty())
+                printf("%s", sync.GetReport().c_str());
+
+            return m_Failures.empty();
+        }
+
+    private:
+        const char* m_Name;
+        std::string m_Failures;
+    };
+
+    // Renders frames the way OutputManager does, aborting every abortEvery-th one
+    uint32_t RunFrames(Takoyaki::FrameSync& sync, uint32_t count, uint32_t abortEvery = 0)
+    {
+        uint32_t rendered = 0;
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (!sync.BeginFrame())
+                continue;
+
+            if (abortEvery != 0 && i % abortEvery == 0)
+            {
+                sync.AbortFrame();
+                continue;
+            }
+
+            sync.EndFrame();
+            ++rendered;
+        }
+
+        return rendered;
+    }
+
+    bool CheckHealthy()
+    {
+        ScriptedLock lock;
+        Takoyaki::FrameSync sync;
+        sync.SetPrimitive(&lock);
+
+        Scenario scenario("healthy producer");
+        scenario.Expect(RunFrames(sync, 50) == 50, "not every frame rendered");
+        scenario.Expect(sync.GetStats().GetDroppedCount() == 0, "frames dropped");
+        scenario.Expect(lock.m_HeldCount == 0, "lock not released");
+
+        return scenario.Finish(sync);
+    }
+
+    bool CheckStall()
+    {
+        ScriptedLock lock;
+        lock.Push(SyncResult::Timeout, 10);
+
+        uint32_t recoveries = 0;
+        Takoyaki::FrameSync sync;
+        sync.SetPrimitive(&lock);
+        sync.SetRecovery([&]() { ++recoveries; return true; });
+        sync.SetOptions({ std::chrono::milliseconds(5), 4 });
+
+        Scenario scenario("stall and recover");
+        auto start = std::chrono::steady_clock::now();
+        uint32_t rendered = RunFrames(sync, 12);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+
+        const Takoyaki::FrameSyncStats& stats = sync.GetStats();
+        scenario.Expect(rendered == 2, "frames after the stall not rendered");
+        scenario.Expect(stats.m_Timeouts == 10, "timeouts not counted");
+        scenario.Expect(recoveries == 2 && stats.m_Recoveries == 2, "watchdog did not recover at 4 and 8 drops");
+        scenario.Expect(stats.m_ConsecutiveDrops == 0, "drop streak not reset by a good frame");
+        scenario.Expect(stats.m_LastDropReason == Takoyaki::FrameDropReason::Timeout, "wrong drop reason");
+
+        // Generous against scheduling noise, a hang would be far beyond it
+        scenario.Expect(stats.m_MaxWait >= std::chrono::milliseconds(5) && stats.m_MaxWait < std::chrono::milliseconds(100), "wait not bounded by the deadline");
+        scenario.Expect(elapsed < std::chrono::seconds(1), "stall took too long");
+        scenario.Expect(lock.m_HeldCount == 0, "lock not released");
+
+        return scenario.Finish(sync);
+    }
+
+    bool CheckFailedRecovery()
+    {
+        ScriptedLock lock;
+        lock.Push(SyncResult::Failed, 9);
+
+        uint32_t attempts = 0;
+        Takoyaki::FrameSync sync;
+        sync.SetPrimitive(&lock);
+        sync.SetRecovery([&]() { return ++attempts == 3; });
+        sync.SetOptions({ std::chrono::milliseconds(5), 3 });
+
+        Scenario scenario("failed recovery");
+        RunFrames(sync, 10);
+
+        const Takoyaki::FrameSyncStats& stats = sync.GetStats();
+        scenario.Expect(stats.m_SyncFailures == 9, "sync failures not counted");
+        scenario.Expect(attempts == 3, "watchdog did not retry every 3 drops");
+        scenario.Expect(stats.m_FailedRecoveries == 2 && stats.m_Recoveries == 1, "recovery results not counted");
+        scenario.Expect(stats.m_Timeouts == 0, "failures counted as timeouts");
+
+        return scenario.Finish(sync);
+    }
+
+    bool CheckRenderAndReleaseFailures()
+    {
+        ScriptedLock lock;
+        Takoyaki::FrameSync sync;
+        sync.SetPrimitive(&lock);
+
+        Scenario scenario("render and release");
+        uint32_t rendered = RunFrames(sync, 9, 3);
+        scenario.Expect(rendered == 6, "aborted frames rendered");
+        scenario.Expect(sync.GetStats().m_RenderFailures == 3, "render failures not counted");
+        scenario.Expect(lock.m_HeldCount == 0, "aborted frames kept the lock");
+
+        lock.m_IsReleaseFailing = true;
+        RunFrames(sync, 2);
+        scenario.Expect(sync.GetStats().m_ReleaseFailures == 2, "release failures not counted");
+        scenario.Expect(sync.GetStats().m_LastDropReason == Takoyaki::FrameDropReason::ReleaseFailed, "wrong drop reason");
+
+        return scenario.Finish(sync);
+    }
+
+    bool CheckPresentFailures()
+    {
+        ScriptedLock lock;
+        uint32_t recoveries = 0;
+        Takoyaki::FrameSync sync;
+        sync.SetPrimitive(&lock);
+        sync.SetRecovery([&]() { ++recoveries; return true; });
+        sync.SetOptions({ std::chrono::milliseconds(5), 3 });
+
+        // Drawn and handed back, then lost at present, the way OutputManager reports it
+        Scenario scenario("present failures");
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            if (sync.BeginFrame())
+            {
+                sync.EndFrame();
+                sync.DropPresent();
+            }
+        }
+
+        const Takoyaki::FrameSyncStats& stats = sync.GetStats();
+        scenario.Expect(stats.m_PresentFailures == 4 && stats.GetDroppedCount() == 4, "present failures not counted as drops");
+        scenario.Expect(stats.m_LastDropReason == Takoyaki::FrameDropReason::PresentFailed, "wrong drop reason");
+        scenario.Expect(stats.m_ReleaseFailures == 0 && stats.m_RenderFailures == 0, "counted as another reason");
+        scenario.Expect(stats.m_ConsecutiveDrops == 1, "handing the lock back did not end the streak");
+        scenario.Expect(recoveries == 0, "watchdog ran on failed presents");
+        scenario.Expect(lock.m_HeldCount == 0, "lock not released");
+
+        return scenario.Finish(sync);
+    }
+
+    bool CheckRequestedRecovery()
+    {
+        ScriptedLock lock;
+        uint32_t attempts = 0;
+        Takoyaki::FrameSync sync;
+        sync.SetPrimitive(&lock);
+        sync.SetRecovery([&]() { return ++attempts == 3; });
+        sync.SetOptions({ std::chrono::milliseconds(5), 4 });
+
+        // A resize that failed, with recovery failing twice before the resources fit again
+        Scenario scenario("requested recovery");
+        sync.RequestRecovery();
+        scenario.Expect(sync.IsRecoveryPending() && attempts == 0, "recovery ran before the next frame");
+
+        uint32_t rendered = RunFrames(sync, 1);
+        scenario.Expect(attempts == 1, "recovery not run on the next frame");
+        scenario.Expect(rendered == 1, "frame dropped while recovery is pending");
+
+        rendered += RunFrames(sync, 3);
+        scenario.Expect(attempts == 1, "failed recovery retried before the stall threshold");
+
+        rendered += RunFrames(sync, 5);
+        scenario.Expect(attempts == 3, "failed recovery not retried every 4 frames");
+        scenario.Expect(!sync.IsRecoveryPending(), "still pending after recovering");
+
+        rendered += RunFrames(sync, 8);
+        scenario.Expect(attempts == 3, "recovered twice");
+        scenario.Expect(rendered == 17, "frames dropped around recovery");
+
+        const Takoyaki::FrameSyncStats& stats = sync.GetStats();
+        scenario.Expect(stats.m_Recoveries == 1 && stats.m_FailedRecoveries == 2, "recovery results not counted");
+        scenario.Expect(stats.GetDroppedCount() == 0, "frames dropped");
+
+        return scenario.Finish(sync);
+    }
+
+    bool CheckMisuse()
+    {
+        ScriptedLock lock;
+        Takoyaki::FrameSync sync;
+
+        Scenario scenario("misuse");
+        scenario.Expect(!sync.BeginFrame(), "began a frame without a lock");
+
+        sync.SetPrimitive(&lock);
+        scenario.Expect(sync.BeginFrame(), "first frame not acquired");
+        scenario.Expect(!sync.BeginFrame(), "began a frame while one is acquired");
+        sync.EndFrame();
+        sync.EndFrame();
+        sync.AbortFrame();
+
+        scenario.Expect(sync.GetStats().m_Waits == 1 && lock.m_HeldCount == 0, "unbalanced acquire and release");
+        return scenario.Finish(sync);
+    }
+}
+
+int main()
+{
+    bool isPassing = true;
+    isPassing &= CheckHealthy();
+    isPassing &= CheckStall();
+    isPassing &= CheckFailedRecovery();
+    isPassing &= CheckRenderAndReleaseFailures();
+    isPassing &= CheckPresentFailures();
+    isPassing &= CheckRequestedRecovery();
+    isPassing &= CheckMisuse();
+
+    return isPassing ? 0 : 1;
+}
@@ -0,0 +1,163 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Benchmarks the HDR tonemapper on 4K frames at every SIMD level this machine runs, against
+// the 16.7 ms a frame has at 60 fps, and checks each level against the float reference.
+//
+//     takotone [iterations]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "framealloc.h"
+#include "kernels/pixelkernels.h"
+#include "tonemapper.h"
+
+namespace
+{
+    constexpr uint32_t Width = 3840;
+    constexpr uint32_t Height = 2160;
+    constexpr double FrameBudgetMs = 1000.0 / 60.0;
+
+    // The float reference is slow, so accuracy is checked on a smaller frame
+    constexpr uint32_t CheckWidth = 509;
+    constexpr uint32_t CheckHeight = 64;
+
+    // Best of several runs, in seconds
+    template<typename Function>
+    double Measure(uint32_t iterations, Function&& function)
+    {
+        double best = 1e9;
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            auto start = std::chrono::steady_clock::now();
+            function();
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+
+        return best;
+    }
+
+    // Every code is equally likely, so the tables are read all over
+    std::vector<uint32_t> MakeHdr10(std::mt19937& rng, uint32_t width, uint32_t height)
+    {
+        std::vector<uint32_t> pixels(static_cast<size_t>(width) * height);
+        for (uint32_t& pixel : pixels)
+            pixel = rng() | 0xC0000000;
+
+        return pixels;
+    }
+
+    // Up to 1000 nits, with a few out of gamut negatives
+    std::vector<uint16_t> MakeFloat16(std::mt19937& rng, uint32_t width, uint32_t height)
+    {
+        std::uniform_real_distribution<float> distribution(-0.5f, 12.5f);
+        std::vector<uint16_t> halves(static_cast<size_t>(width) * height * 4);
+
+        for (uint16_t& half : halves)
+        {
+            float value = distribution(rng);
+            half = value < 0.0f ? static_cast<uint16_t>(0x8000 | Takoyaki::Kernels::FloatToHalfBits(-value)) : Takoyaki::Kernels::FloatToHalfBits(value);
+        }
+
+        return halves;
+    }
+
+    // Largest difference in any channel from the float reference
+    uint32_t GetMaxError(const Takoyaki::Tonemapper& tonemapper, const Takoyaki::HdrFrameView& src, const Takoyaki::PixelKernels& kernels)
+    {
+        std::vector<uint32_t> expected(static_cast<size_t>(src.m_Width) * src.m_Height);
+        std::vector<uint32_t> actual(expected.size());
+        Takoyaki::FrameView expectedView = { reinterpret_cast<uint8_t*>(expected.data()), src.m_Width, src.m_Height, src.m_Width * 4 };
+        Takoyaki::FrameView actualView = { reinterpret_cast<uint8_t*>(actual.data()), src.m_Width, src.m_Height, src.m_Width * 4 };
+
+        tonemapper.ConvertReference(src, expectedView);
+        tonemapper.Convert(src, actualView, kernels);
+
+        uint32_t maxError = 0;
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+            for (uint32_t shift = 0; shift < 32; shift += 8)
+            {
+                int32_t difference = static_cast<int32_t>((expected[i] >> shift) & 0xFF) - static_cast<int32_t>((actual[i] >> shift) & 0xFF);
+                maxError = std::max<uint32_t>(maxError, std::abs(difference));
+            }
+        }
+
+        return maxError;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t iterations = argc > 1 ? std::max(atoi(argv[1]), 1) : 20;
+
+    std::mt19937 rng(7);
+    std::vector<uint32_t> hdr10 = MakeHdr10(rng, Width, Height);
+    std::vector<uint16_t> float16 = MakeFloat16(rng, Width, Height);
+    std::vector<uint32_t> hdr10Check = MakeHdr10(rng, CheckWidth, CheckHeight);
+    std::vector<uint16_t> float16Check = MakeFloat16(rng, CheckWidth, CheckHeight);
+
+    const Takoyaki::HdrFrameView hdr10View = { reinterpret_cast<const uint8_t*>(hdr10.data()), Width, Height, Width * 4, Takoyaki::HdrFormat::Hdr10 };
+    const Takoyaki::HdrFrameView float16View = { reinterpret_cast<const uint8_t*>(float16.data()), Width, Height, Width * 8, Takoyaki::HdrFormat::ScRgbFloat16 };
+    const Takoyaki::HdrFrameView hdr10CheckView = { reinterpret_cast<const uint8_t*>(hdr10Check.data()), CheckWidth, CheckHeight, CheckWidth * 4, Takoyaki::HdrFormat::Hdr10 };
+    const Takoyaki::HdrFrameView float16CheckView = { reinterpret_cast<const uint8_t*>(float16Check.data()), CheckWidth, CheckHeight, CheckWidth * 8, Takoyaki::HdrFormat::ScRgbFloat16 };
+
+    Takoyaki::FrameAllocation allocation = Takoyaki::GetFrameAllocator().Allocate(static_cast<size_t>(Takoyaki::GetPaddedStride(Width)) * Height);
+    const Takoyaki::FrameView dst = { allocation.m_Data, Width, Height, Takoyaki::GetPaddedStride(Width) };
+    memset(allocation.m_Data, 0, allocation.m_Size);
+
+    Takoyaki::Tonemapper tonemapper;
+
+    printf("4K frames, best of %u, against %.1f ms a frame at 60 fps\n", iterations, FrameBudgetMs);
+    printf("%-8s %-7s %10s %10s %10s %10s\n", "level", "format", "ms", "MP/s", "60 fps", "max error");
+
+    for (uint32_t level = 0; level < static_cast<uint32_t>(Takoyaki::SimdLevel::Count); ++level)
+    {
+        Takoyaki::PixelKernels kernels = Takoyaki::BindPixelKernels(static_cast<Takoyaki::SimdLevel>(level));
+        if (kernels.m_Level != static_cast<Takoyaki::SimdLevel>(level))
+            continue;
+
+        struct Format
+        {
+            const char* m_Name;
+            const Takoyaki::HdrFrameView& m_View;
+            const Takoyaki::HdrFrameView& m_CheckView;
+        };
+
+        const Format formats[] = { { "hdr10", hdr10View, hdr10CheckView }, { "fp16", float16View, float16CheckView } };
+
+        for (const Format& format : formats)
+        {
+            double seconds = Measure(iterations, [&]() { tonemapper.Convert(format.m_View, dst, kernels); });
+            double ms = seconds * 1000.0;
+
+            printf("%-8s %-7s %10.2f %10.1f %10s %10u\n", Takoyaki::GetSimdLevelName(kernels.m_Level), format.m_Name, ms,
+                Width * Height / seconds / 1e6, ms <= FrameBudgetMs ? "fits" : "MISSES", GetMaxError(tonemapper, format.m_CheckView, kernels));
+        }
+    }
+
+    Takoyaki::GetFrameAllocator().Free(allocation);
+    return 0;
+}
@@ -0,0 +1,104 @@
+/*
+    This file is part of Takoyaki, a custom screen share utility.
+
+    Copyright (c) 2020-2023 Samuel Huang - All rights reserved.
+
+    Takoyaki is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Headless reference viewer for the stream socket. Reconstructs every frame and prints the
+// bandwidth and capture to reconstruction latency once a second.
+//
+//     takoview [-w] [socket path] [seconds]
+//
+// -w also reads back the watermark stamped by takostream -w and prints its latency
+// distribution at the end.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "streamviewer.h"
+#include "watermark.h"
+
+int main(int argc, char** argv)
+{
+    const bool useWatermark = argc > 1 && strcmp(argv[1], "-w") == 0;
+    if (useWatermark)
+    {
+        --argc;
+        ++argv;
+    }
+
+    const char* socketPath = argc > 1 ? argv[1] : "/tmp/takoyaki.sock";
+    const int seconds = argc > 2 ? atoi(argv[2]) : 0;
+
+    Takoyaki::StreamViewer viewer;
+    if (!viewer.Connect(socketPath))
+        return 1;
+
+    auto start = std::chrono::steady_clock::now();
+    auto lastReport = start;
+    Takoyaki::StreamViewerStats lastStats;
+    Takoyaki::LatencyReport latencyReport;
+    const Takoyaki::Rect watermarkRect = { 0, 0, Takoyaki::Watermark::GetWidth(), Takoyaki::Watermark::GetHeight() };
+
+    while (viewer.ReceiveFrame())
+    {
+        auto now = std::chrono::steady_clock::now();
+
+        if (useWatermark)
+        {
+            Takoyaki::WatermarkData watermark;
+            if (Takoyaki::Watermark::Decode(viewer.GetFrame(), watermarkRect, watermark))
+                latencyReport.AddFrame(watermark, now);
+            else
+                latencyReport.AddUndecodable();
+        }
+        if (now - lastReport < std::chrono::seconds(1))
+            continue;
+
+        const Takoyaki::StreamViewerStats& stats = viewer.GetStats();
+        double elapsed = std::chrono::duration<double>(now - lastReport).count();
+        uint64_t frames = stats.m_FramesReceived - lastStats.m_FramesReceived;
+
+        printf("%ux%u  %.1f fps  %.2f MB/s  %.1f tiles/frame  latency avg %.2f ms, max %.2f ms\n",
+            viewer.GetFrame().m_Width, viewer.GetFrame().m_Height,
+            frames / elapsed,
+            (stats.m_BytesReceived - lastStats.m_BytesReceived) / elapsed / (1024.0 * 1024.0),
+            frames ? static_cast<double>(stats.m_TilesReceived - lastStats.m_TilesReceived) / frames : 0.0,
+            stats.GetAverageLatency().count() / 1000.0,
+            stats.m_MaxLatency.count() / 1000.0);
+
+        lastStats = stats;
+        lastReport = now;
+
+        if (seconds > 0 && now - start >= std::chrono::seconds(seconds))
+            break;
+    }
+
+    const Takoyaki::StreamViewerStats& stats = viewer.GetStats();
+    printf("%llu frames (%llu keyframes), %llu tiles, %llu copies, %.2f MB\n",
+        static_cast<unsigned long long>(stats.m_FramesReceived),
+        static_cast<unsigned long long>(stats.m_KeyframesReceived),
+        static_cast<unsigned long long>(stats.m_TilesReceived),
+        static_cast<unsigned long long>(stats.m_CopiesReceived),
+        stats.m_BytesReceived / (1024.0 * 1024.0));
+
+    if (useWatermark)
+        printf("%s", latencyReport.GetReport().c_str());
+
+    return 0;
+}